@@ -0,0 +1,20 @@
+/*
+ * Host shim for <avr/interrupt.h>.
+ *
+ * Vectors become ordinary functions that the simulator calls when the
+ * corresponding flag is pending, enabled and the global I bit is set.
+ */
+#ifndef LOGGER_HOST_AVR_INTERRUPT_H
+#define LOGGER_HOST_AVR_INTERRUPT_H
+
+#include "sim.h"
+
+#define TIMER1_CAPT_vect sim_timer1_capt_vect
+#define TIMER1_OVF_vect  sim_timer1_ovf_vect
+
+#define ISR(vector) extern "C" void vector(void)
+
+#define sei() sim_sei()
+#define cli() sim_cli()
+
+#endif  // LOGGER_HOST_AVR_INTERRUPT_H
@@ -0,0 +1,87 @@
+/*
+ * Host shim for <avr/io.h> (ATmega328P subset used by the logger).
+ *
+ * Each register name expands to a small proxy object whose reads and
+ * writes go to the simulator in sim.cpp, so register side effects
+ * (write-one-to-clear flags, the running timer, UART pacing) behave as on
+ * the device. This requires the firmware to be compiled as C++; the
+ * sources themselves are unchanged.
+ */
+#ifndef LOGGER_HOST_AVR_IO_H
+#define LOGGER_HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#include "sim.h"
+
+#ifndef __cplusplus
+#error "the host shim compiles the firmware as C++ (see firmware/host/Makefile)"
+#endif
+
+#define _Static_assert static_assert
+
+#define _BV(bit) (1u << (bit))
+
+template <typename T>
+class sim_reg {
+public:
+    explicit sim_reg(sim_reg_id id) : id_(id) {}
+
+    operator T() const { return static_cast<T>(sim_read(id_)); }
+
+    sim_reg &operator=(unsigned v) {
+        sim_write(id_, static_cast<T>(v));
+        return *this;
+    }
+    sim_reg &operator|=(unsigned v) { return *this = static_cast<T>(*this) | v; }
+    sim_reg &operator&=(unsigned v) { return *this = static_cast<T>(*this) & v; }
+    sim_reg &operator^=(unsigned v) { return *this = static_cast<T>(*this) ^ v; }
+
+private:
+    sim_reg_id id_;
+};
+
+/* Timer/Counter1 */
+#define TCCR1A (sim_reg<uint8_t>(SIM_TCCR1A))
+#define TCCR1B (sim_reg<uint8_t>(SIM_TCCR1B))
+#define TCNT1  (sim_reg<uint16_t>(SIM_TCNT1))
+#define ICR1   (sim_reg<uint16_t>(SIM_ICR1))
+#define TIFR1  (sim_reg<uint8_t>(SIM_TIFR1))
+#define TIMSK1 (sim_reg<uint8_t>(SIM_TIMSK1))
+
+#define ICNC1 7
+#define ICES1 6
+#define CS12  2
+#define CS11  1
+#define CS10  0
+#define ICF1  5
+#define TOV1  0
+#define ICIE1 5
+#define TOIE1 0
+
+/* USART0 */
+#define UBRR0H (sim_reg<uint8_t>(SIM_UBRR0H))
+#define UBRR0L (sim_reg<uint8_t>(SIM_UBRR0L))
+#define UCSR0A (sim_reg<uint8_t>(SIM_UCSR0A))
+#define UCSR0B (sim_reg<uint8_t>(SIM_UCSR0B))
+#define UCSR0C (sim_reg<uint8_t>(SIM_UCSR0C))
+#define UDR0   (sim_reg<uint8_t>(SIM_UDR0))
+
+#define UDRE0  5
+#define U2X0   1
+#define TXEN0  3
+#define UCSZ01 2
+#define UCSZ00 1
+
+/* Ports B (ICP1 = PB0, SW2 = PB1) and D (LED = PD7) */
+#define PORTB (sim_reg<uint8_t>(SIM_PORTB))
+#define PINB  (sim_reg<uint8_t>(SIM_PINB))
+#define DDRB  (sim_reg<uint8_t>(SIM_DDRB))
+#define PORTD (sim_reg<uint8_t>(SIM_PORTD))
+#define DDRD  (sim_reg<uint8_t>(SIM_DDRD))
+
+#define PB0 0
+#define PB1 1
+#define PD7 7
+
+#endif  // LOGGER_HOST_AVR_IO_H
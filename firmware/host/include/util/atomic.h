@@ -0,0 +1,21 @@
+/*
+ * Host shim for <util/atomic.h>.
+ *
+ * Same shape as avr-libc: the block runs once with interrupts masked and
+ * the previous I bit is restored on the way out, at which point any
+ * interrupt that became pending inside the block is dispatched.
+ */
+#ifndef LOGGER_HOST_UTIL_ATOMIC_H
+#define LOGGER_HOST_UTIL_ATOMIC_H
+
+#include <stdint.h>
+
+#include "sim.h"
+
+#define ATOMIC_RESTORESTATE
+
+#define ATOMIC_BLOCK(type)                                                            \
+    for (uint8_t sim_sreg_save = sim_irq_save(), sim_atomic_once = 1; sim_atomic_once; \
+         sim_atomic_once = 0, sim_irq_restore(sim_sreg_save))
+
+#endif  // LOGGER_HOST_UTIL_ATOMIC_H
@@ -0,0 +1,37 @@
+/*
+ * Host shim for <util/setbaud.h>.
+ *
+ * Same computation as avr-libc: UBRR for 16x sampling rounded to nearest,
+ * falling back to double speed (8x) when the resulting rate is outside
+ * BAUD_TOL percent. The simulator derives UART byte timing from the
+ * programmed UBRR0 and U2X0, so the host build paces output like the
+ * device does.
+ */
+#ifndef LOGGER_HOST_UTIL_SETBAUD_H
+#define LOGGER_HOST_UTIL_SETBAUD_H
+
+#ifndef F_CPU
+#error "setbaud.h requires F_CPU to be defined"
+#endif
+#ifndef BAUD
+#error "setbaud.h requires BAUD to be defined"
+#endif
+#ifndef BAUD_TOL
+#define BAUD_TOL 2
+#endif
+
+#define UBRR_VALUE (((F_CPU) + 8UL * (BAUD)) / (16UL * (BAUD)) - 1UL)
+
+#if 100 * (F_CPU) > (16 * ((UBRR_VALUE) + 1)) * (100 * (BAUD) + (BAUD) * (BAUD_TOL)) || \
+    100 * (F_CPU) < (16 * ((UBRR_VALUE) + 1)) * (100 * (BAUD) - (BAUD) * (BAUD_TOL))
+#define USE_2X 1
+#undef UBRR_VALUE
+#define UBRR_VALUE (((F_CPU) + 4UL * (BAUD)) / (8UL * (BAUD)) - 1UL)
+#else
+#define USE_2X 0
+#endif
+
+#define UBRRL_VALUE ((UBRR_VALUE) & 0xff)
+#define UBRRH_VALUE ((UBRR_VALUE) >> 8)
+
+#endif  // LOGGER_HOST_UTIL_SETBAUD_H
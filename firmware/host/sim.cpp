@@ -0,0 +1,670 @@
+/*
+ * logger_host: the logger firmware running on Linux.
+ *
+ *   logger_host [-P | -o out] [-x speed] [-l] [-z] [-T seconds] <trace>
+ *
+ * main.c and timer1_capture.c are compiled unchanged against the shim
+ * headers in include/, whose registers are served by the model below:
+ *
+ *   Timer1  free-running at F_CPU (prescaler 1), TOV1 at each wrap, input
+ *           capture on the edge selected by ICES1 (delayed 4 cycles when
+ *           ICNC1 is set), ICF1/TOV1 write-one-to-clear and cleared on
+ *           vector entry; the capture vector has priority over overflow.
+ *   USART0  8N1 transmit timed from UBRR0 and U2X0; UDRE0 clears while a
+ *           byte waits for the shift register, exactly as the firmware's
+ *           busy-wait expects.
+ *   PB0     ICP1 level from the trace; PB1 is SW2 (active low).
+ *
+ * Time is CPU cycles since reset. It advances by a fixed cost per register
+ * access and per interrupt, and jumps straight to the next UART slot while
+ * the firmware waits to transmit, so a run is bound by UART bytes rather
+ * than wall time and completes far faster than real time. Interrupts are
+ * delivered at the cycle their flag is raised whenever the I bit is set.
+ *
+ * The trace is CSV in F_CPU ticks since reset, one event per line:
+ *
+ *   <ticks>,R       rising edge on ICP1
+ *   <ticks>,F       falling edge on ICP1
+ *   <ticks>,SW2     press SW2 (held 100 ms)
+ *
+ * Other lines (comments, headers) are skipped and extra fields ignored,
+ * so a logger capture can be replayed directly; 32-bit tick wraps are
+ * unfolded. Logged ticks count from Timer1 start-up, as on hardware.
+ *
+ *   -o out      write the serial stream to a file (default: stdout)
+ *   -P          serve it on a pseudo-terminal instead; the slave path is
+ *               printed on stdout and the bytes "s" (press SW2) and "q"
+ *               (quit) are accepted from the reader
+ *   -x speed    pace to speed x real time (default 0: unpaced)
+ *   -l          log the whole trace: press SW2 before its first event and
+ *               after its last
+ *   -z          shift the trace to start 0.25 s after reset
+ *   -T seconds  stop at this time (default: 1 s after the last event;
+ *               0 = run until "q")
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "avr/io.h"
+#include "sim.h"
+
+int firmware_main(void);
+
+namespace {
+
+// Model costs in CPU cycles.
+constexpr uint64_t ACCESS_CYCLES = 4;   // Firmware code per register access.
+constexpr uint64_t ISR_CYCLES = 60;     // Vector entry, body and reti.
+constexpr uint64_t ICNC_DELAY = 4;      // Noise canceller latency.
+
+constexpr uint64_t NEVER = UINT64_MAX;
+constexpr uint64_t SERVICE_INTERVAL = 1 << 14;  // Accesses between host I/O checks.
+
+enum trace_kind : uint8_t {
+    TRACE_FALL,
+    TRACE_RISE,
+    TRACE_SW2,
+};
+
+struct trace_event {
+    uint64_t tick;
+    trace_kind kind;
+};
+
+struct sim_done {};
+
+struct machine {
+    uint64_t now = 0;
+    bool irq = false;
+    bool in_isr = false;
+
+    // Timer1.
+    uint8_t tccr1a = 0;
+    uint8_t tccr1b = 0;
+    uint8_t tifr1 = 0;
+    uint8_t timsk1 = 0;
+    uint16_t icr1 = 0;
+    uint16_t tcnt_held = 0;     // Counter value while stopped.
+    uint64_t origin = 0;        // Cycle at which the running counter read 0.
+    uint64_t next_ovf = NEVER;
+
+    // USART0.
+    uint8_t ubrr0h = 0;
+    uint8_t ubrr0l = 0;
+    uint8_t ucsr0a = 0;
+    uint8_t ucsr0b = 0;
+    uint8_t ucsr0c = 0;
+    uint64_t udre_at = 0;       // Data register free (byte moved to shifter).
+    uint64_t shift_free_at = 0; // Last byte fully on the wire.
+
+    // Ports.
+    uint8_t portb = 0;
+    uint8_t ddrb = 0;
+    uint8_t portd = 0;
+    uint8_t ddrd = 0;
+    bool icp1 = false;
+    bool sw2_down = false;
+    uint64_t sw2_release_at = NEVER;
+    uint64_t sw2_hold = 0;
+
+    // Stimulus and run control.
+    std::vector<trace_event> trace;
+    size_t next_event = 0;
+    uint64_t end_tick = NEVER;
+    uint64_t accesses = 0;
+
+    // Host side.
+    int out_fd = STDOUT_FILENO;
+    int pty_slave = -1;
+    bool pty = false;
+    double speed = 0.0;
+    std::chrono::steady_clock::time_point wall_start;
+    std::string out;
+};
+
+machine m;
+
+bool timer_running() { return (m.tccr1b & 0x07) != 0; }
+
+uint16_t tcnt() {
+    return timer_running() ? static_cast<uint16_t>(m.now - m.origin) : m.tcnt_held;
+}
+
+// Start (or re-phase) the counter so that it reads `value` now.
+void set_counter(uint16_t value) {
+    m.tcnt_held = value;
+    if (timer_running()) {
+        m.origin = m.now - value;
+        m.next_ovf = m.now + (0x10000u - value);
+    }
+}
+
+void write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        const ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("write: ") + std::strerror(errno));
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+}
+
+void flush_output() {
+    write_all(m.out_fd, m.out.data(), m.out.size());
+    m.out.clear();
+}
+
+void press_sw2() {
+    m.sw2_down = true;
+    m.sw2_release_at = m.now + m.sw2_hold;
+}
+
+void advance_to(uint64_t t);
+
+/*
+ * Run pending, enabled interrupts in priority order while the I bit is
+ * set. Like the hardware, entering a vector clears its flag and the I bit;
+ * events that fall inside the vector's own cycles are latched but wait
+ * until it returns.
+ */
+void dispatch() {
+    while (m.irq && !m.in_isr) {
+        void (*vector)(void);
+        if ((m.tifr1 & _BV(ICF1)) && (m.timsk1 & _BV(ICIE1))) {
+            m.tifr1 &= static_cast<uint8_t>(~_BV(ICF1));
+            vector = sim_timer1_capt_vect;
+        } else if ((m.tifr1 & _BV(TOV1)) && (m.timsk1 & _BV(TOIE1))) {
+            m.tifr1 &= static_cast<uint8_t>(~_BV(TOV1));
+            vector = sim_timer1_ovf_vect;
+        } else {
+            return;
+        }
+
+        m.in_isr = true;
+        m.irq = false;
+        vector();
+        advance_to(m.now + ISR_CYCLES);
+        m.in_isr = false;
+        m.irq = true;
+    }
+}
+
+uint64_t trace_time(const trace_event &e) {
+    if (e.kind == TRACE_SW2) {
+        return e.tick;
+    }
+    return e.tick + ((m.tccr1b & _BV(ICNC1)) ? ICNC_DELAY : 0);
+}
+
+void apply_trace(const trace_event &e) {
+    if (e.kind == TRACE_SW2) {
+        press_sw2();
+        return;
+    }
+
+    const bool rising = e.kind == TRACE_RISE;
+    if (rising == m.icp1) {
+        return;  // Not a transition.
+    }
+    m.icp1 = rising;
+
+    const bool sense_rising = (m.tccr1b & _BV(ICES1)) != 0;
+    if (timer_running() && rising == sense_rising) {
+        m.icr1 = tcnt();
+        m.tifr1 |= _BV(ICF1);
+    }
+}
+
+/*
+ * Advance the clock to cycle t, applying every stimulus and timer event on
+ * the way in time order and servicing interrupts at the cycle they occur.
+ * Simultaneous events are all applied before dispatch, overflow first, so
+ * a capture on the wrap cycle sees TOV1 as it would on the device.
+ */
+void advance_to(uint64_t t) {
+    for (;;) {
+        uint64_t next = t;
+        if (m.next_ovf < next) {
+            next = m.next_ovf;
+        }
+        if (m.sw2_release_at < next) {
+            next = m.sw2_release_at;
+        }
+        if (m.next_event < m.trace.size()) {
+            next = std::min(next, trace_time(m.trace[m.next_event]));
+        }
+
+        if (next > m.now) {
+            m.now = next;
+        }
+
+        bool any = false;
+        if (m.next_ovf <= m.now) {
+            m.tifr1 |= _BV(TOV1);
+            m.next_ovf += 0x10000u;
+            any = true;
+        }
+        if (m.sw2_release_at <= m.now) {
+            m.sw2_down = false;
+            m.sw2_release_at = NEVER;
+            any = true;
+        }
+        while (m.next_event < m.trace.size() && trace_time(m.trace[m.next_event]) <= m.now) {
+            apply_trace(m.trace[m.next_event++]);
+            any = true;
+        }
+
+        dispatch();
+        if (!any && m.now >= t) {
+            return;
+        }
+    }
+}
+
+/*
+ * Host-side housekeeping, every SERVICE_INTERVAL accesses: pacing,
+ * commands from the pty reader and the end-of-run check.
+ */
+void service() {
+    if (m.speed > 0.0) {
+        const auto due = m.wall_start + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                            std::chrono::duration<double>(
+                                                static_cast<double>(m.now) / F_CPU / m.speed));
+        flush_output();
+        std::this_thread::sleep_until(due);
+    }
+
+    if (m.pty) {
+        flush_output();
+        pollfd p = {m.out_fd, POLLIN, 0};
+        char cmd[64];
+        while (poll(&p, 1, 0) == 1 && (p.revents & POLLIN)) {
+            const ssize_t n = read(m.out_fd, cmd, sizeof(cmd));
+            if (n <= 0) {
+                break;
+            }
+            for (ssize_t i = 0; i < n; i++) {
+                if (cmd[i] == 's') {
+                    press_sw2();
+                } else if (cmd[i] == 'q') {
+                    m.end_tick = m.now;
+                }
+            }
+        }
+    }
+
+    if (m.out.size() > (1u << 16)) {
+        flush_output();
+    }
+}
+
+// Common entry for every register access: charge its cycles, then check
+// whether the run is over (only once the UART has gone quiet).
+void access() {
+    advance_to(m.now + ACCESS_CYCLES);
+    if (++m.accesses % SERVICE_INTERVAL == 0) {
+        service();
+    }
+    if (m.now >= m.end_tick && m.now >= m.shift_free_at) {
+        throw sim_done();
+    }
+}
+
+uint64_t byte_cycles() {
+    const uint64_t ubrr = (static_cast<uint64_t>(m.ubrr0h & 0x0f) << 8) | m.ubrr0l;
+    return 10u * ((m.ucsr0a & _BV(U2X0)) ? 8u : 16u) * (ubrr + 1);
+}
+
+void transmit(uint8_t byte) {
+    if (!(m.ucsr0b & _BV(TXEN0))) {
+        return;
+    }
+    const uint64_t start = std::max(m.now, m.shift_free_at);
+    m.udre_at = start;
+    m.shift_free_at = start + byte_cycles();
+    m.out.push_back(static_cast<char>(byte));
+}
+
+/* ---- Trace loading ---- */
+
+void load_trace(const char *path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error(std::string(path) + ": cannot open trace");
+    }
+
+    std::string line;
+    uint64_t epoch = 0;
+    uint64_t prev = 0;
+    size_t line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (line.empty() || line[0] < '0' || line[0] > '9') {
+            continue;
+        }
+
+        char *p = nullptr;
+        const uint64_t raw = std::strtoull(line.c_str(), &p, 10);
+        if (*p != ',') {
+            continue;
+        }
+        p++;
+
+        trace_event e;
+        if (std::strncmp(p, "SW2", 3) == 0) {
+            e.kind = TRACE_SW2;
+        } else if (*p == 'R') {
+            e.kind = TRACE_RISE;
+        } else if (*p == 'F') {
+            e.kind = TRACE_FALL;
+        } else {
+            continue;
+        }
+
+        uint64_t tick = raw + epoch;
+        if (!m.trace.empty() && tick < prev) {
+            /* A logger capture wraps at 2^32; anything else is disorder. */
+            if (raw <= UINT32_MAX && prev - tick > (UINT64_C(1) << 31)) {
+                epoch += UINT64_C(1) << 32;
+                tick += UINT64_C(1) << 32;
+            } else {
+                throw std::runtime_error(std::string(path) + ":" + std::to_string(line_no) +
+                                         ": trace is not in time order");
+            }
+        }
+        prev = tick;
+        e.tick = tick;
+        m.trace.push_back(e);
+    }
+}
+
+void open_pty() {
+    const int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        throw std::runtime_error(std::string("pty: ") + std::strerror(errno));
+    }
+    const char *path = ptsname(fd);
+    m.pty_slave = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    termios tio;
+    if (m.pty_slave < 0 || tcgetattr(m.pty_slave, &tio) != 0) {
+        throw std::runtime_error(std::string(path) + ": " + std::strerror(errno));
+    }
+    cfmakeraw(&tio);
+    tcsetattr(m.pty_slave, TCSANOW, &tio);
+    std::printf("%s\n", path);
+    std::fflush(stdout);
+
+    m.out_fd = fd;
+    m.pty = true;
+}
+
+// Closing the master discards input the reader has not consumed yet.
+void drain_pty() {
+    int pending = 1;
+    while (ioctl(m.pty_slave, FIONREAD, &pending) == 0 && pending > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+}  // namespace
+
+/* ---- Register file ---- */
+
+uint16_t sim_read(sim_reg_id reg) {
+    access();
+
+    switch (reg) {
+    case SIM_TCCR1A:
+        return m.tccr1a;
+    case SIM_TCCR1B:
+        return m.tccr1b;
+    case SIM_TCNT1:
+        return tcnt();
+    case SIM_ICR1:
+        return m.icr1;
+    case SIM_TIFR1:
+        return m.tifr1;
+    case SIM_TIMSK1:
+        return m.timsk1;
+    case SIM_UBRR0H:
+        return m.ubrr0h;
+    case SIM_UBRR0L:
+        return m.ubrr0l;
+    case SIM_UCSR0A:
+        /* A busy-wait on UDRE0 would spin until the slot frees: skip there. */
+        if (m.now < m.udre_at) {
+            advance_to(m.udre_at);
+        }
+        return static_cast<uint16_t>(m.ucsr0a | _BV(UDRE0));
+    case SIM_UCSR0B:
+        return m.ucsr0b;
+    case SIM_UCSR0C:
+        return m.ucsr0c;
+    case SIM_UDR0:
+        return 0;
+    case SIM_PORTB:
+        return m.portb;
+    case SIM_PINB: {
+        uint8_t pins = static_cast<uint8_t>(m.portb & ~(_BV(PB0) | _BV(PB1)));
+        if (m.icp1) {
+            pins |= _BV(PB0);
+        }
+        if (!m.sw2_down && (m.portb & _BV(PB1))) {
+            pins |= _BV(PB1);
+        }
+        return pins;
+    }
+    case SIM_DDRB:
+        return m.ddrb;
+    case SIM_PORTD:
+        return m.portd;
+    case SIM_DDRD:
+        return m.ddrd;
+    }
+    return 0;
+}
+
+void sim_write(sim_reg_id reg, uint16_t value) {
+    access();
+
+    const uint8_t v8 = static_cast<uint8_t>(value);
+    switch (reg) {
+    case SIM_TCCR1A:
+        m.tccr1a = v8;
+        break;
+    case SIM_TCCR1B: {
+        const bool was_running = timer_running();
+        if ((v8 & 0x07) > 1) {
+            throw std::runtime_error("Timer1 prescaler other than 1 is not modelled");
+        }
+        if (was_running && !(v8 & 0x07)) {
+            m.tcnt_held = tcnt();
+            m.next_ovf = NEVER;
+        }
+        m.tccr1b = v8;
+        if (!was_running && timer_running()) {
+            set_counter(m.tcnt_held);
+        }
+        break;
+    }
+    case SIM_TCNT1:
+        set_counter(value);
+        break;
+    case SIM_ICR1:
+        m.icr1 = value;
+        break;
+    case SIM_TIFR1:
+        m.tifr1 &= static_cast<uint8_t>(~v8);  // Write one to clear.
+        break;
+    case SIM_TIMSK1:
+        m.timsk1 = v8;
+        break;
+    case SIM_UBRR0H:
+        m.ubrr0h = v8;
+        break;
+    case SIM_UBRR0L:
+        m.ubrr0l = v8;
+        break;
+    case SIM_UCSR0A:
+        m.ucsr0a = static_cast<uint8_t>(v8 & _BV(U2X0));
+        break;
+    case SIM_UCSR0B:
+        m.ucsr0b = v8;
+        break;
+    case SIM_UCSR0C:
+        m.ucsr0c = v8;
+        break;
+    case SIM_UDR0:
+        transmit(v8);
+        break;
+    case SIM_PORTB:
+        m.portb = v8;
+        break;
+    case SIM_PINB:
+        m.portb ^= v8;  // Writing PINx toggles PORTx.
+        break;
+    case SIM_DDRB:
+        m.ddrb = v8;
+        break;
+    case SIM_PORTD:
+        m.portd = v8;
+        break;
+    case SIM_DDRD:
+        m.ddrd = v8;
+        break;
+    }
+}
+
+void sim_sei(void) {
+    m.irq = true;
+    dispatch();
+}
+
+void sim_cli(void) { m.irq = false; }
+
+uint8_t sim_irq_save(void) {
+    const uint8_t saved = m.irq ? 1 : 0;
+    m.irq = false;
+    return saved;
+}
+
+void sim_irq_restore(uint8_t saved) {
+    if (saved) {
+        sim_sei();
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = nullptr;
+    bool pty = false;
+    bool log_all = false;
+    bool rebase = false;
+    double stop_s = -1.0;
+    int arg = 1;
+
+    while (arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0') {
+        const std::string opt = argv[arg];
+        if (opt == "-P") {
+            pty = true;
+        } else if (opt == "-l") {
+            log_all = true;
+        } else if (opt == "-z") {
+            rebase = true;
+        } else if (arg + 1 < argc && opt == "-o") {
+            out_path = argv[++arg];
+        } else if (arg + 1 < argc && opt == "-x") {
+            m.speed = std::atof(argv[++arg]);
+        } else if (arg + 1 < argc && opt == "-T") {
+            stop_s = std::atof(argv[++arg]);
+        } else {
+            break;
+        }
+        arg++;
+    }
+    if (arg + 1 != argc || (pty && out_path != nullptr)) {
+        std::fprintf(stderr,
+                     "usage: %s [-P | -o out] [-x speed] [-l] [-z] [-T seconds] <trace>\n",
+                     argv[0]);
+        return 2;
+    }
+
+    try {
+        load_trace(argv[arg]);
+
+        const uint64_t second = F_CPU;
+        m.sw2_hold = second / 10;
+
+        if (rebase && !m.trace.empty()) {
+            const uint64_t shift = m.trace.front().tick;
+            for (trace_event &e : m.trace) {
+                e.tick = e.tick - shift + second / 4;
+            }
+        }
+
+        uint64_t last = m.trace.empty() ? 0 : m.trace.back().tick;
+        if (log_all && !m.trace.empty()) {
+            const uint64_t first = m.trace.front().tick;
+            const uint64_t start = first > second / 5 ? first - second / 5 : 0;
+            const uint64_t stop = std::max(last + second / 5, start + 2 * m.sw2_hold);
+            m.trace.insert(m.trace.begin(), trace_event{start, TRACE_SW2});
+            m.trace.push_back(trace_event{stop, TRACE_SW2});
+            std::stable_sort(m.trace.begin(), m.trace.end(),
+                             [](const trace_event &a, const trace_event &b) {
+                                 return a.tick < b.tick;
+                             });
+            last = stop;
+        }
+
+        if (stop_s < 0.0) {
+            m.end_tick = last + second;
+        } else if (stop_s > 0.0) {
+            m.end_tick = static_cast<uint64_t>(stop_s * second);
+        }
+
+        if (pty) {
+            open_pty();
+        } else if (out_path != nullptr) {
+            m.out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (m.out_fd < 0) {
+                throw std::runtime_error(std::string(out_path) + ": " + std::strerror(errno));
+            }
+        }
+
+        m.wall_start = std::chrono::steady_clock::now();
+        try {
+            firmware_main();
+        } catch (const sim_done &) {
+        }
+
+        flush_output();
+        if (pty) {
+            drain_pty();
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "logger_host: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
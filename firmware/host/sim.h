@@ -0,0 +1,43 @@
+/*
+ * Hardware model behind the host shim headers.
+ *
+ * The firmware talks to the simulator only through register accesses,
+ * sei()/cli() and ATOMIC_BLOCK; see sim.cpp for the model itself.
+ */
+#ifndef LOGGER_HOST_SIM_H
+#define LOGGER_HOST_SIM_H
+
+#include <stdint.h>
+
+enum sim_reg_id {
+    SIM_TCCR1A,
+    SIM_TCCR1B,
+    SIM_TCNT1,
+    SIM_ICR1,
+    SIM_TIFR1,
+    SIM_TIMSK1,
+    SIM_UBRR0H,
+    SIM_UBRR0L,
+    SIM_UCSR0A,
+    SIM_UCSR0B,
+    SIM_UCSR0C,
+    SIM_UDR0,
+    SIM_PORTB,
+    SIM_PINB,
+    SIM_DDRB,
+    SIM_PORTD,
+    SIM_DDRD,
+};
+
+uint16_t sim_read(sim_reg_id reg);
+void sim_write(sim_reg_id reg, uint16_t value);
+
+void sim_sei(void);
+void sim_cli(void);
+uint8_t sim_irq_save(void);
+void sim_irq_restore(uint8_t saved);
+
+extern "C" void sim_timer1_capt_vect(void);
+extern "C" void sim_timer1_ovf_vect(void);
+
+#endif  // LOGGER_HOST_SIM_H
@@ -110,6 +110,334 @@ static void uart_put_uint16(uint16_t value) {
  */
 #define SW2_DEBOUNCE_TICKS  (F_CPU / 20UL)
 
+/*
+ * Lost-edge guard for period measurements.
+ *
+ * The ring drops the newest event when it is full, so a lost edge lies
+ * after every event that was queued at that moment, possibly several pops
+ * before the dropped counter is seen to move. An event popped now was
+ * queued at most CAPTURE_BUFFER_SIZE pops ago, so it is known to have no
+ * lost edge between it and the previous one only once the counter has held
+ * still for that many pops.
+ */
+typedef struct {
+    uint16_t dropped;           /* Counter at the last pop. */
+    uint16_t settle;            /* Pops left until events are trusted again. */
+} drop_guard_t;
+
+static void drop_guard_reset(drop_guard_t *g) {
+    g->dropped = timer1_capture_dropped();
+    g->settle = 0;
+}
+
+/* Call once per popped event; true if an edge may be missing before it. */
+static bool drop_guard_gap(drop_guard_t *g) {
+    const uint16_t dropped = timer1_capture_dropped();
+
+    if (dropped != g->dropped) {
+        g->dropped = dropped;
+        g->settle = CAPTURE_BUFFER_SIZE;
+    } else if (g->settle != 0) {
+        g->settle--;
+    }
+    return g->settle != 0;
+}
+
+/*
+ * Overload summary mode.
+ *
+ * A per-edge row costs roughly STREAM_ROW_BYTES of UART time, so a
+ * sustained edge rate above a few hundred per second fills the capture
+ * ring and the ISR starts dropping events at arbitrary points. Instead,
+ * once the ring passes SUMMARY_HIGH_WATER the drain loop stops printing
+ * rows and reports each SUMMARY_WINDOW_TICKS window as one record:
+ *
+ *   # MODE=SUMMARY,<ticks>     first summarised edge
+ *   # SUMMARY,<start>,<end>,<edges>,<periods>,<min>,<max>,<mean>,<dropped>
+ *   # MODE=EDGES,<ticks>       per-edge rows resume from this tick
+ *
+ * Windows tile time from the first summarised edge, so coverage has no
+ * holes. Periods are rising-to-rising intervals in ticks, leaving out any
+ * that may span a dropped edge (min/max/mean are 0 when a window has none);
+ * dropped counts ring overflows in the window.
+ * Streaming resumes after a window with no more edges than the UART could
+ * carry as rows in half a window, giving hysteresis near the threshold.
+ */
+#define SUMMARY_HIGH_WATER    ((uint8_t)(CAPTURE_BUFFER_SIZE * 3UL / 4UL))
+#define SUMMARY_WINDOW_TICKS  (F_CPU / 10UL)
+#define STREAM_ROW_BYTES      24UL
+#define SUMMARY_RESUME_EDGES \
+    ((BAUD / 10UL) / (F_CPU / SUMMARY_WINDOW_TICKS) / STREAM_ROW_BYTES / 2UL)
+
+/*
+ * Frequency / duty meter mode (LOGGER_METER_MODE=1).
+ *
+ * While logging, edges are not streamed; instead every METER_GATE_MS the
+ * firmware prints one reciprocal-counting reading:
+ *
+ *   # METER,<start>,<end>,<periods>,<span>,<freq_mhz>,<duty_ppm>,<dropped>
+ *
+ * <periods> whole rising-to-rising periods span <span> ticks, so the
+ * frequency is periods * F_CPU / span, resolved to one tick over the span
+ * rather than to one edge per gate. Duty is the summed high time of those
+ * periods over the span. Consecutive gates share their boundary rising
+ * edge, so no period is lost between readings; periods that may contain an
+ * edge lost to ring overflow are left out of both. Output bandwidth depends
+ * only on the gate time, not on the signal rate.
+ */
+#ifndef LOGGER_METER_MODE
+#define LOGGER_METER_MODE 0
+#endif
+
+#ifndef METER_GATE_MS
+#define METER_GATE_MS 100UL
+#endif
+
+#define METER_GATE_TICKS  (F_CPU / 1000UL * (METER_GATE_MS))
+
+#if LOGGER_METER_MODE
+typedef struct {
+    uint32_t start;             /* Gate start tick. */
+    uint32_t periods;           /* Whole periods counted in the gate. */
+    uint32_t span;              /* Their summed length. */
+    uint32_t high_sum;          /* High time within those periods. */
+    uint16_t dropped_at_start;
+    bool have_rise;             /* The fields below carry across gates. */
+    uint32_t last_rise;
+    uint32_t high;              /* High time of the period in progress. */
+} meter_t;
+
+static void meter_open(meter_t *m, uint32_t start) {
+    m->start = start;
+    m->periods = 0;
+    m->span = 0;
+    m->high_sum = 0;
+    m->dropped_at_start = timer1_capture_dropped();
+}
+
+/*
+ * gap: from drop_guard_gap(). A period that may contain a lost edge is
+ * left out; periods and span only cover whole, gap-free periods.
+ */
+static void meter_add(meter_t *m, const capture_event_t *ev, bool gap) {
+    if (gap) {
+        m->have_rise = false;
+    }
+    if (ev->edge == CAPTURE_EDGE_RISING) {
+        if (m->have_rise) {
+            m->periods++;
+            m->span += ev->ticks - m->last_rise;
+            m->high_sum += m->high;
+        }
+        m->have_rise = !gap;
+        m->last_rise = ev->ticks;
+        m->high = 0;
+    } else if (m->have_rise) {
+        m->high = ev->ticks - m->last_rise;
+    }
+}
+
+static void meter_emit(const meter_t *m, uint32_t end) {
+    const uint32_t span = m->span;
+    uint32_t freq_mhz = 0;
+    uint32_t duty_ppm = 0;
+
+    if (m->periods != 0 && span != 0) {
+        /* Rounded fixed point; 64-bit intermediates, once per gate. */
+        const uint64_t f = ((uint64_t)m->periods * F_CPU * 1000ULL + span / 2) / span;
+        freq_mhz = (f > UINT32_MAX) ? UINT32_MAX : (uint32_t)f;
+        duty_ppm = (uint32_t)(((uint64_t)m->high_sum * 1000000ULL + span / 2) / span);
+    }
+
+    uart_puts("# METER,");
+    uart_put_uint32(m->start);
+    uart_putc(',');
+    uart_put_uint32(end);
+    uart_putc(',');
+    uart_put_uint32(m->periods);
+    uart_putc(',');
+    uart_put_uint32(m->periods ? span : 0);
+    uart_putc(',');
+    uart_put_uint32(freq_mhz);
+    uart_putc(',');
+    uart_put_uint32(duty_ppm);
+    uart_putc(',');
+    uart_put_uint16((uint16_t)(timer1_capture_dropped() - m->dropped_at_start));
+    uart_puts("\r\n");
+}
+
+/* Print a reading for every gate that ends at or before tick t. */
+static void meter_advance(meter_t *m, uint32_t t) {
+    while ((int32_t)(t - m->start) >= (int32_t)METER_GATE_TICKS) {
+        const uint32_t end = m->start + (uint32_t)METER_GATE_TICKS;
+
+        meter_emit(m, end);
+        meter_open(m, end);
+    }
+}
+#else
+typedef struct {
+    uint32_t start;             /* Window start tick. */
+    uint32_t edges;
+    uint32_t periods;
+    uint32_t period_min;
+    uint32_t period_max;
+    uint32_t period_sum;
+    uint16_t dropped_at_start;
+    bool have_rise;             /* Carried across windows. */
+    uint32_t last_rise;
+} summary_t;
+
+static void summary_open(summary_t *s, uint32_t start) {
+    s->start = start;
+    s->edges = 0;
+    s->periods = 0;
+    s->period_min = UINT32_MAX;
+    s->period_max = 0;
+    s->period_sum = 0;
+    s->dropped_at_start = timer1_capture_dropped();
+}
+
+/* gap: from drop_guard_gap(); a period is only taken between two rising
+ * edges with no possibly lost edge in between. */
+static void summary_add(summary_t *s, const capture_event_t *ev, bool gap) {
+    s->edges++;
+
+    if (gap) {
+        s->have_rise = false;
+    }
+    if (ev->edge != CAPTURE_EDGE_RISING) {
+        return;
+    }
+    if (s->have_rise) {
+        const uint32_t period = ev->ticks - s->last_rise;
+        s->periods++;
+        s->period_sum += period;
+        if (period < s->period_min) {
+            s->period_min = period;
+        }
+        if (period > s->period_max) {
+            s->period_max = period;
+        }
+    }
+    s->last_rise = ev->ticks;
+    s->have_rise = !gap;
+}
+
+static void summary_emit(const summary_t *s, uint32_t end) {
+    uart_puts("# SUMMARY,");
+    uart_put_uint32(s->start);
+    uart_putc(',');
+    uart_put_uint32(end);
+    uart_putc(',');
+    uart_put_uint32(s->edges);
+    uart_putc(',');
+    uart_put_uint32(s->periods);
+    uart_putc(',');
+    uart_put_uint32(s->periods ? s->period_min : 0);
+    uart_putc(',');
+    uart_put_uint32(s->period_max);
+    uart_putc(',');
+    uart_put_uint32(s->periods ? s->period_sum / s->periods : 0);
+    uart_putc(',');
+    uart_put_uint16((uint16_t)(timer1_capture_dropped() - s->dropped_at_start));
+    uart_puts("\r\n");
+}
+
+/*
+ * Close every window that ends at or before tick t.
+ *
+ * Returns false (after printing the MODE=EDGES record) once a closed
+ * window was quiet enough to resume per-edge streaming.
+ */
+static bool summary_advance(summary_t *s, uint32_t t) {
+    while ((int32_t)(t - s->start) >= (int32_t)SUMMARY_WINDOW_TICKS) {
+        const uint32_t end = s->start + (uint32_t)SUMMARY_WINDOW_TICKS;
+
+        summary_emit(s, end);
+        if (s->edges <= SUMMARY_RESUME_EDGES) {
+            uart_puts("# MODE=EDGES,");
+            uart_put_uint32(end);
+            uart_puts("\r\n");
+            return false;
+        }
+        summary_open(s, end);
+    }
+
+    return true;
+}
+#endif
+
+/*
+ * Clock sync record.
+ *
+ * On the internal RC oscillator F_CPU can be off by a percent or more, so
+ * ticks / F_CPU drifts against real time. Once every SYNC_INTERVAL_TICKS,
+ * logging or not, the firmware prints
+ *
+ *   # SYNC,<ticks>
+ *
+ * timed so that the first byte of the line starts on the wire at <ticks>
+ * and the rest follows back to back: the final '\n' is complete exactly
+ * (line length) character times later. A host that timestamps its serial
+ * reads can fit device ticks against its own clock from these.
+ *
+ * SYNC_LEAD_TICKS covers the byte that may still be in the shift register
+ * plus formatting the line; the transmitter is idle when it runs out.
+ */
+#define SYNC_INTERVAL_TICKS  F_CPU
+#define SYNC_LEAD_TICKS      (10UL * F_CPU / BAUD + F_CPU / 1000UL)
+
+static void sync_emit(void) {
+    char line[20] = "# SYNC,";
+    char digits[10];
+    uint8_t n = 7;
+    uint8_t i = 0;
+
+    while (!(UCSR0A & (1 << UDRE0))) {
+        /* intentional busy-wait */
+    }
+    const uint32_t at = timer1_capture_now() + (uint32_t)SYNC_LEAD_TICKS;
+
+    uint32_t v = at;
+    do {
+        digits[i++] = (char)('0' + (v % 10U));
+        v /= 10U;
+    } while (v > 0);
+    while (i > 0) {
+        line[n++] = digits[--i];
+    }
+    line[n++] = '\r';
+    line[n++] = '\n';
+
+    while ((int32_t)(timer1_capture_now() - at) < 0) {
+        /* intentional busy-wait */
+    }
+    for (i = 0; i < n; i++) {
+        uart_putc(line[i]);
+    }
+}
+
+/*
+ * Status record, sent after each sync:
+ *
+ *   # STATUS,<ticks>,<ring_high_water>,<dropped>
+ *
+ * ring_high_water is the most capture ring slots seen in use since the
+ * previous status (sampled by the drain loop before it prints each row,
+ * which is when the ring grows); dropped is the cumulative overflow
+ * counter, as in event rows. Lets a host watch headroom, logging or not.
+ */
+static void status_emit(uint8_t ring_high_water) {
+    uart_puts("# STATUS,");
+    uart_put_uint32(timer1_capture_now());
+    uart_putc(',');
+    uart_put_uint16(ring_high_water);
+    uart_putc(',');
+    uart_put_uint16(timer1_capture_dropped());
+    uart_puts("\r\n");
+}
+
 int main(void) {
     /*
      * Minimal firmware bring-up.
@@ -142,6 +470,26 @@ int main(void) {
     uart_put_uint16(CAPTURE_BUFFER_SIZE);
     uart_puts("\r\n");
 
+    #if TIMER1_CAPTURE_COMPACT_SLOTS
+        uart_puts("# CAPTURE_SLOTS=COMPACT\r\n");
+    #else
+        uart_puts("# CAPTURE_SLOTS=FULL\r\n");
+    #endif
+
+#if LOGGER_METER_MODE
+    uart_puts("# METER_GATE_TICKS=");
+    uart_put_uint32(METER_GATE_TICKS);
+    uart_puts("\r\n");
+#else
+    uart_puts("# SUMMARY_WINDOW_TICKS=");
+    uart_put_uint32(SUMMARY_WINDOW_TICKS);
+    uart_puts("\r\n");
+#endif
+
+    uart_puts("# SYNC_INTERVAL_TICKS=");
+    uart_put_uint32(SYNC_INTERVAL_TICKS);
+    uart_puts("\r\n");
+
     uart_puts("# ---\r\n");
 
     /*
@@ -165,8 +513,17 @@ int main(void) {
     bool logging = false;
     bool sw2_prev = true;  /* pulled-up = released */
     uint32_t sw2_lockout_until = 0;
-    uint32_t last_tick = 0;
     uint32_t next_heartbeat = 0;
+    uint32_t next_sync = timer1_capture_now();
+    uint8_t ring_high_water = 0;
+    drop_guard_t guard = {0, 0};
+#if LOGGER_METER_MODE
+    meter_t meter;
+#else
+    uint32_t last_tick = 0;
+    bool summarising = false;
+    summary_t summary;
+#endif
 
     for (;;) {
         uint32_t now = timer1_capture_now();
@@ -181,8 +538,11 @@ int main(void) {
             if (logging) {
                 LOG_LED_PORT |= _BV(LOG_LED_BIT);   /* LED ON */
                 uart_puts("# START\r\n");
+#if !LOGGER_METER_MODE
                 uart_puts("ticks,edge,dt_ticks,dropped\r\n");
                 last_tick = 0;
+                summarising = false;
+#endif
 
                 /* Drain any queued events at start-of-run boundary. */
                 {
@@ -191,8 +551,26 @@ int main(void) {
                         /* discard */
                     }
                 }
+                drop_guard_reset(&guard);
+
+#if LOGGER_METER_MODE
+                meter.have_rise = false;
+                meter.last_rise = 0;
+                meter.high = 0;
+                meter_open(&meter, now);
+#endif
             } else {
                 LOG_LED_PORT &= (uint8_t)~_BV(LOG_LED_BIT);  /* LED OFF */
+
+#if LOGGER_METER_MODE
+                meter_emit(&meter, now);
+#else
+                /* Report the partial window; the next run starts streaming. */
+                if (summarising) {
+                    summary_emit(&summary, now);
+                    summarising = false;
+                }
+#endif
                 uart_puts("# STOP\r\n");
             }
         }
@@ -207,13 +585,55 @@ int main(void) {
             }
         }
 
+        /* ---- Clock sync, in every state ---- */
+        if ((int32_t)(now - next_sync) >= 0) {
+            sync_emit();
+            status_emit(ring_high_water);
+            ring_high_water = timer1_capture_occupancy();
+            next_sync = now + (uint32_t)SYNC_INTERVAL_TICKS;
+        }
+
         /* ---- Drain capture buffer ---- */
         {
             capture_event_t ev;
+            uint8_t occupancy = timer1_capture_occupancy();
+            if (occupancy > ring_high_water) {
+                ring_high_water = occupancy;
+            }
             while (timer1_capture_pop(&ev)) {
                 if (!logging) {
                     continue;
                 }
+                const bool gap = drop_guard_gap(&guard);
+
+#if LOGGER_METER_MODE
+                meter_advance(&meter, ev.ticks);
+                meter_add(&meter, &ev, gap);
+#else
+                if (summarising) {
+                    summarising = summary_advance(&summary, ev.ticks);
+                    if (summarising) {
+                        summary_add(&summary, &ev, gap);
+                        continue;
+                    }
+                    last_tick = 0;
+                }
+
+                /* Ring close to full: UART cannot keep up with per-edge rows. */
+                occupancy = timer1_capture_occupancy();
+                if (occupancy > ring_high_water) {
+                    ring_high_water = occupancy;
+                }
+                if (occupancy >= SUMMARY_HIGH_WATER) {
+                    summarising = true;
+                    uart_puts("# MODE=SUMMARY,");
+                    uart_put_uint32(ev.ticks);
+                    uart_puts("\r\n");
+                    summary.have_rise = false;
+                    summary_open(&summary, ev.ticks);
+                    summary_add(&summary, &ev, gap);
+                    continue;
+                }
 
                 uint32_t dt = 0;
                 if (last_tick != 0) {
@@ -229,7 +649,29 @@ int main(void) {
                 uart_putc(',');
                 uart_put_uint16(timer1_capture_dropped());
                 uart_puts("\r\n");
+#endif
             }
         }
+
+        /*
+         * Windows are closed at `now`, sampled before the drain: every edge
+         * captured before it has been popped above, whereas an edge landing
+         * after the drain belongs to a window still open.
+         */
+
+#if LOGGER_METER_MODE
+        /* ---- Report gates that ended with no further edges ---- */
+        if (logging) {
+            meter_advance(&meter, now);
+        }
+#else
+        /* ---- Close summary windows that ended with no further edges ---- */
+        if (logging && summarising) {
+            summarising = summary_advance(&summary, now);
+            if (!summarising) {
+                last_tick = 0;
+            }
+        }
+#endif
     }
 }
@@ -13,7 +13,31 @@
 // Ring buffer for capture events. Size must be a power of two for fast masking.
 #define CAPTURE_BUFFER_MASK (CAPTURE_BUFFER_SIZE - 1)
 
+#if TIMER1_CAPTURE_COMPACT_SLOTS
+/*
+ * Compact slots: raw ICR1 values plus two bitmaps (one bit per slot).
+ *
+ *   capture_edge_bits   - edge polarity of an event slot (1 = rising).
+ *   capture_epoch_bits  - slot is an epoch marker; its value is the new
+ *                         upper 16 bits (timer1_overflow_hi) for the
+ *                         events that follow it.
+ *
+ * ring_epoch is the epoch of the newest queued event (ISR side);
+ * pop_epoch is the epoch of the last event popped (consumer side).
+ * Both start at zero with the overflow counter, so no marker is needed
+ * until the first wrap that has an event after it.
+ */
+static uint16_t capture_icr[CAPTURE_BUFFER_SIZE];
+static uint8_t capture_edge_bits[(CAPTURE_BUFFER_SIZE + 7) / 8];
+static uint8_t capture_epoch_bits[(CAPTURE_BUFFER_SIZE + 7) / 8];
+static uint16_t ring_epoch = 0;
+static uint16_t pop_epoch = 0;
+
+#define SLOT_BYTE(i) ((uint8_t)((i) >> 3))
+#define SLOT_MASK(i) ((uint8_t)(1u << ((i) & 7u)))
+#else
 static capture_event_t capture_buffer[CAPTURE_BUFFER_SIZE];
+#endif
 static volatile uint8_t buffer_head = 0;
 static volatile uint8_t buffer_tail = 0;
 static volatile uint16_t dropped_events = 0;
@@ -33,6 +57,10 @@ void timer1_capture_init(void) {
         buffer_tail = 0;
         dropped_events = 0;
         timer1_overflow_hi = 0;
+#if TIMER1_CAPTURE_COMPACT_SLOTS
+        ring_epoch = 0;
+        pop_epoch = 0;
+#endif
     }
 
     /* Stop Timer1 during configuration */
@@ -87,6 +115,12 @@ bool timer1_capture_available(void) {
  * during which interrupts are masked. Given the expected event rates, this
  * does not materially increase the risk of missed captures.
  *
+ * With compact slots, an epoch marker at the tail is consumed here and
+ * the event behind it is returned with the rebuilt 32-bit tick count. A
+ * marker is always queued together with the event that needed it, so at
+ * most two slots are consumed per call and a non-empty ring always yields
+ * an event.
+ *
  * Returns true if an event was retrieved, or false if the buffer was empty.
  */
 bool timer1_capture_pop(capture_event_t *out_event) {
@@ -94,8 +128,19 @@ bool timer1_capture_pop(capture_event_t *out_event) {
 
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
         if (buffer_head != buffer_tail) {
-            const uint8_t tail = buffer_tail;
+            uint8_t tail = buffer_tail;
+#if TIMER1_CAPTURE_COMPACT_SLOTS
+            if (capture_epoch_bits[SLOT_BYTE(tail)] & SLOT_MASK(tail)) {
+                pop_epoch = capture_icr[tail];
+                tail = (tail + 1) & CAPTURE_BUFFER_MASK;
+            }
+            out_event->ticks = ((uint32_t)pop_epoch << 16) | capture_icr[tail];
+            out_event->edge = (capture_edge_bits[SLOT_BYTE(tail)] & SLOT_MASK(tail))
+                                  ? CAPTURE_EDGE_RISING
+                                  : CAPTURE_EDGE_FALLING;
+#else
             *out_event = capture_buffer[tail];
+#endif
             buffer_tail = (tail + 1) & CAPTURE_BUFFER_MASK;
             ok = true;
         }
@@ -104,6 +149,23 @@ bool timer1_capture_pop(capture_event_t *out_event) {
     return ok;
 }
 
+/*
+ * Return the number of ring slots currently in use.
+ *
+ * Lets the drain logic see overload building up before the ISR has to
+ * start dropping events. The snapshot is taken atomically; it can only
+ * grow (ISR) or shrink (caller) after it is read.
+ */
+uint8_t timer1_capture_occupancy(void) {
+    uint8_t used;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        used = (uint8_t)((buffer_head - buffer_tail) & CAPTURE_BUFFER_MASK);
+    }
+
+    return used;
+}
+
 /*
  * Return the number of capture events dropped due to ring buffer overflow.
  *
@@ -195,6 +257,42 @@ ISR(TIMER1_CAPT_vect) {
         ovf_hi++;
     }
 
+#if TIMER1_CAPTURE_COMPACT_SLOTS
+    /*
+     * Compact enqueue.
+     *
+     * The first event of a new overflow epoch is preceded by a marker
+     * carrying ovf_hi, and the pair is queued as a unit: if there is no
+     * room for both the event is dropped and ring_epoch is left alone,
+     * so the next event retries the marker. Markers are pushed here
+     * rather than from TIMER1_OVF_vect because with both interrupts
+     * pending this vector runs first, and an event latched just after the
+     * wrap would otherwise be queued ahead of its marker. It also keeps
+     * idle overflows from consuming slots.
+     */
+    uint8_t head = buffer_head;
+    const uint8_t free_slots = (uint8_t)((buffer_tail - head - 1) & CAPTURE_BUFFER_MASK);
+    const bool new_epoch = (ovf_hi != ring_epoch);
+
+    if (free_slots > (new_epoch ? 1u : 0u)) {
+        if (new_epoch) {
+            capture_icr[head] = ovf_hi;
+            capture_epoch_bits[SLOT_BYTE(head)] |= SLOT_MASK(head);
+            ring_epoch = ovf_hi;
+            head = (head + 1) & CAPTURE_BUFFER_MASK;
+        }
+        capture_icr[head] = icr_ticks;
+        capture_epoch_bits[SLOT_BYTE(head)] &= (uint8_t)~SLOT_MASK(head);
+        if (edge == CAPTURE_EDGE_RISING) {
+            capture_edge_bits[SLOT_BYTE(head)] |= SLOT_MASK(head);
+        } else {
+            capture_edge_bits[SLOT_BYTE(head)] &= (uint8_t)~SLOT_MASK(head);
+        }
+        buffer_head = (head + 1) & CAPTURE_BUFFER_MASK;
+    } else {
+        dropped_events++;
+    }
+#else
     const uint32_t ticks = ((uint32_t)ovf_hi << 16) | icr_ticks;
 
     /*
@@ -220,6 +318,7 @@ ISR(TIMER1_CAPT_vect) {
          */
         dropped_events++;
     }
+#endif
 
     /*
      * Prepare for the next capture.
@@ -29,6 +29,18 @@ typedef struct {
 #define CAPTURE_BUFFER_SIZE 64
 #endif
 
+// Ring slot encoding.
+//   0: each slot holds a full capture_event_t (32-bit ticks + edge).
+//   1: each slot holds the raw 16-bit ICR1 value; edge polarity lives in a
+//      bitmap and the upper 16 bits are carried by in-band epoch markers
+//      that are queued only when an event lands in a new overflow epoch.
+//      The consumer rebuilds 32-bit ticks in timer1_capture_pop(), so the
+//      interface below is unchanged. Costs 18 bits per slot instead of 48,
+//      allowing a much deeper ring in the same SRAM.
+#ifndef TIMER1_CAPTURE_COMPACT_SLOTS
+#define TIMER1_CAPTURE_COMPACT_SLOTS 0
+#endif
+
 // Configure Timer1 for input capture on ICP1 (PB0 on ATmega328P).
 // Timer1 runs at F_CPU with no prescaler; ticks are raw timer counts.
 void timer1_capture_init(void);
@@ -39,6 +51,10 @@ bool timer1_capture_available(void);
 // Pop the oldest event from the ring buffer. Returns false if empty.
 bool timer1_capture_pop(capture_event_t *out_event);
 
+// Number of ring slots currently in use (0 .. CAPTURE_BUFFER_SIZE - 1).
+// With compact slots this includes queued epoch markers.
+uint8_t timer1_capture_occupancy(void);
+
 // Number of events dropped due to ring-buffer overflow (wraps at 65535).
 // Returned value is a coherent snapshot (read atomically).
 uint16_t timer1_capture_dropped(void);
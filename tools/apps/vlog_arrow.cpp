@@ -0,0 +1,103 @@
+/*
+ * vlog_arrow: export decoded runs as Apache Arrow IPC.
+ *
+ *   vlog_arrow [--stream] <out|-> <input>...
+ *
+ * Inputs are raw logger captures or run files (.vlr). The output is the
+ * Arrow IPC file format, or the streaming format with --stream (required
+ * when writing to stdout via "-"). run_id is unique across the inputs, and
+ * each batch's metadata names its input and its run there.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "vlog/arrow_writer.h"
+#include "vlog/log_decoder.h"
+#include "vlog/mapped_file.h"
+#include "vlog/run_file.h"
+
+namespace {
+
+// Batch size for export: large enough that per-batch metadata is noise.
+constexpr size_t EXPORT_BATCH = 65536;
+
+bool has_suffix(const std::string &s, const char *suffix) {
+    const size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+void export_run_file(const std::string &path, vlog::run_sink &sink) {
+    vlog::replay_run_file(vlog::run_file(path), sink, EXPORT_BATCH);
+}
+
+void export_log(const std::string &path, vlog::run_sink &sink) {
+    const vlog::mapped_file log(path);
+
+    vlog::log_decoder decoder(sink, EXPORT_BATCH);
+    decoder.feed(log.chars(), log.size());
+    decoder.finish();
+
+    const vlog::decode_stats &st = decoder.stats();
+    if (st.malformed != 0) {
+        std::fprintf(stderr, "%s: %" PRIu64 " malformed lines skipped\n", path.c_str(),
+                     st.malformed);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int arg = 1;
+    bool stream = false;
+
+    if (arg < argc && std::strcmp(argv[arg], "--stream") == 0) {
+        stream = true;
+        arg++;
+    }
+    if (argc - arg < 2) {
+        std::fprintf(stderr, "usage: %s [--stream] <out|-> <input>...\n", argv[0]);
+        return 2;
+    }
+
+    const std::string out_path = argv[arg++];
+    const bool to_stdout = (out_path == "-");
+    if (to_stdout && !stream) {
+        std::fprintf(stderr, "vlog_arrow: writing to stdout requires --stream\n");
+        return 2;
+    }
+
+    std::FILE *out = to_stdout ? stdout : std::fopen(out_path.c_str(), "wb");
+    if (out == nullptr) {
+        std::perror(out_path.c_str());
+        return 1;
+    }
+
+    int rc = 0;
+    try {
+        vlog::arrow_ipc_writer writer(out, stream ? vlog::arrow_ipc_writer::layout::stream
+                                                  : vlog::arrow_ipc_writer::layout::file);
+        for (; arg < argc; arg++) {
+            writer.source(argv[arg]);
+            if (has_suffix(argv[arg], ".vlr")) {
+                export_run_file(argv[arg], writer);
+            } else {
+                export_log(argv[arg], writer);
+            }
+        }
+        writer.finish();
+        std::fprintf(stderr, "# rows=%" PRIu64 "\n", writer.rows());
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_arrow: %s\n", e.what());
+        rc = 1;
+    }
+
+    if (!to_stdout && std::fclose(out) != 0) {
+        std::perror(out_path.c_str());
+        rc = 1;
+    }
+    return rc;
+}
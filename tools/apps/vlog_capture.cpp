@@ -0,0 +1,160 @@
+/*
+ * vlog_capture: record several loggers at once.
+ *
+ *   vlog_capture [-o out_dir] [-w writers] [-b ring_kib] [-B baud] [-i report_s]
+ *                [-s fsync_s] [-l live_records] [-m metrics_addr] <device>[=name]...
+ *
+ * Each device's raw stream is appended to <out_dir>/<name>.log (name
+ * defaults to the device's basename). With -l the decoded events are also
+ * published live to the shared-memory ring /vlog.<name> of that many
+ * records (a power of two), for vlog_tap and other monitors. Every report
+ * interval one line per device is printed to stderr with read/write
+ * throughput, backlog and its high-water mark. Runs until SIGINT/SIGTERM
+ * or until every device has hung up.
+ *
+ * With -m the daemon's counters are served as OpenMetrics text on a Unix
+ * socket (an address containing '/') or on loopback TCP ([host:]port):
+ * bytes and events per device, decode errors, the firmware's dropped
+ * counter and ring high-water from status records, backlog, writer queue
+ * depth and fdatasync latency histograms. Scrape it with Prometheus, or
+ *
+ *   curl -s --unix-socket /tmp/cap/metrics.sock http://x/metrics
+ *
+ * For testing without hardware, drive pty pairs with vlog_synth:
+ *
+ *   vlog_synth -P -r 20000 > /tmp/a &   # prints the pty slave path
+ *   vlog_capture -o /tmp/cap $(cat /tmp/a)=a ...
+ */
+
+#include <signal.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vlog/capture_daemon.h"
+#include "vlog/metrics.h"
+
+namespace {
+
+vlog::capture_daemon *g_daemon = nullptr;
+
+void on_signal(int) {
+    if (g_daemon != nullptr) {
+        g_daemon->stop();
+    }
+}
+
+std::string basename_of(const std::string &path) {
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+class reporter {
+public:
+    void operator()(const std::vector<vlog::device_status> &devices) {
+        const auto now = std::chrono::steady_clock::now();
+        const double dt = std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+        prev_.resize(devices.size());
+
+        for (size_t i = 0; i < devices.size(); i++) {
+            const vlog::device_status &d = devices[i];
+            const double in = dt > 0.0 ? (d.bytes_read - prev_[i].bytes_read) / dt : 0.0;
+            const double out = dt > 0.0 ? (d.bytes_written - prev_[i].bytes_written) / dt : 0.0;
+            std::fprintf(stderr,
+                         "%-12s %s in %9.0f B/s out %9.0f B/s total %" PRIu64 " backlog %" PRIu64
+                         " hwm %" PRIu64 " pauses %" PRIu64 " fsyncs %" PRIu64 " errors %" PRIu64
+                         "\n",
+                         d.name.c_str(), d.open ? "open  " : "closed", in, out, d.bytes_read,
+                         d.backlog, d.high_water, d.pauses, d.fsyncs, d.write_errors);
+            prev_[i] = d;
+        }
+    }
+
+private:
+    std::chrono::steady_clock::time_point last_ = std::chrono::steady_clock::now();
+    std::vector<vlog::device_status> prev_;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    vlog::capture_options options;
+    double report_s = 5.0;
+    std::string metrics_addr;
+    int arg = 1;
+
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        const std::string opt = argv[arg];
+        const char *value = argv[arg + 1];
+        if (opt == "-o") {
+            options.out_dir = value;
+        } else if (opt == "-w") {
+            options.writers = static_cast<unsigned>(std::atoi(value));
+        } else if (opt == "-b") {
+            options.ring_bytes = static_cast<size_t>(std::atol(value)) * 1024;
+        } else if (opt == "-B") {
+            options.baud = static_cast<uint32_t>(std::atol(value));
+        } else if (opt == "-i") {
+            report_s = std::atof(value);
+        } else if (opt == "-s") {
+            options.fsync_interval = std::atof(value);
+        } else if (opt == "-l") {
+            options.live_records = static_cast<size_t>(std::atol(value));
+        } else if (opt == "-m") {
+            metrics_addr = value;
+            options.decode = true;
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc || argv[arg][0] == '-') {
+        std::fprintf(stderr,
+                     "usage: %s [-o out_dir] [-w writers] [-b ring_kib] [-B baud] [-i report_s] "
+                     "[-s fsync_s] [-l live_records] [-m metrics_addr] <device>[=name]...\n",
+                     argv[0]);
+        return 2;
+    }
+
+    try {
+        vlog::capture_daemon daemon(options);
+        for (; arg < argc; arg++) {
+            const std::string spec = argv[arg];
+            const size_t eq = spec.find('=');
+            const std::string path = spec.substr(0, eq);
+            daemon.add_device(path, eq == std::string::npos ? basename_of(path)
+                                                            : spec.substr(eq + 1));
+        }
+
+        std::unique_ptr<vlog::metrics_server> metrics;
+        if (!metrics_addr.empty()) {
+            metrics.reset(
+                new vlog::metrics_server(metrics_addr, [&daemon] { return daemon.metrics(); }));
+            std::fprintf(stderr, "metrics on %s\n", metrics->address().c_str());
+        }
+
+        g_daemon = &daemon;
+        struct sigaction sa = {};
+        sa.sa_handler = on_signal;
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+
+        reporter report;
+        daemon.run(report_s, std::ref(report));
+        g_daemon = nullptr;
+    } catch (const std::exception &e) {
+        g_daemon = nullptr;
+        std::fprintf(stderr, "vlog_capture: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
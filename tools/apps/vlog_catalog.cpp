@@ -0,0 +1,157 @@
+/*
+ * vlog_catalog: index an archive of raw logs by run, and query it.
+ *
+ *   vlog_catalog -a [-j threads] [-f] <catalog.vlc> <log>...
+ *   vlog_catalog <catalog.vlc> [condition...]
+ *
+ * With -a every log is decoded (on `threads` workers; -f for the framed
+ * encoding) and its runs are added to the catalog, replacing any entries
+ * it already had for that log; the catalog is created if missing. Logs
+ * are recorded by absolute path.
+ *
+ * Otherwise prints the catalogued runs satisfying all conditions (see
+ * vlog/catalog.h) as CSV, from the catalog alone:
+ *
+ *   vlog_catalog archive.vlc icnc1=off dropped>0
+ *
+ *   source,offset,run,session,f_cpu,baud,prescaler,buffer,icnc1,truncated,
+ *   events,rising,dropped,summarised,duration_s,
+ *   {period,high,low}_{count,min,p50,p99,max,mean} (timings in ticks)
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vlog/binary_log.h"
+#include "vlog/catalog.h"
+#include "vlog/log_decoder.h"
+#include "vlog/mapped_file.h"
+
+namespace {
+
+std::string absolute_path(const std::string &path) {
+    char buf[PATH_MAX];
+    if (realpath(path.c_str(), buf) == nullptr) {
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+    }
+    return buf;
+}
+
+void print_timing(const vlog::catalog_timing &t) {
+    std::printf(",%" PRIu64 ",%u,%u,%u,%u,%.3f", t.count, t.min, t.p50, t.p99, t.max, t.mean);
+}
+
+int add_logs(const std::string &path, const std::vector<std::string> &logs, unsigned threads,
+             bool framed) {
+    struct stat st;
+    vlog::catalog c;
+    if (stat(path.c_str(), &st) == 0) {
+        c = vlog::catalog_file(path).load();
+    }
+
+    for (const std::string &log_path : logs) {
+        const vlog::mapped_file log(log_path);
+        vlog::catalog_builder builder;
+        if (framed) {
+            vlog::binary_log_decoder decoder(builder);
+            decoder.feed(log.chars(), log.size());
+            decoder.finish();
+        } else {
+            vlog::log_decoder decoder(builder);
+            decoder.feed_parallel(log.chars(), log.size(), threads);
+            decoder.finish();
+        }
+        std::fprintf(stderr, "%s: %zu run(s)\n", log_path.c_str(), builder.entries().size());
+        c.add_source(absolute_path(log_path), builder.entries());
+    }
+
+    vlog::write_catalog(path, c);
+    std::fprintf(stderr, "# sources=%zu runs=%zu\n", c.sources.size(), c.entries.size());
+    return 0;
+}
+
+int list_runs(const std::string &path, const std::vector<std::string> &terms) {
+    const std::vector<vlog::catalog_condition> filter = vlog::parse_catalog_filter(terms);
+    const vlog::catalog_file c(path);
+
+    std::printf("source,offset,run,session,f_cpu,baud,prescaler,buffer,icnc1,truncated,events,"
+                "rising,dropped,summarised,duration_s");
+    for (const char *metric : {"period", "high", "low"}) {
+        for (const char *stat : {"count", "min", "p50", "p99", "max", "mean"}) {
+            std::printf(",%s_%s", metric, stat);
+        }
+    }
+    std::printf("\n");
+
+    for (size_t i = 0; i < c.size(); i++) {
+        const vlog::catalog_entry &e = c.entries()[i];
+        const std::string &source = c.source(e.source);
+        if (!vlog::catalog_matches(filter, e, source)) {
+            continue;
+        }
+        std::printf("%s,%" PRIu64 ",%u,%u,%u,%u,%u,%u,%d,%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                    ",%" PRIu64 ",%.6f",
+                    source.c_str(), e.source_offset, e.run_index, e.session, e.f_cpu, e.baud,
+                    e.timer1_prescaler, e.capture_buffer_size, e.icnc1,
+                    (e.flags & vlog::CATALOG_FLAG_TRUNCATED) != 0 ? 1 : 0, e.event_count,
+                    e.rising, e.dropped, e.summarised, vlog::catalog_duration(e));
+        print_timing(e.period);
+        print_timing(e.high);
+        print_timing(e.low);
+        std::printf("\n");
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    unsigned threads = 1;
+    bool add = false;
+    bool framed = false;
+    int arg = 1;
+
+    for (;;) {
+        if (arg + 1 < argc && std::strcmp(argv[arg], "-j") == 0) {
+            threads = static_cast<unsigned>(std::atoi(argv[arg + 1]));
+            arg += 2;
+        } else if (arg < argc && std::strcmp(argv[arg], "-a") == 0) {
+            add = true;
+            arg++;
+        } else if (arg < argc && std::strcmp(argv[arg], "-f") == 0) {
+            framed = true;
+            arg++;
+        } else {
+            break;
+        }
+    }
+    /* An unknown or incomplete option is not a catalog path. */
+    const bool bad = arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0';
+    if (bad || arg >= argc || (add && argc - arg < 2) || threads == 0) {
+        std::fprintf(stderr,
+                     "usage: %s -a [-j threads] [-f] <catalog.vlc> <log>...\n"
+                     "       %s <catalog.vlc> [condition...]\n",
+                     argv[0], argv[0]);
+        return 2;
+    }
+    const std::string path = argv[arg];
+    const std::vector<std::string> rest(argv + arg + 1, argv + argc);
+
+    try {
+        return add ? add_logs(path, rest, threads, framed) : list_runs(path, rest);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_catalog: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * vlog_clock: map device ticks to host time.
+ *
+ *   vlog_clock [-f] [-e] [-m memory] <log> [<stamps>]
+ *
+ * Pairs the log's `# SYNC` records with the read stamps vlog_capture wrote
+ * next to it (<log> with ".log" replaced by ".time" unless given) and fits
+ * device ticks against the host clock (vlog/clock_sync.h). For each
+ * power-on session a summary goes to stderr: sync points used, points
+ * down-weighted as outliers, the device clock error in ppm and the residual
+ * scale. With -e every event is printed to stdout as
+ *
+ *   run,ticks,edge,wall_ns
+ *
+ * where wall_ns is CLOCK_REALTIME in nanoseconds from the fit as it stood
+ * at that point of the log (empty before the first sync). -f reads the
+ * binary framed encoding; -m sets the fit memory in sync points.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+#include "vlog/binary_log.h"
+#include "vlog/clock_sync.h"
+#include "vlog/log_decoder.h"
+#include "vlog/mapped_file.h"
+
+namespace {
+
+class annotator : public vlog::run_sink {
+public:
+    annotator(vlog::device_clock &clock, bool print_events)
+        : clock_(clock), print_events_(print_events) {}
+
+    void begin_run(const vlog::run_info &info) override { run_ = info.index; }
+
+    void events(const vlog::event_batch &batch) override {
+        if (!print_events_) {
+            return;
+        }
+        for (size_t i = 0; i < batch.count; i++) {
+            if (clock_.valid()) {
+                std::printf("%u,%" PRId64 ",%c,%" PRId64 "\n", run_, batch.ticks[i],
+                            batch.edge[i] == vlog::EDGE_RISING ? 'R' : 'F',
+                            clock_.real_ns(batch.ticks[i]));
+            } else {
+                std::printf("%u,%" PRId64 ",%c,\n", run_, batch.ticks[i],
+                            batch.edge[i] == vlog::EDGE_RISING ? 'R' : 'F');
+            }
+        }
+    }
+
+    void end_run(const vlog::run_info &) override {}
+
+    void sync(const vlog::sync_point &s) override {
+        if (clock_.valid() && s.session != clock_.session()) {
+            report();
+        }
+        clock_.sync(s);
+    }
+
+    // Summary of the session whose fit is current.
+    void report() const {
+        const vlog::clock_fit &fit = clock_.fit();
+        std::fprintf(stderr,
+                     "# session=%u syncs=%zu downweighted=%zu error_ppm=%.3f residual_us=%.1f\n",
+                     clock_.session(), fit.points(), fit.downweighted(), clock_.error_ppm(),
+                     fit.residual_ns() / 1000.0);
+    }
+
+private:
+    vlog::device_clock &clock_;
+    bool print_events_;
+    uint32_t run_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    bool framed = false;
+    bool print_events = false;
+    double memory = 300.0;
+    int arg = 1;
+
+    for (;;) {
+        if (arg < argc && std::strcmp(argv[arg], "-f") == 0) {
+            framed = true;
+            arg++;
+        } else if (arg < argc && std::strcmp(argv[arg], "-e") == 0) {
+            print_events = true;
+            arg++;
+        } else if (arg + 1 < argc && std::strcmp(argv[arg], "-m") == 0) {
+            memory = std::atof(argv[arg + 1]);
+            arg += 2;
+        } else {
+            break;
+        }
+    }
+    /* An unknown or incomplete option is not a log path. */
+    const bool bad = arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0';
+    if (bad || argc - arg < 1 || argc - arg > 2 || memory < 1.0) {
+        std::fprintf(stderr, "usage: %s [-f] [-e] [-m memory] <log> [<stamps>]\n", argv[0]);
+        return 2;
+    }
+
+    try {
+        const vlog::mapped_file log(argv[arg]);
+        const vlog::read_stamps stamps(argc - arg > 1 ? argv[arg + 1] : vlog::read_stamps_path(argv[arg]));
+
+        vlog::device_clock clock(stamps, memory);
+        annotator sink(clock, print_events);
+        uint64_t syncs;
+        if (framed) {
+            vlog::binary_log_decoder decoder(sink);
+            decoder.feed(log.chars(), log.size());
+            decoder.finish();
+            syncs = decoder.records().syncs;
+        } else {
+            vlog::log_decoder decoder(sink);
+            decoder.feed(log.chars(), log.size());
+            decoder.finish();
+            syncs = decoder.stats().syncs;
+        }
+
+        if (clock.valid()) {
+            sink.report();
+        }
+        std::fprintf(stderr, "# sync_records=%" PRIu64 " unpaired=%" PRIu64 "\n", syncs,
+                     clock.unpaired());
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_clock: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
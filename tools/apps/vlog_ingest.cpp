@@ -0,0 +1,99 @@
+/*
+ * vlog_ingest: keep the fast formats of a capture directory up to date.
+ *
+ *   vlog_ingest [-j workers] [-o out_dir] [-P] [-Z] [-1] <capture_dir>
+ *
+ * Watches <capture_dir> (typically vlog_capture's -o directory) and
+ * decodes each *.log incrementally as it grows. Every completed run gets
+ * a run file <out_dir>/<log>_NNNN.vlr, its compressed copy .vlz (whose
+ * block index is the time index) and min/max pyramid .vlp, and an entry
+ * in <out_dir>/catalog.vlc (see vlog_catalog). out_dir defaults to the
+ * capture directory.
+ *
+ * -j sets the worker threads packing and summarising runs (default 1);
+ * decoding uses one more. -P skips pyramids and -Z compressed copies.
+ * With -1 the existing logs are ingested and the tool exits; otherwise it
+ * runs until SIGINT/SIGTERM. Each finished run is printed on stderr.
+ */
+
+#include <signal.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "vlog/ingest.h"
+
+namespace {
+
+vlog::ingest_service *g_service = nullptr;
+
+void on_signal(int) {
+    if (g_service != nullptr) {
+        g_service->stop();
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    vlog::ingest_options options;
+    bool once = false;
+    int arg = 1;
+
+    for (;;) {
+        if (arg + 1 < argc && std::strcmp(argv[arg], "-j") == 0) {
+            options.workers = static_cast<unsigned>(std::atoi(argv[arg + 1]));
+            arg += 2;
+        } else if (arg + 1 < argc && std::strcmp(argv[arg], "-o") == 0) {
+            options.out_dir = argv[arg + 1];
+            arg += 2;
+        } else if (arg < argc && std::strcmp(argv[arg], "-P") == 0) {
+            options.pyramid = false;
+            arg++;
+        } else if (arg < argc && std::strcmp(argv[arg], "-Z") == 0) {
+            options.pack = false;
+            arg++;
+        } else if (arg < argc && std::strcmp(argv[arg], "-1") == 0) {
+            once = true;
+            arg++;
+        } else {
+            break;
+        }
+    }
+    /* An unknown or incomplete option is not a capture directory. */
+    const bool bad = arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0';
+    if (bad || argc - arg != 1 || options.workers == 0) {
+        std::fprintf(stderr, "usage: %s [-j workers] [-o out_dir] [-P] [-Z] [-1] <capture_dir>\n",
+                     argv[0]);
+        return 2;
+    }
+
+    try {
+        vlog::ingest_service service(argv[arg], options);
+        g_service = &service;
+        struct sigaction sa = {};
+        sa.sa_handler = on_signal;
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+
+        service.run(once, [](const std::string &line) {
+            std::fprintf(stderr, "%s\n", line.c_str());
+        });
+        g_service = nullptr;
+
+        const vlog::ingest_stats &st = service.stats();
+        std::fprintf(stderr,
+                     "# bytes=%" PRIu64 " runs=%" PRIu64 " skipped=%" PRIu64 " restarts=%" PRIu64
+                     " errors=%" PRIu64 "\n",
+                     st.bytes, st.runs, st.skipped, st.restarts, st.errors);
+    } catch (const std::exception &e) {
+        g_service = nullptr;
+        std::fprintf(stderr, "vlog_ingest: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
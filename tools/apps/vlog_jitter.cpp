@@ -0,0 +1,96 @@
+/*
+ * vlog_jitter: clock stability report for captured runs.
+ *
+ *   vlog_jitter [-j threads] [-p taus_per_octave] [-f] <run.vlr|run.vlz>...
+ *
+ * For each run prints the fitted clock, TIE, period and cycle-to-cycle
+ * jitter, then an overlapping Allan deviation table. Rising edges are the
+ * clock reference unless -f selects falling edges.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "vlog/jitter.h"
+#include "vlog/packed_run.h"
+#include "vlog/run_file.h"
+
+namespace {
+
+bool has_suffix(const std::string &s, const char *suffix) {
+    const size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+void report(const std::string &path, const vlog::run_info &info, const int64_t *ticks,
+            const uint8_t *edge, const uint16_t *gap, size_t n,
+            const vlog::jitter_options &options) {
+    const double f = vlog::tick_rate(info.config);
+    const vlog::jitter_report r = vlog::analyse_jitter(ticks, edge, gap, n, f, options);
+
+    std::printf("# %s (run %u)\n", path.c_str(), info.index);
+    std::printf("edges          %" PRIu64 " over %" PRIu64 " cycles\n", r.edges, r.cycles);
+    std::printf("ideal period   %.6f ticks (%.9g Hz)\n", r.ideal_period, r.frequency_hz);
+    std::printf("tie rms        %.3f ticks (%.4g s)\n", r.tie_rms, r.tie_rms / f);
+    std::printf("tie pk-pk      %.3f ticks (%.4g s)\n", r.tie_max - r.tie_min,
+                (r.tie_max - r.tie_min) / f);
+    std::printf("period         %" PRIu64 " measured, mean %.3f, min %" PRId64 ", max %" PRId64
+                " ticks\n",
+                r.periods, r.period_mean, r.period_min, r.period_max);
+    std::printf("period jitter  %.3f ticks rms (%.4g s)\n", r.period_rms, r.period_rms / f);
+    std::printf("c2c jitter     %.3f ticks rms, %" PRId64 " max (%.4g s rms)\n", r.c2c_rms,
+                r.c2c_max, r.c2c_rms / f);
+    std::printf("m,tau_s,adev,terms\n");
+    for (const vlog::allan_point &p : r.adev) {
+        std::printf("%" PRIu64 ",%.6g,%.6e,%" PRIu64 "\n", p.m, p.tau_s, p.adev, p.terms);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    vlog::jitter_options options;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (std::strcmp(argv[arg], "-f") == 0) {
+            options.edge = vlog::EDGE_FALLING;
+        } else if (std::strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+            options.threads = static_cast<unsigned>(std::atoi(argv[++arg]));
+        } else if (std::strcmp(argv[arg], "-p") == 0 && arg + 1 < argc) {
+            options.taus_per_octave = static_cast<unsigned>(std::atoi(argv[++arg]));
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc || argv[arg][0] == '-') {
+        std::fprintf(stderr,
+                     "usage: %s [-j threads] [-p taus_per_octave] [-f] <run.vlr|run.vlz>...\n",
+                     argv[0]);
+        return 2;
+    }
+
+    try {
+        for (; arg < argc; arg++) {
+            if (has_suffix(argv[arg], ".vlz")) {
+                const vlog::capture_run run =
+                    vlog::packed_run(argv[arg]).decode_all(options.threads);
+                report(argv[arg], run.info, run.ticks.data(), run.edge.data(), run.gap.data(),
+                       run.size(), options);
+            } else {
+                const vlog::run_file run(argv[arg]);
+                report(argv[arg], run.info(), run.ticks(), run.edge(), run.gap(), run.size(),
+                       options);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_jitter: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * vlog_merge: merge captures from several loggers into one timeline.
+ *
+ *   vlog_merge [-m memory] [-H hold] <log>...
+ *
+ * Each log is read with the stamps vlog_capture wrote next to it and its
+ * ticks are mapped to host time through its own sync records (see
+ * vlog_clock). The events of all logs are then merged by host time and
+ * written to stdout as
+ *
+ *   time_ns,channel,run,ticks,edge
+ *
+ * where channel is the log's position on the command line and time_ns is
+ * CLOCK_REALTIME in nanoseconds: the host's monotonic clock shifted by one
+ * fixed offset, taken from channel 0 where it can be, so that a wall-clock
+ * step during the capture cannot reorder the output. Logs may be text or
+ * framed. A summary per channel goes to stderr, with the clock's offset and
+ * drift relative to channel 0. -m sets the fit memory in sync points, -H
+ * the events held per log while waiting for a session's first sync.
+ */
+
+#include <charconv>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include "vlog/merge.h"
+
+namespace {
+
+// Formats rows straight into a large buffer; this is the bulk of the
+// tool's work once the sources are decoded.
+class csv_writer : public vlog::merge_sink {
+public:
+    explicit csv_writer(const std::vector<vlog::merge_source *> &sources) : sources_(sources) {}
+    ~csv_writer() override { flush(); }
+
+    void events(uint16_t channel, const vlog::timed_event *ev, size_t n) override {
+        if (!have_offset_) {
+            offset_ = sources_[0]->clock().valid() ? sources_[0]->clock().real_offset_ns()
+                                                   : sources_[channel]->clock().real_offset_ns();
+            have_offset_ = true;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (len_ > sizeof(buf_) - ROW_MAX) {
+                flush();
+            }
+            char *p = buf_ + len_;
+            char *const end = buf_ + sizeof(buf_);
+            p = std::to_chars(p, end, ev[i].time_ns + offset_).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, end, channel).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, end, ev[i].run).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, end, ev[i].ticks).ptr;
+            *p++ = ',';
+            *p++ = ev[i].edge == vlog::EDGE_RISING ? 'R' : 'F';
+            *p++ = '\n';
+            len_ = static_cast<size_t>(p - buf_);
+        }
+        rows_ += n;
+    }
+
+    void flush() {
+        if (len_ != 0 && std::fwrite(buf_, 1, len_, stdout) != len_) {
+            failed_ = true;
+        }
+        len_ = 0;
+    }
+
+    bool failed() const { return failed_ || std::ferror(stdout) != 0; }
+    uint64_t rows() const { return rows_; }
+
+private:
+    static constexpr size_t ROW_MAX = 80;
+
+    const std::vector<vlog::merge_source *> &sources_;
+    bool have_offset_ = false;
+    int64_t offset_ = 0;
+    char buf_[1u << 16];
+    size_t len_ = 0;
+    uint64_t rows_ = 0;
+    bool failed_ = false;
+};
+
+void report(const std::vector<vlog::merge_source *> &sources) {
+    const vlog::device_clock &ref = sources[0]->clock();
+    for (size_t i = 0; i < sources.size(); i++) {
+        const vlog::merge_source &s = *sources[i];
+        const vlog::device_clock &clock = s.clock();
+        std::fprintf(stderr,
+                     "# channel=%zu source=%s events=%" PRIu64 " unaligned=%" PRIu64
+                     " clamped=%" PRIu64 " unpaired_syncs=%" PRIu64 "\n",
+                     i, s.path().c_str(), s.stats().events, s.stats().unaligned,
+                     s.stats().clamped, clock.unpaired());
+        if (!clock.valid()) {
+            continue;
+        }
+        /* The offset is between the two clocks' tick zeros (power-on) in
+         * host time; the drift is their rate difference. */
+        std::fprintf(stderr, "#   error_ppm=%.3f residual_us=%.1f", clock.error_ppm(),
+                     clock.fit().residual_ns() / 1000.0);
+        if (i != 0 && ref.valid()) {
+            std::fprintf(stderr, " offset_ms=%.3f drift_ppm=%.3f",
+                         (clock.mono_ns(0) - ref.mono_ns(0)) / 1e6,
+                         clock.error_ppm() - ref.error_ppm());
+        }
+        std::fprintf(stderr, "\n");
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    double memory = 300.0;
+    long hold = 1l << 20;
+    int arg = 1;
+
+    for (;;) {
+        if (arg + 1 < argc && std::strcmp(argv[arg], "-m") == 0) {
+            memory = std::atof(argv[arg + 1]);
+            arg += 2;
+        } else if (arg + 1 < argc && std::strcmp(argv[arg], "-H") == 0) {
+            hold = std::atol(argv[arg + 1]);
+            arg += 2;
+        } else {
+            break;
+        }
+    }
+    /* An unknown or incomplete option is not a source path. */
+    const bool bad = arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0';
+    if (bad || arg >= argc || argc - arg > 65536 || memory < 1.0 || hold < 0) {
+        std::fprintf(stderr, "usage: %s [-m memory] [-H hold] <log>...\n", argv[0]);
+        return 2;
+    }
+
+    try {
+        std::vector<std::unique_ptr<vlog::merge_source>> owned;
+        std::vector<vlog::merge_source *> sources;
+        for (int i = arg; i < argc; i++) {
+            owned.emplace_back(new vlog::merge_source(argv[i], vlog::read_stamps_path(argv[i]),
+                                                      memory, static_cast<size_t>(hold)));
+            sources.push_back(owned.back().get());
+        }
+
+        std::fputs("time_ns,channel,run,ticks,edge\n", stdout);
+        csv_writer out(sources);
+        vlog::merge_timelines(sources, out);
+        out.flush();
+        if (std::fflush(stdout) != 0 || out.failed()) {
+            std::fprintf(stderr, "vlog_merge: write error on stdout\n");
+            return 1;
+        }
+
+        report(sources);
+        std::fprintf(stderr, "# rows=%" PRIu64 "\n", out.rows());
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_merge: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * vlog_pack: compress runs with the edge timestamp codec, or expand them.
+ *
+ *   vlog_pack <log|run.vlr> <out-dir> [stem]    write <out-dir>/<stem>_NNNN.vlz
+ *   vlog_pack -x <run.vlz> <out.vlr> [threads]  expand back to a run file
+ *
+ * Sizes, ratios and decode throughput are reported on stderr.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include <sys/stat.h>
+
+#include "vlog/log_decoder.h"
+#include "vlog/mapped_file.h"
+#include "vlog/packed_run.h"
+#include "vlog/run_file.h"
+
+namespace {
+
+bool has_suffix(const std::string &s, const char *suffix) {
+    const size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+double file_size(const std::string &path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 ? static_cast<double>(st.st_size) : 0.0;
+}
+
+int compress(const std::string &input, const std::string &dir, const std::string &stem) {
+    vlog::packed_run_writer writer(dir, stem);
+
+    if (has_suffix(input, ".vlr")) {
+        vlog::replay_run_file(vlog::run_file(input), writer);
+    } else {
+        const vlog::mapped_file log(input);
+        vlog::log_decoder decoder(writer);
+        decoder.feed(log.chars(), log.size());
+        decoder.finish();
+    }
+
+    const double in_bytes = file_size(input);
+    double out_bytes = 0.0;
+    for (const std::string &path : writer.paths()) {
+        const vlog::packed_run packed(path);
+        const double sz = file_size(path);
+        out_bytes += sz;
+        std::fprintf(stderr, "%s: %zu events, %.0f bytes (%.3f bytes/event)\n", path.c_str(),
+                     packed.size(), sz, packed.size() > 0 ? sz / packed.size() : 0.0);
+    }
+    if (out_bytes > 0.0) {
+        std::fprintf(stderr, "# ratio=%.1f (%.0f -> %.0f bytes)\n", in_bytes / out_bytes, in_bytes,
+                     out_bytes);
+    }
+    return 0;
+}
+
+int expand(const std::string &input, const std::string &output, unsigned threads) {
+    const vlog::packed_run packed(input);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const vlog::capture_run run = packed.decode_all(threads);
+    const auto t1 = std::chrono::steady_clock::now();
+
+    vlog::write_run_file(output, run);
+
+    const double secs = std::chrono::duration<double>(t1 - t0).count();
+    const double raw = static_cast<double>(run.size()) * (sizeof(int64_t) + sizeof(uint8_t) + sizeof(uint16_t));
+    std::fprintf(stderr, "# events=%zu decode=%.3fs (%.2f GB/s of columns)\n", run.size(), secs,
+                 secs > 0.0 ? raw / secs / 1e9 : 0.0);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    try {
+        if (argc >= 4 && argc <= 5 && std::strcmp(argv[1], "-x") == 0) {
+            const unsigned threads = argc > 4 ? static_cast<unsigned>(std::atoi(argv[4])) : 1u;
+            return expand(argv[2], argv[3], threads);
+        }
+        if (argc >= 3 && argc <= 4 && argv[1][0] != '-') {
+            return compress(argv[1], argv[2], argc > 3 ? argv[3] : "run");
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_pack: %s\n", e.what());
+        return 1;
+    }
+
+    std::fprintf(stderr,
+                 "usage: %s <log|run.vlr> <out-dir> [stem]\n"
+                 "       %s -x <run.vlz> <out.vlr> [threads]\n",
+                 argv[0], argv[0]);
+    return 2;
+}
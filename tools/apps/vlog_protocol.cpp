@@ -0,0 +1,152 @@
+/*
+ * vlog_protocol: decode serial protocols captured on ICP1.
+ *
+ *   vlog_protocol uart <baud> [-d data_bits] [-p none|even|odd] [-s stop_bits] [-i]
+ *                 <input>...
+ *   vlog_protocol manchester <bit_rate> [-t] [-w word_bits] [-l] <input>...
+ *
+ * Inputs are raw logger captures or run files (.vlr). Prints one CSV row
+ * per frame: UART characters, or Manchester bits assembled into words
+ * (-w, MSB first unless -l; -t selects the G. E. Thomas convention).
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include "vlog/log_decoder.h"
+#include "vlog/manchester.h"
+#include "vlog/mapped_file.h"
+#include "vlog/protocol.h"
+#include "vlog/run_file.h"
+#include "vlog/serial_decoder.h"
+
+namespace {
+
+constexpr size_t DECODE_BATCH = 65536;
+
+const char *const KIND_NAMES[] = {"uart", "bit", "word"};
+
+bool has_suffix(const std::string &s, const char *suffix) {
+    const size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+class frame_printer : public vlog::frame_sink {
+public:
+    void frames(const vlog::protocol_frame *f, size_t n) override {
+        for (size_t i = 0; i < n; i++) {
+            std::printf("%u,%" PRId64 ",%" PRId64 ",%s,%u,0x%" PRIx64 ",%u\n", run, f[i].start,
+                        f[i].end, KIND_NAMES[f[i].kind], f[i].bits, f[i].value, f[i].flags);
+        }
+    }
+
+    uint32_t run = 0;
+};
+
+// Labels output rows with the run they came from.
+class labelled_runner : public vlog::protocol_runner {
+public:
+    labelled_runner(vlog::edge_decoder &decoder, frame_printer &printer)
+        : protocol_runner(decoder), printer_(printer) {}
+
+    void begin_run(const vlog::run_info &info) override {
+        printer_.run = info.index;
+        protocol_runner::begin_run(info);
+    }
+
+private:
+    frame_printer &printer_;
+};
+
+void decode_input(const std::string &path, vlog::run_sink &sink) {
+    if (has_suffix(path, ".vlr")) {
+        vlog::replay_run_file(vlog::run_file(path), sink, DECODE_BATCH);
+        return;
+    }
+
+    const vlog::mapped_file log(path);
+    vlog::log_decoder decoder(sink, DECODE_BATCH);
+    decoder.feed(log.chars(), log.size());
+    decoder.finish();
+}
+
+int usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s uart <baud> [-d data_bits] [-p none|even|odd] [-s stop_bits] [-i] "
+                 "<input>...\n"
+                 "       %s manchester <bit_rate> [-t] [-w word_bits] [-l] <input>...\n",
+                 argv0, argv0);
+    return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        return usage(argv[0]);
+    }
+    const std::string protocol = argv[1];
+    const double rate = std::atof(argv[2]);
+    int arg = 3;
+
+    vlog::uart_options uart;
+    vlog::manchester_options manchester;
+    vlog::assembler_options assembler;
+    uart.baud = rate;
+    manchester.bit_rate = rate;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        const char *opt = argv[arg];
+        const bool has_value = arg + 1 < argc;
+        if (std::strcmp(opt, "-i") == 0) {
+            uart.inverted = true;
+        } else if (std::strcmp(opt, "-t") == 0) {
+            manchester.ieee = false;
+        } else if (std::strcmp(opt, "-l") == 0) {
+            assembler.msb_first = false;
+        } else if (std::strcmp(opt, "-d") == 0 && has_value) {
+            uart.data_bits = static_cast<uint8_t>(std::atoi(argv[++arg]));
+        } else if (std::strcmp(opt, "-s") == 0 && has_value) {
+            uart.stop_bits = static_cast<uint8_t>(std::atoi(argv[++arg]));
+        } else if (std::strcmp(opt, "-w") == 0 && has_value) {
+            assembler.word_bits = static_cast<unsigned>(std::atoi(argv[++arg]));
+        } else if (std::strcmp(opt, "-p") == 0 && has_value) {
+            const std::string p = argv[++arg];
+            uart.parity = p == "even" ? vlog::PARITY_EVEN
+                                      : (p == "odd" ? vlog::PARITY_ODD : vlog::PARITY_NONE);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (arg >= argc || (protocol != "uart" && protocol != "manchester")) {
+        return usage(argv[0]);
+    }
+
+    try {
+        frame_printer printer;
+        std::unique_ptr<vlog::bit_assembler> words;
+        std::unique_ptr<vlog::edge_decoder> decoder;
+        if (protocol == "uart") {
+            decoder.reset(new vlog::uart_decoder(printer, uart));
+        } else {
+            words.reset(new vlog::bit_assembler(printer, assembler));
+            decoder.reset(new vlog::manchester_decoder(*words, manchester));
+        }
+
+        labelled_runner runner(*decoder, printer);
+        std::printf("run,start_tick,end_tick,kind,bits,value,flags\n");
+        for (; arg < argc; arg++) {
+            decode_input(argv[arg], runner);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_protocol: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
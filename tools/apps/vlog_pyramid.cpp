@@ -0,0 +1,124 @@
+/*
+ * vlog_pyramid: build and query multi-resolution run summaries.
+ *
+ *   vlog_pyramid build [-j threads] [-s shift] <run.vlr>...
+ *   vlog_pyramid query <run.vlp> <t0> <t1> <width>
+ *
+ * `build` writes run_NNNN.vlp next to each run file. `query` prints at
+ * most about `width` buckets covering ticks [t0, t1) as CSV; fields with
+ * no measurement in a bucket are left empty.
+ */
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "vlog/pyramid.h"
+#include "vlog/run_file.h"
+
+namespace {
+
+int usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s build [-j threads] [-s shift] <run.vlr>...\n"
+                 "       %s query <run.vlp> <t0> <t1> <width>\n",
+                 argv0, argv0);
+    return 2;
+}
+
+void print_field(uint32_t v, bool present) {
+    if (present) {
+        std::printf(",%" PRIu32, v);
+    } else {
+        std::printf(",");
+    }
+}
+
+int build(int argc, char **argv) {
+    unsigned threads = 1;
+    int shift = -1;
+    int arg = 2;
+
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        if (std::strcmp(argv[arg], "-j") == 0) {
+            threads = static_cast<unsigned>(std::atoi(argv[arg + 1]));
+        } else if (std::strcmp(argv[arg], "-s") == 0) {
+            shift = std::atoi(argv[arg + 1]);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (arg >= argc) {
+        return usage(argv[0]);
+    }
+
+    for (; arg < argc; arg++) {
+        const vlog::run_file run(argv[arg]);
+
+        const auto t0 = std::chrono::steady_clock::now();
+        const vlog::pyramid p =
+            vlog::build_pyramid(run.ticks(), run.edge(), run.gap(), run.size(), shift, threads);
+        const auto t1 = std::chrono::steady_clock::now();
+
+        const std::string out = vlog::pyramid_path_for(argv[arg]);
+        vlog::write_pyramid(out, p);
+
+        std::fprintf(stderr, "%s: %zu events, %zu levels, level0 %zu x 2^%u ticks, %.3fs\n",
+                     out.c_str(), run.size(), p.levels.size(), p.levels[0].size(), p.base_shift,
+                     std::chrono::duration<double>(t1 - t0).count());
+    }
+    return 0;
+}
+
+int query(int argc, char **argv) {
+    if (argc != 6) {
+        return usage(argv[0]);
+    }
+
+    const vlog::pyramid_file pyr(argv[2]);
+    const int64_t t0 = std::strtoll(argv[3], nullptr, 0);
+    const int64_t t1 = std::strtoll(argv[4], nullptr, 0);
+    const size_t width = static_cast<size_t>(std::strtoull(argv[5], nullptr, 0));
+
+    const vlog::pyramid_span span = pyr.query(t0, t1, width);
+
+    std::printf("# level=%u bucket_ticks=%" PRId64 "\n", span.level, span.bucket_ticks);
+    std::printf("tick,edges,drops,high_min,high_max,period_min,period_max\n");
+    for (size_t i = 0; i < span.count; i++) {
+        const vlog::pyramid_bucket &b = span.buckets[i];
+        std::printf("%" PRId64 ",%" PRIu32 ",%" PRIu32,
+                    span.first_tick + static_cast<int64_t>(i) * span.bucket_ticks, b.edges, b.drops);
+        print_field(b.high_min, b.high_min != UINT32_MAX);
+        print_field(b.high_max, b.high_min != UINT32_MAX);
+        print_field(b.period_min, b.period_min != UINT32_MAX);
+        print_field(b.period_max, b.period_min != UINT32_MAX);
+        std::printf("\n");
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+
+    try {
+        if (std::strcmp(argv[1], "build") == 0) {
+            return build(argc, argv);
+        }
+        if (std::strcmp(argv[1], "query") == 0) {
+            return query(argc, argv);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_pyramid: %s\n", e.what());
+        return 1;
+    }
+
+    return usage(argv[0]);
+}
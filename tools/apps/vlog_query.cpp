@@ -0,0 +1,58 @@
+/*
+ * vlog_query: filter and aggregate events in run files.
+ *
+ *   vlog_query [-j threads] "<query>" <run.vlr|run.vlz>...
+ *
+ * See vlog/query.h for the query language. Prints CSV with one column per
+ * select item; files are queried in the order given.
+ *
+ *   vlog_query "SELECT run, t, width FROM high WHERE t BETWEEN 100s AND 200s
+ *               AND width < 12us" runs/run_0000.vlr
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "vlog/query.h"
+
+int main(int argc, char **argv) {
+    unsigned threads = 1;
+    int arg = 1;
+
+    if (arg + 1 < argc && std::strcmp(argv[arg], "-j") == 0) {
+        threads = static_cast<unsigned>(std::atoi(argv[arg + 1]));
+        arg += 2;
+    }
+    if (argc - arg < 2) {
+        std::fprintf(stderr, "usage: %s [-j threads] \"<query>\" <run.vlr|run.vlz>...\n",
+                     argv[0]);
+        return 2;
+    }
+
+    try {
+        const vlog::query q = vlog::parse_query(argv[arg++]);
+        const size_t width = q.select.size();
+
+        for (size_t s = 0; s < width; s++) {
+            std::printf("%s%s", s > 0 ? "," : "", q.select[s].name.c_str());
+        }
+        std::printf("\n");
+
+        for (; arg < argc; arg++) {
+            vlog::execute_query(q, argv[arg], threads, [&](const double *values) {
+                for (size_t s = 0; s < width; s++) {
+                    std::printf("%s%.10g", s > 0 ? "," : "", values[s]);
+                }
+                std::printf("\n");
+            });
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_query: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
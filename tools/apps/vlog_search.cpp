@@ -0,0 +1,95 @@
+/*
+ * vlog_search: find pulse patterns in stored runs.
+ *
+ *   vlog_search [-j threads] [-T tolerance] [-c] -p <pattern>... <run.vlr|run.vlz>...
+ *
+ * Scans every run for any of the -p patterns (see vlog/pulse_search.h),
+ * e.g. a 3 ms low followed by eight 100 us pulses:
+ *
+ *   vlog_search -p "L3ms H100us{8}" run_0001.vlz run_0002.vlz
+ *
+ * -T sets the default width tolerance, a percentage or a duration
+ * (default 10%). Prints one CSV row per match, in file order:
+ *
+ *   path,run,pattern,first_event,last_event,start_tick,end_tick,start_s,duration_s
+ *
+ * with exact device tick positions and their seconds. With
+ * -c only a count per pattern is printed. Files are cut into chunks
+ * searched on `threads` workers (default: all cores).
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vlog/pulse_search.h"
+
+int main(int argc, char **argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    std::string tolerance = "10%";
+    std::vector<std::string> pattern_texts;
+    bool count_only = false;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        const std::string opt = argv[arg];
+        if (opt == "-c") {
+            count_only = true;
+        } else if (arg + 1 < argc && opt == "-j") {
+            threads = static_cast<unsigned>(std::atoi(argv[++arg]));
+        } else if (arg + 1 < argc && opt == "-T") {
+            tolerance = argv[++arg];
+        } else if (arg + 1 < argc && opt == "-p") {
+            pattern_texts.push_back(argv[++arg]);
+        } else {
+            break;
+        }
+    }
+    if (pattern_texts.empty() || arg >= argc || argv[arg][0] == '-') {
+        std::fprintf(stderr,
+                     "usage: %s [-j threads] [-T tolerance] [-c] -p <pattern>... "
+                     "<run.vlr|run.vlz>...\n",
+                     argv[0]);
+        return 2;
+    }
+    const std::vector<std::string> paths(argv + arg, argv + argc);
+
+    try {
+        std::vector<vlog::pulse_pattern> patterns;
+        for (const std::string &text : pattern_texts) {
+            patterns.push_back(vlog::parse_pulse_pattern(text, tolerance));
+        }
+
+        std::vector<uint64_t> counts(patterns.size(), 0);
+        if (!count_only) {
+            std::printf("path,run,pattern,first_event,last_event,start_tick,end_tick,start_s,"
+                        "duration_s\n");
+        }
+        vlog::search_runs(paths, patterns, threads,
+                          [&](size_t file, const vlog::run_info &info, const vlog::pulse_match &m) {
+            counts[m.pattern]++;
+            if (count_only) {
+                return;
+            }
+            const double rate = vlog::tick_rate(info.config);
+            std::printf("%s,%u,\"%s\",%" PRIu64 ",%" PRIu64 ",%" PRId64 ",%" PRId64 ",%.9f,%.9f\n",
+                        paths[file].c_str(), info.index, patterns[m.pattern].text.c_str(),
+                        m.first, m.last, m.start, m.end, m.start / rate,
+                        (m.end - m.start) / rate);
+        });
+
+        if (count_only) {
+            for (size_t p = 0; p < patterns.size(); p++) {
+                std::printf("%s,%" PRIu64 "\n", patterns[p].text.c_str(), counts[p]);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_search: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * vlog_spectrum: modulation spectrum of edge timing.
+ *
+ *   vlog_spectrum [-j threads] [-n segment] [-o overlap] [-r rate_hz]
+ *                 [-k peaks] [-t] [-f] [-p] <run.vlr|run.vlz>...
+ *
+ * Analyses the period series (or the TIE series with -t) of rising edges
+ * (falling with -f) and lists the strongest modulation frequencies. -p also
+ * prints the full density as frequency_hz,psd rows.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "vlog/packed_run.h"
+#include "vlog/run_file.h"
+#include "vlog/spectrum.h"
+
+namespace {
+
+bool has_suffix(const std::string &s, const char *suffix) {
+    const size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+void report(const std::string &path, const vlog::run_info &info, const int64_t *ticks,
+            const uint8_t *edge, const uint16_t *gap, size_t n,
+            const vlog::spectrum_options &options, size_t peaks, bool full) {
+    const vlog::timing_spectrum s =
+        vlog::welch_spectrum(ticks, edge, gap, n, vlog::tick_rate(info.config), options);
+
+    std::printf("# %s (run %u): %s, %.6g Hz sampling, %.6g Hz bins, %" PRIu64
+                " samples, %" PRIu64 " segments\n",
+                path.c_str(), info.index, options.series == vlog::SERIES_TIE ? "tie" : "period",
+                s.sample_rate_hz, s.resolution_hz, s.samples, s.segments);
+    std::printf("frequency_hz,psd_ticks2_per_hz,rms_ticks\n");
+    for (const vlog::spectral_peak &p : vlog::find_peaks(s, peaks)) {
+        std::printf("%.6f,%.6e,%.6g\n", p.frequency_hz, p.psd, p.rms);
+    }
+
+    if (full) {
+        std::printf("frequency_hz,psd\n");
+        for (size_t k = 0; k < s.psd.size(); k++) {
+            std::printf("%.6f,%.6e\n", k * s.resolution_hz, s.psd[k]);
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    vlog::spectrum_options options;
+    size_t peaks = 10;
+    bool full = false;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        const char *opt = argv[arg];
+        const bool has_value = arg + 1 < argc;
+        if (std::strcmp(opt, "-t") == 0) {
+            options.series = vlog::SERIES_TIE;
+        } else if (std::strcmp(opt, "-f") == 0) {
+            options.edge = vlog::EDGE_FALLING;
+        } else if (std::strcmp(opt, "-p") == 0) {
+            full = true;
+        } else if (std::strcmp(opt, "-j") == 0 && has_value) {
+            options.threads = static_cast<unsigned>(std::atoi(argv[++arg]));
+        } else if (std::strcmp(opt, "-n") == 0 && has_value) {
+            options.segment = static_cast<size_t>(std::atol(argv[++arg]));
+        } else if (std::strcmp(opt, "-o") == 0 && has_value) {
+            options.overlap = std::atof(argv[++arg]);
+        } else if (std::strcmp(opt, "-r") == 0 && has_value) {
+            options.sample_rate_hz = std::atof(argv[++arg]);
+        } else if (std::strcmp(opt, "-k") == 0 && has_value) {
+            peaks = static_cast<size_t>(std::atol(argv[++arg]));
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc || argv[arg][0] == '-') {
+        std::fprintf(stderr,
+                     "usage: %s [-j threads] [-n segment] [-o overlap] [-r rate_hz] [-k peaks] "
+                     "[-t] [-f] [-p] <run.vlr|run.vlz>...\n",
+                     argv[0]);
+        return 2;
+    }
+
+    try {
+        for (; arg < argc; arg++) {
+            if (has_suffix(argv[arg], ".vlz")) {
+                const vlog::capture_run run =
+                    vlog::packed_run(argv[arg]).decode_all(options.threads);
+                report(argv[arg], run.info, run.ticks.data(), run.edge.data(), run.gap.data(),
+                       run.size(), options, peaks, full);
+            } else {
+                const vlog::run_file run(argv[arg]);
+                report(argv[arg], run.info(), run.ticks(), run.edge(), run.gap(), run.size(),
+                       options, peaks, full);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_spectrum: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * vlog_stats: pulse timing percentiles per run and per time window.
+ *
+ *   vlog_stats [-j threads] [-w window_seconds] <run.vlr|run.vlz>...
+ *
+ * Prints one CSV row per run and metric (period, high, low), followed by
+ * one row per window and metric when -w is given. All timings are in
+ * Timer1 ticks; the run's F_CPU is included for conversion.
+ */
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "vlog/packed_run.h"
+#include "vlog/pulse_stats.h"
+#include "vlog/run_file.h"
+
+namespace {
+
+bool has_suffix(const std::string &s, const char *suffix) {
+    const size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+void print_row(uint32_t run, const char *scope, int64_t start, uint32_t f_cpu, const char *metric,
+               const vlog::timing_sketch &s) {
+    if (s.count() == 0) {
+        return;
+    }
+    std::printf("%u,%s,%" PRId64 ",%u,%s,%" PRIu64 ",%" PRIu64 ",%.1f,%.1f,%.1f,%" PRIu64
+                ",%.3f,%.3f\n",
+                run, scope, start, f_cpu, metric, s.count(), s.min(), s.quantile(0.5),
+                s.quantile(0.99), s.quantile(0.999), s.max(), s.mean(), s.stddev());
+}
+
+void print_sketches(uint32_t run, const char *scope, int64_t start, uint32_t f_cpu,
+                    const vlog::interval_sketches &s) {
+    print_row(run, scope, start, f_cpu, "period", s.period);
+    print_row(run, scope, start, f_cpu, "high", s.high);
+    print_row(run, scope, start, f_cpu, "low", s.low);
+}
+
+void report(const vlog::run_info &info, const int64_t *ticks, const uint8_t *edge,
+            const uint16_t *gap, size_t n, double window_s, unsigned threads) {
+    const int64_t window_ticks =
+        window_s > 0.0 ? static_cast<int64_t>(window_s * vlog::tick_rate(info.config)) : 0;
+    const vlog::pulse_timing t =
+        vlog::analyse_pulse_timing(ticks, edge, gap, n, window_ticks, threads);
+
+    print_sketches(info.index, "run", t.origin, info.config.f_cpu, t.total);
+    for (size_t w = 0; w < t.windows.size(); w++) {
+        print_sketches(info.index, "window", t.origin + static_cast<int64_t>(w) * window_ticks,
+                       info.config.f_cpu, t.windows[w]);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    unsigned threads = 1;
+    double window_s = 0.0;
+    int arg = 1;
+
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        if (std::strcmp(argv[arg], "-j") == 0) {
+            threads = static_cast<unsigned>(std::atoi(argv[arg + 1]));
+        } else if (std::strcmp(argv[arg], "-w") == 0) {
+            window_s = std::atof(argv[arg + 1]);
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc || argv[arg][0] == '-') {
+        std::fprintf(stderr, "usage: %s [-j threads] [-w window_seconds] <run.vlr|run.vlz>...\n",
+                     argv[0]);
+        return 2;
+    }
+
+    std::printf("run,scope,start_tick,f_cpu,metric,count,min,p50,p99,p99.9,max,mean,stddev\n");
+
+    try {
+        for (; arg < argc; arg++) {
+            if (has_suffix(argv[arg], ".vlz")) {
+                const vlog::capture_run run = vlog::packed_run(argv[arg]).decode_all(threads);
+                report(run.info, run.ticks.data(), run.edge.data(), run.gap.data(), run.size(),
+                       window_s, threads);
+            } else {
+                const vlog::run_file run(argv[arg]);
+                report(run.info(), run.ticks(), run.edge(), run.gap(), run.size(), window_s,
+                       threads);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_stats: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * vlog_synth: generate logger output for tests and load.
+ *
+ *   vlog_synth [-r events_per_s] [-n events] [-p period_ticks] [-d drop_rate]
+ *              [-e events_per_run] [-s seed] [-f] (-P | <out>|-)
+ *
+ * Writes a square wave in the firmware's serial format to <out> (or stdout
+ * for "-"). With -P a pseudo-terminal is opened instead, its slave path is
+ * printed on stdout and the stream is written to the master, so the slave
+ * can be captured like a real logger. -r paces output to the given event
+ * rate (0 = as fast as the reader accepts); -n stops after that many events.
+ * -f writes the binary framed encoding (vlog/binary_log.h) instead of text.
+ */
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "vlog/synth.h"
+
+namespace {
+
+struct pty_pair {
+    int master = -1;
+    int slave = -1;
+};
+
+// The line discipline is made raw up front: bytes written before the
+// reader opens the slave would otherwise get CR/LF translation. A slave
+// descriptor is kept so the unread input can be watched at exit.
+pty_pair open_pty() {
+    pty_pair p;
+    p.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (p.master < 0 || grantpt(p.master) != 0 || unlockpt(p.master) != 0) {
+        throw std::runtime_error(std::string("pty: ") + std::strerror(errno));
+    }
+    const char *path = ptsname(p.master);
+    p.slave = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    termios tio;
+    if (p.slave < 0 || tcgetattr(p.slave, &tio) != 0) {
+        throw std::runtime_error(std::string(path) + ": " + std::strerror(errno));
+    }
+    cfmakeraw(&tio);
+    tcsetattr(p.slave, TCSANOW, &tio);
+    std::printf("%s\n", path);
+    std::fflush(stdout);
+    return p;
+}
+
+// Closing the master hangs up the slave and discards input not yet read,
+// so wait for the reader to catch up first.
+void drain_pty(const pty_pair &p) {
+    int pending = 1;
+    while (ioctl(p.slave, FIONREAD, &pending) == 0 && pending > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void write_all(int fd, const std::string &data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("write: ") + std::strerror(errno));
+        }
+        done += static_cast<size_t>(n);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    vlog::synth_options options;
+    double rate = 0.0;
+    bool pty = false;
+    bool bad = false;
+    int arg = 1;
+
+    while (arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0') {
+        const std::string opt = argv[arg];
+        if (opt == "-P") {
+            pty = true;
+            arg++;
+            continue;
+        }
+        if (opt == "-f") {
+            options.framed = true;
+            arg++;
+            continue;
+        }
+        if (arg + 1 >= argc) {
+            bad = true;  // Option without its value.
+            break;
+        }
+        const char *value = argv[arg + 1];
+        if (opt == "-r") {
+            rate = std::atof(value);
+        } else if (opt == "-n") {
+            options.total_events = std::strtoull(value, nullptr, 10);
+        } else if (opt == "-p") {
+            options.period_ticks = static_cast<uint32_t>(std::atol(value));
+        } else if (opt == "-d") {
+            options.drop_rate = std::atof(value);
+        } else if (opt == "-e") {
+            options.events_per_run = std::strtoull(value, nullptr, 10);
+        } else if (opt == "-s") {
+            options.seed = std::strtoull(value, nullptr, 10);
+        } else {
+            bad = true;
+            break;
+        }
+        arg += 2;
+    }
+    /* Anything but "-" that looks like an option is not an output path. */
+    if (bad || (pty ? arg != argc : arg + 1 != argc)) {
+        std::fprintf(stderr,
+                     "usage: %s [-r events_per_s] [-n events] [-p period_ticks] [-d drop_rate] "
+                     "[-e events_per_run] [-s seed] [-f] (-P | <out>|-)\n",
+                     argv[0]);
+        return 2;
+    }
+
+    int fd = -1;
+    pty_pair pair;
+    try {
+        if (pty) {
+            pair = open_pty();
+            fd = pair.master;
+        } else if (std::string(argv[arg]) == "-") {
+            fd = STDOUT_FILENO;
+        } else {
+            fd = open(argv[arg], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                throw std::runtime_error(std::string(argv[arg]) + ": " + std::strerror(errno));
+            }
+        }
+
+        // Pace in 10 ms steps against an absolute schedule so rounding
+        // and write latency do not accumulate into rate error.
+        using steady = std::chrono::steady_clock;
+        const std::chrono::milliseconds step(10);
+        const size_t per_step = rate > 0.0 ? static_cast<size_t>(rate / 100.0) + 1 : 4096;
+        steady::time_point next = steady::now();
+        std::string chunk;
+
+        vlog::log_synth synth(options);
+        while (!synth.done()) {
+            chunk.clear();
+            synth.generate(chunk, per_step);
+            write_all(fd, chunk);
+            if (rate > 0.0) {
+                next += step;
+                std::this_thread::sleep_until(next);
+            }
+        }
+        if (pty) {
+            drain_pty(pair);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_synth: %s\n", e.what());
+        return 1;
+    }
+    if (pair.slave >= 0) {
+        close(pair.slave);
+    }
+    if (fd > STDOUT_FILENO) {
+        close(fd);
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * vlog_tap: follow a capture's live stream.
+ *
+ *   vlog_tap [-a] [-c interval_s] <name>
+ *
+ * Attaches to the shared-memory ring vlog_capture -l publishes for device
+ * <name> and prints each event to stdout as
+ *
+ *   seq,run,ticks,edge
+ *
+ * plus `# START,<run>` / `# STOP,<run>,<events>[,truncated]` at run
+ * boundaries and `# STATUS,<ticks>,<ring_high_water>,<dropped>` from the
+ * firmware, starting from the newest record (-a: the oldest still held).
+ * With -c only a line of counts is printed every interval: records read
+ * and records lost to overruns. Records are read in place; nothing the tap
+ * does can slow the capture, and if it falls more than a ring behind the
+ * overwritten records are counted as lost. Exits when the capture closes
+ * the ring.
+ */
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <thread>
+
+#include "vlog/shm_ring.h"
+
+namespace {
+
+// Poll period while caught up; the ring has no wakeup mechanism.
+constexpr auto IDLE_SLEEP = std::chrono::milliseconds(2);
+
+void print(const vlog::live_event &e) {
+    switch (e.kind) {
+    case vlog::LIVE_EVENT:
+        std::printf("%" PRIu64 ",%u,%" PRId64 ",%c\n", e.seq, e.run, e.ticks,
+                    e.edge == vlog::EDGE_RISING ? 'R' : 'F');
+        break;
+    case vlog::LIVE_BEGIN_RUN:
+        std::printf("# START,%u\n", e.run);
+        break;
+    case vlog::LIVE_END_RUN:
+        std::printf("# STOP,%u,%" PRId64 "%s\n", e.run, e.ticks, e.edge ? ",truncated" : "");
+        break;
+    case vlog::LIVE_STATUS:
+        std::printf("# STATUS,%" PRId64 ",%u,%u\n", e.ticks, e.run, e.gap);
+        break;
+    default:
+        break;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    bool from_start = false;
+    double interval = 0.0;
+    int arg = 1;
+
+    for (;;) {
+        if (arg < argc && std::strcmp(argv[arg], "-a") == 0) {
+            from_start = true;
+            arg++;
+        } else if (arg + 1 < argc && std::strcmp(argv[arg], "-c") == 0) {
+            interval = std::atof(argv[arg + 1]);
+            arg += 2;
+        } else {
+            break;
+        }
+    }
+    /* An unknown or incomplete option is not a ring name. */
+    const bool bad = arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0';
+    if (bad || argc - arg != 1 || interval < 0.0) {
+        std::fprintf(stderr, "usage: %s [-a] [-c interval_s] <name>\n", argv[0]);
+        return 2;
+    }
+
+    try {
+        vlog::shm_ring_reader ring(std::string("/vlog.") + argv[arg], from_start);
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(interval));
+        auto next = std::chrono::steady_clock::now() + period;
+        uint64_t records = 0;
+        uint64_t reported = 0;
+        vlog::live_event buf[4096];
+
+        for (;;) {
+            /* Check before reading so the final records are not missed. */
+            const bool closed = ring.closed();
+            const uint64_t position = ring.position();
+            size_t n;
+            if (interval > 0.0) {
+                /* Counting needs nothing from the records themselves. */
+                const vlog::shm_ring_reader::span s = ring.peek();
+                n = s.count - ring.release(s);
+            } else {
+                n = ring.read(buf, sizeof(buf) / sizeof(buf[0]));
+                for (size_t i = 0; i < n; i++) {
+                    print(buf[i]);
+                }
+            }
+            records += n;
+
+            if (interval > 0.0 && std::chrono::steady_clock::now() >= next) {
+                std::printf("records %" PRIu64 " (+%" PRIu64 ") lost %" PRIu64 "\n", records,
+                            records - reported, ring.lost());
+                std::fflush(stdout);
+                reported = records;
+                next += period;
+            }
+            if (ring.position() == position) {
+                if (closed) {
+                    break;
+                }
+                std::this_thread::sleep_for(IDLE_SLEEP);
+            }
+        }
+        std::fflush(stdout);
+        std::fprintf(stderr, "# records=%" PRIu64 " lost=%" PRIu64 "\n", records, ring.lost());
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_tap: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
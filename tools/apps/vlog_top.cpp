@@ -0,0 +1,383 @@
+/*
+ * vlog_top: live dashboard for a logger.
+ *
+ *   vlog_top [-r redraw_hz] [-f] [-b] (<log> | - | -l <name>)
+ *
+ * Decodes a log (text or framed; a file, a FIFO, a serial device or "-"
+ * for stdin) or follows the shared-memory ring vlog_capture -l publishes
+ * for device <name>, and keeps redrawing a screen of statistics:
+ *
+ *   - edges per second, dropped events and period / high-time
+ *     min / mean / max for the last complete second of device time and the
+ *     one in progress;
+ *   - a histogram of the periods measured over the last 10 s;
+ *   - the firmware's capture ring high-water mark and dropped counter from
+ *     its status records;
+ *   - decode counters.
+ *
+ * Statistics are updated per event in constant time and the screen is
+ * redrawn at a fixed rate (default 10 Hz) however fast input arrives, so
+ * replaying a file runs at decode speed. A log ends the dashboard at EOF
+ * unless -f is given, which keeps following it as it grows; a ring ends
+ * when its capture closes it. -b prints plain frames one after another
+ * instead of repainting the terminal, the default when stdout is not a
+ * terminal. The last frame stays on stdout when the dashboard exits.
+ */
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include "vlog/live_source.h"
+#include "vlog/live_stats.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr unsigned HIST_ROWS = 16;
+constexpr unsigned HIST_BAR = 40;
+
+volatile sig_atomic_t g_stop = 0;
+
+void on_signal(int) {
+    g_stop = 1;
+}
+
+class top_sink : public vlog::run_sink {
+public:
+    explicit top_sink(vlog::live_stats &stats) : stats_(stats) {}
+
+    void begin_run(const vlog::run_info &info) override {
+        stats_.begin_run(info.config);
+        run_ = info.index;
+    }
+    void events(const vlog::event_batch &batch) override {
+        for (size_t i = 0; i < batch.count; i++) {
+            stats_.add(batch.ticks[i], batch.edge[i], batch.gap[i]);
+        }
+    }
+    void summary(const vlog::summary_window &w) override { stats_.add_summary(w); }
+    void end_run(const vlog::run_info &) override { stats_.end_run(); }
+    void status(const vlog::status_record &s) override { stats_.add_status(s); }
+
+    uint32_t run() const { return run_; }
+
+private:
+    vlog::live_stats &stats_;
+    uint32_t run_ = 0;
+};
+
+// One screenful, built in memory and written with a single write().
+class frame {
+public:
+    void line(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list ap;
+        va_start(ap, fmt);
+        const int n = std::vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        text_.append(buf, n < 0 ? 0 : std::min<size_t>(static_cast<size_t>(n), sizeof(buf) - 1));
+        text_ += repaint_ ? "\x1b[K\n" : "\n";
+    }
+
+    void start(bool repaint) {
+        repaint_ = repaint;
+        text_ = repaint ? "\x1b[H" : "";
+    }
+
+    void emit() {
+        if (repaint_) {
+            text_ += "\x1b[J";
+        } else {
+            text_ += "\n";
+        }
+        write_all(text_);
+    }
+
+    static void write_all(const std::string &s) {
+        const char *p = s.data();
+        size_t left = s.size();
+        while (left != 0) {
+            const ssize_t n = write(STDOUT_FILENO, p, left);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+
+private:
+    std::string text_;
+    bool repaint_ = false;
+};
+
+// Alternate screen with the cursor hidden, for as long as it lives.
+class screen_guard {
+public:
+    explicit screen_guard(bool on) : on_(on) {
+        if (on_) {
+            frame::write_all("\x1b[?1049h\x1b[?25l");
+        }
+    }
+    ~screen_guard() { leave(); }
+
+    void leave() {
+        if (on_) {
+            frame::write_all("\x1b[?25h\x1b[?1049l");
+            on_ = false;
+        }
+    }
+
+private:
+    bool on_;
+};
+
+struct source_info {
+    std::string name;
+    bool live = false;
+    uint32_t run = 0;
+    const vlog::decode_stats *decode = nullptr;
+    const vlog::binary_log_stats *framing = nullptr;
+    uint64_t ring_lost = 0;
+    bool ended = false;
+};
+
+// Ticks as microseconds when the rate is known, else as ticks.
+void interval_row(frame &f, const char *label, const vlog::live_interval &a,
+                  const vlog::live_interval &b, double rate) {
+    const double scale = rate > 0.0 ? 1e6 / rate : 1.0;
+    auto cell = [&](char *out, size_t size, const vlog::live_interval &v) {
+        if (v.count == 0) {
+            std::snprintf(out, size, "-");
+        } else {
+            std::snprintf(out, size, "%8.2f %8.2f %8.2f", v.min * scale, v.mean() * scale,
+                          v.max * scale);
+        }
+    };
+    char left[64];
+    char right[64];
+    cell(left, sizeof(left), a);
+    cell(right, sizeof(right), b);
+    f.line("%-12s %-28s %s", label, left, right);
+}
+
+void histogram(frame &f, const vlog::live_stats &stats) {
+    using vlog::live_stats;
+    const uint64_t *h = stats.histogram();
+    unsigned lo = live_stats::HIST_BUCKETS;
+    unsigned hi = 0;
+    uint64_t total = 0;
+    for (unsigned b = 0; b < live_stats::HIST_BUCKETS; b++) {
+        if (h[b] != 0) {
+            lo = b < lo ? b : lo;
+            hi = b;
+            total += h[b];
+        }
+    }
+    const double rate = stats.tick_rate();
+    const char *unit = rate > 0.0 ? "us" : "ticks";
+    f.line("period histogram, last %u s (%" PRIu64 " periods, %s)", live_stats::LIVE_HISTORY,
+           total, unit);
+    if (total == 0) {
+        return;
+    }
+
+    /* Merge neighbouring buckets until the span fits. */
+    unsigned group = 1;
+    while ((hi / group - lo / group) + 1 > HIST_ROWS) {
+        group *= 2;
+    }
+    lo -= lo % group;
+    uint64_t counts[live_stats::HIST_BUCKETS];
+    unsigned rows = 0;
+    uint64_t peak = 0;
+    for (unsigned b = lo; b <= hi; b += group) {
+        uint64_t c = 0;
+        for (unsigned k = b; k < b + group && k < live_stats::HIST_BUCKETS; k++) {
+            c += h[k];
+        }
+        counts[rows++] = c;
+        peak = c > peak ? c : peak;
+    }
+
+    const double scale = rate > 0.0 ? 1e6 / rate : 1.0;
+    for (unsigned r = 0; r < rows; r++) {
+        const unsigned b = lo + r * group;
+        const double from = live_stats::bucket_low(b) * scale;
+        const unsigned next = b + group;
+        const uint64_t to_ticks = next < live_stats::HIST_BUCKETS
+                                      ? live_stats::bucket_low(next)
+                                      : UINT64_MAX;
+        const double to = static_cast<double>(to_ticks) * scale;
+        const unsigned width =
+            static_cast<unsigned>((counts[r] * HIST_BAR + peak - 1) / peak);
+        char bar[HIST_BAR + 1];
+        std::memset(bar, '#', width);
+        bar[width] = '\0';
+        f.line("  %10.2f - %10.2f |%-*s %" PRIu64, from, to, static_cast<int>(HIST_BAR), bar,
+               counts[r]);
+    }
+}
+
+void render(frame &f, bool repaint, const vlog::live_stats &stats, const source_info &src) {
+    f.start(repaint);
+    const double rate = stats.tick_rate();
+
+    f.line("vlog_top  %s  [%s%s]  run %u %s  mode %s", src.name.c_str(),
+           src.live ? "live" : "log", src.ended ? ", ended" : "", src.run,
+           stats.logging() ? "logging" : "stopped", stats.summarising() ? "SUMMARY" : "EDGES");
+    if (rate > 0.0) {
+        f.line("device time %.3f s   tick rate %.0f Hz", stats.latest() / rate, rate);
+    } else {
+        f.line("device time unknown (no header seen yet)");
+    }
+    char extra[96] = "";
+    if (src.decode != nullptr) {
+        std::snprintf(extra, sizeof(extra), "   malformed %" PRIu64,
+                      src.decode->malformed +
+                          (src.framing != nullptr ? src.framing->bad_frames : 0));
+    } else if (src.live) {
+        std::snprintf(extra, sizeof(extra), "   ring lost %" PRIu64, src.ring_lost);
+    }
+    f.line("events %" PRIu64 "   runs %" PRIu64 "   summaries %" PRIu64 "   dropped %" PRIu64 "%s",
+           stats.events(), stats.runs(), stats.summaries(), stats.dropped(), extra);
+    f.line("%s", "");
+
+    const vlog::live_window empty;
+    const vlog::live_window &last = stats.have_last() ? stats.last() : empty;
+    const vlog::live_window &now = stats.current();
+    const double elapsed = rate > 0.0 ? (stats.latest() - now.start) / rate : 0.0;
+    f.line("%-12s %-28s this second (%.1f s)", "", "last second", elapsed);
+    char a[32];
+    char b[32];
+    std::snprintf(a, sizeof(a), "%.0f", static_cast<double>(last.edges));
+    std::snprintf(b, sizeof(b), "%.0f", elapsed > 0.0 ? now.edges / elapsed : 0.0);
+    f.line("%-12s %-28s %s", "edges/s", stats.have_last() ? a : "-", b);
+    f.line("%-12s %-28" PRIu64 " %" PRIu64, "dropped", last.dropped, now.dropped);
+    char columns[32];
+    std::snprintf(columns, sizeof(columns), "%8s %8s %8s", "min", "mean", "max");
+    f.line("%-12s %-28s %s", rate > 0.0 ? "(us)" : "(ticks)", columns, columns);
+    interval_row(f, "period", last.period, now.period, rate);
+    interval_row(f, "high", last.high, now.high, rate);
+    f.line("%s", "");
+
+    if (stats.have_status()) {
+        const vlog::status_record &s = stats.status();
+        char depth[16] = "?";
+        if (s.config.capture_buffer_size != 0) {
+            std::snprintf(depth, sizeof(depth), "%u", s.config.capture_buffer_size);
+        }
+        f.line("firmware ring high-water %u/%s (peak %u)   dropped counter %u",
+               s.ring_high_water, depth, stats.peak_high_water(), s.dropped);
+    } else {
+        f.line("firmware ring: no status records");
+    }
+    f.line("%s", "");
+    histogram(f, stats);
+    f.emit();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    double redraw_hz = 10.0;
+    bool follow = false;
+    bool batch = isatty(STDOUT_FILENO) == 0;
+    const char *ring_name = nullptr;
+    int arg = 1;
+
+    for (;;) {
+        if (arg + 1 < argc && std::strcmp(argv[arg], "-r") == 0) {
+            redraw_hz = std::atof(argv[arg + 1]);
+            arg += 2;
+        } else if (arg + 1 < argc && std::strcmp(argv[arg], "-l") == 0) {
+            ring_name = argv[arg + 1];
+            arg += 2;
+        } else if (arg < argc && std::strcmp(argv[arg], "-f") == 0) {
+            follow = true;
+            arg++;
+        } else if (arg < argc && std::strcmp(argv[arg], "-b") == 0) {
+            batch = true;
+            arg++;
+        } else {
+            break;
+        }
+    }
+    /* An unknown or incomplete option is not a log path; "-" is stdin. */
+    const bool bad = arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0';
+    if (bad || argc - arg != (ring_name != nullptr ? 0 : 1) || !(redraw_hz > 0.0)) {
+        std::fprintf(stderr, "usage: %s [-r redraw_hz] [-f] [-b] (<log> | - | -l <name>)\n",
+                     argv[0]);
+        return 2;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    const bool repaint = !batch;
+    int status = 0;
+    try {
+        vlog::live_stats stats;
+        top_sink sink(stats);
+        std::unique_ptr<vlog::live_source> input;
+        vlog::log_source *log = nullptr;
+        vlog::ring_source *ring = nullptr;
+        source_info src;
+        if (ring_name != nullptr) {
+            input.reset(ring = new vlog::ring_source(ring_name, sink));
+            src.name = ring_name;
+            src.live = true;
+        } else {
+            input.reset(log = new vlog::log_source(argv[arg], sink, follow));
+            src.name = argv[arg];
+        }
+
+        screen_guard screen(repaint);
+        const auto period = std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double>(1.0 / redraw_hz));
+        auto next = clock_type::now() + period;
+        frame f;
+        bool more = true;
+
+        while (more && !g_stop) {
+            /* Slices of at most one frame keep SIGINT responsive. */
+            more = input->pump(next);
+            src.run = sink.run();
+            src.decode = log != nullptr ? log->decode() : nullptr;
+            src.framing = log != nullptr ? log->framing() : nullptr;
+            src.ring_lost = ring != nullptr ? ring->lost() : 0;
+            if (more && !g_stop) {
+                render(f, repaint, stats, src);
+                /* Skip frames missed while busy rather than bursting. */
+                next = std::max(next + period, clock_type::now());
+            }
+        }
+
+        screen.leave();
+        input->finish();
+        src.ended = true;
+        render(f, false, stats, src);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_top: %s\n", e.what());
+        status = 1;
+    }
+    return status;
+}
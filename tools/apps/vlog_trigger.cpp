@@ -0,0 +1,184 @@
+/*
+ * vlog_trigger: record only the moments around faults.
+ *
+ *   vlog_trigger [-o out_dir] [-p pre_s] [-a post_s] [-m max_window_s]
+ *                [-n pre_events] [-f] -t <condition>... (<log> | - | -l <name>)
+ *
+ * Watches a log as it is written (or, with -l, the live ring vlog_capture
+ * -l publishes for device <name>) and evaluates each -t condition on the
+ * decoded events (see vlog/trigger.h):
+ *
+ *   high:2us..20us  low:..1ms  period:90us..110us  silence:5ms  step:10%
+ *   pattern:10us..20us,40us..60us,10us..20us
+ *
+ * Events from pre_s (default 0.01) before a trigger to post_s (default
+ * 0.01) after it are written as a run file <out_dir>/trigger_NNNN.vlr;
+ * triggers inside a window extend it, by at most max_window_s (default 1)
+ * past the first. The pre-trigger part comes from a ring of the last
+ * pre_events (default 2^20) events. Each window is also listed in
+ * <out_dir>/triggers.csv as
+ *
+ *   window,condition,run,trigger_ticks,trigger_s,value_s,hits,events,
+ *   start_ticks,end_ticks,pre_truncated,path
+ *
+ * with device ticks and seconds, exact to the tick. A log ends at EOF
+ * unless -f is given; a ring ends when its capture closes it. Runs until
+ * then or SIGINT/SIGTERM; a window still open is written as it stands.
+ */
+
+#include <signal.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "vlog/live_source.h"
+#include "vlog/run_file.h"
+#include "vlog/trigger.h"
+
+namespace {
+
+volatile sig_atomic_t g_stop = 0;
+
+void on_signal(int) {
+    g_stop = 1;
+}
+
+// Longest a slice of input runs before the stop flag is checked.
+constexpr auto SLICE = std::chrono::milliseconds(100);
+
+class window_writer {
+public:
+    window_writer(const std::string &dir, const std::vector<vlog::trigger_spec> &specs)
+        : dir_(dir), specs_(specs) {
+        const std::string path = dir + "/triggers.csv";
+        index_ = std::fopen(path.c_str(), "w");
+        if (index_ == nullptr) {
+            throw std::runtime_error(path + ": " + std::strerror(errno));
+        }
+        std::fprintf(index_,
+                     "window,condition,run,trigger_ticks,trigger_s,value_s,hits,events,"
+                     "start_ticks,end_ticks,pre_truncated,path\n");
+        std::fflush(index_);
+    }
+    ~window_writer() { std::fclose(index_); }
+
+    window_writer(const window_writer &) = delete;
+    window_writer &operator=(const window_writer &) = delete;
+
+    void operator()(const vlog::trigger_window &w) {
+        const std::string path = vlog::run_file_path(dir_, "trigger", w.index);
+        vlog::write_run_file(path, w.events);
+
+        const double rate = vlog::tick_rate(w.events.info.config);
+        const std::string &cond = specs_[w.spec].text;
+        std::fprintf(index_,
+                     "%u,\"%s\",%u,%" PRId64 ",%.9f,%.9f,%u,%zu,%" PRId64 ",%" PRId64 ",%d,%s\n",
+                     w.index, cond.c_str(), w.events.info.index, w.trigger_ticks,
+                     w.trigger_ticks / rate, w.value / rate, w.hits, w.events.size(), w.start,
+                     w.end, w.pre_truncated ? 1 : 0, path.c_str());
+        std::fflush(index_);
+        std::fprintf(stderr, "window %u: %s at %.6f s (%.3f us), %u hit(s), %zu events%s\n",
+                     w.index, cond.c_str(), w.trigger_ticks / rate, w.value * 1e6 / rate, w.hits,
+                     w.events.size(), w.pre_truncated ? ", pre-trigger truncated" : "");
+    }
+
+private:
+    std::string dir_;
+    const std::vector<vlog::trigger_spec> &specs_;
+    std::FILE *index_ = nullptr;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string out_dir = ".";
+    vlog::trigger_options options;
+    std::vector<vlog::trigger_spec> specs;
+    const char *ring_name = nullptr;
+    bool follow = false;
+    int arg = 1;
+
+    try {
+        for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++) {
+            const std::string opt = argv[arg];
+            if (opt == "-f") {
+                follow = true;
+                continue;
+            }
+            if (arg + 1 >= argc) {
+                break;
+            }
+            const char *value = argv[++arg];
+            if (opt == "-o") {
+                out_dir = value;
+            } else if (opt == "-p") {
+                options.pre = std::atof(value);
+            } else if (opt == "-a") {
+                options.post = std::atof(value);
+            } else if (opt == "-m") {
+                options.max_window = std::atof(value);
+            } else if (opt == "-n") {
+                options.pre_events = static_cast<size_t>(std::atol(value));
+            } else if (opt == "-t") {
+                specs.push_back(vlog::parse_trigger(value));
+            } else if (opt == "-l") {
+                ring_name = value;
+            } else {
+                arg--;
+                break;
+            }
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_trigger: %s\n", e.what());
+        return 2;
+    }
+    if (specs.empty() || argc - arg != (ring_name != nullptr ? 0 : 1) || options.pre < 0.0 ||
+        options.post < 0.0 || options.pre_events == 0) {
+        std::fprintf(stderr,
+                     "usage: %s [-o out_dir] [-p pre_s] [-a post_s] [-m max_window_s] "
+                     "[-n pre_events] [-f] -t <condition>... (<log> | - | -l <name>)\n",
+                     argv[0]);
+        return 2;
+    }
+
+    struct sigaction sa = {};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    try {
+        window_writer writer(out_dir, specs);
+        vlog::trigger_recorder recorder(specs, options, std::ref(writer));
+        std::unique_ptr<vlog::live_source> input;
+        if (ring_name != nullptr) {
+            input.reset(new vlog::ring_source(ring_name, recorder));
+        } else {
+            input.reset(new vlog::log_source(argv[arg], recorder, follow));
+        }
+
+        while (!g_stop && input->pump(vlog::live_source::clock::now() + SLICE)) {
+        }
+        input->finish();
+
+        std::fprintf(stderr, "# events=%" PRIu64 " windows=%" PRIu64, recorder.events_seen(),
+                     recorder.windows());
+        for (size_t i = 0; i < specs.size(); i++) {
+            std::fprintf(stderr, " %s=%" PRIu64, specs[i].text.c_str(), recorder.hits()[i]);
+        }
+        std::fprintf(stderr, "\n");
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "vlog_trigger: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
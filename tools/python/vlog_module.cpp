@@ -0,0 +1,363 @@
+/*
+ * vlog: Python bindings for the host-side capture decoder.
+ *
+ * Runs are exposed as objects whose columns are read-only memoryviews onto
+ * storage owned by C++: either the pages of a memory-mapped run file
+ * (vlog.load) or the decoder's own column buffers (vlog.decode). No Python
+ * object is created per event, so
+ *
+ *     import numpy as np, vlog
+ *     run = vlog.load("run_0000.vlr")
+ *     ticks = np.asarray(run.ticks)      # int64, zero-copy
+ *
+ * costs little more than the mapping itself, whatever the run length.
+ * The views keep their run alive; the run keeps its mapping alive.
+ *
+ * Written against the CPython C API only so that the module builds with
+ * nothing but the interpreter headers.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <exception>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vlog/log_decoder.h"
+#include "vlog/run_file.h"
+
+namespace {
+
+/*
+ * Backing store for one run's columns.
+ *
+ * Concrete stores own either a decoded in-memory run or a mapped run file;
+ * Python objects share them through std::shared_ptr.
+ */
+struct run_store {
+    virtual ~run_store() = default;
+
+    vlog::run_info info;
+    const int64_t *ticks = nullptr;
+    const uint8_t *edge = nullptr;
+    const uint16_t *gap = nullptr;
+    size_t size = 0;
+};
+
+struct decoded_store : run_store {
+    explicit decoded_store(vlog::capture_run &&r) : run(std::move(r)) {
+        info = run.info;
+        ticks = run.ticks.data();
+        edge = run.edge.data();
+        gap = run.gap.data();
+        size = run.size();
+    }
+
+    vlog::capture_run run;
+};
+
+struct mapped_store : run_store {
+    explicit mapped_store(const std::string &path) : file(path) {
+        info = file.info();
+        ticks = file.ticks();
+        edge = file.edge();
+        gap = file.gap();
+        size = file.size();
+    }
+
+    vlog::run_file file;
+};
+
+enum column_id { COLUMN_TICKS, COLUMN_EDGE, COLUMN_GAP };
+
+/* ---- vlog._Column: buffer exporter for a single column ---- */
+
+struct column_object {
+    PyObject_HEAD
+    std::shared_ptr<run_store> *store;
+    column_id id;
+    Py_ssize_t shape[1];
+    Py_ssize_t strides[1];
+};
+
+void column_dealloc(PyObject *self) {
+    delete reinterpret_cast<column_object *>(self)->store;
+    Py_TYPE(self)->tp_free(self);
+}
+
+int column_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+    column_object *col = reinterpret_cast<column_object *>(self);
+    const run_store &store = **col->store;
+
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "vlog columns are read-only");
+        view->obj = nullptr;
+        return -1;
+    }
+
+    const void *buf = nullptr;
+    const char *format = nullptr;
+    Py_ssize_t itemsize = 0;
+
+    switch (col->id) {
+    case COLUMN_TICKS:
+        buf = store.ticks;
+        format = "q";
+        itemsize = sizeof(int64_t);
+        break;
+    case COLUMN_EDGE:
+        buf = store.edge;
+        format = "B";
+        itemsize = sizeof(uint8_t);
+        break;
+    case COLUMN_GAP:
+        buf = store.gap;
+        format = "H";
+        itemsize = sizeof(uint16_t);
+        break;
+    }
+
+    col->shape[0] = static_cast<Py_ssize_t>(store.size);
+    col->strides[0] = itemsize;
+
+    view->buf = const_cast<void *>(buf);
+    view->obj = self;
+    Py_INCREF(self);
+    view->len = col->shape[0] * itemsize;
+    view->readonly = 1;
+    view->itemsize = itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(format) : nullptr;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? col->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? col->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+PyBufferProcs column_as_buffer = {column_getbuffer, nullptr};
+
+PyTypeObject column_type = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+/* ---- vlog.Run ---- */
+
+struct run_object {
+    PyObject_HEAD
+    std::shared_ptr<run_store> *store;
+};
+
+PyTypeObject run_type = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+PyObject *run_wrap(std::shared_ptr<run_store> store) {
+    run_object *obj = PyObject_New(run_object, &run_type);
+    if (obj == nullptr) {
+        return nullptr;
+    }
+    obj->store = new std::shared_ptr<run_store>(std::move(store));
+    return reinterpret_cast<PyObject *>(obj);
+}
+
+void run_dealloc(PyObject *self) {
+    delete reinterpret_cast<run_object *>(self)->store;
+    Py_TYPE(self)->tp_free(self);
+}
+
+const run_store &store_of(PyObject *self) {
+    return **reinterpret_cast<run_object *>(self)->store;
+}
+
+Py_ssize_t run_length(PyObject *self) {
+    return static_cast<Py_ssize_t>(store_of(self).size);
+}
+
+/* Return a memoryview of one column; the view holds the run's storage. */
+PyObject *run_column(PyObject *self, column_id id) {
+    column_object *col = PyObject_New(column_object, &column_type);
+    if (col == nullptr) {
+        return nullptr;
+    }
+    col->store = new std::shared_ptr<run_store>(*reinterpret_cast<run_object *>(self)->store);
+    col->id = id;
+
+    PyObject *view = PyMemoryView_FromObject(reinterpret_cast<PyObject *>(col));
+    Py_DECREF(col);
+    return view;
+}
+
+PyObject *run_get_ticks(PyObject *self, void *) { return run_column(self, COLUMN_TICKS); }
+PyObject *run_get_edge(PyObject *self, void *) { return run_column(self, COLUMN_EDGE); }
+PyObject *run_get_gap(PyObject *self, void *) { return run_column(self, COLUMN_GAP); }
+
+PyObject *run_get_index(PyObject *self, void *) {
+    return PyLong_FromUnsignedLong(store_of(self).info.index);
+}
+
+PyObject *run_get_source_offset(PyObject *self, void *) {
+    return PyLong_FromUnsignedLongLong(store_of(self).info.source_offset);
+}
+
+PyObject *run_get_dropped(PyObject *self, void *) {
+    return PyLong_FromUnsignedLongLong(store_of(self).info.dropped);
+}
+
+PyObject *run_get_truncated(PyObject *self, void *) {
+    return PyBool_FromLong(store_of(self).info.truncated);
+}
+
+PyObject *run_get_config(PyObject *self, void *) {
+    const vlog::run_config &c = store_of(self).info.config;
+
+    PyObject *icnc1 = Py_None;
+    if (c.icnc1 >= 0) {
+        icnc1 = c.icnc1 ? Py_True : Py_False;
+    }
+
+    return Py_BuildValue("{s:k,s:k,s:k,s:k,s:O}",
+                         "f_cpu", static_cast<unsigned long>(c.f_cpu),
+                         "baud", static_cast<unsigned long>(c.baud),
+                         "timer1_prescaler", static_cast<unsigned long>(c.timer1_prescaler),
+                         "capture_buffer_size", static_cast<unsigned long>(c.capture_buffer_size),
+                         "icnc1", icnc1);
+}
+
+PyObject *run_repr(PyObject *self) {
+    const run_store &s = store_of(self);
+    return PyUnicode_FromFormat("<vlog.Run index=%u events=%zu dropped=%llu%s>",
+                                static_cast<unsigned>(s.info.index), s.size,
+                                static_cast<unsigned long long>(s.info.dropped),
+                                s.info.truncated ? " truncated" : "");
+}
+
+PyGetSetDef run_getset[] = {
+    {"ticks", run_get_ticks, nullptr, "Absolute 64-bit Timer1 ticks (int64 memoryview).", nullptr},
+    {"edge", run_get_edge, nullptr, "Edge polarity, 1 = rising, 0 = falling (uint8 memoryview).", nullptr},
+    {"gap", run_get_gap, nullptr, "Events dropped before each event (uint16 memoryview).", nullptr},
+    {"index", run_get_index, nullptr, "Run number within its source log.", nullptr},
+    {"source_offset", run_get_source_offset, nullptr, "Byte offset of the run's # START line.", nullptr},
+    {"dropped", run_get_dropped, nullptr, "Total events dropped during the run.", nullptr},
+    {"truncated", run_get_truncated, nullptr, "True if the run ended without # STOP.", nullptr},
+    {"config", run_get_config, nullptr, "Logger header configuration as a dict.", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PySequenceMethods run_as_sequence = {run_length};
+
+/* ---- module functions ---- */
+
+/*
+ * Run `fn` with the GIL released, translating C++ exceptions into OSError.
+ * Returns false (with a Python exception set) on failure.
+ */
+template <typename Fn>
+bool call_unlocked(Fn &&fn) {
+    std::string error;
+
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        fn();
+    } catch (const std::bad_alloc &) {
+        error = "out of memory";
+    } catch (const std::exception &e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_OSError, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+PyObject *vlog_load(PyObject *, PyObject *args) {
+    const char *path;
+    if (!PyArg_ParseTuple(args, "s:load", &path)) {
+        return nullptr;
+    }
+
+    std::shared_ptr<run_store> store;
+    if (!call_unlocked([&] { store = std::make_shared<mapped_store>(path); })) {
+        return nullptr;
+    }
+    return run_wrap(std::move(store));
+}
+
+PyObject *vlog_decode(PyObject *, PyObject *args) {
+    const char *path;
+    if (!PyArg_ParseTuple(args, "s:decode", &path)) {
+        return nullptr;
+    }
+
+    std::vector<vlog::capture_run> runs;
+    if (!call_unlocked([&] { runs = vlog::decode_log_file(path); })) {
+        return nullptr;
+    }
+
+    PyObject *list = PyList_New(static_cast<Py_ssize_t>(runs.size()));
+    if (list == nullptr) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < runs.size(); i++) {
+        PyObject *run = run_wrap(std::make_shared<decoded_store>(std::move(runs[i])));
+        if (run == nullptr) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), run);
+    }
+    return list;
+}
+
+PyMethodDef vlog_methods[] = {
+    {"load", vlog_load, METH_VARARGS,
+     "load(path) -> Run\n\nMemory-map a columnar run file (.vlr)."},
+    {"decode", vlog_decode, METH_VARARGS,
+     "decode(path) -> list[Run]\n\nDecode every run in a raw logger capture."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef vlog_module = {
+    PyModuleDef_HEAD_INIT, "vlog",
+    "Zero-copy access to validation-logger captures.", -1, vlog_methods,
+    nullptr, nullptr, nullptr, nullptr,
+};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_vlog(void) {
+    column_type.tp_name = "vlog._Column";
+    column_type.tp_basicsize = sizeof(column_object);
+    column_type.tp_dealloc = column_dealloc;
+    column_type.tp_as_buffer = &column_as_buffer;
+    column_type.tp_flags = Py_TPFLAGS_DEFAULT;
+
+    run_type.tp_name = "vlog.Run";
+    run_type.tp_basicsize = sizeof(run_object);
+    run_type.tp_dealloc = run_dealloc;
+    run_type.tp_repr = run_repr;
+    run_type.tp_as_sequence = &run_as_sequence;
+    run_type.tp_getset = run_getset;
+    run_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    run_type.tp_doc = "One logging run; columns are zero-copy memoryviews.";
+
+    if (PyType_Ready(&column_type) < 0 || PyType_Ready(&run_type) < 0) {
+        return nullptr;
+    }
+
+    PyObject *m = PyModule_Create(&vlog_module);
+    if (m == nullptr) {
+        return nullptr;
+    }
+
+    Py_INCREF(&run_type);
+    if (PyModule_AddObject(m, "Run", reinterpret_cast<PyObject *>(&run_type)) < 0) {
+        Py_DECREF(&run_type);
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}
@@ -0,0 +1,325 @@
+#include "arrow_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "flatbuf.h"
+
+namespace vlog {
+
+namespace {
+
+// Arrow format constants (Schema.fbs / Message.fbs).
+constexpr int16_t METADATA_V5 = 4;
+constexpr int16_t ENDIAN_LITTLE = 0;
+constexpr uint8_t TYPE_INT = 2;
+constexpr uint8_t HEADER_SCHEMA = 1;
+constexpr uint8_t HEADER_RECORD_BATCH = 3;
+
+constexpr uint32_t CONTINUATION = 0xFFFFFFFFu;
+constexpr char FILE_MAGIC[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+
+struct column_def {
+    const char *name;
+    int32_t bit_width;
+    bool is_signed;
+    bool nullable;
+};
+
+const column_def COLUMNS[] = {
+    {"run_id", 32, false, false},
+    {"tick", 64, true, false},
+    {"time_ns", 64, true, true},
+    {"edge", 8, false, false},
+    {"dt", 64, true, false},
+    {"gap", 16, false, false},
+};
+constexpr size_t COLUMN_COUNT = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+struct field_node {
+    int64_t length;
+    int64_t null_count;
+};
+
+struct buffer_desc {
+    int64_t offset;
+    int64_t length;
+};
+
+size_t pad8(size_t n) {
+    return (n + 7u) & ~static_cast<size_t>(7u);
+}
+
+flatbuf::writer key_value(const std::string &key, const std::string &value) {
+    return flatbuf::table_writer({
+        flatbuf::ref(0, flatbuf::string_writer(key)),
+        flatbuf::ref(1, flatbuf::string_writer(value)),
+    });
+}
+
+/* Header configuration as Arrow key/value pairs, named as in the log. */
+std::vector<flatbuf::writer> config_metadata(const run_config &c) {
+    const char *icnc1 = c.icnc1 < 0 ? "unknown" : (c.icnc1 ? "ON" : "OFF");
+    return {
+        key_value("F_CPU", std::to_string(c.f_cpu)),
+        key_value("BAUD", std::to_string(c.baud)),
+        key_value("TIMER1_PRESCALER", std::to_string(c.timer1_prescaler)),
+        key_value("ICNC1", icnc1),
+        key_value("CAPTURE_BUFFER_SIZE", std::to_string(c.capture_buffer_size)),
+    };
+}
+
+flatbuf::writer metadata_vector(std::vector<flatbuf::writer> kv) {
+    return [kv = std::move(kv)](flatbuf &fb) { return fb.table_vector(kv); };
+}
+
+flatbuf::writer field_writer(const column_def &col) {
+    return flatbuf::table_writer({
+        flatbuf::ref(0, flatbuf::string_writer(col.name)),
+        flatbuf::scalar<uint8_t>(1, col.nullable ? 1 : 0),
+        flatbuf::scalar<uint8_t>(2, TYPE_INT),
+        flatbuf::ref(3, flatbuf::table_writer({
+                            flatbuf::scalar<int32_t>(0, col.bit_width),
+                            flatbuf::scalar<uint8_t>(1, col.is_signed ? 1 : 0),
+                        })),
+        /* Readers require a children vector even for primitive types. */
+        flatbuf::ref(5, metadata_vector({})),
+    });
+}
+
+flatbuf::writer schema_writer(const run_config &config) {
+    std::vector<flatbuf::writer> fields;
+    for (const column_def &col : COLUMNS) {
+        fields.push_back(field_writer(col));
+    }
+
+    return flatbuf::table_writer({
+        flatbuf::scalar<int16_t>(0, ENDIAN_LITTLE),
+        flatbuf::ref(1, metadata_vector(fields)),
+        flatbuf::ref(2, metadata_vector(config_metadata(config))),
+    });
+}
+
+std::vector<uint8_t> message(uint8_t header_type, flatbuf::writer header, int64_t body_len,
+                             std::vector<flatbuf::writer> metadata) {
+    std::vector<flatbuf::field> fields = {
+        flatbuf::scalar<int16_t>(0, METADATA_V5),
+        flatbuf::scalar<uint8_t>(1, header_type),
+        flatbuf::ref(2, std::move(header)),
+        flatbuf::scalar<int64_t>(3, body_len),
+    };
+    if (!metadata.empty()) {
+        fields.push_back(flatbuf::ref(4, metadata_vector(std::move(metadata))));
+    }
+    return flatbuf::finish(flatbuf::table_writer(std::move(fields)));
+}
+
+/*
+ * Convert ticks to nanoseconds without overflowing for long runs.
+ *
+ * The tick rate is tick_rate(config), kept here as the exact ratio
+ * f_cpu / prescaler. The common clocks (8 MHz, 16 MHz, small prescalers)
+ * give a whole number of nanoseconds per tick and reduce to a multiply;
+ * otherwise split prescaled ticks into whole seconds and remainder.
+ */
+void ticks_to_ns(const int64_t *ticks, size_t n, const run_config &config, int64_t *out) {
+    const int64_t f_cpu = config.f_cpu;
+    const int64_t prescaler = config.timer1_prescaler > 1 ? config.timer1_prescaler : 1;
+    if (1000000000 * prescaler % f_cpu == 0) {
+        const int64_t ns_per_tick = 1000000000 * prescaler / f_cpu;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = ticks[i] * ns_per_tick;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const int64_t cycles = ticks[i] * prescaler;
+        const int64_t sec = cycles / f_cpu;
+        const int64_t rem = cycles % f_cpu;
+        out[i] = sec * 1000000000 + rem * 1000000000 / f_cpu;
+    }
+}
+
+}  // namespace
+
+arrow_ipc_writer::arrow_ipc_writer(std::FILE *out, layout fmt) : out_(out), layout_(fmt) {
+    if (layout_ == layout::file) {
+        write_bytes(FILE_MAGIC, sizeof(FILE_MAGIC));
+    }
+}
+
+void arrow_ipc_writer::write_bytes(const void *data, size_t len) {
+    if (len > 0 && std::fwrite(data, 1, len, out_) != len) {
+        throw std::runtime_error(std::string("arrow: write failed: ") + std::strerror(errno));
+    }
+    pos_ += len;
+}
+
+void arrow_ipc_writer::write_padding(size_t len) {
+    static const uint8_t zeros[8] = {};
+    write_bytes(zeros, len);
+}
+
+/*
+ * Write one encapsulated IPC message:
+ *
+ *   <0xFFFFFFFF> <int32 metadata length> <flatbuffer, padded to 8> <body>
+ *
+ * Body buffers are each padded to 8 bytes, matching the offsets recorded
+ * in the message's buffer table.
+ */
+void arrow_ipc_writer::write_message(const std::vector<uint8_t> &meta,
+                                     const std::vector<buffer_ref> &body, uint64_t body_len,
+                                     bool record_block) {
+    const uint64_t start = pos_;
+    const int32_t meta_len = static_cast<int32_t>(meta.size());
+
+    write_bytes(&CONTINUATION, sizeof(CONTINUATION));
+    write_bytes(&meta_len, sizeof(meta_len));
+    write_bytes(meta.data(), meta.size());
+
+    for (const buffer_ref &b : body) {
+        write_bytes(b.data, b.len);
+        write_padding(pad8(b.len) - b.len);
+    }
+
+    if (record_block) {
+        blocks_.push_back(block{static_cast<int64_t>(start),
+                                static_cast<int32_t>(8 + meta.size()), 0,
+                                static_cast<int64_t>(body_len)});
+    }
+}
+
+void arrow_ipc_writer::write_schema(const run_config &config) {
+    schema_config_ = config;
+    schema_written_ = true;
+    write_message(message(HEADER_SCHEMA, schema_writer(config), 0, {}), {}, 0, false);
+}
+
+void arrow_ipc_writer::source(const std::string &name) {
+    source_ = name;
+    run_base_ = next_run_id_;
+}
+
+void arrow_ipc_writer::begin_run(const run_info &info) {
+    if (!schema_written_) {
+        write_schema(info.config);
+    }
+    run_ = info;
+    current_run_id_ = run_base_ + info.index;
+    next_run_id_ = std::max(next_run_id_, current_run_id_ + 1);
+    have_last_ = false;
+}
+
+/*
+ * Emit one record batch per decoder batch.
+ *
+ * tick, edge and gap are written straight from the decoder's buffers; only
+ * the derived columns (run_id, time_ns, dt) are materialised here.
+ */
+void arrow_ipc_writer::events(const event_batch &batch) {
+    const size_t n = batch.count;
+    if (n == 0) {
+        return;
+    }
+
+    run_id_.assign(n, current_run_id_);
+
+    time_ns_.resize(n);
+    int64_t time_nulls = 0;
+    if (run_.config.f_cpu != 0) {
+        ticks_to_ns(batch.ticks, n, run_.config, time_ns_.data());
+        null_bitmap_.clear();
+    } else {
+        std::memset(time_ns_.data(), 0, n * sizeof(int64_t));
+        null_bitmap_.assign((n + 7) / 8, 0);
+        time_nulls = static_cast<int64_t>(n);
+    }
+
+    dt_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        dt_[i] = have_last_ ? batch.ticks[i] - last_tick_ : 0;
+        last_tick_ = batch.ticks[i];
+        have_last_ = true;
+    }
+
+    /* Validity buffer (possibly empty) then values, per column. */
+    const std::vector<buffer_ref> body = {
+        {nullptr, 0}, {run_id_.data(), n * sizeof(uint32_t)},
+        {nullptr, 0}, {batch.ticks, n * sizeof(int64_t)},
+        {null_bitmap_.data(), null_bitmap_.size()}, {time_ns_.data(), n * sizeof(int64_t)},
+        {nullptr, 0}, {batch.edge, n * sizeof(uint8_t)},
+        {nullptr, 0}, {dt_.data(), n * sizeof(int64_t)},
+        {nullptr, 0}, {batch.gap, n * sizeof(uint16_t)},
+    };
+
+    std::vector<buffer_desc> buffers;
+    int64_t offset = 0;
+    for (const buffer_ref &b : body) {
+        buffers.push_back(buffer_desc{offset, static_cast<int64_t>(b.len)});
+        offset += static_cast<int64_t>(pad8(b.len));
+    }
+
+    std::vector<field_node> nodes(COLUMN_COUNT, field_node{static_cast<int64_t>(n), 0});
+    nodes[2].null_count = time_nulls;
+
+    flatbuf::writer record_batch = [&](flatbuf &fb) {
+        return fb.table({
+            flatbuf::scalar<int64_t>(0, static_cast<int64_t>(n)),
+            flatbuf::ref(1, [&](flatbuf &f) {
+                return f.struct_vector(nodes.data(), sizeof(field_node), nodes.size(), 8);
+            }),
+            flatbuf::ref(2, [&](flatbuf &f) {
+                return f.struct_vector(buffers.data(), sizeof(buffer_desc), buffers.size(), 8);
+            }),
+        });
+    };
+
+    std::vector<flatbuf::writer> metadata = config_metadata(run_.config);
+    metadata.push_back(key_value("run_id", std::to_string(current_run_id_)));
+    metadata.push_back(key_value("source", source_));
+    metadata.push_back(key_value("source_run", std::to_string(run_.index)));
+    metadata.push_back(key_value("source_offset", std::to_string(run_.source_offset)));
+
+    write_message(message(HEADER_RECORD_BATCH, record_batch, offset, std::move(metadata)),
+                  body, static_cast<uint64_t>(offset), true);
+    rows_ += n;
+}
+
+void arrow_ipc_writer::end_run(const run_info &) {}
+
+void arrow_ipc_writer::finish() {
+    if (!schema_written_) {
+        write_schema(run_config());
+    }
+
+    /* End-of-stream marker: continuation followed by a zero length. */
+    const uint32_t eos[2] = {CONTINUATION, 0};
+    write_bytes(eos, sizeof(eos));
+
+    if (layout_ == layout::file) {
+        const std::vector<block> &blocks = blocks_;
+        const std::vector<uint8_t> footer = flatbuf::finish(flatbuf::table_writer({
+            flatbuf::scalar<int16_t>(0, METADATA_V5),
+            flatbuf::ref(1, schema_writer(schema_config_)),
+            flatbuf::ref(2, [](flatbuf &fb) { return fb.struct_vector(nullptr, sizeof(block), 0, 8); }),
+            flatbuf::ref(3, [&blocks](flatbuf &fb) {
+                return fb.struct_vector(blocks.data(), sizeof(block), blocks.size(), 8);
+            }),
+        }));
+
+        const int32_t footer_len = static_cast<int32_t>(footer.size());
+        write_bytes(footer.data(), footer.size());
+        write_bytes(&footer_len, sizeof(footer_len));
+        write_bytes(FILE_MAGIC, 6);
+    }
+
+    if (std::fflush(out_) != 0) {
+        throw std::runtime_error(std::string("arrow: write failed: ") + std::strerror(errno));
+    }
+}
+
+}  // namespace vlog
@@ -0,0 +1,106 @@
+#ifndef VLOG_ARROW_WRITER_H
+#define VLOG_ARROW_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+
+namespace vlog {
+
+/*
+ * Apache Arrow IPC writer for decoded runs.
+ *
+ * Produces either the Arrow IPC file format (random access, readable with
+ * pyarrow.ipc.open_file, DuckDB, Polars) or the streaming format (for pipes).
+ * Encoding is done in-tree: the metadata is a handful of flatbuffers and the
+ * column buffers are written directly from the batches the decoder delivers,
+ * so no Arrow library is needed to produce the files.
+ *
+ * Schema (one row per edge):
+ *
+ *   run_id  : uint32   run number, unique across the inputs of one file
+ *   tick    : int64    absolute Timer1 tick
+ *   time_ns : int64    tick converted with the run's F_CPU (null if unknown)
+ *   edge    : uint8    1 = rising, 0 = falling
+ *   dt      : int64    ticks since the previous edge of the run (0 for the first)
+ *   gap     : uint16   events dropped before this edge
+ *
+ * The schema's custom metadata carries the `#` header configuration of the
+ * first run (F_CPU, BAUD, TIMER1_PRESCALER, ICNC1, CAPTURE_BUFFER_SIZE). Each
+ * record batch belongs to exactly one run and repeats that run's header
+ * values plus run_id, source, source_run (its index within the source) and
+ * source_offset in its own message metadata, so mixed configurations in
+ * one log remain distinguishable.
+ *
+ * run_id is source_run offset past the ids of earlier sources, so runs
+ * exported from one source keep their own index.
+ */
+class arrow_ipc_writer : public run_sink {
+public:
+    enum class layout { file, stream };
+
+    // `out` is not owned and must stay open until finish() returns.
+    arrow_ipc_writer(std::FILE *out, layout fmt);
+
+    // Name the input the following runs come from; call before each one
+    // when exporting several.
+    void source(const std::string &name);
+
+    void begin_run(const run_info &info) override;
+    void events(const event_batch &batch) override;
+    void end_run(const run_info &info) override;
+
+    // Terminate the stream and, for the file layout, write the footer.
+    void finish();
+
+    uint64_t rows() const { return rows_; }
+
+private:
+    struct block {
+        int64_t offset;
+        int32_t metadata_length;
+        int32_t pad;
+        int64_t body_length;
+    };
+
+    struct buffer_ref {
+        const void *data;
+        size_t len;
+    };
+
+    void write_schema(const run_config &config);
+    void write_message(const std::vector<uint8_t> &meta, const std::vector<buffer_ref> &body,
+                       uint64_t body_len, bool record_block);
+    void write_bytes(const void *data, size_t len);
+    void write_padding(size_t len);
+
+    std::FILE *out_;
+    layout layout_;
+    uint64_t pos_ = 0;
+    uint64_t rows_ = 0;
+    bool schema_written_ = false;
+    run_config schema_config_;
+    std::vector<block> blocks_;
+
+    std::string source_;
+    uint32_t run_base_ = 0;          // run_id of the source's run 0.
+    uint32_t next_run_id_ = 0;       // First id not yet used.
+    run_info run_;
+    uint32_t current_run_id_ = 0;
+    bool have_last_ = false;
+    int64_t last_tick_ = 0;
+
+    // Per-batch scratch for derived columns.
+    std::vector<uint32_t> run_id_;
+    std::vector<int64_t> time_ns_;
+    std::vector<int64_t> dt_;
+    std::vector<uint8_t> null_bitmap_;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_ARROW_WRITER_H
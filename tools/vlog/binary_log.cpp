@@ -0,0 +1,464 @@
+#include "binary_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "crc32c.h"
+#include "log_syntax.h"
+
+namespace vlog {
+
+using namespace log_syntax;
+
+namespace {
+
+void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+uint16_t get_u16(const uint8_t *p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get_u32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// type + seq before the payload, CRC after it.
+constexpr size_t FRAME_OVERHEAD = 6;
+
+// Bitmap byte -> eight EDGE_RISING / EDGE_FALLING bytes, lowest bit first.
+struct edge_lane_table {
+    uint64_t lanes[256];
+
+    edge_lane_table() {
+        for (unsigned b = 0; b < 256; b++) {
+            uint8_t e[8];
+            for (unsigned i = 0; i < 8; i++) {
+                e[i] = (b >> i) & 1u ? EDGE_RISING : EDGE_FALLING;
+            }
+            std::memcpy(&lanes[b], e, 8);
+        }
+    }
+};
+
+const edge_lane_table &edge_lanes() {
+    static const edge_lane_table table;
+    return table;
+}
+
+}  // namespace
+
+void cobs_append(std::string &out, const uint8_t *data, size_t len) {
+    size_t code_at = out.size();
+    uint8_t code = 1;
+    out.push_back('\0');
+
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != 0) {
+            out.push_back(static_cast<char>(data[i]));
+            code++;
+        }
+        if (data[i] == 0 || code == 0xFF) {
+            out[code_at] = static_cast<char>(code);
+            code_at = out.size();
+            code = 1;
+            out.push_back('\0');
+        }
+    }
+
+    out[code_at] = static_cast<char>(code);
+    out.push_back('\0');
+}
+
+void binary_log_writer::header(std::string &out, const run_config &config) {
+    uint8_t p[17];
+    put_u32(p, config.f_cpu);
+    put_u32(p + 4, config.baud);
+    put_u32(p + 8, config.timer1_prescaler);
+    put_u32(p + 12, config.capture_buffer_size);
+    p[16] = config.icnc1 < 0 ? 0xFF : static_cast<uint8_t>(config.icnc1);
+
+    flush(out);
+    seq_ = 0;
+    emit(out, RECORD_HEADER, p, sizeof(p));
+}
+
+void binary_log_writer::start(std::string &out) {
+    frame(out, RECORD_START, nullptr, 0);
+}
+
+void binary_log_writer::stop(std::string &out) {
+    frame(out, RECORD_STOP, nullptr, 0);
+}
+
+void binary_log_writer::event(std::string &out, uint32_t tick32, uint8_t edge, uint16_t dropped) {
+    if (events_ != 0 && dropped != dropped_) {
+        flush(out);
+    }
+    if (events_ == 0) {
+        dropped_ = dropped;
+        std::memset(edges_, 0, sizeof(edges_));
+    }
+
+    ticks_[events_] = tick32;
+    if (edge == EDGE_RISING) {
+        edges_[events_ / 8] |= static_cast<uint8_t>(1u << (events_ % 8));
+    }
+
+    if (++events_ == BINARY_LOG_EVENTS_PER_FRAME) {
+        flush(out);
+    }
+}
+
+void binary_log_writer::sync(std::string &out, uint32_t tick32) {
+    uint8_t p[4];
+    put_u32(p, tick32);
+    frame(out, RECORD_SYNC, p, sizeof(p));
+}
+
+void binary_log_writer::status(std::string &out, uint32_t tick32, uint16_t ring_high_water,
+                               uint16_t dropped) {
+    uint8_t p[8];
+    put_u32(p, tick32);
+    put_u16(p + 4, ring_high_water);
+    put_u16(p + 6, dropped);
+    frame(out, RECORD_STATUS, p, sizeof(p));
+}
+
+void binary_log_writer::flush(std::string &out) {
+    if (events_ == 0) {
+        return;
+    }
+
+    uint8_t p[BINARY_LOG_MAX_FRAME];
+    const size_t edge_bytes = (events_ + 7) / 8;
+    put_u16(p, dropped_);
+    p[2] = static_cast<uint8_t>(events_);
+    std::memcpy(p + 3, edges_, edge_bytes);
+    for (size_t i = 0; i < events_; i++) {
+        put_u32(p + 3 + edge_bytes + 4 * i, ticks_[i]);
+    }
+
+    const size_t len = 3 + edge_bytes + 4 * events_;
+    events_ = 0;
+    emit(out, RECORD_EVENTS, p, len);
+}
+
+void binary_log_writer::frame(std::string &out, uint8_t type, const uint8_t *payload,
+                              size_t len) {
+    if (len > BINARY_LOG_MAX_FRAME - FRAME_OVERHEAD) {
+        throw std::runtime_error("binary log frame payload too long");
+    }
+    flush(out);
+    emit(out, type, payload, len);
+}
+
+void binary_log_writer::emit(std::string &out, uint8_t type, const uint8_t *payload,
+                             size_t len) {
+    uint8_t f[BINARY_LOG_MAX_FRAME];
+    f[0] = type;
+    f[1] = seq_++;
+    if (len != 0) {
+        std::memcpy(f + 2, payload, len);
+    }
+    put_u32(f + 2 + len, crc32c(f, 2 + len));
+
+    if (!started_) {
+        started_ = true;
+        out.push_back('\0');
+    }
+    cobs_append(out, f, len + FRAME_OVERHEAD);
+}
+
+binary_log_decoder::binary_log_decoder(run_sink &sink, size_t batch_size)
+    : records_(sink, batch_size) {}
+
+/*
+ * Split the input at delimiters. Frames are decoded straight from the
+ * caller's buffer; a partial frame at the end of a piece is carried, unless
+ * it is already too long to be valid, in which case it is skipped up to the
+ * next delimiter without being buffered.
+ */
+void binary_log_decoder::feed(const char *data, size_t len) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    const uint8_t *const end = p + len;
+    stats_.bytes += len;
+
+    if (discarding_ || !carry_.empty()) {
+        const uint8_t *z = static_cast<const uint8_t *>(std::memchr(p, 0, len));
+        const size_t take = z != nullptr ? static_cast<size_t>(z - p) : len;
+
+        if (discarding_) {
+            stats_.skipped_bytes += take;
+        } else if (carry_.size() + take > BINARY_LOG_MAX_ENCODED) {
+            stats_.skipped_bytes += carry_.size() + take;
+            carry_.clear();
+            discarding_ = true;
+        } else {
+            carry_.append(reinterpret_cast<const char *>(p), take);
+        }
+        consumed_ += take;
+
+        if (z == nullptr) {
+            return;
+        }
+        if (discarding_) {
+            stats_.framing_errors++;
+            stats_.bad_frames++;
+            discarding_ = false;
+        } else {
+            decode_frame(reinterpret_cast<const uint8_t *>(carry_.data()), carry_.size(),
+                         carry_offset_);
+            carry_.clear();
+        }
+        consumed_++;
+        p = z + 1;
+    }
+
+    while (p != end) {
+        const uint8_t *z =
+            static_cast<const uint8_t *>(std::memchr(p, 0, static_cast<size_t>(end - p)));
+        if (z == nullptr) {
+            const size_t rest = static_cast<size_t>(end - p);
+            if (rest > BINARY_LOG_MAX_ENCODED) {
+                stats_.skipped_bytes += rest;
+                discarding_ = true;
+            } else {
+                carry_.assign(reinterpret_cast<const char *>(p), rest);
+                carry_offset_ = consumed_;
+            }
+            consumed_ += rest;
+            break;
+        }
+
+        decode_frame(p, static_cast<size_t>(z - p), consumed_);
+        consumed_ += static_cast<uint64_t>(z + 1 - p);
+        p = z + 1;
+    }
+
+    check_pending();
+}
+
+void binary_log_decoder::finish() {
+    if (discarding_ || !carry_.empty()) {
+        stats_.skipped_bytes += carry_.size();
+        stats_.framing_errors++;
+        stats_.bad_frames++;
+        carry_.clear();
+        discarding_ = false;
+    }
+    records_.finish();
+}
+
+void binary_log_decoder::reject(uint64_t &counter, size_t n) {
+    counter++;
+    stats_.bad_frames++;
+    stats_.skipped_bytes += n;
+}
+
+/*
+ * Unstuff one COBS frame (delimiter removed) into the next slot of the
+ * pending batch. Checking is deferred to check_pending(): reading a frame
+ * straight after the short, unaligned stores that rebuilt it stalls on
+ * store forwarding, whereas a batch later they are plain cache hits.
+ */
+void binary_log_decoder::decode_frame(const uint8_t *p, size_t n, uint64_t offset) {
+    /* Back-to-back delimiters, e.g. the one a writer sends first. */
+    if (n == 0) {
+        return;
+    }
+    if (n > BINARY_LOG_MAX_ENCODED) {
+        reject(stats_.framing_errors, n);
+        return;
+    }
+
+    /* Each code byte is followed by code - 1 literal bytes and, unless it
+     * is 0xFF or the last block, an implied zero. Delimiter scanning has
+     * already ruled out zero code bytes. */
+    pending_frame &slot = pending_[pending_count_];
+    uint8_t *const f = slot.data;
+    size_t len = 0;
+    const uint8_t *q = p;
+    const uint8_t *const end = p + n;
+    while (q != end) {
+        const size_t code = *q++;
+        const size_t run = code - 1;
+        if (run > static_cast<size_t>(end - q)) {
+            reject(stats_.framing_errors, n);
+            return;
+        }
+        /* Most blocks are short: a fixed 8-byte copy (into slack at the
+         * end of the slot) beats a variable-length memcpy() call. */
+        if (run <= 8 && end - q >= 8) {
+            std::memcpy(f + len, q, 8);
+        } else {
+            std::memcpy(f + len, q, run);
+        }
+        len += run;
+        q += run;
+        if (code != 0xFF && q != end) {
+            f[len++] = 0;
+        }
+    }
+
+    if (len < FRAME_OVERHEAD || len > BINARY_LOG_MAX_FRAME) {
+        reject(stats_.framing_errors, n);
+        return;
+    }
+
+    slot.len = len;
+    slot.encoded = n;
+    slot.offset = offset;
+    if (++pending_count_ == FRAME_BATCH) {
+        check_pending();
+    }
+}
+
+/* Verify and apply the pending frames, in stream order. */
+void binary_log_decoder::check_pending() {
+    for (size_t i = 0; i < pending_count_; i++) {
+        const pending_frame &slot = pending_[i];
+        const uint8_t *const f = slot.data;
+        const size_t len = slot.len;
+
+        if (crc32c(f, len - 4) != get_u32(f + len - 4)) {
+            reject(stats_.crc_errors, slot.encoded);
+            continue;
+        }
+
+        const uint8_t type = f[0];
+        const uint8_t seq = f[1];
+        if (have_seq_ && !(type == RECORD_HEADER && seq == 0)) {
+            stats_.lost_frames += static_cast<uint8_t>(seq - seq_ - 1);
+        }
+        have_seq_ = true;
+        seq_ = seq;
+
+        /* A known record with a length it cannot have passed the CRC: a
+         * producer bug, but treated like any other bad frame. */
+        if (!dispatch(f, len - 4, slot.offset, slot.encoded)) {
+            reject(stats_.framing_errors, slot.encoded);
+            continue;
+        }
+        stats_.frames++;
+    }
+    pending_count_ = 0;
+}
+
+/* Turn one checked frame (without CRC) into log records. */
+bool binary_log_decoder::dispatch(const uint8_t *f, size_t n, uint64_t offset, size_t encoded) {
+    const uint8_t *p = f + 2;
+    const size_t len = n - 2;
+    uint64_t v[MAX_LINE_FIELDS] = {};
+
+    switch (f[0]) {
+    case RECORD_HEADER:
+        if (len != 17) {
+            return false;
+        }
+        records_.apply_line(LINE_BANNER, v, offset);
+        v[0] = get_u32(p);
+        records_.apply_line(LINE_F_CPU, v, offset);
+        v[0] = get_u32(p + 4);
+        records_.apply_line(LINE_BAUD, v, offset);
+        v[0] = get_u32(p + 8);
+        records_.apply_line(LINE_PRESCALER, v, offset);
+        v[0] = get_u32(p + 12);
+        records_.apply_line(LINE_BUFFER_SIZE, v, offset);
+        if (p[16] <= 1) {
+            records_.apply_line(p[16] != 0 ? LINE_ICNC1_ON : LINE_ICNC1_OFF, v, offset);
+        }
+        return true;
+
+    case RECORD_START:
+    case RECORD_STOP:
+        if (len != 0) {
+            return false;
+        }
+        records_.apply_line(f[0] == RECORD_START ? LINE_START : LINE_STOP, v, offset);
+        return true;
+
+    case RECORD_EVENTS: {
+        if (len < 3) {
+            return false;
+        }
+        const size_t count = p[2];
+        const size_t edge_bytes = (count + 7) / 8;
+        if (count == 0 || count > BINARY_LOG_EVENTS_PER_FRAME ||
+            len != 3 + edge_bytes + 4 * count) {
+            return false;
+        }
+
+        uint32_t ticks[BINARY_LOG_EVENTS_PER_FRAME];
+        uint8_t edge[BINARY_LOG_EVENTS_PER_FRAME];
+        uint16_t dropped[BINARY_LOG_EVENTS_PER_FRAME];
+        /* Host and wire are both little-endian (see run_file.h). */
+        std::memcpy(ticks, p + 3 + edge_bytes, 4 * count);
+        const uint16_t d16 = get_u16(p);
+        for (size_t i = 0; i < edge_bytes; i++) {
+            std::memcpy(edge + 8 * i, &edge_lanes().lanes[p[3 + i]], 8);
+        }
+        std::fill(dropped, dropped + count, d16);
+        records_.add_rows(ticks, edge, dropped, count);
+        return true;
+    }
+
+    case RECORD_MODE:
+        if (len != 5) {
+            return false;
+        }
+        v[0] = get_u32(p + 1);
+        records_.apply_line(LINE_MODE, v, offset);
+        return true;
+
+    case RECORD_SUMMARY:
+    case RECORD_METER: {
+        const size_t words = f[0] == RECORD_SUMMARY ? 7 : 6;
+        if (len != words * 4 + 2) {
+            return false;
+        }
+        for (size_t i = 0; i < words; i++) {
+            v[i] = get_u32(p + 4 * i);
+        }
+        v[words] = get_u16(p + 4 * words);
+        records_.apply_line(f[0] == RECORD_SUMMARY ? LINE_SUMMARY : LINE_METER, v, offset);
+        return true;
+    }
+
+    case RECORD_SYNC:
+        if (len != 4) {
+            return false;
+        }
+        v[0] = get_u32(p);
+        v[1] = encoded + 1;
+        records_.apply_line(LINE_SYNC, v, offset);
+        return true;
+
+    case RECORD_STATUS:
+        if (len != 8) {
+            return false;
+        }
+        v[0] = get_u32(p);
+        v[1] = get_u16(p + 4);
+        v[2] = get_u16(p + 6);
+        records_.apply_line(LINE_STATUS, v, offset);
+        return true;
+
+    default:
+        stats_.unknown_frames++;
+        return true;
+    }
+}
+
+}  // namespace vlog
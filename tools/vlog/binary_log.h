@@ -0,0 +1,173 @@
+#ifndef VLOG_BINARY_LOG_H
+#define VLOG_BINARY_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+
+namespace vlog {
+
+/*
+ * Framed binary encoding of the logger stream.
+ *
+ * Carries the same records as the text log in a form that is cheaper to
+ * produce and to check. Every frame is COBS-encoded and terminated by a
+ * 0x00 byte, so 0x00 occurs nowhere else and a reader that lost sync (byte
+ * corruption, joining mid-stream) is back in step at the next delimiter.
+ * A writer sends one delimiter before its first frame. Decoded, a frame is
+ *
+ *   type:u8  seq:u8  payload  crc:u32
+ *
+ * with all integers little-endian. crc is CRC-32C over type .. payload; seq
+ * counts frames modulo 256 and restarts at 0 with a RECORD_HEADER, so lost
+ * frames can be counted. A decoded frame is at most BINARY_LOG_MAX_FRAME
+ * bytes.
+ *
+ * Payloads, by type (the text equivalent in brackets):
+ *
+ *   RECORD_HEADER   f_cpu:u32 baud:u32 prescaler:u32 buffer_size:u32
+ *                   icnc1:u8 (0, 1, 0xFF unknown)       [banner and headers]
+ *   RECORD_START    (empty)                              [# START]
+ *   RECORD_STOP     (empty)                              [# STOP]
+ *   RECORD_EVENTS   dropped:u16 count:u8 edges:u8[(count + 7) / 8]
+ *                   ticks:u32[count]                     [rows]
+ *   RECORD_MODE     summary:u8 ticks:u32                 [# MODE=...]
+ *   RECORD_SUMMARY  start end edges periods min max mean:u32 dropped:u16
+ *   RECORD_METER    start end periods span freq_mhz duty_ppm:u32 dropped:u16
+ *   RECORD_SYNC     ticks:u32                            [# SYNC,<ticks>]
+ *   RECORD_STATUS   ticks:u32 high_water:u16 dropped:u16 [# STATUS,...]
+ *
+ * An event frame holds 1..BINARY_LOG_EVENTS_PER_FRAME consecutive rows that
+ * share one value of the dropped counter (a writer starts a new frame when
+ * it changes); bit i % 8 of edges[i / 8] is set for a rising edge. The
+ * layout keeps zero bytes, and so COBS blocks, rare in the bulk of the
+ * stream. A sync frame's ticks are when its first encoded byte went on the
+ * wire, its delimiter ending the record as '\n' ends the text line.
+ *
+ * Frames of other types are skipped so that newer producers may add
+ * records without breaking older tools.
+ */
+enum binary_record : uint8_t {
+    RECORD_HEADER = 1,
+    RECORD_START = 2,
+    RECORD_STOP = 3,
+    RECORD_EVENTS = 4,
+    RECORD_MODE = 5,
+    RECORD_SUMMARY = 6,
+    RECORD_METER = 7,
+    RECORD_SYNC = 8,
+    RECORD_STATUS = 9,
+};
+
+constexpr size_t BINARY_LOG_MAX_FRAME = 254;
+constexpr size_t BINARY_LOG_MAX_ENCODED = BINARY_LOG_MAX_FRAME + 2;  // COBS overhead.
+constexpr size_t BINARY_LOG_EVENTS_PER_FRAME = 56;
+
+// Append a COBS-encoded block and its 0x00 delimiter to out.
+void cobs_append(std::string &out, const uint8_t *data, size_t len);
+
+/*
+ * Producer side of the binary encoding, for the synthetic generator and
+ * for tests. Events are packed until a frame is full or another record
+ * needs to go out; flush() sends a partial event frame.
+ */
+class binary_log_writer {
+public:
+    void header(std::string &out, const run_config &config);
+    void start(std::string &out);
+    void stop(std::string &out);
+    void event(std::string &out, uint32_t tick32, uint8_t edge, uint16_t dropped);
+    void sync(std::string &out, uint32_t tick32);
+    void status(std::string &out, uint32_t tick32, uint16_t ring_high_water, uint16_t dropped);
+    void flush(std::string &out);
+
+    // Send one frame with an arbitrary type and payload (at most
+    // BINARY_LOG_MAX_FRAME - 6 bytes); pending events go first.
+    void frame(std::string &out, uint8_t type, const uint8_t *payload, size_t len);
+
+private:
+    void emit(std::string &out, uint8_t type, const uint8_t *payload, size_t len);
+
+    bool started_ = false;
+    uint8_t seq_ = 0;
+    uint32_t ticks_[BINARY_LOG_EVENTS_PER_FRAME];
+    uint8_t edges_[BINARY_LOG_EVENTS_PER_FRAME / 8];
+    size_t events_ = 0;
+    uint16_t dropped_ = 0;
+};
+
+// Frame-level accounting for one binary decode.
+struct binary_log_stats {
+    uint64_t bytes = 0;           // Input bytes seen.
+    uint64_t frames = 0;          // Frames that passed the CRC check.
+    uint64_t bad_frames = 0;      // Frames discarded (crc + framing errors).
+    uint64_t crc_errors = 0;
+    uint64_t framing_errors = 0;  // Broken COBS, or a length the record cannot have.
+    uint64_t skipped_bytes = 0;   // Encoded bytes of discarded frames.
+    uint64_t lost_frames = 0;     // Gaps in the sequence number.
+    uint64_t unknown_frames = 0;  // Valid frames of a type not listed above.
+};
+
+/*
+ * Streaming decoder for the binary encoding.
+ *
+ * Input may be fed in arbitrary pieces. Delimiters are located with
+ * memchr(), which the C library implements with vector compares; complete
+ * frames are unstuffed from the caller's buffer a COBS block at a time into
+ * a small batch, which is then CRC-checked (hardware CRC-32C where
+ * available) and applied. Every complete frame of a piece has been applied
+ * when feed() returns. Records go through the same
+ * state machine as the text log (log_decoder::apply_line()), so the sink
+ * sees identical runs, batches and decode_stats for the same content.
+ *
+ * A frame that fails any check is counted and dropped; decoding resumes
+ * with the frame after the next delimiter.
+ */
+class binary_log_decoder {
+public:
+    explicit binary_log_decoder(run_sink &sink, size_t batch_size = 4096);
+
+    void feed(const char *data, size_t len);
+
+    // Count a trailing partial frame as bad and close an open run as truncated.
+    void finish();
+
+    const binary_log_stats &stats() const { return stats_; }
+    const decode_stats &records() const { return records_.stats(); }
+
+private:
+    // Unstuffed frame awaiting its CRC check.
+    struct pending_frame {
+        size_t len;
+        size_t encoded;
+        uint64_t offset;
+        uint8_t data[BINARY_LOG_MAX_ENCODED + 8];
+    };
+    static constexpr size_t FRAME_BATCH = 16;
+
+    void decode_frame(const uint8_t *p, size_t n, uint64_t offset);
+    void check_pending();
+    bool dispatch(const uint8_t *f, size_t n, uint64_t offset, size_t encoded);
+    void reject(uint64_t &counter, size_t n);
+
+    log_decoder records_;
+    binary_log_stats stats_;
+
+    std::string carry_;           // Partial frame awaiting its delimiter.
+    uint64_t carry_offset_ = 0;
+    bool discarding_ = false;     // Inside an overlong frame; skip to the delimiter.
+    uint64_t consumed_ = 0;
+
+    bool have_seq_ = false;
+    uint8_t seq_ = 0;
+
+    pending_frame pending_[FRAME_BATCH];
+    size_t pending_count_ = 0;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_BINARY_LOG_H
@@ -0,0 +1,727 @@
+#include "capture_daemon.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+
+#include "binary_log.h"
+#include "clock_sync.h"
+#include "log_decoder.h"
+#include "shm_ring.h"
+
+namespace vlog {
+
+namespace {
+
+using steady = std::chrono::steady_clock;
+
+// epoll tag of the stop eventfd (device tags are their index).
+constexpr uint64_t STOP_TAG = UINT64_MAX;
+
+// How often paused devices are re-checked for buffer space.
+constexpr int PAUSE_POLL_MS = 10;
+
+std::runtime_error sys_error(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+speed_t baud_constant(uint32_t baud) {
+    static const struct {
+        uint32_t baud;
+        speed_t speed;
+    } table[] = {
+        {9600, B9600},       {19200, B19200},     {38400, B38400},     {57600, B57600},
+        {115200, B115200},   {230400, B230400},   {460800, B460800},   {500000, B500000},
+        {921600, B921600},   {1000000, B1000000}, {2000000, B2000000},
+    };
+    for (const auto &e : table) {
+        if (e.baud == baud) {
+            return e.speed;
+        }
+    }
+    throw std::runtime_error("unsupported baud rate " + std::to_string(baud));
+}
+
+// Raw 8N1 at the requested rate, no flow control, reads never block.
+void configure_tty(int fd, uint32_t baud, const std::string &path) {
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        throw sys_error(path);
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~static_cast<tcflag_t>(CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    const speed_t speed = baud_constant(baud);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        throw sys_error(path);
+    }
+}
+
+int64_t clock_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+read_stamp stamp_now(uint64_t end) {
+    read_stamp s;
+    s.end = end;
+    s.mono_ns = clock_ns(CLOCK_MONOTONIC);
+    s.real_ns = clock_ns(CLOCK_REALTIME);
+    return s;
+}
+
+// What decoding a device's stream has found so far.
+struct stream_counters {
+    std::atomic<uint64_t> events{0};
+    std::atomic<uint64_t> dropped_events{0};
+    std::atomic<uint64_t> decode_errors{0};
+    std::atomic<int64_t> firmware_dropped{-1};
+    std::atomic<int64_t> firmware_high_water{-1};
+    std::atomic<int64_t> firmware_ring{-1};
+};
+
+// Counts the decoded stream, then passes it on to the live ring, if any.
+class counting_sink : public run_sink {
+public:
+    counting_sink(stream_counters &counters, run_sink *next) : counters_(counters), next_(next) {}
+
+    void begin_run(const run_info &info) override {
+        summarised_gap_ = 0;
+        if (next_ != nullptr) {
+            next_->begin_run(info);
+        }
+    }
+    void events(const event_batch &batch) override {
+        /* A gap after summaries includes their edges and drops, counted
+         * in summary() already. */
+        uint64_t dropped = 0;
+        for (size_t i = 0; i < batch.count; i++) {
+            const uint64_t gap = batch.gap[i];
+            dropped += gap > summarised_gap_ ? gap - summarised_gap_ : 0;
+            summarised_gap_ = 0;
+        }
+        counters_.events.fetch_add(batch.count, std::memory_order_relaxed);
+        counters_.dropped_events.fetch_add(dropped, std::memory_order_relaxed);
+        if (next_ != nullptr) {
+            next_->events(batch);
+        }
+    }
+    void summary(const summary_window &w) override {
+        counters_.dropped_events.fetch_add(w.dropped, std::memory_order_relaxed);
+        summarised_gap_ += w.edges + w.dropped;
+        if (next_ != nullptr) {
+            next_->summary(w);
+        }
+    }
+    void end_run(const run_info &info) override {
+        if (next_ != nullptr) {
+            next_->end_run(info);
+        }
+    }
+    void status(const status_record &s) override {
+        counters_.firmware_dropped.store(s.dropped, std::memory_order_relaxed);
+        counters_.firmware_high_water.store(s.ring_high_water, std::memory_order_relaxed);
+        counters_.firmware_ring.store(s.config.capture_buffer_size, std::memory_order_relaxed);
+        if (next_ != nullptr) {
+            next_->status(s);
+        }
+    }
+
+private:
+    stream_counters &counters_;
+    run_sink *next_;
+    uint64_t summarised_gap_ = 0;   // Of the next row's gap.
+};
+
+}  // namespace
+
+struct capture_daemon::device {
+    explicit device(size_t ring_bytes) : ring(ring_bytes) {}
+
+    size_t index = 0;
+    std::string path;
+    std::string name;
+    int fd = -1;
+    int out_fd = -1;
+    int time_fd = -1;
+    spsc_ring ring;
+
+    bool paused = false;              // I/O thread only.
+    bool polled = true;               // I/O thread only: false for regular files.
+    uint64_t log_end = 0;             // I/O thread only: log offset after the last read.
+    steady::time_point last_sync;     // Writer owning the device only.
+    uint64_t unsynced = 0;            // Writer owning the device only.
+
+    std::atomic<bool> open{true};
+    std::atomic<bool> queued{false};
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> bytes_written{0};
+    std::atomic<uint64_t> high_water{0};
+    std::atomic<uint64_t> pauses{0};
+    std::atomic<uint64_t> fsyncs{0};
+    std::atomic<uint64_t> write_errors{0};
+    stream_counters decoded;
+    latency_histogram fsync_latency;
+
+    std::mutex stamps_mutex;
+    std::vector<read_stamp> stamps;   // Filled by the I/O thread, written by the writer.
+
+    // Live stream and decoding; the writer owning the device only. The
+    // decoder is chosen by the first byte captured.
+    std::unique_ptr<shm_ring_writer> live;
+    std::unique_ptr<live_publisher> publisher;
+    std::unique_ptr<counting_sink> sink;
+    std::unique_ptr<log_decoder> text;
+    std::unique_ptr<binary_log_decoder> framed;
+};
+
+capture_daemon::capture_daemon(const capture_options &options) : options_(options) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        throw sys_error("epoll_create1");
+    }
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+        close(epoll_fd_);
+        throw sys_error("eventfd");
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = STOP_TAG;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &ev);
+}
+
+capture_daemon::~capture_daemon() {
+    for (const std::unique_ptr<device> &d : devices_) {
+        if (d->fd >= 0) {
+            close(d->fd);
+        }
+        if (d->out_fd >= 0) {
+            close(d->out_fd);
+        }
+        if (d->time_fd >= 0) {
+            close(d->time_fd);
+        }
+    }
+    close(stop_fd_);
+    close(epoll_fd_);
+}
+
+void capture_daemon::add_device(const std::string &path, const std::string &name) {
+    std::unique_ptr<device> d(new device(options_.ring_bytes));
+    d->index = devices_.size();
+    d->path = path;
+    d->name = name;
+    d->last_sync = steady::now();
+
+    d->fd = open(path.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (d->fd < 0) {
+        throw sys_error(path);
+    }
+    if (isatty(d->fd)) {
+        configure_tty(d->fd, options_.baud, path);
+    }
+
+    const std::string out_path = options_.out_dir + "/" + name + ".log";
+    d->out_fd = open(out_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (d->out_fd < 0) {
+        throw sys_error(out_path);
+    }
+
+    /* Stamps refer to log offsets; the log may already hold earlier captures. */
+    struct stat st;
+    if (fstat(d->out_fd, &st) != 0) {
+        throw sys_error(out_path);
+    }
+    d->log_end = static_cast<uint64_t>(st.st_size);
+
+    const std::string time_path = options_.out_dir + "/" + name + ".time";
+    d->time_fd = open(time_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (d->time_fd < 0 || fstat(d->time_fd, &st) != 0) {
+        throw sys_error(time_path);
+    }
+    if (st.st_size == 0 &&
+        write(d->time_fd, READ_STAMP_MAGIC, sizeof(READ_STAMP_MAGIC)) !=
+            static_cast<ssize_t>(sizeof(READ_STAMP_MAGIC))) {
+        throw sys_error(time_path);
+    }
+    /* A zero-length read marks where stamped data starts. */
+    d->stamps.push_back(stamp_now(d->log_end));
+
+    if (options_.live_records != 0) {
+        d->live.reset(new shm_ring_writer("/vlog." + name, options_.live_records));
+        d->publisher.reset(new live_publisher(*d->live));
+    }
+    if (d->publisher || options_.decode) {
+        d->sink.reset(new counting_sink(d->decoded, d->publisher.get()));
+    }
+
+    /* epoll refuses regular files, which are always readable; the I/O loop
+     * reads those on every pass until they reach EOF. */
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = d->index;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, d->fd, &ev) != 0) {
+        if (errno != EPERM || fstat(d->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            throw sys_error(path);
+        }
+        d->polled = false;
+    }
+    devices_.push_back(std::move(d));
+}
+
+void capture_daemon::stop() {
+    const uint64_t one = 1;
+    const ssize_t r = write(stop_fd_, &one, sizeof(one));
+    (void)r;
+}
+
+std::vector<device_status> capture_daemon::status() const {
+    std::vector<device_status> out;
+    for (const std::unique_ptr<device> &d : devices_) {
+        device_status s;
+        s.name = d->name;
+        s.path = d->path;
+        s.open = d->open.load();
+        s.bytes_read = d->bytes_read.load();
+        s.bytes_written = d->bytes_written.load();
+        s.backlog = d->ring.size();
+        s.high_water = d->high_water.load();
+        s.pauses = d->pauses.load();
+        s.fsyncs = d->fsyncs.load();
+        s.write_errors = d->write_errors.load();
+        s.events = d->decoded.events.load(std::memory_order_relaxed);
+        s.dropped_events = d->decoded.dropped_events.load(std::memory_order_relaxed);
+        s.decode_errors = d->decoded.decode_errors.load(std::memory_order_relaxed);
+        s.firmware_dropped = d->decoded.firmware_dropped.load(std::memory_order_relaxed);
+        s.firmware_high_water = d->decoded.firmware_high_water.load(std::memory_order_relaxed);
+        s.firmware_ring = d->decoded.firmware_ring.load(std::memory_order_relaxed);
+        s.fsync_latency = d->fsync_latency.snapshot();
+        out.push_back(s);
+    }
+    return out;
+}
+
+void capture_daemon::run(double report_interval,
+                         const std::function<void(const std::vector<device_status> &)> &report) {
+    std::vector<std::thread> writers;
+    for (unsigned i = 0; i < std::max(1u, options_.writers); i++) {
+        writers.emplace_back([this] { writer_loop(); });
+    }
+
+    std::exception_ptr error;
+    try {
+        io_loop(report_interval, report);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    /* Drain whatever is buffered, then let the writers go. */
+    for (const std::unique_ptr<device> &d : devices_) {
+        if (d->open) {
+            close_device(*d);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        writers_stop_ = true;
+    }
+    queue_ready_.notify_all();
+    for (std::thread &t : writers) {
+        t.join();
+    }
+
+    for (const std::unique_ptr<device> &d : devices_) {
+        if (d->out_fd >= 0) {
+            if (options_.fsync_interval > 0.0) {
+                sync_output(*d);
+            }
+            close(d->out_fd);
+            d->out_fd = -1;
+        }
+        if (d->time_fd >= 0) {
+            close(d->time_fd);
+            d->time_fd = -1;
+        }
+        d->live.reset();
+    }
+    if (report) {
+        report(status());
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void capture_daemon::io_loop(double report_interval,
+                             const std::function<void(const std::vector<device_status> &)> &report) {
+    const auto interval = std::chrono::duration_cast<steady::duration>(
+        std::chrono::duration<double>(report_interval));
+    steady::time_point next_report = steady::now() + interval;
+    epoll_event events[64];
+
+    for (;;) {
+        size_t live = 0;
+        bool paused = false;
+        bool unpolled = false;
+        for (const std::unique_ptr<device> &d : devices_) {
+            live += d->open ? 1 : 0;
+            paused |= d->paused;
+            unpolled |= d->open && !d->polled && !d->paused;
+        }
+        if (live == 0) {
+            return;
+        }
+
+        int timeout = -1;
+        if (report && report_interval > 0.0) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                next_report - steady::now());
+            timeout = static_cast<int>(std::max<int64_t>(0, left.count()));
+        }
+        if (paused && (timeout < 0 || timeout > PAUSE_POLL_MS)) {
+            timeout = PAUSE_POLL_MS;
+        }
+        if (unpolled) {
+            timeout = 0;
+        }
+
+        const int n = epoll_wait(epoll_fd_, events, 64, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw sys_error("epoll_wait");
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u64 == STOP_TAG) {
+                return;
+            }
+            read_device(*devices_[events[i].data.u64]);
+        }
+        for (const std::unique_ptr<device> &d : devices_) {
+            if (d->open && !d->polled && !d->paused) {
+                read_device(*d);
+            }
+        }
+
+        /* Resume paused devices once their writer has made room. */
+        for (const std::unique_ptr<device> &d : devices_) {
+            if (d->paused && d->open && d->ring.size() <= d->ring.capacity() / 4 * 3) {
+                if (d->polled) {
+                    epoll_event ev = {};
+                    ev.events = EPOLLIN;
+                    ev.data.u64 = d->index;
+                    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, d->fd, &ev);
+                }
+                d->paused = false;
+            }
+        }
+
+        if (report && report_interval > 0.0 && steady::now() >= next_report) {
+            report(status());
+            next_report += interval;
+        }
+    }
+}
+
+void capture_daemon::read_device(device &d) {
+    for (;;) {
+        iovec span[2];
+        const int spans = d.ring.prepare(span);
+        if (spans == 0) {
+            if (d.polled) {
+                epoll_event ev = {};
+                ev.data.u64 = d.index;
+                epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, d.fd, &ev);
+            }
+            d.paused = true;
+            d.pauses++;
+            return;
+        }
+
+        const ssize_t r = readv(d.fd, span, spans);
+        if (r > 0) {
+            d.log_end += static_cast<uint64_t>(r);
+            const read_stamp stamp = stamp_now(d.log_end);
+            {
+                std::lock_guard<std::mutex> lock(d.stamps_mutex);
+                d.stamps.push_back(stamp);
+            }
+            d.ring.commit(static_cast<size_t>(r));
+            d.bytes_read += static_cast<uint64_t>(r);
+            const uint64_t backlog = d.ring.size();
+            if (backlog > d.high_water.load(std::memory_order_relaxed)) {
+                d.high_water.store(backlog, std::memory_order_relaxed);
+            }
+            schedule(d.index);
+
+            // A short read means the kernel buffer is empty; epoll will say when not.
+            const size_t room = span[0].iov_len + (spans == 2 ? span[1].iov_len : 0);
+            if (static_cast<size_t>(r) < room) {
+                return;
+            }
+            continue;
+        }
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        // EOF, or EIO from a tty whose other end went away.
+        close_device(d);
+        return;
+    }
+}
+
+void capture_daemon::close_device(device &d) {
+    if (d.polled) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, d.fd, nullptr);
+    }
+    close(d.fd);
+    d.fd = -1;
+    d.paused = false;
+    d.open = false;
+    schedule(d.index);
+}
+
+void capture_daemon::schedule(size_t index) {
+    if (devices_[index]->queued.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queue_.push_back(index);
+        queue_depth_.store(queue_.size(), std::memory_order_relaxed);
+    }
+    queue_ready_.notify_one();
+}
+
+void capture_daemon::writer_loop() {
+    for (;;) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_ready_.wait(lock, [&] { return !queue_.empty() || writers_stop_; });
+            if (queue_.empty()) {
+                return;
+            }
+            index = queue_.front();
+            queue_.pop_front();
+            queue_depth_.store(queue_.size(), std::memory_order_relaxed);
+        }
+
+        device &d = *devices_[index];
+        drain(d);
+
+        // A hangup landing after drain() looked at `open` was not queued
+        // again while we held the device, so its final flush is still due.
+        const bool unfinished = d.sink != nullptr;
+
+        // exchange (not store) so data committed while we drained is seen below.
+        d.queued.exchange(false);
+        if (d.ring.size() > 0 || (unfinished && !d.open.load())) {
+            schedule(index);
+        }
+    }
+}
+
+/*
+ * Write out everything buffered for one device. On a write error the data
+ * is discarded and counted, so a full or failed disk cannot wedge the ring.
+ */
+void capture_daemon::drain(device &d) {
+    // Read first: once the device is seen closed, all its data is in the ring.
+    const bool closed = !d.open.load();
+
+    for (;;) {
+        iovec span[2];
+        const int spans = d.ring.peek(span);
+        if (spans == 0) {
+            break;
+        }
+        const ssize_t w = writev(d.out_fd, span, spans);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            d.write_errors++;
+            const size_t all = span[0].iov_len + (spans == 2 ? span[1].iov_len : 0);
+            publish(d, span, all);
+            d.ring.release(all);
+            continue;
+        }
+        publish(d, span, static_cast<size_t>(w));
+        d.ring.release(static_cast<size_t>(w));
+        d.bytes_written += static_cast<uint64_t>(w);
+        d.unsynced += static_cast<uint64_t>(w);
+    }
+
+    /* Stamps are small and lag the data by one drain at most. */
+    std::vector<read_stamp> stamps;
+    {
+        std::lock_guard<std::mutex> lock(d.stamps_mutex);
+        stamps.swap(d.stamps);
+    }
+    if (!stamps.empty()) {
+        const size_t len = stamps.size() * sizeof(read_stamp);
+        if (write(d.time_fd, stamps.data(), len) != static_cast<ssize_t>(len)) {
+            d.write_errors++;
+        }
+    }
+
+    if (closed && d.sink) {
+        if (d.framed) {
+            d.framed->finish();
+        } else if (d.text) {
+            d.text->finish();
+        }
+        d.framed.reset();
+        d.text.reset();
+        d.sink.reset();
+        d.publisher.reset();
+    }
+
+    if (options_.fsync_interval > 0.0 && d.unsynced > 0) {
+        const steady::time_point now = steady::now();
+        if (std::chrono::duration<double>(now - d.last_sync).count() >= options_.fsync_interval) {
+            sync_output(d);
+            d.last_sync = now;
+            d.unsynced = 0;
+        }
+    }
+}
+
+void capture_daemon::sync_output(device &d) {
+    const steady::time_point start = steady::now();
+    if (fdatasync(d.out_fd) == 0) {
+        d.fsyncs++;
+    }
+    d.fsync_latency.observe(std::chrono::duration<double>(steady::now() - start).count());
+}
+
+/* Decode the first n bytes of the spans for the counters and live ring. */
+void capture_daemon::publish(device &d, const iovec span[2], size_t n) {
+    if (!d.sink || n == 0) {
+        return;
+    }
+    const char *first = static_cast<const char *>(span[0].iov_base);
+    if (!d.text && !d.framed) {
+        if (first[0] == 0) {
+            d.framed.reset(new binary_log_decoder(*d.sink));
+        } else {
+            d.text.reset(new log_decoder(*d.sink));
+        }
+    }
+    for (int i = 0; i < 2 && n > 0; i++) {
+        const size_t len = std::min(n, span[i].iov_len);
+        if (d.framed) {
+            d.framed->feed(static_cast<const char *>(span[i].iov_base), len);
+        } else {
+            d.text->feed(static_cast<const char *>(span[i].iov_base), len);
+        }
+        n -= len;
+    }
+    const uint64_t errors = d.framed ? d.framed->stats().bad_frames + d.framed->records().malformed
+                                     : d.text->stats().malformed;
+    d.decoded.decode_errors.store(errors, std::memory_order_relaxed);
+}
+
+std::string capture_daemon::metrics() const {
+    using labels = std::vector<std::pair<std::string, std::string>>;
+    const std::vector<device_status> devices = status();
+    openmetrics_writer w;
+
+    const auto per_device = [&](const char *name, openmetrics_writer::kind kind, const char *help,
+                                const char *unit, double (*value)(const device_status &)) {
+        w.family(name, kind, help, unit);
+        for (const device_status &d : devices) {
+            w.sample(labels{{"device", d.name}}, value(d));
+        }
+    };
+    per_device("vlog_capture_open", openmetrics_writer::GAUGE, "Device is open (1) or hung up (0).",
+               "", [](const device_status &d) { return d.open ? 1.0 : 0.0; });
+    per_device("vlog_capture_read_bytes", openmetrics_writer::COUNTER,
+               "Bytes read from the device.", "bytes",
+               [](const device_status &d) { return double(d.bytes_read); });
+    per_device("vlog_capture_written_bytes", openmetrics_writer::COUNTER,
+               "Bytes appended to the log.", "bytes",
+               [](const device_status &d) { return double(d.bytes_written); });
+    per_device("vlog_capture_backlog_bytes", openmetrics_writer::GAUGE,
+               "Bytes read but not yet written.", "bytes",
+               [](const device_status &d) { return double(d.backlog); });
+    per_device("vlog_capture_backlog_high_water_bytes", openmetrics_writer::GAUGE,
+               "Largest backlog seen.", "bytes",
+               [](const device_status &d) { return double(d.high_water); });
+    per_device("vlog_capture_pauses", openmetrics_writer::COUNTER,
+               "Times reading stopped because the buffer was full.", "",
+               [](const device_status &d) { return double(d.pauses); });
+    per_device("vlog_capture_write_errors", openmetrics_writer::COUNTER,
+               "Failed log or time stamp writes.", "",
+               [](const device_status &d) { return double(d.write_errors); });
+
+    /* Stream counters only mean something while the writers decode. */
+    if (options_.decode || options_.live_records != 0) {
+        per_device("vlog_capture_events", openmetrics_writer::COUNTER, "Edge events decoded.", "",
+                   [](const device_status &d) { return double(d.events); });
+        per_device("vlog_capture_dropped_events", openmetrics_writer::COUNTER,
+                   "Events the firmware reported dropped.", "",
+                   [](const device_status &d) { return double(d.dropped_events); });
+        per_device("vlog_capture_decode_errors", openmetrics_writer::COUNTER,
+                   "Malformed lines or bad frames.", "",
+                   [](const device_status &d) { return double(d.decode_errors); });
+    }
+
+    /* Firmware gauges only once a status record has reported them. */
+    const struct {
+        const char *name;
+        const char *help;
+        int64_t device_status::*field;
+    } firmware[] = {
+        {"vlog_capture_firmware_dropped", "Firmware overflow counter from the last status.",
+         &device_status::firmware_dropped},
+        {"vlog_capture_firmware_ring_high_water",
+         "Most firmware capture ring slots in use in the last status interval.",
+         &device_status::firmware_high_water},
+        {"vlog_capture_firmware_ring_slots", "Firmware capture ring depth.",
+         &device_status::firmware_ring},
+    };
+    for (const auto &f : firmware) {
+        w.family(f.name, openmetrics_writer::GAUGE, f.help);
+        for (const device_status &d : devices) {
+            if (d.*f.field >= 0) {
+                w.sample(labels{{"device", d.name}}, double(d.*f.field));
+            }
+        }
+    }
+
+    w.family("vlog_capture_fsync_seconds", openmetrics_writer::HISTOGRAM,
+             "Time taken by each fdatasync of a log.", "seconds");
+    for (const device_status &d : devices) {
+        w.histogram(labels{{"device", d.name}}, d.fsync_latency);
+    }
+    w.family("vlog_capture_writer_queue_depth", openmetrics_writer::GAUGE,
+             "Devices waiting for a writer thread.");
+    w.sample(labels{}, double(queue_depth()));
+    return w.finish();
+}
+
+}  // namespace vlog
@@ -0,0 +1,139 @@
+#ifndef VLOG_CAPTURE_DAEMON_H
+#define VLOG_CAPTURE_DAEMON_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+#include "spsc_ring.h"
+
+namespace vlog {
+
+struct capture_options {
+    std::string out_dir = ".";
+    unsigned writers = 2;            // Writer threads shared by all devices.
+    size_t ring_bytes = 1 << 20;     // Per-device buffer, power of two.
+    uint32_t baud = 38400;           // Applied to devices that are ttys.
+    double fsync_interval = 1.0;     // Seconds between fdatasync per device; 0 = never.
+    size_t live_records = 0;         // Per-device live ring (power of two); 0 = none.
+    bool decode = false;             // Decode streams for the event and firmware counters
+                                     // even without a live ring.
+};
+
+// Point-in-time view of one device's counters.
+struct device_status {
+    std::string name;
+    std::string path;
+    bool open;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t backlog;          // Bytes buffered, not yet written.
+    uint64_t high_water;       // Largest backlog seen.
+    uint64_t pauses;           // Times reading stopped because the buffer was full.
+    uint64_t fsyncs;
+    uint64_t write_errors;
+
+    // From decoding the stream (with a live ring or capture_options::decode).
+    uint64_t events;
+    uint64_t dropped_events;   // Reported lost by the firmware, once each.
+    uint64_t decode_errors;    // Malformed lines, or bad frames.
+    int64_t firmware_dropped;  // From the last `# STATUS`; -1 before one.
+    int64_t firmware_high_water;
+    int64_t firmware_ring;     // Capture ring depth the status reported.
+    histogram_snapshot fsync_latency;
+};
+
+/*
+ * Capture daemon for several loggers on one host.
+ *
+ * A single I/O thread waits on every device with epoll and reads straight
+ * into each device's lock-free ring. A pool of writer threads drains rings
+ * to <out_dir>/<name>.log; a device is handled by at most one writer at a
+ * time, so a slow write or fdatasync on one disk only holds up that
+ * device. When a device's ring fills, the I/O thread stops polling it
+ * (the kernel tty buffer absorbs the stall) until the writer has freed a
+ * quarter of it, rather than blocking the other devices.
+ *
+ * Every read is stamped with CLOCK_MONOTONIC and CLOCK_REALTIME as it
+ * returns, and the stamps go to <out_dir>/<name>.time (see clock_sync.h)
+ * so that device ticks can later be mapped to host time.
+ *
+ * With live_records set, the writer draining a device also decodes it and
+ * publishes the records to the shared-memory ring "/vlog.<name>" (see
+ * shm_ring.h), so monitors can follow the capture without touching the
+ * serial port. A reader that falls behind loses records; the capture
+ * never waits for it.
+ *
+ * Every counter in device_status is a relaxed atomic, updated by the
+ * thread doing the work and read by status() and metrics() without any
+ * lock, so monitoring cannot slow the I/O thread down. Writers time each
+ * fdatasync into a histogram. The event and firmware counters need the
+ * stream decoded, which the writers do with a live ring or when asked.
+ *
+ * Devices that hang up (EOF, or EIO once a pty master closes) are drained
+ * and closed; run() returns when all are closed or stop() is called.
+ */
+class capture_daemon {
+public:
+    explicit capture_daemon(const capture_options &options);
+    ~capture_daemon();
+
+    capture_daemon(const capture_daemon &) = delete;
+    capture_daemon &operator=(const capture_daemon &) = delete;
+
+    // Open a device (tty, pty, FIFO or file). Throws std::runtime_error.
+    void add_device(const std::string &path, const std::string &name);
+
+    // Capture until stop() or every device has closed, calling report from
+    // the I/O thread every report_interval seconds (0 = never).
+    void run(double report_interval,
+             const std::function<void(const std::vector<device_status> &)> &report);
+
+    // Request run() to return. Async-signal-safe.
+    void stop();
+
+    std::vector<device_status> status() const;
+
+    // Devices waiting for a writer thread.
+    size_t queue_depth() const { return queue_depth_.load(std::memory_order_relaxed); }
+
+    // OpenMetrics exposition of status() and queue_depth(). Only reads
+    // atomics, so scraping never holds up the I/O or writer threads.
+    std::string metrics() const;
+
+private:
+    struct device;
+
+    void io_loop(double report_interval,
+                 const std::function<void(const std::vector<device_status> &)> &report);
+    void read_device(device &d);
+    void close_device(device &d);
+    void schedule(size_t index);
+    void writer_loop();
+    void drain(device &d);
+    void publish(device &d, const iovec span[2], size_t n);
+    void sync_output(device &d);
+
+    capture_options options_;
+    std::vector<std::unique_ptr<device>> devices_;
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_ready_;
+    std::deque<size_t> queue_;
+    std::atomic<size_t> queue_depth_{0};
+    bool writers_stop_ = false;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_CAPTURE_DAEMON_H
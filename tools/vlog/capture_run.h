@@ -0,0 +1,87 @@
+#ifndef VLOG_CAPTURE_RUN_H
+#define VLOG_CAPTURE_RUN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace vlog {
+
+// Edge polarity as recorded by the firmware (matches capture_edge_t).
+enum : uint8_t {
+    EDGE_FALLING = 0u,
+    EDGE_RISING = 1u,
+};
+
+// Logger configuration reported in the `#` header block that precedes runs.
+//
+// Values are copied verbatim from the header lines. Fields the header did
+// not mention keep their zero / unknown defaults so that downstream tools
+// can distinguish "not reported" from a real value.
+struct run_config {
+    uint32_t f_cpu = 0;                // Timer1 clock in Hz (tick rate).
+    uint32_t baud = 0;                 // UART baud rate of the log stream.
+    uint32_t timer1_prescaler = 0;     // Timer1 prescaler (1 on current firmware).
+    uint32_t capture_buffer_size = 0;  // Firmware ring buffer depth.
+    int8_t icnc1 = -1;                 // Noise canceller: 1 = ON, 0 = OFF, -1 = unknown.
+};
+
+// Timer1 ticks per second for a run; throws if the header did not report F_CPU.
+inline double tick_rate(const run_config &config) {
+    if (config.f_cpu == 0) {
+        throw std::runtime_error("run header does not report F_CPU");
+    }
+    return static_cast<double>(config.f_cpu) /
+           (config.timer1_prescaler > 1 ? config.timer1_prescaler : 1);
+}
+
+// Identity and bookkeeping for one logging run (`# START` .. `# STOP`).
+struct run_info {
+    run_config config;
+    uint32_t index = 0;          // Zero-based run number within the source.
+    uint32_t session = 0;        // Banners seen before the run (as sync_point).
+    uint64_t source_offset = 0;  // Byte offset of the `# START` line.
+    uint64_t event_count = 0;    // Events decoded (valid once the run ended).
+    uint64_t dropped = 0;        // Events the firmware reported dropped (its counter's
+                                 // advance over the run's rows); summarised edges are
+                                 // not included.
+    bool truncated = false;      // Run ended without an explicit `# STOP`.
+};
+
+// A contiguous batch of decoded events in column form.
+//
+// Pointers refer to storage owned by the producer and are only valid for
+// the duration of the call that delivered the batch.
+//
+//   ticks : absolute Timer1 tick, extended to 64 bits across 32-bit wraps.
+//   edge  : EDGE_RISING / EDGE_FALLING.
+//   gap   : events missing between the previous row and this one: those the
+//           firmware reported dropped, plus edges reported only through
+//           `# SUMMARY` windows in between, which were counted rather than
+//           lost. 0 means the event is contiguous with its predecessor; the
+//           drops alone are summed in run_info::dropped.
+struct event_batch {
+    const int64_t *ticks = nullptr;
+    const uint8_t *edge = nullptr;
+    const uint16_t *gap = nullptr;
+    size_t count = 0;
+};
+
+// Fully materialised run held in memory.
+struct capture_run {
+    run_info info;
+    std::vector<int64_t> ticks;
+    std::vector<uint8_t> edge;
+    std::vector<uint16_t> gap;
+
+    size_t size() const { return ticks.size(); }
+
+    event_batch batch() const {
+        return event_batch{ticks.data(), edge.data(), gap.data(), ticks.size()};
+    }
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_CAPTURE_RUN_H
@@ -0,0 +1,452 @@
+#include "catalog.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace vlog {
+
+namespace {
+
+uint32_t saturate(double v) {
+    return v >= UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(std::llround(v));
+}
+
+catalog_timing reduce(const timing_sketch &s) {
+    catalog_timing t;
+    std::memset(&t, 0, sizeof(t));
+    t.count = s.count();
+    if (t.count != 0) {
+        t.min = saturate(static_cast<double>(s.min()));
+        t.p50 = saturate(s.quantile(0.5));
+        t.p99 = saturate(s.quantile(0.99));
+        t.max = saturate(static_cast<double>(s.max()));
+        t.mean = static_cast<float>(s.mean());
+        t.stddev = static_cast<float>(s.stddev());
+    }
+    return t;
+}
+
+run_config entry_config(const catalog_entry &e) {
+    run_config c;
+    c.f_cpu = e.f_cpu;
+    c.baud = e.baud;
+    c.timer1_prescaler = e.timer1_prescaler;
+    c.capture_buffer_size = e.capture_buffer_size;
+    c.icnc1 = static_cast<int8_t>(e.icnc1);
+    return c;
+}
+
+enum catalog_field : uint8_t {
+    FIELD_RUN,
+    FIELD_SESSION,
+    FIELD_OFFSET,
+    FIELD_F_CPU,
+    FIELD_BAUD,
+    FIELD_PRESCALER,
+    FIELD_BUFFER,
+    FIELD_ICNC1,
+    FIELD_TRUNCATED,
+    FIELD_EVENTS,
+    FIELD_RISING,
+    FIELD_DROPPED,
+    FIELD_SUMMARISED,
+    FIELD_DURATION,
+    FIELD_SOURCE,
+    FIELD_TIMING,                  // FIELD_TIMING + metric * 6 + statistic.
+};
+
+enum catalog_op : uint8_t {
+    CMP_EQ,
+    CMP_NE,
+    CMP_LT,
+    CMP_LE,
+    CMP_GT,
+    CMP_GE,
+    CMP_CONTAINS,
+};
+
+const char *const FIELD_NAMES[] = {
+    "run",    "session", "offset",  "f_cpu",      "baud",     "prescaler", "buffer", "icnc1",
+    "truncated", "events", "rising", "dropped", "summarised", "duration", "source",
+};
+const char *const METRIC_NAMES[] = {"period", "high", "low"};
+const char *const STATISTIC_NAMES[] = {"count", "min", "p50", "p99", "max", "mean"};
+
+bool is_time(uint8_t field) {
+    return field == FIELD_DURATION || (field >= FIELD_TIMING && (field - FIELD_TIMING) % 6 != 0);
+}
+
+std::runtime_error filter_error(const std::string &term, const std::string &what) {
+    return std::runtime_error("condition '" + term + "': " + what);
+}
+
+uint8_t parse_field(const std::string &term, const std::string &name) {
+    for (uint8_t f = 0; f < FIELD_TIMING; f++) {
+        if (name == FIELD_NAMES[f]) {
+            return f;
+        }
+    }
+    for (uint8_t m = 0; m < 3; m++) {
+        for (uint8_t s = 0; s < 6; s++) {
+            if (name == std::string(METRIC_NAMES[m]) + "_" + STATISTIC_NAMES[s]) {
+                return static_cast<uint8_t>(FIELD_TIMING + m * 6 + s);
+            }
+        }
+    }
+    throw filter_error(term, "unknown field '" + name + "'");
+}
+
+double parse_value(const std::string &term, uint8_t field, const std::string &s) {
+    if (field == FIELD_ICNC1 || field == FIELD_TRUNCATED) {
+        if (s == "on" || s == "ON" || s == "yes") {
+            return 1.0;
+        }
+        if (s == "off" || s == "OFF" || s == "no") {
+            return 0.0;
+        }
+    }
+    const char *p = s.c_str();
+    char *stop = nullptr;
+    double v = std::strtod(p, &stop);
+    if (stop == p) {
+        throw filter_error(term, "bad value '" + s + "'");
+    }
+    const std::string unit(stop);
+    if (unit.empty()) {
+        return v;
+    }
+    if (!is_time(field)) {
+        throw filter_error(term, "unexpected unit '" + unit + "'");
+    }
+    if (unit == "s") {
+    } else if (unit == "ms") {
+        v *= 1e-3;
+    } else if (unit == "us") {
+        v *= 1e-6;
+    } else if (unit == "ns") {
+        v *= 1e-9;
+    } else {
+        throw filter_error(term, "unknown unit '" + unit + "'");
+    }
+    return v;
+}
+
+// The value a condition compares against; false if the run has none.
+bool field_value(const catalog_entry &e, uint8_t field, double *v) {
+    switch (field) {
+    case FIELD_RUN: *v = e.run_index; return true;
+    case FIELD_SESSION: *v = e.session; return true;
+    case FIELD_OFFSET: *v = static_cast<double>(e.source_offset); return true;
+    case FIELD_F_CPU: *v = e.f_cpu; return true;
+    case FIELD_BAUD: *v = e.baud; return true;
+    case FIELD_PRESCALER: *v = e.timer1_prescaler; return true;
+    case FIELD_BUFFER: *v = e.capture_buffer_size; return true;
+    case FIELD_ICNC1: *v = e.icnc1; return true;
+    case FIELD_TRUNCATED: *v = (e.flags & CATALOG_FLAG_TRUNCATED) != 0; return true;
+    case FIELD_EVENTS: *v = static_cast<double>(e.event_count); return true;
+    case FIELD_RISING: *v = static_cast<double>(e.rising); return true;
+    case FIELD_DROPPED: *v = static_cast<double>(e.dropped); return true;
+    case FIELD_SUMMARISED: *v = static_cast<double>(e.summarised); return true;
+    case FIELD_DURATION:
+        *v = catalog_duration(e);
+        return e.f_cpu != 0;
+    default:
+        break;
+    }
+    const unsigned metric = (field - FIELD_TIMING) / 6;
+    const unsigned statistic = (field - FIELD_TIMING) % 6;
+    const catalog_timing &t = metric == 0 ? e.period : (metric == 1 ? e.high : e.low);
+    if (statistic == 0) {
+        *v = static_cast<double>(t.count);
+        return true;
+    }
+    if (t.count == 0 || e.f_cpu == 0) {
+        return false;
+    }
+    const double ticks[] = {0.0, double(t.min), double(t.p50), double(t.p99), double(t.max),
+                            double(t.mean)};
+    *v = ticks[statistic] / tick_rate(entry_config(e));
+    return true;
+}
+
+}  // namespace
+
+double catalog_duration(const catalog_entry &e) {
+    if (e.f_cpu == 0) {
+        return 0.0;
+    }
+    return (e.last_tick - e.first_tick) / tick_rate(entry_config(e));
+}
+
+void catalog_builder::begin_run(const run_info &info) {
+    std::memset(&entry_, 0, sizeof(entry_));
+    entry_.source = source_;
+    entry_.run_index = info.index;
+    entry_.source_offset = info.source_offset;
+    entry_.session = info.session;
+    entry_.f_cpu = info.config.f_cpu;
+    entry_.baud = info.config.baud;
+    entry_.timer1_prescaler = info.config.timer1_prescaler;
+    entry_.capture_buffer_size = info.config.capture_buffer_size;
+    entry_.icnc1 = info.config.icnc1;
+    sketches_ = interval_sketches();
+    have_event_ = false;
+    have_rising_ = false;
+    dropped_since_rising_ = false;
+}
+
+void catalog_builder::events(const event_batch &batch) {
+    if (batch.count == 0) {
+        return;
+    }
+    if (!have_event_ && entry_.summarised == 0) {
+        entry_.first_tick = batch.ticks[0];
+    }
+    /* As for_each_interval(), carrying the previous event across batches. */
+    for (size_t i = 0; i < batch.count; i++) {
+        const int64_t t = batch.ticks[i];
+        const uint8_t edge = batch.edge[i];
+        const bool contiguous = have_event_ && batch.gap[i] == 0;
+        dropped_since_rising_ |= batch.gap[i] != 0;
+
+        if (edge == EDGE_FALLING) {
+            if (contiguous && prev_edge_ == EDGE_RISING) {
+                sketches_.high.add(static_cast<uint64_t>(t - prev_tick_));
+            }
+        } else {
+            entry_.rising++;
+            if (contiguous && prev_edge_ == EDGE_FALLING) {
+                sketches_.low.add(static_cast<uint64_t>(t - prev_tick_));
+            }
+            if (have_rising_ && !dropped_since_rising_) {
+                sketches_.period.add(static_cast<uint64_t>(t - rising_tick_));
+            }
+            have_rising_ = true;
+            rising_tick_ = t;
+            dropped_since_rising_ = false;
+        }
+        prev_tick_ = t;
+        prev_edge_ = edge;
+        have_event_ = true;
+    }
+    entry_.last_tick = prev_tick_;
+}
+
+void catalog_builder::summary(const summary_window &w) {
+    if (!have_event_ && entry_.summarised == 0) {
+        entry_.first_tick = w.start;
+    }
+    entry_.summarised += w.edges;
+    entry_.last_tick = std::max(entry_.last_tick, w.end);
+}
+
+void catalog_builder::end_run(const run_info &info) {
+    entry_.event_count = info.event_count;
+    entry_.dropped = info.dropped;
+    entry_.flags = info.truncated ? CATALOG_FLAG_TRUNCATED : 0;
+    entry_.period = reduce(sketches_.period);
+    entry_.high = reduce(sketches_.high);
+    entry_.low = reduce(sketches_.low);
+    entries_.push_back(entry_);
+}
+
+void catalog::add_source(const std::string &path, std::vector<catalog_entry> runs) {
+    std::vector<std::string> paths = sources;
+    if (std::find(paths.begin(), paths.end(), path) == paths.end()) {
+        paths.push_back(path);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    /* Renumber the kept entries into the new source table. */
+    std::vector<catalog_entry> merged;
+    for (const catalog_entry &e : entries) {
+        const std::string &from = sources[e.source];
+        if (from != path) {
+            catalog_entry k = e;
+            k.source = static_cast<uint32_t>(
+                std::lower_bound(paths.begin(), paths.end(), from) - paths.begin());
+            merged.push_back(k);
+        }
+    }
+    const uint32_t index =
+        static_cast<uint32_t>(std::lower_bound(paths.begin(), paths.end(), path) - paths.begin());
+    for (catalog_entry &e : runs) {
+        e.source = index;
+        merged.push_back(e);
+    }
+    std::sort(merged.begin(), merged.end(), [](const catalog_entry &a, const catalog_entry &b) {
+        return a.source != b.source ? a.source < b.source : a.source_offset < b.source_offset;
+    });
+    sources = std::move(paths);
+    entries = std::move(merged);
+}
+
+void write_catalog(const std::string &path, const catalog &c) {
+    std::string table;
+    for (const std::string &s : c.sources) {
+        table.append(s.c_str(), s.size() + 1);
+    }
+
+    catalog_file_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, CATALOG_FILE_MAGIC, sizeof(h.magic));
+    h.version = CATALOG_FILE_VERSION;
+    h.entry_size = sizeof(catalog_entry);
+    h.entry_count = c.entries.size();
+    h.source_count = c.sources.size();
+    h.sources_offset = sizeof(h) + c.entries.size() * sizeof(catalog_entry);
+    h.sources_size = table.size();
+
+    const std::string tmp = path + ".tmp";
+    std::FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        throw std::runtime_error(tmp + ": " + std::strerror(errno));
+    }
+    const bool ok =
+        std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+        std::fwrite(c.entries.data(), sizeof(catalog_entry), c.entries.size(), f) ==
+            c.entries.size() &&
+        std::fwrite(table.data(), 1, table.size(), f) == table.size();
+    const int err = errno;
+
+    if (std::fclose(f) != 0 || !ok) {
+        const int e = ok ? errno : err;
+        std::remove(tmp.c_str());
+        throw std::runtime_error(tmp + ": " + std::strerror(e));
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int e = errno;
+        std::remove(tmp.c_str());
+        throw std::runtime_error(path + ": " + std::strerror(e));
+    }
+}
+
+catalog_file::catalog_file(const std::string &path) : file_(path) {
+    const uint64_t size = file_.size();
+    if (size < sizeof(catalog_file_header)) {
+        throw std::runtime_error(path + ": not a catalog file (too short)");
+    }
+    header_ = reinterpret_cast<const catalog_file_header *>(file_.data());
+    if (std::memcmp(header_->magic, CATALOG_FILE_MAGIC, sizeof(CATALOG_FILE_MAGIC)) != 0 ||
+        header_->version != CATALOG_FILE_VERSION ||
+        header_->entry_size != sizeof(catalog_entry)) {
+        throw std::runtime_error(path + ": not a catalog file (bad magic or version)");
+    }
+    if (header_->entry_count > (size - sizeof(catalog_file_header)) / sizeof(catalog_entry) ||
+        header_->sources_offset != sizeof(catalog_file_header) +
+                                       header_->entry_count * sizeof(catalog_entry) ||
+        header_->sources_size > size - header_->sources_offset) {
+        throw std::runtime_error(path + ": catalog is truncated or corrupt");
+    }
+    entries_ = reinterpret_cast<const catalog_entry *>(file_.data() + sizeof(catalog_file_header));
+
+    const char *p = file_.chars() + header_->sources_offset;
+    const char *end = p + header_->sources_size;
+    while (p < end) {
+        const char *nul = static_cast<const char *>(std::memchr(p, '\0', end - p));
+        if (nul == nullptr) {
+            break;
+        }
+        sources_.emplace_back(p, nul);
+        p = nul + 1;
+    }
+    if (sources_.size() != header_->source_count) {
+        throw std::runtime_error(path + ": catalog source table is corrupt");
+    }
+    for (size_t i = 0; i < header_->entry_count; i++) {
+        if (entries_[i].source >= sources_.size()) {
+            throw std::runtime_error(path + ": catalog entry " + std::to_string(i) +
+                                     " has a bad source");
+        }
+    }
+}
+
+catalog catalog_file::load() const {
+    catalog c;
+    c.sources = sources_;
+    c.entries.assign(entries_, entries_ + size());
+    return c;
+}
+
+std::vector<catalog_condition> parse_catalog_filter(const std::vector<std::string> &terms) {
+    std::vector<catalog_condition> filter;
+    for (const std::string &term : terms) {
+        const size_t at = term.find_first_of("=!<>~");
+        if (at == std::string::npos || at == 0) {
+            throw filter_error(term, "expected <field><op><value>");
+        }
+        catalog_condition c;
+        c.field = parse_field(term, term.substr(0, at));
+
+        size_t value_at = at + 1;
+        const char op = term[at];
+        const bool eq = value_at < term.size() && term[value_at] == '=';
+        if (op == '~') {
+            c.op = CMP_CONTAINS;
+        } else if (op == '=') {
+            c.op = CMP_EQ;
+        } else if (op == '!' && eq) {
+            c.op = CMP_NE;
+        } else if (op == '<') {
+            c.op = eq ? CMP_LE : CMP_LT;
+        } else if (op == '>') {
+            c.op = eq ? CMP_GE : CMP_GT;
+        } else {
+            throw filter_error(term, "unknown operator");
+        }
+        if (op == '!' || ((op == '<' || op == '>') && eq)) {
+            value_at++;
+        }
+        const std::string value = term.substr(value_at);
+
+        if ((c.field == FIELD_SOURCE) != (c.op == CMP_CONTAINS)) {
+            throw filter_error(term, "source takes ~ and only source does");
+        }
+        if (c.op == CMP_CONTAINS) {
+            c.text = value;
+        } else {
+            c.value = parse_value(term, c.field, value);
+        }
+        filter.push_back(c);
+    }
+    return filter;
+}
+
+bool catalog_matches(const std::vector<catalog_condition> &filter, const catalog_entry &e,
+                     const std::string &source) {
+    for (const catalog_condition &c : filter) {
+        if (c.op == CMP_CONTAINS) {
+            if (source.find(c.text) == std::string::npos) {
+                return false;
+            }
+            continue;
+        }
+        double v;
+        if (!field_value(e, c.field, &v)) {
+            return false;
+        }
+        /* Times compare to within a tick's rounding of the stored value. */
+        const double slack = is_time(c.field) ? 1e-12 + std::fabs(c.value) * 1e-9 : 0.0;
+        bool ok = false;
+        switch (c.op) {
+        case CMP_EQ: ok = std::fabs(v - c.value) <= slack; break;
+        case CMP_NE: ok = std::fabs(v - c.value) > slack; break;
+        case CMP_LT: ok = v < c.value - slack; break;
+        case CMP_LE: ok = v <= c.value + slack; break;
+        case CMP_GT: ok = v > c.value + slack; break;
+        case CMP_GE: ok = v >= c.value - slack; break;
+        default: break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace vlog
@@ -0,0 +1,188 @@
+#ifndef VLOG_CATALOG_H
+#define VLOG_CATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+#include "mapped_file.h"
+#include "pulse_stats.h"
+
+namespace vlog {
+
+// Summary of one timing metric, in ticks (saturated to 32 bits).
+struct catalog_timing {
+    uint64_t count;
+    uint32_t min;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+    float mean;
+    float stddev;
+};
+
+static_assert(sizeof(catalog_timing) == 32, "catalog_timing layout changed");
+
+constexpr uint32_t CATALOG_FLAG_TRUNCATED = 1u << 0;
+
+// Everything the catalog records about one run.
+struct catalog_entry {
+    uint32_t source;               // Index into the catalog's source table.
+    uint32_t run_index;
+    uint64_t source_offset;        // Byte offset of the run's `# START`.
+    uint32_t session;
+    uint32_t flags;
+    uint32_t f_cpu;
+    uint32_t baud;
+    uint32_t timer1_prescaler;
+    uint32_t capture_buffer_size;
+    int32_t icnc1;
+    uint32_t reserved0;
+    uint64_t event_count;
+    uint64_t rising;               // Rising edges among the events.
+    uint64_t dropped;
+    uint64_t summarised;           // Edges reported only through `# SUMMARY`.
+    int64_t first_tick;            // First and last event (or summary window).
+    int64_t last_tick;
+    catalog_timing period;
+    catalog_timing high;
+    catalog_timing low;
+};
+
+static_assert(sizeof(catalog_entry) == 192, "catalog_entry layout changed");
+
+// Seconds from the first to the last event; 0 if F_CPU is unknown.
+double catalog_duration(const catalog_entry &e);
+
+/*
+ * Sink that summarises every decoded run into a catalog_entry.
+ *
+ * Intervals are measured as for_each_interval() does, across batch
+ * boundaries, into sketches that are reduced to the entry when the run
+ * ends. Memory use per run in progress is that of three sketches: at
+ * most about 25 KB, and usually well under 1 KB (see timing_sketch).
+ */
+class catalog_builder : public run_sink {
+public:
+    explicit catalog_builder(uint32_t source = 0) : source_(source) {}
+
+    void begin_run(const run_info &info) override;
+    void events(const event_batch &batch) override;
+    void summary(const summary_window &w) override;
+    void end_run(const run_info &info) override;
+
+    // Entries of the runs completed so far, in run order.
+    const std::vector<catalog_entry> &entries() const { return entries_; }
+
+private:
+    uint32_t source_;
+    std::vector<catalog_entry> entries_;
+
+    catalog_entry entry_;
+    interval_sketches sketches_;
+    bool have_event_ = false;
+    int64_t prev_tick_ = 0;
+    uint8_t prev_edge_ = 0;
+    bool have_rising_ = false;
+    int64_t rising_tick_ = 0;
+    bool dropped_since_rising_ = false;
+};
+
+/*
+ * An archive's runs in memory.
+ *
+ * Entries are kept sorted by (source path, source offset); sources are
+ * sorted by path. add_source() replaces whatever the catalog held for a
+ * path, so re-cataloguing a log that has grown updates it in place.
+ */
+struct catalog {
+    std::vector<std::string> sources;
+    std::vector<catalog_entry> entries;
+
+    // Entries' `source` fields are ignored and reassigned.
+    void add_source(const std::string &path, std::vector<catalog_entry> runs);
+};
+
+/*
+ * Catalog file (.vlc):
+ *
+ *   [catalog_file_header, 64 bytes]
+ *   [catalog_entry x entry_count]       sorted as in struct catalog
+ *   [source table: NUL-terminated paths x source_count]
+ *
+ * write_catalog() replaces the file atomically (write and rename), so
+ * readers never see a partial catalog.
+ */
+constexpr char CATALOG_FILE_MAGIC[8] = {'V', 'L', 'O', 'G', 'C', 'A', 'T', '1'};
+constexpr uint32_t CATALOG_FILE_VERSION = 1;
+
+struct catalog_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t entry_count;
+    uint64_t source_count;
+    uint64_t sources_offset;
+    uint64_t sources_size;
+    uint8_t reserved[16];
+};
+
+static_assert(sizeof(catalog_file_header) == 64, "catalog_file_header layout changed");
+
+void write_catalog(const std::string &path, const catalog &c);
+
+// Memory-mapped catalog file; throws std::runtime_error if invalid.
+class catalog_file {
+public:
+    explicit catalog_file(const std::string &path);
+
+    size_t size() const { return static_cast<size_t>(header_->entry_count); }
+    const catalog_entry *entries() const { return entries_; }
+    const std::string &source(uint32_t i) const { return sources_[i]; }
+    size_t source_count() const { return sources_.size(); }
+
+    // A copy to modify and write back.
+    catalog load() const;
+
+private:
+    mapped_file file_;
+    const catalog_file_header *header_ = nullptr;
+    const catalog_entry *entries_ = nullptr;
+    std::vector<std::string> sources_;
+};
+
+/*
+ * Conditions selecting catalog entries, all of which must hold:
+ *
+ *   icnc1=off dropped>0 duration>=10s period_p99<1.05ms source~rig3
+ *
+ * Each is <field><op><value> with op one of = != < <= > >=, or
+ * source~<text> for paths containing text. Fields:
+ *
+ *   run session offset f_cpu baud prescaler buffer icnc1 truncated
+ *   events rising dropped summarised duration
+ *   {period,high,low}_{count,min,p50,p99,max,mean}
+ *
+ * Times (duration and the timing fields) are in seconds and take units
+ * s, ms, us or ns; icnc1 and truncated also accept on/off and yes/no.
+ * A run whose F_CPU is unknown fails every time comparison.
+ */
+struct catalog_condition {
+    uint8_t field = 0;
+    uint8_t op = 0;
+    double value = 0.0;
+    std::string text;              // For source~.
+};
+
+// Throws std::runtime_error describing the first bad condition.
+std::vector<catalog_condition> parse_catalog_filter(const std::vector<std::string> &terms);
+
+bool catalog_matches(const std::vector<catalog_condition> &filter, const catalog_entry &e,
+                     const std::string &source);
+
+}  // namespace vlog
+
+#endif  // VLOG_CATALOG_H
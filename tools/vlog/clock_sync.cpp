@@ -0,0 +1,183 @@
+#include "clock_sync.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "mapped_file.h"
+
+namespace vlog {
+
+namespace {
+
+// Floor on the residual scale: a perfectly regular feed (a file, a pty)
+// must not shrink it to nothing and down-weight every later point.
+constexpr double MIN_SCALE_NS = 1000.0;
+
+// Median absolute deviation to standard deviation, for normal residuals.
+constexpr double MAD_TO_SIGMA = 1.4826;
+
+// Relative step of the running median of |residual|.
+constexpr double SCALE_STEP = 0.05;
+
+// Residual quantile taken as the latency floor, and its step in sigmas.
+constexpr double EDGE_QUANTILE = 0.1;
+constexpr double EDGE_STEP = 0.05;
+
+// UART frames are 8N1: ten bit times per character.
+constexpr double BITS_PER_CHAR = 10.0;
+
+}  // namespace
+
+std::string read_stamps_path(const std::string &log) {
+    const size_t n = log.size();
+    if (n >= 4 && log.compare(n - 4, 4, ".log") == 0) {
+        return log.substr(0, n - 4) + ".time";
+    }
+    return log + ".time";
+}
+
+read_stamps::read_stamps(const std::string &path) {
+    const mapped_file file(path);
+
+    if (file.size() < sizeof(READ_STAMP_MAGIC) ||
+        std::memcmp(file.data(), READ_STAMP_MAGIC, sizeof(READ_STAMP_MAGIC)) != 0) {
+        throw std::runtime_error(path + ": not a read stamp file");
+    }
+    const size_t count = (file.size() - sizeof(READ_STAMP_MAGIC)) / sizeof(read_stamp);
+    stamps_.resize(count);
+    if (count != 0) {
+        std::memcpy(stamps_.data(), file.data() + sizeof(READ_STAMP_MAGIC),
+                    count * sizeof(read_stamp));
+    }
+}
+
+/*
+ * Reads are recorded in log order, so the read that delivered `offset` is
+ * the first whose end lies past it. The one before it gives the start of
+ * the read, so a covering read always has a predecessor; with none (bytes
+ * logged before stamping began, the daemon records a zero-length read when
+ * it opens the log) the offset is not covered.
+ */
+const read_stamp *read_stamps::covering(uint64_t offset) const {
+    if (cursor_ > 0 && stamps_[cursor_ - 1].end > offset) {
+        const auto it = std::upper_bound(
+            stamps_.begin(), stamps_.end(), offset,
+            [](uint64_t off, const read_stamp &s) { return off < s.end; });
+        cursor_ = static_cast<size_t>(it - stamps_.begin());
+    } else {
+        while (cursor_ < stamps_.size() && stamps_[cursor_].end <= offset) {
+            cursor_++;
+        }
+    }
+    return cursor_ > 0 && cursor_ < stamps_.size() ? &stamps_[cursor_] : nullptr;
+}
+
+/* The daemon records a zero-length read whenever it opens the log. */
+bool read_stamps::backlog(const read_stamp *s) const {
+    const size_t i = static_cast<size_t>(s - stamps_.data());
+    return i == 1 || (i > 1 && stamps_[i - 1].end == stamps_[i - 2].end);
+}
+
+clock_fit::clock_fit(double memory) : lambda_(memory > 1.0 ? 1.0 - 1.0 / memory : 0.0) {}
+
+void clock_fit::reset() {
+    const double lambda = lambda_;
+    *this = clock_fit();
+    lambda_ = lambda;
+}
+
+void clock_fit::add(int64_t ticks, int64_t host_ns) {
+    if (points_ == 0) {
+        tick0_ = ticks;
+        host0_ = host_ns;
+    }
+    const double x = static_cast<double>(ticks - tick0_);
+    const double y = static_cast<double>(host_ns - host0_);
+
+    /* Weigh the point against the line so far. The scale is a running
+     * median of |residual| and the edge a running low quantile of the
+     * residual, both by stochastic approximation: fixed steps up or down,
+     * so neither can be dragged far by a burst of late reads. */
+    double w = 1.0;
+    if (points_ >= 2 && cxx_ > 0.0) {
+        const double r = y - (mean_y_ + cxy_ / cxx_ * (x - mean_x_));
+        const double a = std::fabs(r);
+        if (points_ == 2) {
+            scale_ = std::max(a, MIN_SCALE_NS);
+        } else {
+            const double limit = HUBER_K * MAD_TO_SIGMA * scale_;
+            if (a > limit) {
+                w = limit / a;
+                downweighted_++;
+            }
+            edge_ += EDGE_STEP * MAD_TO_SIGMA * scale_ * (EDGE_QUANTILE - (r < edge_ ? 1.0 : 0.0));
+            scale_ = std::max(scale_ * (a > scale_ ? 1.0 + SCALE_STEP : 1.0 - SCALE_STEP),
+                              MIN_SCALE_NS);
+        }
+    }
+
+    weight_ = lambda_ * weight_ + w;
+    const double dx = x - mean_x_;
+    const double dy = y - mean_y_;
+    mean_x_ += w * dx / weight_;
+    mean_y_ += w * dy / weight_;
+    cxx_ = lambda_ * cxx_ + w * dx * (x - mean_x_);
+    cxy_ = lambda_ * cxy_ + w * dx * (y - mean_y_);
+    points_++;
+    slope_ = points_ >= 2 && cxx_ > 0.0 ? cxy_ / cxx_ : 0.0;
+}
+
+/* Called per event by the annotating tools, hence the cached slope. */
+int64_t clock_fit::host_ns(int64_t ticks, double nominal_ns_per_tick) const {
+    const double slope = slope_ != 0.0 ? slope_ : nominal_ns_per_tick;
+    const double x = static_cast<double>(ticks - tick0_);
+    return host0_ + std::llround(mean_y_ + edge_ + slope * (x - mean_x_));
+}
+
+device_clock::device_clock(const read_stamps &stamps, double memory)
+    : stamps_(stamps), fit_(memory) {}
+
+bool device_clock::sync(const sync_point &s) {
+    if (!have_session_ || s.session != session_) {
+        fit_.reset();
+        have_session_ = true;
+        session_ = s.session;
+    }
+
+    const read_stamp *r = s.end > 0 ? stamps_.covering(s.end - 1) : nullptr;
+    if (r == nullptr || stamps_.backlog(r)) {
+        unpaired_++;
+        return false;
+    }
+
+    /* Without F_CPU or BAUD in the header the wire-time corrections are
+     * unknown and left out; the fit then carries them as a fixed offset. */
+    const double rate = s.config.f_cpu != 0 ? tick_rate(s.config) : 0.0;
+    nominal_ns_per_tick_ = rate > 0.0 ? 1e9 / rate : 0.0;
+    double arrival = static_cast<double>(r->mono_ns);
+    double sent = static_cast<double>(s.ticks);
+    if (s.config.baud != 0) {
+        const double char_s = BITS_PER_CHAR / s.config.baud;
+        arrival -= static_cast<double>(r->end - s.end) * char_s * 1e9;
+        sent += s.bytes * char_s * rate;
+    }
+    /* Anything the previous read could have returned, it would have. */
+    arrival = std::max(arrival, static_cast<double>(r[-1].mono_ns));
+
+    real_offset_ = r->real_ns - r->mono_ns;
+    fit_.add(std::llround(sent), std::llround(arrival));
+    return true;
+}
+
+int64_t device_clock::mono_ns(int64_t ticks) const {
+    return fit_.host_ns(ticks, nominal_ns_per_tick_);
+}
+
+double device_clock::error_ppm() const {
+    const double b = fit_.ns_per_tick();
+    return b > 0.0 && nominal_ns_per_tick_ > 0.0 ? (nominal_ns_per_tick_ / b - 1.0) * 1e6 : 0.0;
+}
+
+}  // namespace vlog
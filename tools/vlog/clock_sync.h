@@ -0,0 +1,151 @@
+#ifndef VLOG_CLOCK_SYNC_H
+#define VLOG_CLOCK_SYNC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "log_decoder.h"
+
+namespace vlog {
+
+/*
+ * Host timestamps for a capture.
+ *
+ * capture_daemon writes <name>.time next to <name>.log: the 8-byte magic,
+ * then one record per read() from the device, all little-endian. A record
+ * says that by `mono_ns` the log held `end` bytes; the bytes of that read
+ * arrived at most then.
+ */
+constexpr char READ_STAMP_MAGIC[8] = {'V', 'L', 'O', 'G', 'T', 'I', 'M', '1'};
+
+struct read_stamp {
+    uint64_t end;        // Log offset just past the last byte of the read.
+    int64_t mono_ns;     // CLOCK_MONOTONIC when read() returned.
+    int64_t real_ns;     // CLOCK_REALTIME, sampled right after.
+};
+static_assert(sizeof(read_stamp) == 24, "read_stamp is a file record");
+
+// Where vlog_capture puts the stamps for `log`: ".log" replaced by ".time",
+// or ".time" appended.
+std::string read_stamps_path(const std::string &log);
+
+// The read stamps of one capture, loaded into memory.
+class read_stamps {
+public:
+    // Throws std::runtime_error if the file cannot be read or has no magic.
+    // A trailing partial record (capture killed mid-write) is ignored.
+    explicit read_stamps(const std::string &path);
+
+    size_t size() const { return stamps_.size(); }
+
+    // The read that delivered byte `offset`, or nullptr if none did. Queries
+    // in ascending order cost O(1) each.
+    const read_stamp *covering(uint64_t offset) const;
+
+    // True for the first read after the capture opened the device: it may
+    // return bytes that were queued for any length of time before that.
+    bool backlog(const read_stamp *s) const;
+
+private:
+    std::vector<read_stamp> stamps_;
+    mutable size_t cursor_ = 0;
+};
+
+/*
+ * Running linear fit of host time against device ticks.
+ *
+ * Each point updates exponentially weighted means and co-moments of
+ * (ticks, host ns) in Welford form, so a point costs O(1) and the fit
+ * follows slow oscillator drift with a memory of about `memory` points
+ * without the cancellation of raw sums. Points are weighted Huber-style:
+ * one whose residual exceeds HUBER_K standard deviations (from a running
+ * median of |residual|) counts with proportionally less weight, so a read
+ * delayed by scheduling or USB latency barely moves the line.
+ *
+ * Latency only ever delays a read, so the least-squares line runs late by
+ * the mean latency. host_ns() instead follows the lower edge of the
+ * residuals (a running 10th percentile), which is close to the fastest
+ * path from device to host.
+ */
+class clock_fit {
+public:
+    explicit clock_fit(double memory = 300.0);
+
+    void reset();
+    void add(int64_t ticks, int64_t host_ns);
+
+    // A slope needs two points; with one, host_ns() assumes ns_per_tick
+    // equals the nominal rate passed here (ns per tick from F_CPU).
+    bool valid() const { return points_ > 0; }
+    int64_t host_ns(int64_t ticks, double nominal_ns_per_tick) const;
+
+    size_t points() const { return points_; }
+    size_t downweighted() const { return downweighted_; }
+    double ns_per_tick() const { return slope_; }  // 0 until two points.
+    double residual_ns() const { return scale_; }  // Median |residual|.
+
+    static constexpr double HUBER_K = 3.0;
+
+private:
+    double lambda_;
+    size_t points_ = 0;
+    size_t downweighted_ = 0;
+    int64_t tick0_ = 0;     // Origins keep the doubles small and exact.
+    int64_t host0_ = 0;
+    double weight_ = 0.0;
+    double mean_x_ = 0.0;
+    double mean_y_ = 0.0;
+    double cxx_ = 0.0;
+    double cxy_ = 0.0;
+    double scale_ = 0.0;
+    double edge_ = 0.0;     // Low residual quantile, ns.
+    double slope_ = 0.0;    // cxy_ / cxx_ once defined.
+};
+
+/*
+ * Device-tick to host-clock mapping for one capture.
+ *
+ * Sync records from the decoder are paired with the read that delivered
+ * their last byte. That byte arrived before the read returned by at least
+ * the time the rest of the read took on the wire (but after the previous
+ * read returned), and left the device `bytes` character times after the
+ * sync tick, so each record gives one (ticks, CLOCK_MONOTONIC) point for
+ * clock_fit. The fit restarts with each power-on session. Wall-clock
+ * times apply the CLOCK_REALTIME offset of the latest paired read, so an
+ * NTP step moves later events only.
+ */
+class device_clock {
+public:
+    explicit device_clock(const read_stamps &stamps, double memory = 300.0);
+
+    // Returns false if no read covers the record, or only a backlog read.
+    bool sync(const sync_point &s);
+
+    bool valid() const { return fit_.valid(); }
+    uint32_t session() const { return session_; }
+    int64_t mono_ns(int64_t ticks) const;
+    int64_t real_ns(int64_t ticks) const { return mono_ns(ticks) + real_offset_; }
+    int64_t real_offset_ns() const { return real_offset_; }  // REALTIME - MONOTONIC.
+
+    // Device clock error against the host in parts per million (positive
+    // when the device runs fast); 0 until the fit has a slope.
+    double error_ppm() const;
+
+    const clock_fit &fit() const { return fit_; }
+    uint64_t unpaired() const { return unpaired_; }
+
+private:
+    const read_stamps &stamps_;
+    clock_fit fit_;
+    bool have_session_ = false;
+    uint32_t session_ = 0;
+    double nominal_ns_per_tick_ = 0.0;
+    int64_t real_offset_ = 0;
+    uint64_t unpaired_ = 0;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_CLOCK_SYNC_H
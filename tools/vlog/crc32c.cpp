@@ -0,0 +1,103 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+namespace vlog {
+
+namespace {
+
+/*
+ * Slice-by-8 tables: t[0] is the classic byte-at-a-time table and t[k][b]
+ * is the CRC of byte b followed by k zero bytes, so eight table lookups
+ * advance the CRC over one 64-bit word.
+ */
+struct crc_tables {
+    uint32_t t[8][256];
+
+    crc_tables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1u)));
+            }
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFFu];
+            }
+        }
+    }
+};
+
+const crc_tables &tables() {
+    static const crc_tables tables;
+    return tables;
+}
+
+/* Words are loaded little-endian, as on every host the tools target. */
+uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t n) {
+    const crc_tables &tab = tables();
+
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        w ^= crc;
+        crc = tab.t[7][w & 0xFFu] ^ tab.t[6][(w >> 8) & 0xFFu] ^
+              tab.t[5][(w >> 16) & 0xFFu] ^ tab.t[4][(w >> 24) & 0xFFu] ^
+              tab.t[3][(w >> 32) & 0xFFu] ^ tab.t[2][(w >> 40) & 0xFFu] ^
+              tab.t[1][(w >> 48) & 0xFFu] ^ tab.t[0][w >> 56];
+    }
+    for (; n > 0; p++, n--) {
+        crc = tab.t[0][(crc ^ *p) & 0xFFu] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define VLOG_CRC32C_HW 1
+
+__attribute__((target("sse4.2"))) uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t n) {
+    uint64_t c = crc;
+
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        c = __builtin_ia32_crc32di(c, w);
+    }
+    crc = static_cast<uint32_t>(c);
+    for (; n > 0; p++, n--) {
+        crc = __builtin_ia32_crc32qi(crc, *p);
+    }
+    return crc;
+}
+
+bool have_hw() {
+    static const bool have = __builtin_cpu_supports("sse4.2");
+    return have;
+}
+#else
+#define VLOG_CRC32C_HW 0
+#endif
+
+}  // namespace
+
+uint32_t crc32c(const void *data, size_t len, uint32_t crc) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+#if VLOG_CRC32C_HW
+    if (have_hw()) {
+        return ~crc32c_hw(~crc, p, len);
+    }
+#endif
+    return ~crc32c_sw(~crc, p, len);
+}
+
+bool crc32c_hardware() {
+#if VLOG_CRC32C_HW
+    return have_hw();
+#else
+    return false;
+#endif
+}
+
+}  // namespace vlog
@@ -0,0 +1,142 @@
+#include "fft.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace vlog {
+
+/*
+ * Factor n into radix-4 stages first, then 2, then odd factors in
+ * increasing order; anything left above sqrt(n) is a single prime stage.
+ */
+fft::fft(size_t n) : n_(n) {
+    if (n == 0) {
+        throw std::invalid_argument("fft length must be positive");
+    }
+
+    size_t rest = n;
+    size_t p = 4;
+    do {
+        while (rest % p != 0) {
+            p = p == 4 ? 2 : (p == 2 ? 3 : p + 2);
+            if (p * p > rest) {
+                p = rest;
+            }
+        }
+        rest /= p;
+        factors_.push_back(p);
+        factors_.push_back(rest);
+    } while (rest > 1);
+
+    twiddles_.resize(n);
+    const double step = -2.0 * M_PI / static_cast<double>(n);
+    for (size_t i = 0; i < n; i++) {
+        twiddles_[i] = std::polar(1.0, step * static_cast<double>(i));
+    }
+}
+
+void fft::forward(const complex *in, complex *out) const {
+    work(out, in, 1, factors_.data());
+}
+
+/*
+ * Decimation in time: the p interleaved subsequences of `in` are
+ * transformed into consecutive blocks of `out`, which are then combined
+ * in place by one radix-p butterfly pass.
+ */
+void fft::work(complex *out, const complex *in, size_t stride, const size_t *factors) const {
+    const size_t p = factors[0];
+    const size_t m = factors[1];
+    complex *const end = out + p * m;
+
+    if (m == 1) {
+        for (complex *o = out; o != end; o++, in += stride) {
+            *o = *in;
+        }
+    } else {
+        for (complex *o = out; o != end; o += m, in += stride) {
+            work(o, in, stride * p, factors + 2);
+        }
+    }
+
+    switch (p) {
+    case 2:
+        butterfly2(out, stride, m);
+        break;
+    case 3:
+        butterfly3(out, stride, m);
+        break;
+    case 4:
+        butterfly4(out, stride, m);
+        break;
+    default:
+        butterfly(out, stride, m, p);
+        break;
+    }
+}
+
+void fft::butterfly2(complex *out, size_t stride, size_t m) const {
+    for (size_t k = 0; k < m; k++) {
+        const complex t = out[m + k] * twiddles_[k * stride];
+        out[m + k] = out[k] - t;
+        out[k] += t;
+    }
+}
+
+void fft::butterfly3(complex *out, size_t stride, size_t m) const {
+    const double s = twiddles_[stride * m].imag();   // -sin(2 pi / 3)
+
+    for (size_t k = 0; k < m; k++) {
+        const complex s1 = out[m + k] * twiddles_[k * stride];
+        const complex s2 = out[2 * m + k] * twiddles_[2 * k * stride];
+        const complex sum = s1 + s2;
+        const complex diff = (s1 - s2) * s;
+        const complex mid = out[k] - sum * 0.5;
+
+        out[k] += sum;
+        out[m + k] = complex(mid.real() - diff.imag(), mid.imag() + diff.real());
+        out[2 * m + k] = complex(mid.real() + diff.imag(), mid.imag() - diff.real());
+    }
+}
+
+void fft::butterfly4(complex *out, size_t stride, size_t m) const {
+    for (size_t k = 0; k < m; k++) {
+        const complex s0 = out[m + k] * twiddles_[k * stride];
+        const complex s1 = out[2 * m + k] * twiddles_[2 * k * stride];
+        const complex s2 = out[3 * m + k] * twiddles_[3 * k * stride];
+        const complex a = out[k] + s1;
+        const complex b = out[k] - s1;
+        const complex c = s0 + s2;
+        const complex d = s0 - s2;
+
+        out[k] = a + c;
+        out[2 * m + k] = a - c;
+        out[m + k] = complex(b.real() + d.imag(), b.imag() - d.real());
+        out[3 * m + k] = complex(b.real() - d.imag(), b.imag() + d.real());
+    }
+}
+
+void fft::butterfly(complex *out, size_t stride, size_t m, size_t p) const {
+    std::vector<complex> scratch(p);
+
+    for (size_t u = 0; u < m; u++) {
+        for (size_t q = 0; q < p; q++) {
+            scratch[q] = out[u + q * m];
+        }
+        for (size_t q1 = 0; q1 < p; q1++) {
+            const size_t k = u + q1 * m;
+            size_t tw = 0;
+            complex acc = scratch[0];
+            for (size_t q = 1; q < p; q++) {
+                tw += stride * k;
+                if (tw >= n_) {
+                    tw -= n_;
+                }
+                acc += scratch[q] * twiddles_[tw];
+            }
+            out[k] = acc;
+        }
+    }
+}
+
+}  // namespace vlog
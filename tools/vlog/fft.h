@@ -0,0 +1,42 @@
+#ifndef VLOG_FFT_H
+#define VLOG_FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace vlog {
+
+/*
+ * Forward complex FFT of any length, mixed radix (4, 2, 3, generic).
+ *
+ * The plan holds the factorisation and twiddle table and is immutable
+ * once built, so one plan may be shared by any number of threads. Lengths
+ * with large prime factors work but fall back to O(n * p) butterflies.
+ */
+class fft {
+public:
+    using complex = std::complex<double>;
+
+    explicit fft(size_t n);
+
+    size_t size() const { return n_; }
+
+    // out[k] = sum_j in[j] * exp(-2 pi i j k / n). in and out must not alias.
+    void forward(const complex *in, complex *out) const;
+
+private:
+    void work(complex *out, const complex *in, size_t stride, const size_t *factors) const;
+    void butterfly2(complex *out, size_t stride, size_t m) const;
+    void butterfly3(complex *out, size_t stride, size_t m) const;
+    void butterfly4(complex *out, size_t stride, size_t m) const;
+    void butterfly(complex *out, size_t stride, size_t m, size_t p) const;
+
+    size_t n_;
+    std::vector<size_t> factors_;   // Pairs {radix, remaining length}.
+    std::vector<complex> twiddles_;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_FFT_H
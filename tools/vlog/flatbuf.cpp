@@ -0,0 +1,134 @@
+#include "flatbuf.h"
+
+#include <algorithm>
+
+namespace vlog {
+
+void flatbuf::align(size_t a) {
+    while (buf_.size() % a != 0) {
+        buf_.push_back(0);
+    }
+}
+
+size_t flatbuf::put(const void *data, size_t len) {
+    const size_t pos = buf_.size();
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    buf_.insert(buf_.end(), p, p + len);
+    return pos;
+}
+
+void flatbuf::patch_uoffset(uint32_t at, uint32_t target) {
+    const uint32_t rel = target - at;
+    std::memcpy(&buf_[at], &rel, sizeof(rel));
+}
+
+/*
+ * Lay out a table as [vtable][soffset][fields...] followed by the objects
+ * its reference fields point at.
+ *
+ * Fields are packed widest first so that only the table start ever needs
+ * padding. The vtable precedes the table; the table's leading soffset is
+ * the (positive) distance back to it.
+ */
+uint32_t flatbuf::table(const std::vector<field> &fields) {
+    std::vector<field> sorted(fields);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const field &a, const field &b) { return a.size > b.size; });
+
+    uint16_t slots = 0;
+    uint8_t widest = 4;
+    for (const field &f : fields) {
+        slots = std::max<uint16_t>(slots, static_cast<uint16_t>(f.id + 1));
+        widest = std::max(widest, f.size);
+    }
+
+    std::vector<uint16_t> vtable(2u + slots, 0);
+
+    align(2);
+    const size_t vt_pos = put(vtable.data(), vtable.size() * sizeof(uint16_t));
+
+    align(4);
+    if (widest == 8 && (buf_.size() + 4) % 8 != 0) {
+        align(8);
+        buf_.insert(buf_.end(), 4, 0);
+    }
+    const size_t table_pos = buf_.size();
+    const int32_t soffset = static_cast<int32_t>(table_pos - vt_pos);
+    put(&soffset, sizeof(soffset));
+
+    std::vector<size_t> field_pos(sorted.size());
+    for (size_t i = 0; i < sorted.size(); i++) {
+        align(sorted[i].size);
+        field_pos[i] = put(&sorted[i].scalar, sorted[i].size);
+        vtable[2u + sorted[i].id] = static_cast<uint16_t>(field_pos[i] - table_pos);
+    }
+
+    vtable[0] = static_cast<uint16_t>(vtable.size() * sizeof(uint16_t));
+    vtable[1] = static_cast<uint16_t>(buf_.size() - table_pos);
+    std::memcpy(&buf_[vt_pos], vtable.data(), vtable.size() * sizeof(uint16_t));
+
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (sorted[i].ref) {
+            const uint32_t child = sorted[i].ref(*this);
+            patch_uoffset(static_cast<uint32_t>(field_pos[i]), child);
+        }
+    }
+
+    return static_cast<uint32_t>(table_pos);
+}
+
+uint32_t flatbuf::string(const std::string &s) {
+    align(4);
+    const uint32_t len = static_cast<uint32_t>(s.size());
+    const size_t pos = put(&len, sizeof(len));
+    put(s.data(), s.size());
+    buf_.push_back(0);
+    return static_cast<uint32_t>(pos);
+}
+
+uint32_t flatbuf::table_vector(const std::vector<writer> &elems) {
+    align(4);
+    const uint32_t count = static_cast<uint32_t>(elems.size());
+    const size_t pos = put(&count, sizeof(count));
+    buf_.insert(buf_.end(), elems.size() * sizeof(uint32_t), 0);
+
+    for (size_t i = 0; i < elems.size(); i++) {
+        const uint32_t slot = static_cast<uint32_t>(pos + 4 + i * sizeof(uint32_t));
+        patch_uoffset(slot, elems[i](*this));
+    }
+    return static_cast<uint32_t>(pos);
+}
+
+uint32_t flatbuf::struct_vector(const void *data, size_t elem_size, size_t count, size_t a) {
+    /* The length prefix sits directly before the (aligned) first element. */
+    align(4);
+    while ((buf_.size() + 4) % a != 0) {
+        buf_.insert(buf_.end(), 4, 0);
+    }
+    const uint32_t n = static_cast<uint32_t>(count);
+    const size_t pos = put(&n, sizeof(n));
+    put(data, elem_size * count);
+    return static_cast<uint32_t>(pos);
+}
+
+uint32_t flatbuf::long_vector(const std::vector<int64_t> &values) {
+    return struct_vector(values.data(), sizeof(int64_t), values.size(), sizeof(int64_t));
+}
+
+std::vector<uint8_t> flatbuf::finish(const writer &root) {
+    flatbuf fb;
+    fb.buf_.assign(4, 0);
+    fb.patch_uoffset(0, root(fb));
+    fb.align(8);
+    return std::move(fb.buf_);
+}
+
+flatbuf::writer flatbuf::string_writer(std::string s) {
+    return [s = std::move(s)](flatbuf &fb) { return fb.string(s); };
+}
+
+flatbuf::writer flatbuf::table_writer(std::vector<field> fields) {
+    return [fields = std::move(fields)](flatbuf &fb) { return fb.table(fields); };
+}
+
+}  // namespace vlog
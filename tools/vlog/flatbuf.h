@@ -0,0 +1,80 @@
+#ifndef VLOG_FLATBUF_H
+#define VLOG_FLATBUF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace vlog {
+
+/*
+ * Minimal FlatBuffers encoder.
+ *
+ * Just enough of the wire format to emit Arrow IPC metadata without the
+ * flatc code generator or the FlatBuffers runtime. Objects are written
+ * front to back: a table is laid out first and the objects it refers to
+ * follow it, so every reference is the forward uoffset the format requires.
+ *
+ * Callers describe each object as a `writer` that appends it to the buffer
+ * and returns its position; tables receive their child writers as fields
+ * and patch the references once the children have been written.
+ */
+class flatbuf {
+public:
+    using writer = std::function<uint32_t(flatbuf &)>;
+
+    struct field {
+        uint16_t id;
+        uint8_t size;      // Inline size in bytes (offsets are 4).
+        uint64_t scalar;   // Little-endian scalar value (if not a reference).
+        writer ref;        // Referenced object (if set).
+    };
+
+    template <typename T>
+    static field scalar(uint16_t id, T value) {
+        static_assert(sizeof(T) <= 8, "scalar too wide");
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(T));
+        return field{id, static_cast<uint8_t>(sizeof(T)), bits, nullptr};
+    }
+
+    static field ref(uint16_t id, writer w) {
+        return field{id, 4, 0, std::move(w)};
+    }
+
+    // Append a table built from `fields`; returns its position.
+    uint32_t table(const std::vector<field> &fields);
+
+    // Append a string (length-prefixed, NUL-terminated).
+    uint32_t string(const std::string &s);
+
+    // Append a vector of references to tables.
+    uint32_t table_vector(const std::vector<writer> &elems);
+
+    // Append a vector of inline structs (`count` elements of `elem_size`).
+    uint32_t struct_vector(const void *data, size_t elem_size, size_t count, size_t align);
+
+    // Append a vector of 64-bit scalars.
+    uint32_t long_vector(const std::vector<int64_t> &values);
+
+    // Encode a complete buffer whose root object is produced by `root`.
+    static std::vector<uint8_t> finish(const writer &root);
+
+    // Writer helpers for building nested descriptions.
+    static writer string_writer(std::string s);
+    static writer table_writer(std::vector<field> fields);
+
+private:
+    void align(size_t a);
+    size_t put(const void *data, size_t len);
+    void patch_uoffset(uint32_t at, uint32_t target);
+
+    std::vector<uint8_t> buf_;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_FLATBUF_H
@@ -0,0 +1,502 @@
+#include "ingest.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "binary_log.h"
+#include "log_decoder.h"
+#include "packed_run.h"
+#include "pyramid.h"
+#include "run_file.h"
+
+namespace vlog {
+
+namespace {
+
+// Bytes read from a log per decoder feed.
+constexpr size_t READ_BYTES = 8u << 20;
+
+constexpr const char *LOG_SUFFIX = ".log";
+
+std::runtime_error sys_error(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+bool is_log(const std::string &name) {
+    const size_t n = std::strlen(LOG_SUFFIX);
+    return name.size() > n && name.compare(name.size() - n, n, LOG_SUFFIX) == 0;
+}
+
+bool exists(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+bool newer(const struct stat &a, const struct stat &b) {
+    return a.st_mtim.tv_sec != b.st_mtim.tv_sec ? a.st_mtim.tv_sec > b.st_mtim.tv_sec
+                                                : a.st_mtim.tv_nsec > b.st_mtim.tv_nsec;
+}
+
+/*
+ * Sink for one log: streams new runs to run files and catalogues them.
+ * Runs starting at an offset in `done` are passed over.
+ */
+class ingest_sink : public run_sink {
+public:
+    ingest_sink(const std::string &dir, const std::string &stem, std::set<uint64_t> done)
+        : writer_(dir, stem), done_(std::move(done)) {}
+
+    void begin_run(const run_info &info) override {
+        skip_ = done_.count(info.source_offset) != 0;
+        if (skip_) {
+            skipped_++;
+            return;
+        }
+        writer_.begin_run(info);
+        builder_.begin_run(info);
+    }
+    void events(const event_batch &batch) override {
+        if (!skip_) {
+            writer_.events(batch);
+            builder_.events(batch);
+        }
+    }
+    void summary(const summary_window &w) override {
+        if (!skip_) {
+            builder_.summary(w);
+        }
+    }
+    void end_run(const run_info &info) override {
+        if (skip_) {
+            return;
+        }
+        writer_.end_run(info);
+        builder_.end_run(info);
+        finished_.emplace_back(writer_.paths().back(), builder_.entries().back());
+    }
+
+    // Runs ended since the last call: run file path and catalog entry.
+    std::vector<std::pair<std::string, catalog_entry>> take_finished() {
+        return std::move(finished_);
+    }
+
+    uint64_t skipped() const { return skipped_; }
+
+private:
+    run_file_writer writer_;
+    catalog_builder builder_;
+    std::set<uint64_t> done_;
+    bool skip_ = false;
+    uint64_t skipped_ = 0;
+    std::vector<std::pair<std::string, catalog_entry>> finished_;
+};
+
+}  // namespace
+
+struct ingest_service::tracked_log {
+    std::string path;
+    std::string source;            // Absolute, as catalogued.
+    std::string stem;
+    uint64_t offset = 0;           // Bytes decoded.
+    bool dormant = false;          // Fully catalogued at startup; not yet read.
+    bool finished = false;         // Decoder finished after the writer closed the log.
+    std::set<uint64_t> queued;     // Runs with the workers, by offset.
+    uint64_t skipped = 0;          // Of the sink's, already counted.
+    std::unique_ptr<ingest_sink> sink;
+    // vlog_capture stores what the device sends, text or framed; the
+    // decoder is chosen by the log's first byte, as merge_source does.
+    std::unique_ptr<log_decoder> text;
+    std::unique_ptr<binary_log_decoder> framed;
+};
+
+ingest_service::ingest_service(const std::string &watch_dir, const ingest_options &options)
+    : watch_dir_(watch_dir), options_(options) {
+    if (options_.out_dir.empty()) {
+        options_.out_dir = watch_dir;
+    }
+    catalog_path_ = options_.out_dir + "/catalog.vlc";
+    if (exists(catalog_path_)) {
+        catalog_ = catalog_file(catalog_path_).load();
+        for (const catalog_entry &e : catalog_.entries) {
+            runs_[catalog_.sources[e.source]].push_back(e);
+        }
+    }
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        throw sys_error("inotify_init1");
+    }
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    done_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd_ < 0 || done_fd_ < 0) {
+        const std::runtime_error e = sys_error("eventfd");
+        close(inotify_fd_);
+        close(stop_fd_);
+        close(done_fd_);
+        throw e;
+    }
+    const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_DELETE |
+                          IN_MOVED_FROM | IN_ONLYDIR;
+    if (inotify_add_watch(inotify_fd_, watch_dir.c_str(), mask) < 0) {
+        const std::runtime_error e = sys_error(watch_dir);
+        close(inotify_fd_);
+        close(stop_fd_);
+        close(done_fd_);
+        throw e;
+    }
+}
+
+ingest_service::~ingest_service() {
+    close(done_fd_);
+    close(stop_fd_);
+    close(inotify_fd_);
+}
+
+void ingest_service::stop() {
+    const uint64_t one = 1;
+    const ssize_t r = write(stop_fd_, &one, sizeof(one));
+    (void)r;
+}
+
+void ingest_service::run(bool once, const std::function<void(const std::string &)> &log) {
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < std::max(1u, options_.workers); i++) {
+        workers.emplace_back([this] { worker_loop(); });
+    }
+
+    std::exception_ptr error;
+    try {
+        scan(once);
+        for (;;) {
+            collect(log);
+            if (once && pending_ == 0) {
+                break;
+            }
+
+            pollfd fds[3] = {{stop_fd_, POLLIN, 0}, {done_fd_, POLLIN, 0}, {inotify_fd_, POLLIN, 0}};
+            if (poll(fds, once ? 2 : 3, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw sys_error("poll");
+            }
+            if (fds[0].revents != 0) {
+                break;
+            }
+            uint64_t n;
+            if (read(done_fd_, &n, sizeof(n)) < 0 && errno != EAGAIN) {
+                throw sys_error("eventfd");
+            }
+            if (once || fds[2].revents == 0) {
+                continue;
+            }
+
+            /* Coalesce a burst of events into one update per log. */
+            alignas(inotify_event) char buf[64 * 1024];
+            std::map<std::string, bool> changed;   // Name -> writer closed it.
+            bool rescan = false;
+            for (;;) {
+                const ssize_t r = read(inotify_fd_, buf, sizeof(buf));
+                if (r <= 0) {
+                    if (r < 0 && errno != EAGAIN) {
+                        throw sys_error("inotify");
+                    }
+                    break;
+                }
+                for (ssize_t at = 0; at < r;) {
+                    const inotify_event *ev = reinterpret_cast<const inotify_event *>(buf + at);
+                    at += sizeof(inotify_event) + ev->len;
+                    if ((ev->mask & IN_Q_OVERFLOW) != 0) {
+                        rescan = true;
+                        continue;
+                    }
+                    const std::string name = ev->len > 0 ? ev->name : "";
+                    if (!is_log(name)) {
+                        continue;
+                    }
+                    if ((ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0) {
+                        logs_.erase(name);
+                        changed.erase(name);
+                        continue;
+                    }
+                    changed[name] |= (ev->mask & IN_CLOSE_WRITE) != 0;
+                }
+            }
+            if (rescan) {
+                scan(false);
+            }
+            for (const auto &c : changed) {
+                auto it = logs_.find(c.first);
+                if (it == logs_.end()) {
+                    track(c.first, false, c.second);
+                } else {
+                    update(*it->second, c.second);
+                }
+            }
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        workers_stop_ = true;
+    }
+    ready_.notify_all();
+    for (std::thread &t : workers) {
+        t.join();
+    }
+    collect(log);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ingest_service::scan(bool closed) {
+    DIR *d = opendir(watch_dir_.c_str());
+    if (d == nullptr) {
+        throw sys_error(watch_dir_);
+    }
+    std::vector<std::string> names;
+    while (const dirent *e = readdir(d)) {
+        if (is_log(e->d_name)) {
+            names.push_back(e->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    for (const std::string &name : names) {
+        auto it = logs_.find(name);
+        if (it == logs_.end()) {
+            track(name, true, closed);
+        } else {
+            update(*it->second, closed);
+        }
+    }
+}
+
+void ingest_service::track(const std::string &name, bool startup, bool closed) {
+    std::unique_ptr<tracked_log> l(new tracked_log);
+    l->path = watch_dir_ + "/" + name;
+    l->stem = name.substr(0, name.size() - std::strlen(LOG_SUFFIX));
+    char buf[PATH_MAX];
+    if (realpath(l->path.c_str(), buf) == nullptr) {
+        return;  // Gone already.
+    }
+    l->source = buf;
+
+    /* Logs the catalog already covers are left alone until they change. */
+    struct stat log_st;
+    struct stat catalog_st;
+    if (startup && runs_.count(l->source) != 0 && stat(l->path.c_str(), &log_st) == 0 &&
+        stat(catalog_path_.c_str(), &catalog_st) == 0 && !newer(log_st, catalog_st)) {
+        l->dormant = true;
+        l->offset = static_cast<uint64_t>(log_st.st_size);
+    }
+    tracked_log &ref = *l;
+    logs_[name] = std::move(l);
+    if (!ref.dormant) {
+        update(ref, closed);
+    }
+}
+
+void ingest_service::restart(tracked_log &l) {
+    /* Runs whose files are still there need not be written again, except
+     * a last one cut short by the end of the log. */
+    std::set<uint64_t> done = l.queued;
+    const std::vector<catalog_entry> &runs = runs_[l.source];
+    uint64_t last = 0;
+    for (const catalog_entry &e : runs) {
+        last = std::max(last, e.source_offset);
+    }
+    for (const catalog_entry &e : runs) {
+        const bool cut = (e.flags & CATALOG_FLAG_TRUNCATED) != 0 && e.source_offset == last;
+        if (!cut && exists(run_file_path(options_.out_dir, l.stem, e.run_index))) {
+            done.insert(e.source_offset);
+        }
+    }
+    if (l.sink) {
+        stats_.restarts++;
+    }
+    l.text.reset();
+    l.framed.reset();
+    l.sink.reset(new ingest_sink(options_.out_dir, l.stem, std::move(done)));
+    l.offset = 0;
+    l.skipped = 0;
+    l.dormant = false;
+    l.finished = false;
+}
+
+void ingest_service::update(tracked_log &l, bool closed) {
+    const int fd = open(l.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;  // Removed; the delete event drops it.
+    }
+    try {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            throw sys_error(l.path);
+        }
+        const uint64_t size = static_cast<uint64_t>(st.st_size);
+        if (l.dormant && size == l.offset) {
+            close(fd);
+            return;
+        }
+        if (!l.sink || size < l.offset || (size > l.offset && l.finished)) {
+            restart(l);
+        }
+
+        std::vector<char> buf(static_cast<size_t>(std::min<uint64_t>(size - l.offset, READ_BYTES)));
+        while (l.offset < size) {
+            const size_t want = static_cast<size_t>(std::min<uint64_t>(size - l.offset, buf.size()));
+            const ssize_t r = pread(fd, buf.data(), want, static_cast<off_t>(l.offset));
+            if (r < 0) {
+                throw sys_error(l.path);
+            }
+            if (r == 0) {
+                break;
+            }
+            if (!l.text && !l.framed) {
+                if (buf[0] == 0) {
+                    l.framed.reset(new binary_log_decoder(*l.sink));
+                } else {
+                    l.text.reset(new log_decoder(*l.sink));
+                }
+            }
+            if (l.framed) {
+                l.framed->feed(buf.data(), static_cast<size_t>(r));
+            } else {
+                l.text->feed(buf.data(), static_cast<size_t>(r));
+            }
+            l.offset += static_cast<uint64_t>(r);
+            stats_.bytes += static_cast<uint64_t>(r);
+        }
+        if (closed && !l.finished) {
+            if (l.framed) {
+                l.framed->finish();
+            } else if (l.text) {
+                l.text->finish();
+            }
+            l.finished = true;
+        }
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+
+    stats_.skipped += l.sink->skipped() - l.skipped;
+    l.skipped = l.sink->skipped();
+    for (auto &f : l.sink->take_finished()) {
+        l.queued.insert(f.second.source_offset);
+        submit(job{l.source, l.stem, f.first, f.second, std::string()});
+    }
+}
+
+void ingest_service::submit(job j) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(j));
+        pending_++;
+    }
+    ready_.notify_one();
+}
+
+void ingest_service::worker_loop() {
+    for (;;) {
+        job j;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [&] { return !queue_.empty() || workers_stop_; });
+            if (queue_.empty()) {
+                return;
+            }
+            j = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        try {
+            const run_file run(j.run_path);
+            if (options_.pack) {
+                packed_run_writer packer(options_.out_dir, j.stem);
+                replay_run_file(run, packer);
+            }
+            if (options_.pyramid) {
+                const pyramid p = build_pyramid(run.ticks(), run.edge(), run.gap(), run.size());
+                write_pyramid(pyramid_path_for(j.run_path), p);
+            }
+        } catch (const std::exception &e) {
+            j.error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.push_back(std::move(j));
+        }
+        const uint64_t one = 1;
+        const ssize_t r = write(done_fd_, &one, sizeof(one));
+        (void)r;
+    }
+}
+
+/*
+ * Catalogue the runs the workers have finished. The catalog is rewritten
+ * once per batch, on this thread only.
+ */
+void ingest_service::collect(const std::function<void(const std::string &)> &log) {
+    std::deque<job> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done.swap(done_);
+        pending_ -= done.size();
+    }
+
+    bool changed = false;
+    for (const job &j : done) {
+        for (auto &l : logs_) {
+            if (l.second->source == j.source) {
+                l.second->queued.erase(j.entry.source_offset);
+            }
+        }
+        if (!j.error.empty()) {
+            stats_.errors++;
+            log(j.run_path + ": " + j.error);
+            continue;
+        }
+        std::vector<catalog_entry> &runs = runs_[j.source];
+        auto it = std::find_if(runs.begin(), runs.end(), [&](const catalog_entry &e) {
+            return e.source_offset == j.entry.source_offset;
+        });
+        if (it != runs.end()) {
+            *it = j.entry;
+        } else {
+            runs.push_back(j.entry);
+        }
+        catalog_.add_source(j.source, runs);
+        stats_.runs++;
+        changed = true;
+        log(j.run_path);
+    }
+    if (changed) {
+        write_catalog(catalog_path_, catalog_);
+    }
+}
+
+}  // namespace vlog
@@ -0,0 +1,115 @@
+#ifndef VLOG_INGEST_H
+#define VLOG_INGEST_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "catalog.h"
+
+namespace vlog {
+
+struct ingest_options {
+    std::string out_dir;             // Outputs and catalog; empty = the watched directory.
+    unsigned workers = 1;            // Threads packing and summarising finished runs.
+    bool pack = true;                // Write .vlz (compressed, with the block time index).
+    bool pyramid = true;             // Write .vlp min/max pyramids.
+};
+
+struct ingest_stats {
+    uint64_t bytes = 0;              // Log bytes decoded.
+    uint64_t runs = 0;               // Runs completed and catalogued.
+    uint64_t skipped = 0;            // Runs found already catalogued.
+    uint64_t restarts = 0;           // Logs decoded again from the start.
+    uint64_t errors = 0;
+};
+
+/*
+ * Incremental ingest of the raw logs in one directory.
+ *
+ * Every *.log in the directory (as written by vlog_capture, text or
+ * framed as its first byte says) is decoded as
+ * it grows: inotify reports writes and only the bytes appended since the
+ * last read are fed to the log's decoder. Each run is streamed to
+ * <out_dir>/<log>_NNNN.vlr while it is logged; once it ends, a bounded
+ * pool of `workers` threads writes its .vlz and .vlp next to it, and the
+ * run is then added to <out_dir>/catalog.vlc. Decoding runs on the
+ * calling thread, so ingest keeps at most workers + 1 threads busy.
+ *
+ * Runs already in the catalog are not produced again. At startup a log
+ * that the catalog covers and that has not changed since the catalog was
+ * written is not read at all until it next grows; decoding then starts
+ * from the beginning of the log (the decoder's tick extension needs the
+ * whole stream) but only new runs are written. A log that is closed by
+ * its writer is finished, so a run cut short without `# STOP` is written
+ * as truncated, and replaced if the log grows again. A log that shrinks
+ * is decoded again from the start.
+ */
+class ingest_service {
+public:
+    ingest_service(const std::string &watch_dir, const ingest_options &options);
+    ~ingest_service();
+
+    ingest_service(const ingest_service &) = delete;
+    ingest_service &operator=(const ingest_service &) = delete;
+
+    // Process changes until stop(), calling log for each completed run or
+    // error. With once, ingest the existing logs as if their writers had
+    // closed them, and return when done.
+    void run(bool once, const std::function<void(const std::string &)> &log);
+
+    // Request run() to return. Async-signal-safe.
+    void stop();
+
+    const ingest_stats &stats() const { return stats_; }
+
+private:
+    struct tracked_log;
+
+    // A finished run for the workers, then back with any error.
+    struct job {
+        std::string source;
+        std::string stem;
+        std::string run_path;
+        catalog_entry entry;
+        std::string error;
+    };
+
+    void scan(bool closed);
+    void track(const std::string &name, bool startup, bool closed);
+    void update(tracked_log &l, bool closed);
+    void restart(tracked_log &l);
+    void submit(job j);
+    void worker_loop();
+    void collect(const std::function<void(const std::string &)> &log);
+
+    std::string watch_dir_;
+    ingest_options options_;
+    int inotify_fd_ = -1;
+    int stop_fd_ = -1;
+    int done_fd_ = -1;               // Signalled by workers as jobs finish.
+    ingest_stats stats_;
+
+    std::map<std::string, std::unique_ptr<tracked_log>> logs_;
+    catalog catalog_;
+    std::map<std::string, std::vector<catalog_entry>> runs_;   // Catalogued, by source.
+    std::string catalog_path_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<job> queue_;
+    std::deque<job> done_;
+    size_t pending_ = 0;
+    bool workers_stop_ = false;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_INGEST_H
@@ -0,0 +1,70 @@
+#ifndef VLOG_INTERVALS_H
+#define VLOG_INTERVALS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "capture_run.h"
+
+namespace vlog {
+
+// Pulse timing measurements derived from consecutive edges.
+enum interval_kind : uint8_t {
+    INTERVAL_HIGH,    // Rising edge to the following falling edge.
+    INTERVAL_LOW,     // Falling edge to the following rising edge.
+    INTERVAL_PERIOD,  // Rising edge to the next rising edge.
+};
+
+/*
+ * Walk events [begin, end) and report every interval that ends there as
+ * fn(kind, end_index, length_ticks).
+ *
+ * An interval is only measured when no events were dropped inside it (gap
+ * is zero on every event after its start), since a lost edge would make
+ * the measurement meaningless. Events before `begin` are read to recover
+ * the interval state, so splitting a run into ranges and walking each one
+ * independently yields exactly the intervals of a single walk.
+ */
+template <typename Fn>
+void for_each_interval(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                       size_t begin, size_t end, Fn &&fn) {
+    size_t rising = SIZE_MAX;
+    bool dropped_since_rising = false;
+
+    for (size_t j = begin; j > 0; j--) {
+        if (edge[j - 1] == EDGE_RISING) {
+            rising = j - 1;
+            break;
+        }
+    }
+    if (rising != SIZE_MAX) {
+        for (size_t j = rising + 1; j < begin; j++) {
+            dropped_since_rising |= gap[j] != 0;
+        }
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        const bool contiguous = i > 0 && gap[i] == 0;
+        dropped_since_rising |= gap[i] != 0;
+
+        if (edge[i] == EDGE_FALLING) {
+            if (contiguous && edge[i - 1] == EDGE_RISING) {
+                fn(INTERVAL_HIGH, i, ticks[i] - ticks[i - 1]);
+            }
+            continue;
+        }
+
+        if (contiguous && edge[i - 1] == EDGE_FALLING) {
+            fn(INTERVAL_LOW, i, ticks[i] - ticks[i - 1]);
+        }
+        if (rising != SIZE_MAX && !dropped_since_rising) {
+            fn(INTERVAL_PERIOD, i, ticks[i] - ticks[rising]);
+        }
+        rising = i;
+        dropped_since_rising = false;
+    }
+}
+
+}  // namespace vlog
+
+#endif  // VLOG_INTERVALS_H
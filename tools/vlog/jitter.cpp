@@ -0,0 +1,239 @@
+#include "jitter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace vlog {
+
+namespace {
+
+/*
+ * Sum of squared overlapping second differences x[i+2m] - 2x[i+m] + x[i]
+ * for i in [0, count). With Masked, w[i] is 1 where the cycle was observed
+ * and 0 where it was lost, and only terms with all three samples present
+ * are counted.
+ *
+ * Four independent accumulators keep the loop free of a serial dependency
+ * so the compiler can vectorise it without reassociating floating point.
+ */
+template <bool Masked>
+void second_differences(const double *x, const double *w, size_t count, size_t m, double &sum,
+                        double &terms) {
+    double s[4] = {0.0, 0.0, 0.0, 0.0};
+    double c[4] = {0.0, 0.0, 0.0, 0.0};
+    const double *x1 = x + m;
+    const double *x2 = x + 2 * m;
+    const double *w1 = Masked ? w + m : nullptr;
+    const double *w2 = Masked ? w + 2 * m : nullptr;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        for (size_t l = 0; l < 4; l++) {
+            const double d = x2[i + l] - 2.0 * x1[i + l] + x[i + l];
+            if (Masked) {
+                const double v = w[i + l] * w1[i + l] * w2[i + l];
+                s[l] += v * d * d;
+                c[l] += v;
+            } else {
+                s[l] += d * d;
+            }
+        }
+    }
+    for (; i < count; i++) {
+        const double d = x2[i] - 2.0 * x1[i] + x[i];
+        const double v = Masked ? w[i] * w1[i] * w2[i] : 1.0;
+        s[0] += v * d * d;
+        c[0] += v;
+    }
+
+    sum = (s[0] + s[1]) + (s[2] + s[3]);
+    terms = Masked ? (c[0] + c[1]) + (c[2] + c[3]) : static_cast<double>(count);
+}
+
+std::vector<uint64_t> tau_multipliers(uint64_t cycles, unsigned per_octave) {
+    std::vector<uint64_t> ms;
+    const uint64_t limit = (cycles - 1) / 3;
+    per_octave = std::max(1u, per_octave);
+
+    for (unsigned j = 0;; j++) {
+        const double m = std::round(std::exp2(static_cast<double>(j) / per_octave));
+        if (m > static_cast<double>(limit)) {
+            break;
+        }
+        if (ms.empty() || static_cast<uint64_t>(m) != ms.back()) {
+            ms.push_back(static_cast<uint64_t>(m));
+        }
+    }
+    return ms;
+}
+
+}  // namespace
+
+jitter_report analyse_jitter(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                             size_t n, double tick_rate, const jitter_options &options) {
+    jitter_report r;
+
+    /* Selected edges, and whether each follows the previous without drops. */
+    std::vector<int64_t> t;
+    std::vector<uint8_t> contiguous;
+    bool dropped = true;
+    for (size_t i = 0; i < n; i++) {
+        dropped |= gap[i] != 0;
+        if (edge[i] == options.edge) {
+            t.push_back(ticks[i]);
+            contiguous.push_back(!dropped);
+            dropped = false;
+        }
+    }
+    if (t.size() < 3) {
+        throw std::runtime_error("too few edges for jitter analysis");
+    }
+    r.edges = t.size();
+
+    /* Period and cycle-to-cycle jitter from directly measured periods. */
+    int64_t period_sum = 0;
+    r.period_min = INT64_MAX;
+    r.period_max = INT64_MIN;
+    for (size_t k = 1; k < t.size(); k++) {
+        if (contiguous[k]) {
+            const int64_t p = t[k] - t[k - 1];
+            period_sum += p;
+            r.period_min = std::min(r.period_min, p);
+            r.period_max = std::max(r.period_max, p);
+            r.periods++;
+        }
+    }
+    if (r.periods == 0) {
+        throw std::runtime_error("no complete periods for jitter analysis");
+    }
+    r.period_mean = static_cast<double>(period_sum) / static_cast<double>(r.periods);
+
+    double period_m2 = 0.0;
+    double c2c_sq = 0.0;
+    for (size_t k = 1; k < t.size(); k++) {
+        if (!contiguous[k]) {
+            continue;
+        }
+        const int64_t p = t[k] - t[k - 1];
+        const double d = static_cast<double>(p) - r.period_mean;
+        period_m2 += d * d;
+        if (k >= 2 && contiguous[k - 1]) {
+            const int64_t c2c = p - (t[k - 1] - t[k - 2]);
+            c2c_sq += static_cast<double>(c2c) * static_cast<double>(c2c);
+            r.c2c_max = std::max(r.c2c_max, c2c < 0 ? -c2c : c2c);
+            r.c2c_count++;
+        }
+    }
+    r.period_rms = r.periods > 1 ? std::sqrt(period_m2 / static_cast<double>(r.periods - 1)) : 0.0;
+    r.c2c_rms = r.c2c_count > 0 ? std::sqrt(c2c_sq / static_cast<double>(r.c2c_count)) : 0.0;
+
+    /* Cycle numbers, estimating cycles lost across drops. */
+    std::vector<uint64_t> cycle(t.size());
+    for (size_t k = 1; k < t.size(); k++) {
+        uint64_t step = 1;
+        if (!contiguous[k]) {
+            const double est = std::round(static_cast<double>(t[k] - t[k - 1]) / r.period_mean);
+            step = est > 1.0 ? static_cast<uint64_t>(est) : 1;
+        }
+        cycle[k] = cycle[k - 1] + step;
+    }
+    r.cycles = cycle.back() + 1;
+
+    /* Least-squares ideal clock, on ticks relative to the first edge. */
+    double mean_k = 0.0;
+    double mean_t = 0.0;
+    for (size_t k = 0; k < t.size(); k++) {
+        mean_k += static_cast<double>(cycle[k]);
+        mean_t += static_cast<double>(t[k] - t[0]);
+    }
+    mean_k /= static_cast<double>(t.size());
+    mean_t /= static_cast<double>(t.size());
+
+    double skk = 0.0;
+    double skt = 0.0;
+    for (size_t k = 0; k < t.size(); k++) {
+        const double dk = static_cast<double>(cycle[k]) - mean_k;
+        skk += dk * dk;
+        skt += dk * (static_cast<double>(t[k] - t[0]) - mean_t);
+    }
+    r.ideal_period = skt / skk;
+    r.frequency_hz = r.ideal_period > 0.0 ? tick_rate / r.ideal_period : 0.0;
+
+    /* TIE, laid out densely by cycle number for the Allan deviation. */
+    const bool masked = r.cycles != t.size();
+    std::vector<double> x(r.cycles, 0.0);
+    std::vector<double> w(masked ? r.cycles : 0, 0.0);
+    double tie_sq = 0.0;
+    r.tie_min = HUGE_VAL;
+    r.tie_max = -HUGE_VAL;
+    for (size_t k = 0; k < t.size(); k++) {
+        const double ideal = mean_t + (static_cast<double>(cycle[k]) - mean_k) * r.ideal_period;
+        const double tie = static_cast<double>(t[k] - t[0]) - ideal;
+        tie_sq += tie * tie;
+        r.tie_min = std::min(r.tie_min, tie);
+        r.tie_max = std::max(r.tie_max, tie);
+        x[cycle[k]] = tie;
+        if (masked) {
+            w[cycle[k]] = 1.0;
+        }
+    }
+    r.tie_rms = std::sqrt(tie_sq / static_cast<double>(t.size()));
+
+    /* Overlapping Allan deviation; workers claim tau values in turn. */
+    const std::vector<uint64_t> ms = tau_multipliers(r.cycles, options.taus_per_octave);
+    r.adev.resize(ms.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::exception_ptr> errors(std::max(1u, options.threads));
+
+    const auto work = [&](unsigned id) {
+        try {
+            for (size_t j = next++; j < ms.size(); j = next++) {
+                const size_t m = ms[j];
+                const size_t count = x.size() - 2 * m;
+                double sum = 0.0;
+                double terms = 0.0;
+                if (masked) {
+                    second_differences<true>(x.data(), w.data(), count, m, sum, terms);
+                } else {
+                    second_differences<false>(x.data(), nullptr, count, m, sum, terms);
+                }
+
+                allan_point &p = r.adev[j];
+                const double tau_ticks = static_cast<double>(m) * r.ideal_period;
+                p.m = m;
+                p.tau_s = tau_ticks / tick_rate;
+                p.terms = static_cast<uint64_t>(terms);
+                p.adev = terms > 0.0 ? std::sqrt(sum / (2.0 * terms)) / tau_ticks : 0.0;
+            }
+        } catch (...) {
+            errors[id] = std::current_exception();
+        }
+    };
+
+    const unsigned threads =
+        static_cast<unsigned>(std::min<size_t>(errors.size(), std::max<size_t>(1, ms.size())));
+    if (threads == 1) {
+        work(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (unsigned i = 0; i < threads; i++) {
+            pool.emplace_back(work, i);
+        }
+        for (std::thread &th : pool) {
+            th.join();
+        }
+    }
+    for (const std::exception_ptr &e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+
+    return r;
+}
+
+}  // namespace vlog
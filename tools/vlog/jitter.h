@@ -0,0 +1,71 @@
+#ifndef VLOG_JITTER_H
+#define VLOG_JITTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "capture_run.h"
+
+namespace vlog {
+
+struct jitter_options {
+    uint8_t edge = EDGE_RISING;       // Edge polarity treated as the clock.
+    unsigned taus_per_octave = 1;     // Allan deviation tau density.
+    unsigned threads = 1;
+};
+
+// Overlapping Allan deviation at tau = m ideal periods.
+struct allan_point {
+    uint64_t m;
+    double tau_s;
+    double adev;
+    uint64_t terms;    // Second differences that contributed.
+};
+
+/*
+ * Clock quality of one run. Times are in Timer1 ticks unless suffixed _s.
+ *
+ * Each selected edge is assigned a cycle number: consecutive edges with no
+ * drops between them are one cycle apart, and across a drop the number of
+ * missed cycles is estimated from the mean period. The ideal clock is the
+ * least-squares line through (cycle, tick), and the time-interval error
+ * (TIE) is each edge's deviation from it.
+ */
+struct jitter_report {
+    uint64_t edges = 0;             // Selected edges analysed.
+    uint64_t cycles = 0;            // Cycle span covered by them.
+    double ideal_period = 0.0;      // Fitted period.
+    double frequency_hz = 0.0;
+    double tie_rms = 0.0;
+    double tie_min = 0.0;
+    double tie_max = 0.0;
+
+    uint64_t periods = 0;           // Directly measured periods.
+    double period_mean = 0.0;
+    double period_rms = 0.0;        // Standard deviation: RMS period jitter.
+    int64_t period_min = 0;
+    int64_t period_max = 0;
+
+    uint64_t c2c_count = 0;         // Adjacent period pairs.
+    double c2c_rms = 0.0;
+    int64_t c2c_max = 0;            // Largest absolute period change.
+
+    std::vector<allan_point> adev;
+};
+
+/*
+ * Analyse the edges of one run, whose Timer1 ticks run at `tick_rate` per
+ * second (tick_rate() of its config). Allan deviation is computed from the TIE
+ * sequence at roughly `taus_per_octave` log-spaced tau values per octave
+ * up to a third of the cycle span, spread across `threads` workers.
+ *
+ * Throws std::runtime_error if the run holds fewer than three selected
+ * edges or no complete period.
+ */
+jitter_report analyse_jitter(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                             size_t n, double tick_rate, const jitter_options &options = {});
+
+}  // namespace vlog
+
+#endif  // VLOG_JITTER_H
@@ -0,0 +1,225 @@
+#include "live_source.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace vlog {
+
+namespace {
+
+constexpr size_t READ_CHUNK = 256 * 1024;
+constexpr size_t RING_SLICE = 4096;
+
+// Poll period while caught up; neither a grown file nor the ring wakes us.
+constexpr auto IDLE_SLEEP = std::chrono::milliseconds(2);
+constexpr auto FOLLOW_SLEEP = std::chrono::milliseconds(50);
+
+}  // namespace
+
+log_source::log_source(const std::string &path, run_sink &sink, bool follow)
+    : sink_(sink), follow_(follow), buf_(new char[READ_CHUNK]) {
+    if (path == "-") {
+        fd_ = STDIN_FILENO;
+        return;
+    }
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd_ < 0) {
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+    }
+    owned_ = true;
+    /* A serial device is read as is, at the baud rate it was left at. */
+    termios tio;
+    if (tcgetattr(fd_, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd_, TCSANOW, &tio);
+    }
+}
+
+log_source::~log_source() {
+    if (owned_) {
+        close(fd_);
+    }
+}
+
+bool log_source::pump(clock::time_point deadline) {
+    if (finished_) {
+        return false;
+    }
+    for (;;) {
+        const auto now = clock::now();
+        if (now >= deadline) {
+            return true;
+        }
+        pollfd p = {fd_, POLLIN, 0};
+        const int ms = static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1);
+        if (poll(&p, 1, ms) <= 0) {
+            continue;
+        }
+        const ssize_t n = read(fd_, buf_.get(), READ_CHUNK);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            throw std::runtime_error(std::string("read: ") + std::strerror(errno));
+        }
+        if (n == 0) {
+            if (!follow_) {
+                finish();
+                return false;
+            }
+            std::this_thread::sleep_until(std::min(deadline, now + FOLLOW_SLEEP));
+            continue;
+        }
+        feed(buf_.get(), static_cast<size_t>(n));
+    }
+}
+
+void log_source::finish() {
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    if (framed_) {
+        framed_->finish();
+    } else if (text_) {
+        text_->finish();
+    }
+}
+
+const decode_stats *log_source::decode() const {
+    return framed_ ? &framed_->records() : text_ ? &text_->stats() : nullptr;
+}
+
+const binary_log_stats *log_source::framing() const {
+    return framed_ ? &framed_->stats() : nullptr;
+}
+
+void log_source::feed(const char *data, size_t len) {
+    if (!framed_ && !text_) {
+        if (data[0] == '\0') {
+            framed_.reset(new binary_log_decoder(sink_));
+        } else {
+            text_.reset(new log_decoder(sink_));
+        }
+    }
+    if (framed_) {
+        framed_->feed(data, len);
+    } else {
+        text_->feed(data, len);
+    }
+}
+
+ring_source::ring_source(const std::string &name, run_sink &sink, bool from_start)
+    : ring_("/vlog." + name, from_start), sink_(sink), buf_(RING_SLICE) {
+    ticks_.reserve(RING_SLICE);
+    edge_.reserve(RING_SLICE);
+    gap_.reserve(RING_SLICE);
+}
+
+bool ring_source::pump(clock::time_point deadline) {
+    while (clock::now() < deadline) {
+        /* Check before reading so the final records are not missed. */
+        const bool closed = ring_.closed();
+        const size_t n = ring_.read(buf_.data(), buf_.size());
+        apply(buf_.data(), n);
+        if (n == 0) {
+            if (closed) {
+                finish();
+                return false;
+            }
+            std::this_thread::sleep_for(IDLE_SLEEP);
+        }
+    }
+    return true;
+}
+
+void ring_source::finish() {
+    flush();
+    if (in_run_) {
+        info_.truncated = true;
+        sink_.end_run(info_);
+        in_run_ = false;
+    }
+}
+
+run_config ring_source::header_config() const {
+    const shm_ring_header &h = ring_.header();
+    run_config c;
+    c.f_cpu = h.f_cpu.load(std::memory_order_relaxed);
+    c.baud = h.baud.load(std::memory_order_relaxed);
+    c.capture_buffer_size = h.buffer_size.load(std::memory_order_relaxed);
+    return c;
+}
+
+void ring_source::begin(uint32_t run, uint32_t session) {
+    info_ = run_info();
+    info_.config = header_config();
+    info_.index = run;
+    info_.session = session;
+    in_run_ = true;
+    sink_.begin_run(info_);
+}
+
+void ring_source::apply(const live_event *e, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        switch (e[i].kind) {
+        case LIVE_EVENT:
+            if (!in_run_) {
+                begin(e[i].run, e[i].session);
+            }
+            ticks_.push_back(e[i].ticks);
+            edge_.push_back(e[i].edge);
+            gap_.push_back(e[i].gap);
+            info_.event_count++;
+            info_.dropped += e[i].gap;
+            break;
+        case LIVE_BEGIN_RUN:
+            finish();
+            begin(e[i].run, e[i].session);
+            break;
+        case LIVE_END_RUN:
+            flush();
+            if (in_run_) {
+                info_.event_count = static_cast<uint64_t>(e[i].ticks);
+                info_.truncated = e[i].edge != 0;
+                sink_.end_run(info_);
+                in_run_ = false;
+            }
+            break;
+        case LIVE_STATUS: {
+            flush();
+            status_record s;
+            s.ticks = e[i].ticks;
+            s.ring_high_water = static_cast<uint16_t>(e[i].run);
+            s.dropped = e[i].gap;
+            s.config = header_config();
+            sink_.status(s);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    flush();
+}
+
+void ring_source::flush() {
+    if (ticks_.empty()) {
+        return;
+    }
+    sink_.events(event_batch{ticks_.data(), edge_.data(), gap_.data(), ticks_.size()});
+    ticks_.clear();
+    edge_.clear();
+    gap_.clear();
+}
+
+}  // namespace vlog
@@ -0,0 +1,106 @@
+#ifndef VLOG_LIVE_SOURCE_H
+#define VLOG_LIVE_SOURCE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binary_log.h"
+#include "log_decoder.h"
+#include "shm_ring.h"
+
+namespace vlog {
+
+/*
+ * A live input for monitors: delivers decoded runs to a run_sink as they
+ * arrive, a slice at a time, so the caller can interleave its own work
+ * (redraws, timeouts) between slices.
+ */
+class live_source {
+public:
+    using clock = std::chrono::steady_clock;
+
+    virtual ~live_source() = default;
+
+    // Deliver what arrives before `deadline`. Returns false once the input
+    // has ended, after closing any open run.
+    virtual bool pump(clock::time_point deadline) = 0;
+
+    // Close an open run as truncated, when stopping before the input ends.
+    virtual void finish() = 0;
+};
+
+/*
+ * A log as it is written: a file, FIFO, serial device, or "-" for stdin.
+ * Text and framed logs are told apart by the first byte (a framed log
+ * starts with its delimiter). At end of input the source ends, unless
+ * `follow` is set, in which case it waits for the file to grow.
+ * Throws std::runtime_error on open and read errors.
+ */
+class log_source : public live_source {
+public:
+    log_source(const std::string &path, run_sink &sink, bool follow = false);
+    ~log_source() override;
+
+    log_source(const log_source &) = delete;
+    log_source &operator=(const log_source &) = delete;
+
+    bool pump(clock::time_point deadline) override;
+    void finish() override;
+
+    // Counters of the decoder the input called for; null before the first
+    // byte. framing() stays null for a text log.
+    const decode_stats *decode() const;
+    const binary_log_stats *framing() const;
+
+private:
+    void feed(const char *data, size_t len);
+
+    run_sink &sink_;
+    bool follow_;
+    int fd_ = -1;
+    bool owned_ = false;
+    bool finished_ = false;
+    std::unique_ptr<char[]> buf_;
+    std::unique_ptr<log_decoder> text_;
+    std::unique_ptr<binary_log_decoder> framed_;
+};
+
+/*
+ * A capture's shared-memory ring (see shm_ring.h), turned back into run_sink
+ * calls: events between other records arrive as one batch, status records
+ * carry the header's configuration, and a reader that attaches mid-run sees
+ * a begin_run for it first. The source ends when the capture closes the
+ * ring. Throws std::runtime_error if the ring does not exist.
+ */
+class ring_source : public live_source {
+public:
+    ring_source(const std::string &name, run_sink &sink, bool from_start = false);
+
+    bool pump(clock::time_point deadline) override;
+    void finish() override;
+
+    uint64_t lost() const { return ring_.lost(); }
+
+private:
+    run_config header_config() const;
+    void apply(const live_event *e, size_t n);
+    void flush();
+    void begin(uint32_t run, uint32_t session);
+
+    shm_ring_reader ring_;
+    run_sink &sink_;
+    bool in_run_ = false;
+    run_info info_;
+    std::vector<live_event> buf_;
+    std::vector<int64_t> ticks_;
+    std::vector<uint8_t> edge_;
+    std::vector<uint16_t> gap_;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_LIVE_SOURCE_H
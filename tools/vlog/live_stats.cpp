@@ -0,0 +1,173 @@
+#include "live_stats.h"
+
+#include <cstring>
+
+namespace vlog {
+
+void live_stats::config(const run_config &config) {
+    if (config.f_cpu != 0) {
+        rate_ = vlog::tick_rate(config);
+        window_ = static_cast<int64_t>(rate_ + 0.5);
+    }
+}
+
+void live_stats::begin_run(const run_config &config) {
+    this->config(config);
+    logging_ = true;
+    summarising_ = false;
+    summarised_gap_ = 0;
+    runs_++;
+    /* Intervals never span runs. */
+    have_prev_ = false;
+    have_rising_ = false;
+}
+
+void live_stats::end_run() {
+    logging_ = false;
+    have_prev_ = false;
+    have_rising_ = false;
+}
+
+void live_stats::add(int64_t ticks, uint8_t edge, uint16_t gap) {
+    advance(ticks);
+
+    /* Count each firmware drop once, from the summary if one reported it. */
+    const uint64_t lost = gap > summarised_gap_ ? gap - summarised_gap_ : 0;
+    summarised_gap_ = 0;
+
+    events_++;
+    dropped_ += lost;
+    logging_ = true;            // A monitor may attach mid-run.
+    summarising_ = false;
+    current_.edges++;
+    current_.dropped += lost;
+
+    const bool contiguous = have_prev_ && gap == 0;
+    dropped_since_rising_ |= gap != 0;
+    if (edge == EDGE_FALLING) {
+        if (contiguous && prev_edge_ == EDGE_RISING) {
+            current_.high.add(static_cast<uint64_t>(ticks - prev_ticks_));
+        }
+    } else {
+        if (have_rising_ && !dropped_since_rising_) {
+            const uint64_t period = static_cast<uint64_t>(ticks - rising_);
+            const unsigned b = bucket_of(period);
+            current_.period.add(period);
+            hist_[slot_][b]++;
+            rolling_[b]++;
+        }
+        have_rising_ = true;
+        rising_ = ticks;
+        dropped_since_rising_ = false;
+    }
+    have_prev_ = true;
+    prev_edge_ = edge;
+    prev_ticks_ = ticks;
+}
+
+/* A summary stands in for the rows of its window: edges and the period
+ * range count, the mean is weighted by the periods it covers. The
+ * histogram only takes measured intervals. */
+void live_stats::add_summary(const summary_window &w) {
+    advance(w.end);
+    summaries_++;
+    summarising_ = true;
+    current_.edges += w.edges;
+    current_.dropped += w.dropped;
+    dropped_ += w.dropped;
+    summarised_gap_ += w.edges + w.dropped;
+    if (w.periods != 0) {
+        live_interval &p = current_.period;
+        p.min = p.count == 0 || w.period_min < p.min ? w.period_min : p.min;
+        p.max = w.period_max > p.max ? w.period_max : p.max;
+        p.sum += static_cast<double>(w.period_mean) * w.periods;
+        p.count += w.periods;
+    }
+    /* Rows resume with no usable predecessor. */
+    have_prev_ = false;
+    have_rising_ = false;
+}
+
+void live_stats::add_status(const status_record &s) {
+    config(s.config);
+    advance(s.ticks);
+    have_status_ = true;
+    status_ = s;
+    peak_high_water_ = s.ring_high_water > peak_high_water_ ? s.ring_high_water : peak_high_water_;
+}
+
+void live_stats::advance(int64_t ticks) {
+    if (window_ == 0) {
+        latest_ = ticks;
+        return;
+    }
+    if (!have_window_ || ticks < current_.start) {
+        /* First tick, or a new session restarted the clock. */
+        std::memset(hist_, 0, sizeof(hist_));
+        std::memset(rolling_, 0, sizeof(rolling_));
+        current_ = live_window();
+        current_.start = ticks;
+        have_window_ = true;
+        have_last_ = false;
+        have_prev_ = false;
+        have_rising_ = false;
+    } else if (ticks >= current_.start + window_) {
+        roll(ticks);
+    }
+    latest_ = ticks;
+}
+
+void live_stats::roll(int64_t ticks) {
+    const int64_t elapsed = (ticks - current_.start) / window_;
+    const int64_t start = current_.start + elapsed * window_;
+
+    if (elapsed == 1) {
+        last_ = current_;
+    } else {
+        /* The second before `ticks` saw nothing. */
+        last_ = live_window();
+        last_.start = start - window_;
+    }
+    have_last_ = true;
+
+    /* Retire the windows that fall out of the history, at most all of it. */
+    const unsigned steps =
+        elapsed < LIVE_HISTORY ? static_cast<unsigned>(elapsed) : LIVE_HISTORY;
+    for (unsigned i = 0; i < steps; i++) {
+        slot_ = (slot_ + 1) % LIVE_HISTORY;
+        uint64_t *h = hist_[slot_];
+        for (unsigned b = 0; b < HIST_BUCKETS; b++) {
+            rolling_[b] -= h[b];
+            h[b] = 0;
+        }
+    }
+
+    current_ = live_window();
+    current_.start = start;
+}
+
+/* Values below 4 get a bucket each; above, the top three significant bits
+ * pick one of four buckets per octave (at most 25% wide). */
+unsigned live_stats::bucket_of(uint64_t v) {
+    if (v < 4) {
+        return static_cast<unsigned>(v);
+    }
+    const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(v));
+    return (msb << HIST_SUB_BITS) | static_cast<unsigned>((v >> (msb - HIST_SUB_BITS)) & 3u);
+}
+
+uint64_t live_stats::bucket_low(unsigned b) {
+    if (b < 4) {
+        return b;
+    }
+    if (b < 8) {
+        return 4;           // Unused buckets between the exact and octave ranges.
+    }
+    const unsigned msb = b >> HIST_SUB_BITS;
+    if (msb >= 64) {
+        return UINT64_MAX;
+    }
+    return static_cast<uint64_t>(4u | (b & 3u)) << (msb - HIST_SUB_BITS);
+}
+
+}  // namespace vlog
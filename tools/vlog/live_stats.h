@@ -0,0 +1,133 @@
+#ifndef VLOG_LIVE_STATS_H
+#define VLOG_LIVE_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+
+namespace vlog {
+
+// Count, range and mean of one interval kind within a window.
+struct live_interval {
+    uint64_t count = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    double sum = 0.0;
+
+    void add(uint64_t v) {
+        min = count == 0 || v < min ? v : min;
+        max = v > max ? v : max;
+        sum += static_cast<double>(v);
+        count++;
+    }
+    double mean() const { return count != 0 ? sum / count : 0.0; }
+};
+
+// One second of device time.
+struct live_window {
+    int64_t start = 0;           // Extended ticks.
+    uint64_t edges = 0;          // Including edges seen only through summaries.
+    uint64_t dropped = 0;        // Events the firmware reported lost.
+    live_interval period;        // Rising to rising, ticks.
+    live_interval high;          // Rising to falling, ticks.
+};
+
+/*
+ * Incremental pulse statistics for live displays.
+ *
+ * Every event costs O(1). Events fold into the current one-second window
+ * of device time, so replayed input reads the same at any speed. The
+ * rolling period histogram over the last LIVE_HISTORY windows is a
+ * running sum: at each rollover the expiring window's counts are taken
+ * out, a fixed cost per second rather than per event. Intervals follow
+ * for_each_interval(): none spans a dropped event.
+ *
+ * Windows advance on event, summary and status ticks, so a logger that is
+ * idle (or stopped, but still sending status) still rolls over. Ticks
+ * going backwards (a new power-on session) restart the windows.
+ */
+class live_stats {
+public:
+    static constexpr unsigned LIVE_HISTORY = 10;
+    static constexpr unsigned HIST_SUB_BITS = 2;     // 4 buckets per octave.
+    static constexpr unsigned HIST_BUCKETS = 64u << HIST_SUB_BITS;
+
+    // Take the tick rate from a header; windows start once it is known.
+    void config(const run_config &config);
+    void begin_run(const run_config &config);
+    void end_run();
+    void add(int64_t ticks, uint8_t edge, uint16_t gap);
+    void add_summary(const summary_window &w);
+    void add_status(const status_record &s);
+    void advance(int64_t ticks);
+
+    double tick_rate() const { return rate_; }
+    bool logging() const { return logging_; }
+    bool summarising() const { return summarising_; }
+    int64_t latest() const { return latest_; }
+
+    const live_window &current() const { return current_; }
+    const live_window &last() const { return last_; }
+    bool have_last() const { return have_last_; }
+
+    // Rolling period histogram, HIST_BUCKETS counts; bucket b holds values
+    // from bucket_low(b) to bucket_low(b + 1) - 1.
+    const uint64_t *histogram() const { return rolling_; }
+    static unsigned bucket_of(uint64_t v);
+    static uint64_t bucket_low(unsigned b);
+
+    uint64_t events() const { return events_; }
+    uint64_t runs() const { return runs_; }
+    uint64_t summaries() const { return summaries_; }
+    uint64_t dropped() const { return dropped_; }
+
+    // Latest firmware status; peak_high_water() is the most over all of them.
+    bool have_status() const { return have_status_; }
+    const status_record &status() const { return status_; }
+    uint16_t peak_high_water() const { return peak_high_water_; }
+
+private:
+    void roll(int64_t ticks);
+
+    double rate_ = 0.0;
+    int64_t window_ = 0;         // Ticks per window; 0 until a rate is known.
+    bool logging_ = false;
+    bool summarising_ = false;
+    int64_t latest_ = 0;
+
+    live_window current_;
+    live_window last_;
+    bool have_window_ = false;
+    bool have_last_ = false;
+
+    // Interval state, as in for_each_interval().
+    bool have_prev_ = false;
+    uint8_t prev_edge_ = 0;
+    int64_t prev_ticks_ = 0;
+    bool have_rising_ = false;
+    int64_t rising_ = 0;
+    bool dropped_since_rising_ = false;
+
+    // Part of the next row's gap already accounted for by summaries: their
+    // edges (not lost) and their drops (counted from the summary).
+    uint64_t summarised_gap_ = 0;
+
+    uint64_t hist_[LIVE_HISTORY][HIST_BUCKETS] = {};
+    uint64_t rolling_[HIST_BUCKETS] = {};
+    unsigned slot_ = 0;
+
+    uint64_t events_ = 0;
+    uint64_t runs_ = 0;
+    uint64_t summaries_ = 0;
+    uint64_t dropped_ = 0;
+
+    bool have_status_ = false;
+    status_record status_;
+    uint16_t peak_high_water_ = 0;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_LIVE_STATS_H
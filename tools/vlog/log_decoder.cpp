@@ -0,0 +1,464 @@
+#include "log_decoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "log_syntax.h"
+#include "mapped_file.h"
+
+namespace vlog {
+
+using namespace log_syntax;
+
+log_decoder::log_decoder(run_sink &sink, size_t batch_size)
+    : sink_(sink), batch_size_(batch_size > 0 ? batch_size : 1) {
+    ticks_.reserve(batch_size_);
+    edge_.reserve(batch_size_);
+    gap_.reserve(batch_size_);
+}
+
+/*
+ * Split the input into lines and decode each one.
+ *
+ * Complete lines are parsed in place from the caller's buffer; only a
+ * trailing partial line is copied into the carry buffer to be joined with
+ * the next piece.
+ */
+void log_decoder::feed(const char *data, size_t len) {
+    const char *p = data;
+    const char *end = data + len;
+
+    if (!carry_.empty()) {
+        const char *nl = static_cast<const char *>(std::memchr(p, '\n', len));
+        if (nl == nullptr) {
+            carry_.append(p, len);
+            consumed_ += len;
+            return;
+        }
+
+        const uint64_t line_offset = consumed_ - carry_.size();
+        carry_.append(p, static_cast<size_t>(nl - p));
+        parse_line(carry_.data(), carry_.data() + carry_.size(), line_offset);
+        carry_.clear();
+
+        consumed_ += static_cast<uint64_t>(nl + 1 - p);
+        p = nl + 1;
+    }
+
+    while (p != end) {
+        const char *nl =
+            static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (nl == nullptr) {
+            carry_.assign(p, static_cast<size_t>(end - p));
+            consumed_ += static_cast<uint64_t>(end - p);
+            return;
+        }
+
+        parse_line(p, nl, consumed_);
+        consumed_ += static_cast<uint64_t>(nl + 1 - p);
+        p = nl + 1;
+    }
+}
+
+void log_decoder::finish() {
+    if (!carry_.empty()) {
+        const uint64_t line_offset = consumed_ - carry_.size();
+        parse_line(carry_.data(), carry_.data() + carry_.size(), line_offset);
+        carry_.clear();
+    }
+
+    if (in_run_) {
+        close_run(true);
+    }
+}
+
+void log_decoder::parse_line(const char *p, const char *end, uint64_t offset) {
+    uint64_t v[MAX_LINE_FIELDS];
+
+    stats_.lines++;
+    apply_line(classify_line(p, end, v), v, offset);
+}
+
+/*
+ * Act on one classified line. This is the only place decoder state changes
+ * in response to input, so the sequential and chunk-parallel paths share
+ * it.
+ */
+void log_decoder::apply_line(uint8_t kind, const uint64_t *v, uint64_t offset) {
+    switch (kind) {
+    case LINE_BLANK:
+    case LINE_IGNORED:
+        break;
+
+    case LINE_MALFORMED:
+        stats_.malformed++;
+        break;
+
+    case LINE_ROW:
+        add_row(static_cast<uint32_t>(v[0]), static_cast<uint8_t>(v[1]),
+                static_cast<uint16_t>(v[2]));
+        break;
+
+    case LINE_START:
+        if (in_run_) {
+            close_run(true);
+        }
+        open_run(offset);
+        break;
+
+    case LINE_STOP:
+        if (in_run_) {
+            close_run(false);
+        }
+        break;
+
+    case LINE_BANNER:
+        /* A fresh banner means the device restarted: nothing carries over. */
+        if (in_run_) {
+            close_run(true);
+        }
+        config_ = run_config();
+        session_++;
+        have_sync_ = false;
+        have_tick_ = false;
+        tick_epoch_ = 0;
+        break;
+
+    case LINE_F_CPU:
+        config_.f_cpu = static_cast<uint32_t>(v[0]);
+        break;
+    case LINE_BAUD:
+        config_.baud = static_cast<uint32_t>(v[0]);
+        break;
+    case LINE_PRESCALER:
+        config_.timer1_prescaler = static_cast<uint32_t>(v[0]);
+        break;
+    case LINE_BUFFER_SIZE:
+        config_.capture_buffer_size = static_cast<uint32_t>(v[0]);
+        break;
+
+    case LINE_ICNC1_ON:
+        config_.icnc1 = 1;
+        break;
+    case LINE_ICNC1_OFF:
+        config_.icnc1 = 0;
+        break;
+
+    case LINE_SUMMARY:
+        add_summary(v);
+        break;
+
+    case LINE_METER:
+        add_meter(v);
+        break;
+
+    case LINE_SYNC:
+        add_sync(v, offset);
+        break;
+
+    case LINE_STATUS:
+        add_status(v);
+        break;
+
+    case LINE_MODE:
+        if (in_run_) {
+            extend_tick(static_cast<uint32_t>(v[0]));
+            stats_.mode_changes++;
+        }
+        break;
+    }
+}
+
+void log_decoder::add_row(uint32_t tick32, uint8_t edge, uint16_t dropped) {
+    if (!in_run_) {
+        stats_.orphan_rows++;
+        return;
+    }
+
+    const int64_t tick = extend_tick(tick32);
+
+    /* The firmware counter is cumulative since power-on and wraps at 2^16. */
+    uint16_t gap = 0;
+    if (have_dropped_) {
+        gap = static_cast<uint16_t>(dropped - prev_dropped_);
+    }
+    prev_dropped_ = dropped;
+    have_dropped_ = true;
+    run_.dropped += gap;
+
+    /* Edges that went into summaries are missing from the columns too,
+     * but were not lost: they break contiguity without counting as drops. */
+    if (summarised_gap_ != 0) {
+        gap = static_cast<uint16_t>(std::min<uint64_t>(gap + summarised_gap_, UINT16_MAX));
+        summarised_gap_ = 0;
+    }
+
+    ticks_.push_back(tick);
+    edge_.push_back(edge);
+    gap_.push_back(gap);
+
+    run_.event_count++;
+    stats_.rows++;
+
+    if (ticks_.size() >= batch_size_) {
+        flush_batch();
+    }
+}
+
+/*
+ * add_row() over a block. The first row takes the general path; after it
+ * the tick and dropped baselines exist and no summarised edges are
+ * pending, so the rest need no branches. Decoder state is kept in locals:
+ * stores through the uint8_t column would otherwise force members to be
+ * reloaded on every row.
+ */
+void log_decoder::add_rows(const uint32_t *tick32, const uint8_t *edge, const uint16_t *dropped,
+                           size_t n) {
+    if (n == 0) {
+        return;
+    }
+    add_row(tick32[0], edge[0], dropped[0]);
+    if (!in_run_) {
+        stats_.orphan_rows += n - 1;
+        return;
+    }
+
+    uint32_t prev_tick32 = prev_tick32_;
+    int64_t epoch = tick_epoch_;
+    uint16_t prev_dropped = prev_dropped_;
+    uint64_t dropped_sum = 0;
+
+    for (size_t i = 1; i < n;) {
+        const size_t at = ticks_.size();
+        const size_t take = std::min(n - i, batch_size_ - at);
+        ticks_.resize(at + take);
+        edge_.resize(at + take);
+        gap_.resize(at + take);
+        int64_t *t = ticks_.data() + at;
+        uint8_t *e = edge_.data() + at;
+        uint16_t *g = gap_.data() + at;
+
+        for (size_t k = 0; k < take; k++, i++) {
+            epoch += static_cast<int64_t>(tick32[i] < prev_tick32) << 32;
+            prev_tick32 = tick32[i];
+            t[k] = epoch + tick32[i];
+            e[k] = edge[i];
+
+            const uint16_t gap = static_cast<uint16_t>(dropped[i] - prev_dropped);
+            prev_dropped = dropped[i];
+            g[k] = gap;
+            dropped_sum += gap;
+        }
+
+        if (ticks_.size() >= batch_size_) {
+            flush_batch();
+        }
+    }
+
+    prev_tick32_ = prev_tick32;
+    tick_epoch_ = epoch;
+    prev_dropped_ = prev_dropped;
+
+    run_.event_count += n - 1;
+    run_.dropped += dropped_sum;
+    stats_.rows += n - 1;
+}
+
+/* Deliver a `# SUMMARY,<start>,<end>,<edges>,<periods>,<min>,<max>,<mean>,<dropped>`. */
+void log_decoder::add_summary(const uint64_t *v) {
+    if (!in_run_) {
+        return;
+    }
+
+    summary_window w;
+    w.start = extend_tick(static_cast<uint32_t>(v[0]));
+    w.end = w.start + static_cast<uint32_t>(v[1] - v[0]);
+    w.edges = static_cast<uint32_t>(v[2]);
+    w.periods = static_cast<uint32_t>(v[3]);
+    w.period_min = static_cast<uint32_t>(v[4]);
+    w.period_max = static_cast<uint32_t>(v[5]);
+    w.period_mean = static_cast<uint32_t>(v[6]);
+    w.dropped = static_cast<uint16_t>(v[7]);
+
+    summarised_gap_ += w.edges;
+    stats_.summaries++;
+    stats_.summarised += w.edges;
+
+    flush_batch();
+    sink_.summary(w);
+}
+
+/* Deliver a `# METER,<start>,<end>,<periods>,<span>,<freq_mhz>,<duty_ppm>,<dropped>`. */
+void log_decoder::add_meter(const uint64_t *v) {
+    if (!in_run_) {
+        return;
+    }
+
+    meter_reading r;
+    r.start = extend_tick(static_cast<uint32_t>(v[0]));
+    r.end = r.start + static_cast<uint32_t>(v[1] - v[0]);
+    r.periods = static_cast<uint32_t>(v[2]);
+    r.span = static_cast<uint32_t>(v[3]);
+    r.freq_mhz = static_cast<uint32_t>(v[4]);
+    r.duty_ppm = static_cast<uint32_t>(v[5]);
+    r.dropped = static_cast<uint16_t>(v[6]);
+
+    stats_.meter_gates++;
+
+    flush_batch();
+    sink_.meter(r);
+}
+
+/*
+ * Deliver a `# SYNC,<ticks>`; v[1] is the record's length on the wire.
+ *
+ * Syncs come at a fixed interval well under a wrap, logging or not, so
+ * each is simply ahead of the previous one. They are also printed between
+ * rows whose ticks may be slightly earlier (events still queued when the
+ * sync went out), so instead of feeding the "smaller means wrap" rule the
+ * sync re-anchors it: the next timestamp is taken as the one nearest the
+ * sync. That also carries the epoch across wraps while logging is stopped.
+ */
+void log_decoder::add_sync(const uint64_t *v, uint64_t offset) {
+    const uint32_t t32 = static_cast<uint32_t>(v[0]);
+
+    sync_point s;
+    if (have_sync_) {
+        s.ticks = last_sync_ + static_cast<uint32_t>(t32 - static_cast<uint32_t>(last_sync_));
+    } else if (have_tick_) {
+        s.ticks = tick_epoch_ + prev_tick32_ + static_cast<int32_t>(t32 - prev_tick32_);
+    } else {
+        s.ticks = t32;
+    }
+    s.bytes = static_cast<uint32_t>(v[1]);
+    s.end = offset + v[1];
+    s.session = session_;
+    s.config = config_;
+
+    have_sync_ = true;
+    last_sync_ = s.ticks;
+
+    const int64_t anchor = s.ticks - (INT64_C(1) << 31);
+    prev_tick32_ = static_cast<uint32_t>(anchor);
+    tick_epoch_ = anchor - prev_tick32_;
+    have_tick_ = true;
+
+    stats_.syncs++;
+
+    flush_batch();
+    sink_.sync(s);
+}
+
+/*
+ * Deliver a `# STATUS,<ticks>,<ring_high_water>,<dropped>`. It follows a
+ * sync, so its ticks are taken nearest that; it does not move the tick
+ * extension itself.
+ */
+void log_decoder::add_status(const uint64_t *v) {
+    const uint32_t t32 = static_cast<uint32_t>(v[0]);
+
+    status_record s;
+    if (have_sync_) {
+        s.ticks = last_sync_ + static_cast<int32_t>(t32 - static_cast<uint32_t>(last_sync_));
+    } else if (have_tick_) {
+        s.ticks = tick_epoch_ + prev_tick32_ + static_cast<int32_t>(t32 - prev_tick32_);
+    } else {
+        s.ticks = t32;
+    }
+    s.ring_high_water = static_cast<uint16_t>(v[1]);
+    s.dropped = static_cast<uint16_t>(v[2]);
+    s.config = config_;
+
+    stats_.statuses++;
+
+    flush_batch();
+    sink_.status(s);
+}
+
+/*
+ * Extend a 32-bit firmware tick to 64 bits. Every timestamped record in a
+ * session goes through here, in stream order, so a smaller value than the
+ * previous one is one wrap.
+ */
+int64_t log_decoder::extend_tick(uint32_t t32) {
+    if (have_tick_ && t32 < prev_tick32_) {
+        tick_epoch_ += INT64_C(1) << 32;
+    }
+    prev_tick32_ = t32;
+    have_tick_ = true;
+    return tick_epoch_ + t32;
+}
+
+void log_decoder::open_run(uint64_t offset) {
+    run_ = run_info();
+    run_.config = config_;
+    run_.index = next_run_index_++;
+    run_.session = session_;
+    run_.source_offset = offset;
+
+    have_dropped_ = false;
+    summarised_gap_ = 0;
+    in_run_ = true;
+
+    sink_.begin_run(run_);
+}
+
+void log_decoder::close_run(bool truncated) {
+    flush_batch();
+
+    run_.truncated = truncated;
+    in_run_ = false;
+    stats_.runs++;
+
+    sink_.end_run(run_);
+}
+
+void log_decoder::flush_batch() {
+    if (ticks_.empty()) {
+        return;
+    }
+
+    sink_.events(event_batch{ticks_.data(), edge_.data(), gap_.data(), ticks_.size()});
+
+    ticks_.clear();
+    edge_.clear();
+    gap_.clear();
+}
+
+void run_collector::begin_run(const run_info &info) {
+    runs.emplace_back();
+    runs.back().info = info;
+}
+
+void run_collector::events(const event_batch &batch) {
+    capture_run &run = runs.back();
+    run.ticks.insert(run.ticks.end(), batch.ticks, batch.ticks + batch.count);
+    run.edge.insert(run.edge.end(), batch.edge, batch.edge + batch.count);
+    run.gap.insert(run.gap.end(), batch.gap, batch.gap + batch.count);
+}
+
+/*
+ * Growth slack is deliberately not trimmed: pages past size() are never
+ * touched and so never become resident, whereas shrink_to_fit() would copy
+ * the whole column and briefly double the footprint of a long run.
+ */
+void run_collector::end_run(const run_info &info) {
+    runs.back().info = info;
+}
+
+std::vector<capture_run> decode_log_file(const std::string &path, decode_stats *stats,
+                                         unsigned threads) {
+    const mapped_file file(path);
+
+    run_collector collector;
+    log_decoder decoder(collector);
+    decoder.feed_parallel(file.chars(), file.size(), threads);
+    decoder.finish();
+
+    if (stats != nullptr) {
+        *stats = decoder.stats();
+    }
+    return std::move(collector.runs);
+}
+
+}  // namespace vlog
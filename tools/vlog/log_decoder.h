@@ -0,0 +1,223 @@
+#ifndef VLOG_LOG_DECODER_H
+#define VLOG_LOG_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "capture_run.h"
+
+namespace vlog {
+
+// One window the firmware reported as a summary while overloaded
+// (`# SUMMARY,...`). Ticks are extended like event ticks; periods are
+// rising-to-rising intervals and min/max/mean are 0 when periods == 0.
+struct summary_window {
+    int64_t start = 0;
+    int64_t end = 0;
+    uint32_t edges = 0;
+    uint32_t periods = 0;
+    uint32_t period_min = 0;
+    uint32_t period_max = 0;
+    uint32_t period_mean = 0;
+    uint16_t dropped = 0;       // Ring overflows during the window.
+};
+
+// One gate of the firmware's frequency / duty meter mode (`# METER,...`).
+// `periods` whole periods span `span` ticks; frequency and duty are the
+// firmware's rounded fixed-point results.
+struct meter_reading {
+    int64_t start = 0;          // Gate start / end, extended ticks.
+    int64_t end = 0;
+    uint32_t periods = 0;
+    uint32_t span = 0;
+    uint32_t freq_mhz = 0;      // Millihertz; 0 when the gate saw no period.
+    uint32_t duty_ppm = 0;      // High time per million.
+    uint16_t dropped = 0;       // Ring overflows during the gate.
+};
+
+// A clock sync record (`# SYNC,<ticks>`). The record's first byte went on
+// the wire at `ticks` and the rest followed back to back, so its last byte
+// was complete `bytes` character times later; `end` is the stream offset
+// just past that byte. Pairing `end` with host read timestamps relates
+// device ticks to host time (see clock_sync.h).
+struct sync_point {
+    int64_t ticks = 0;          // Extended like event ticks.
+    uint64_t end = 0;
+    uint32_t bytes = 0;
+    uint32_t session = 0;       // Banners seen before it; ticks restart with each.
+    run_config config;          // Header in force.
+};
+
+// A firmware status record (`# STATUS,...`), sent after each sync. Ticks
+// are extended like event ticks.
+struct status_record {
+    int64_t ticks = 0;
+    uint16_t ring_high_water = 0;  // Most capture ring slots in use since the last status.
+    uint16_t dropped = 0;          // Cumulative overflow counter, as in event rows.
+    run_config config;             // Header in force; capture_buffer_size is the ring depth.
+};
+
+// Receiver for decoded runs.
+//
+// Calls arrive strictly in the order begin_run, events / summary / meter
+// (zero or more times, in stream order), end_run for each run. Batch
+// pointers are only valid during the call. Sinks that only want edges can
+// ignore summaries and meter readings. sync() and status() are not tied to
+// runs: they are called in stream order both inside and between them.
+class run_sink {
+public:
+    virtual ~run_sink() = default;
+    virtual void begin_run(const run_info &info) = 0;
+    virtual void events(const event_batch &batch) = 0;
+    virtual void summary(const summary_window &) {}
+    virtual void meter(const meter_reading &) {}
+    virtual void end_run(const run_info &info) = 0;
+    virtual void sync(const sync_point &) {}
+    virtual void status(const status_record &) {}
+};
+
+// Line-level accounting for one decode.
+struct decode_stats {
+    uint64_t lines = 0;        // Lines seen (including headers and blanks).
+    uint64_t rows = 0;         // Event rows decoded into runs.
+    uint64_t runs = 0;         // Runs delivered to the sink.
+    uint64_t malformed = 0;    // Lines that could not be parsed.
+    uint64_t orphan_rows = 0;  // Well-formed rows outside `# START` .. `# STOP`.
+    uint64_t summaries = 0;    // `# SUMMARY` windows delivered to the sink.
+    uint64_t summarised = 0;   // Edges reported only through summaries.
+    uint64_t mode_changes = 0; // `# MODE=` switches between rows and summaries.
+    uint64_t meter_gates = 0;  // `# METER` readings delivered to the sink.
+    uint64_t syncs = 0;        // `# SYNC` records delivered to the sink.
+    uint64_t statuses = 0;     // `# STATUS` records delivered to the sink.
+};
+
+/*
+ * Streaming decoder for the logger's serial output.
+ *
+ * Input may be fed in arbitrary pieces (serial reads, file chunks); partial
+ * lines are carried over internally. The decoder recognises:
+ *
+ *   # validation-logger       start of a header block (new power-on session)
+ *   # KEY=VALUE               header configuration (F_CPU, BAUD, ...)
+ *   # START / # STOP          run boundaries
+ *   ticks,edge,dt_ticks,...   column header (ignored)
+ *   <ticks>,<R|F>,<dt>,<drop> event row
+ *   alive                     idle heartbeat (ignored)
+ *   # MODE=SUMMARY|EDGES,<t>  overload mode switch
+ *   # SUMMARY,<start>,...     per-window statistics while overloaded
+ *   # METER,<start>,...       frequency / duty reading (meter firmware)
+ *   # SYNC,<ticks>            clock sync record, logging or not
+ *   # STATUS,<ticks>,...      ring high-water and dropped counter, likewise
+ *
+ * Edges covered only by summaries are absent from the event columns; the
+ * first row after a summary section carries them in its gap so consumers
+ * see the discontinuity.
+ *
+ * Other `#` lines are ignored so that newer firmware may add records
+ * without breaking older tools.
+ *
+ * The firmware's 32-bit tick counter is extended to 64 bits: a tick smaller
+ * than its predecessor within a session is taken as one wrap (2^32 ticks,
+ * ~537 s at 8 MHz). Sync records, which the firmware sends logging or
+ * not, carry the extension across stopped periods; without them wraps that
+ * occur entirely while logging is stopped cannot be observed and are not
+ * reconstructed.
+ */
+class log_decoder {
+public:
+    explicit log_decoder(run_sink &sink, size_t batch_size = 4096);
+
+    // Decode the next piece of the stream.
+    void feed(const char *data, size_t len);
+
+    // Decode the next piece of the stream on up to `threads` worker threads.
+    //
+    // The piece is cut into chunks of about chunk_bytes at line boundaries;
+    // workers parse chunks into columns while this thread stitches them
+    // together in order (tick wraps, dropped-counter deltas, run and header
+    // records). Sink calls, batch boundaries and stats are exactly those of
+    // feed() on the same bytes. Small pieces are simply fed sequentially.
+    void feed_parallel(const char *data, size_t len, unsigned threads,
+                       size_t chunk_bytes = 8u << 20);
+
+    // Flush any trailing partial line and close an open run as truncated.
+    void finish();
+
+    // Apply one record decoded from another encoding of the same stream
+    // (see binary_log_decoder). kind and v are as produced by
+    // log_syntax::classify_line(); offset is the record's stream offset.
+    void apply_line(uint8_t kind, const uint64_t *v, uint64_t offset);
+
+    // Same as n LINE_ROW records, without the per-row dispatch.
+    void add_rows(const uint32_t *tick32, const uint8_t *edge, const uint16_t *dropped, size_t n);
+
+    const decode_stats &stats() const { return stats_; }
+
+private:
+    struct chunk;               // One parsed piece of feed_parallel().
+
+    void parse_line(const char *p, const char *end, uint64_t offset);
+    void add_row(uint32_t tick32, uint8_t edge, uint16_t dropped);
+    void add_summary(const uint64_t *v);
+    void add_meter(const uint64_t *v);
+    void add_sync(const uint64_t *v, uint64_t offset);
+    void add_status(const uint64_t *v);
+    void apply_chunk(chunk &c);
+    void append_rows(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap, size_t n);
+    int64_t extend_tick(uint32_t t32);
+    void open_run(uint64_t offset);
+    void close_run(bool truncated);
+    void flush_batch();
+
+    run_sink &sink_;
+    size_t batch_size_;
+    decode_stats stats_;
+
+    std::string carry_;         // Partial line awaiting its terminator.
+    uint64_t consumed_ = 0;     // Stream offset of the next byte fed.
+
+    run_config config_;         // Current session header.
+    uint32_t session_ = 0;      // Banners seen.
+    run_info run_;              // Run under construction.
+    bool in_run_ = false;
+    uint32_t next_run_index_ = 0;
+
+    // Tick extension state, per session.
+    bool have_tick_ = false;
+    uint32_t prev_tick32_ = 0;
+    int64_t tick_epoch_ = 0;
+    bool have_sync_ = false;
+    int64_t last_sync_ = 0;
+
+    // Dropped-counter tracking, per run.
+    bool have_dropped_ = false;
+    uint16_t prev_dropped_ = 0;
+    uint64_t summarised_gap_ = 0;  // Summarised edges not yet charged to a row.
+
+    std::vector<int64_t> ticks_;
+    std::vector<uint8_t> edge_;
+    std::vector<uint16_t> gap_;
+};
+
+// Sink that materialises every run in memory.
+class run_collector : public run_sink {
+public:
+    void begin_run(const run_info &info) override;
+    void events(const event_batch &batch) override;
+    void end_run(const run_info &info) override;
+
+    std::vector<capture_run> runs;
+};
+
+// Decode a complete log file (memory-mapped) into in-memory runs, using
+// feed_parallel() when threads > 1.
+// Throws std::runtime_error if the file cannot be read.
+std::vector<capture_run> decode_log_file(const std::string &path,
+                                         decode_stats *stats = nullptr,
+                                         unsigned threads = 1);
+
+}  // namespace vlog
+
+#endif  // VLOG_LOG_DECODER_H
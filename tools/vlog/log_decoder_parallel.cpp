@@ -0,0 +1,362 @@
+/*
+ * Chunk-parallel decoding for log_decoder::feed_parallel().
+ *
+ * Line syntax is context free, so a chunk cut at a line boundary can be
+ * parsed without knowing what came before it. What is not context free is
+ * small: the tick epoch, the dropped-counter baseline, whether a run is
+ * open and the header in force. Workers therefore produce columns whose
+ * ticks are extended only by the wraps seen inside the chunk and whose gaps
+ * are deltas inside the chunk, plus the few lines that change decoder
+ * state ("marks"). The feeding thread replays the marks through
+ * apply_line() and fixes up each stretch of rows between them with one
+ * addition per tick and one gap adjustment, then hands the columns to the
+ * sink with the same batch boundaries as a sequential decode.
+ */
+
+#include "log_decoder.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "log_syntax.h"
+
+namespace vlog {
+
+using namespace log_syntax;
+
+struct log_decoder::chunk {
+    // A stateful line, to be replayed before row `row` of the chunk.
+    struct mark {
+        size_t row;
+        uint64_t offset;
+        line_kind kind;
+        uint64_t v[MAX_LINE_FIELDS];
+    };
+
+    // A maximal stretch of rows with no mark in between.
+    struct segment {
+        size_t begin;
+        size_t end;
+        uint32_t first_tick32;
+        uint32_t last_tick32;
+        uint64_t wraps;             // Wraps between first and last row.
+        uint16_t first_dropped;
+        uint16_t last_dropped;
+        uint64_t gap_sum;           // Sum of gap[begin + 1 .. end).
+    };
+
+    std::vector<int64_t> ticks;
+    std::vector<uint8_t> edge;
+    std::vector<uint16_t> gap;
+    std::vector<mark> marks;
+    std::vector<segment> segments;
+    uint64_t lines = 0;
+    uint64_t malformed = 0;
+
+    void parse(const char *p, const char *end, uint64_t offset);
+
+private:
+    void close_segment(segment &s) {
+        s.end = ticks.size();
+        if (s.end > s.begin) {
+            segments.push_back(s);
+        }
+        s = segment();
+        s.begin = ticks.size();
+    }
+};
+
+/* Parse whole lines [p, end); offset is the stream offset of p. */
+void log_decoder::chunk::parse(const char *p, const char *end, uint64_t offset) {
+    const char *const base = p;
+    segment s = segment();
+
+    ticks.clear();
+    edge.clear();
+    gap.clear();
+    marks.clear();
+    segments.clear();
+    lines = 0;
+    malformed = 0;
+
+    /* A row is 20-30 bytes; reserving on that basis avoids regrowth. */
+    const size_t guess = static_cast<size_t>(end - p) / 20 + 1;
+    ticks.reserve(guess);
+    edge.reserve(guess);
+    gap.reserve(guess);
+
+    while (p != end) {
+        const char *nl =
+            static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        uint64_t v[MAX_LINE_FIELDS];
+        const line_kind kind = classify_line(p, nl, v);
+        lines++;
+
+        switch (kind) {
+        case LINE_BLANK:
+        case LINE_IGNORED:
+            break;
+
+        case LINE_MALFORMED:
+            malformed++;
+            break;
+
+        case LINE_ROW: {
+            const uint32_t t32 = static_cast<uint32_t>(v[0]);
+            const uint16_t d16 = static_cast<uint16_t>(v[2]);
+            uint16_t g = 0;
+            if (ticks.size() == s.begin) {
+                s.first_tick32 = t32;
+                s.first_dropped = d16;
+            } else {
+                if (t32 < s.last_tick32) {
+                    s.wraps++;
+                }
+                g = static_cast<uint16_t>(d16 - s.last_dropped);
+                s.gap_sum += g;
+            }
+            s.last_tick32 = t32;
+            s.last_dropped = d16;
+
+            ticks.push_back(static_cast<int64_t>(s.wraps << 32) + t32);
+            edge.push_back(static_cast<uint8_t>(v[1]));
+            gap.push_back(g);
+            break;
+        }
+
+        default:
+            close_segment(s);
+            marks.push_back(mark());
+            marks.back().row = ticks.size();
+            marks.back().offset = offset + static_cast<uint64_t>(p - base);
+            marks.back().kind = kind;
+            std::memcpy(marks.back().v, v, sizeof(v));
+            break;
+        }
+
+        p = nl + 1;
+    }
+
+    close_segment(s);
+}
+
+/* Stitch one parsed chunk onto the decoder state, in stream order. */
+void log_decoder::apply_chunk(chunk &c) {
+    stats_.lines += c.lines;
+    stats_.malformed += c.malformed;
+
+    size_t next_mark = 0;
+    for (const chunk::segment &s : c.segments) {
+        while (next_mark < c.marks.size() && c.marks[next_mark].row <= s.begin) {
+            const chunk::mark &m = c.marks[next_mark++];
+            apply_line(m.kind, m.v, m.offset);
+        }
+
+        const size_t n = s.end - s.begin;
+        if (!in_run_) {
+            stats_.orphan_rows += n;
+            continue;
+        }
+
+        /* Same rule as extend_tick(), applied once to the first row. */
+        if (have_tick_ && s.first_tick32 < prev_tick32_) {
+            tick_epoch_ += INT64_C(1) << 32;
+        }
+        if (tick_epoch_ != 0) {
+            int64_t *t = c.ticks.data() + s.begin;
+            for (size_t i = 0; i < n; i++) {
+                t[i] += tick_epoch_;
+            }
+        }
+        tick_epoch_ += static_cast<int64_t>(s.wraps << 32);
+        prev_tick32_ = s.last_tick32;
+        have_tick_ = true;
+
+        /* Only the first row's gap depends on what came before. */
+        uint16_t first_gap = 0;
+        if (have_dropped_) {
+            first_gap = static_cast<uint16_t>(s.first_dropped - prev_dropped_);
+        }
+        prev_dropped_ = s.last_dropped;
+        have_dropped_ = true;
+        run_.dropped += first_gap + s.gap_sum;
+        if (summarised_gap_ != 0) {
+            first_gap = static_cast<uint16_t>(
+                std::min<uint64_t>(first_gap + summarised_gap_, UINT16_MAX));
+            summarised_gap_ = 0;
+        }
+        c.gap[s.begin] = first_gap;
+
+        run_.event_count += n;
+        stats_.rows += n;
+
+        append_rows(c.ticks.data() + s.begin, c.edge.data() + s.begin, c.gap.data() + s.begin, n);
+    }
+
+    while (next_mark < c.marks.size()) {
+        const chunk::mark &m = c.marks[next_mark++];
+        apply_line(m.kind, m.v, m.offset);
+    }
+}
+
+/*
+ * Deliver rows with the batch boundaries add_row() would produce: top up a
+ * pending batch, pass whole batches straight from the chunk's columns and
+ * keep the remainder pending.
+ */
+void log_decoder::append_rows(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                              size_t n) {
+    size_t i = 0;
+
+    if (!ticks_.empty()) {
+        const size_t take = std::min(n, batch_size_ - ticks_.size());
+        ticks_.insert(ticks_.end(), ticks, ticks + take);
+        edge_.insert(edge_.end(), edge, edge + take);
+        gap_.insert(gap_.end(), gap, gap + take);
+        i = take;
+        if (ticks_.size() >= batch_size_) {
+            flush_batch();
+        }
+    }
+
+    for (; n - i >= batch_size_; i += batch_size_) {
+        sink_.events(event_batch{ticks + i, edge + i, gap + i, batch_size_});
+    }
+
+    ticks_.insert(ticks_.end(), ticks + i, ticks + n);
+    edge_.insert(edge_.end(), edge + i, edge + n);
+    gap_.insert(gap_.end(), gap + i, gap + n);
+}
+
+void log_decoder::feed_parallel(const char *data, size_t len, unsigned threads,
+                                size_t chunk_bytes) {
+    /* Finish a line carried over from an earlier feed sequentially. */
+    if (!carry_.empty()) {
+        const char *nl = static_cast<const char *>(std::memchr(data, '\n', len));
+        const size_t head = nl != nullptr ? static_cast<size_t>(nl + 1 - data) : len;
+        feed(data, head);
+        data += head;
+        len -= head;
+    }
+
+    /* Whole lines only; a trailing partial line is carried as by feed(). */
+    size_t body = len;
+    while (body > 0 && data[body - 1] != '\n') {
+        body--;
+    }
+
+    if (chunk_bytes == 0) {
+        chunk_bytes = 1;
+    }
+    if (threads <= 1 || body / chunk_bytes < 2) {
+        feed(data, len);
+        return;
+    }
+
+    /* Chunk i starts at the first line beginning at or after i * chunk_bytes. */
+    const size_t chunks = (body + chunk_bytes - 1) / chunk_bytes;
+    const auto boundary = [&](size_t i) -> size_t {
+        if (i == 0) {
+            return 0;
+        }
+        if (i >= chunks) {
+            return body;
+        }
+        const size_t from = i * chunk_bytes - 1;
+        const char *nl = static_cast<const char *>(std::memchr(data + from, '\n', body - from));
+        return static_cast<size_t>(nl + 1 - data);
+    };
+
+    /*
+     * Workers fill a window of slots ahead of the stitching thread, which
+     * bounds memory to a few chunks regardless of input size.
+     */
+    struct slot {
+        chunk parsed;
+        bool ready = false;
+        std::exception_ptr error;
+    };
+    const size_t window = 2 * static_cast<size_t>(threads);
+    std::vector<slot> slots(window);
+    std::mutex mu;
+    std::condition_variable cv;
+    size_t claimed = 0;
+    size_t applied = 0;
+    bool abort = false;
+    const uint64_t base = consumed_;
+
+    const auto work = [&] {
+        for (;;) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mu);
+                cv.wait(lock, [&] { return abort || claimed >= chunks || claimed < applied + window; });
+                if (abort || claimed >= chunks) {
+                    return;
+                }
+                i = claimed++;
+            }
+
+            slot &s = slots[i % window];
+            try {
+                const size_t begin = boundary(i);
+                s.parsed.parse(data + begin, data + boundary(i + 1), base + begin);
+            } catch (...) {
+                s.error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                s.ready = true;
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back(work);
+    }
+
+    std::exception_ptr error;
+    for (size_t i = 0; i < chunks && !error; i++) {
+        slot &s = slots[i % window];
+        {
+            std::unique_lock<std::mutex> lock(mu);
+            cv.wait(lock, [&] { return s.ready; });
+        }
+
+        try {
+            if (s.error) {
+                std::rethrow_exception(s.error);
+            }
+            apply_chunk(s.parsed);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            s.ready = false;
+            applied++;
+            abort = error != nullptr;
+        }
+        cv.notify_all();
+    }
+
+    for (std::thread &th : pool) {
+        th.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    consumed_ += body;
+    feed(data + body, len - body);
+}
+
+}  // namespace vlog
@@ -0,0 +1,235 @@
+#ifndef VLOG_LOG_SYNTAX_H
+#define VLOG_LOG_SYNTAX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "capture_run.h"
+
+namespace vlog {
+namespace log_syntax {
+
+// What one line of logger output says, independent of any decoder state.
+// The meaning of v[] for classify_line() is given per kind.
+enum line_kind : uint8_t {
+    LINE_BLANK,
+    LINE_MALFORMED,
+    LINE_IGNORED,       // Heartbeat, column header or informational comment.
+    LINE_ROW,           // v: tick32, edge, dropped.
+    LINE_START,
+    LINE_STOP,
+    LINE_BANNER,        // `# validation-logger`.
+    LINE_F_CPU,         // v[0]: header value (likewise for the next three).
+    LINE_BAUD,
+    LINE_PRESCALER,
+    LINE_BUFFER_SIZE,
+    LINE_ICNC1_ON,
+    LINE_ICNC1_OFF,
+    LINE_SUMMARY,       // v: start, end, edges, periods, min, max, mean, dropped.
+    LINE_METER,         // v: start, end, periods, span, freq_mhz, duty_ppm, dropped.
+    LINE_MODE,          // v[0]: tick32.
+    LINE_SYNC,          // v[0]: tick32, v[1]: line length including its '\n'.
+    LINE_STATUS,        // v: tick32, ring high-water, dropped.
+};
+
+constexpr size_t MAX_LINE_FIELDS = 8;
+
+/*
+ * Parse an unsigned decimal field.
+ *
+ * Advances *pp past the digits. Fails on an empty field or a value above
+ * `limit`; the caller checks the terminator.
+ */
+inline bool parse_uint(const char **pp, const char *end, uint64_t limit, uint64_t *out) {
+    const char *p = *pp;
+    uint64_t v = 0;
+
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
+    }
+
+    while (p != end && *p >= '0' && *p <= '9') {
+        v = v * 10u + static_cast<uint64_t>(*p - '0');
+        if (v > limit) {
+            return false;
+        }
+        p++;
+    }
+
+    *pp = p;
+    *out = v;
+    return true;
+}
+
+inline bool starts_with(const char *p, const char *end, const char *prefix) {
+    const size_t n = std::strlen(prefix);
+    return static_cast<size_t>(end - p) >= n && std::memcmp(p, prefix, n) == 0;
+}
+
+inline bool equals(const char *p, const char *end, const char *text) {
+    const size_t n = std::strlen(text);
+    return static_cast<size_t>(end - p) == n && std::memcmp(p, text, n) == 0;
+}
+
+/* Parse the value of a `# KEY=<uint32>` header line. */
+inline bool header_uint(const char *p, const char *end, const char *key, uint64_t *out) {
+    if (!starts_with(p, end, key)) {
+        return false;
+    }
+    p += std::strlen(key);
+    return parse_uint(&p, end, UINT32_MAX, out) && p == end;
+}
+
+/*
+ * Parse exactly n comma-separated unsigned fields, each bounded by its
+ * limit, spanning the rest of the line.
+ */
+inline bool parse_fields(const char *p, const char *end, const uint64_t *limits, size_t n,
+                         uint64_t *out) {
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0 && (p == end || *p++ != ',')) {
+            return false;
+        }
+        if (!parse_uint(&p, end, limits[i], &out[i])) {
+            return false;
+        }
+    }
+    return p == end;
+}
+
+/*
+ * Parse a `ticks,edge,dt_ticks,dropped` row.
+ *
+ * dt_ticks is validated for syntax only: it is fully determined by the
+ * tick column and is recomputed by consumers that need it.
+ */
+inline bool parse_row(const char *p, const char *end, uint64_t *v) {
+    uint64_t dt;
+
+    if (!parse_uint(&p, end, UINT32_MAX, &v[0]) || p == end || *p++ != ',') {
+        return false;
+    }
+
+    if (p == end) {
+        return false;
+    }
+    if (*p == 'R') {
+        v[1] = EDGE_RISING;
+    } else if (*p == 'F') {
+        v[1] = EDGE_FALLING;
+    } else {
+        return false;
+    }
+    p++;
+
+    if (p == end || *p++ != ',') {
+        return false;
+    }
+    if (!parse_uint(&p, end, UINT32_MAX, &dt) || p == end || *p++ != ',') {
+        return false;
+    }
+    return parse_uint(&p, end, UINT16_MAX, &v[2]) && p == end;
+}
+
+inline line_kind classify_comment(const char *p, const char *end, uint64_t *v) {
+    static const uint64_t summary_limits[8] = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX,
+                                               UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT16_MAX};
+    static const uint64_t meter_limits[7] = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX,
+                                             UINT32_MAX, UINT32_MAX, UINT16_MAX};
+    static const uint64_t status_limits[3] = {UINT32_MAX, UINT16_MAX, UINT16_MAX};
+
+    if (equals(p, end, "# START")) {
+        return LINE_START;
+    }
+    if (equals(p, end, "# STOP")) {
+        return LINE_STOP;
+    }
+    if (equals(p, end, "# validation-logger")) {
+        return LINE_BANNER;
+    }
+
+    if (header_uint(p, end, "# F_CPU=", v)) {
+        return LINE_F_CPU;
+    }
+    if (header_uint(p, end, "# BAUD=", v)) {
+        return LINE_BAUD;
+    }
+    if (header_uint(p, end, "# TIMER1_PRESCALER=", v)) {
+        return LINE_PRESCALER;
+    }
+    if (header_uint(p, end, "# CAPTURE_BUFFER_SIZE=", v)) {
+        return LINE_BUFFER_SIZE;
+    }
+
+    if (starts_with(p, end, "# SUMMARY,")) {
+        return parse_fields(p + 10, end, summary_limits, 8, v) ? LINE_SUMMARY : LINE_MALFORMED;
+    }
+    if (starts_with(p, end, "# METER,")) {
+        return parse_fields(p + 8, end, meter_limits, 7, v) ? LINE_METER : LINE_MALFORMED;
+    }
+    if (starts_with(p, end, "# MODE=")) {
+        p += 7;
+        if (starts_with(p, end, "SUMMARY,")) {
+            p += 8;
+        } else if (starts_with(p, end, "EDGES,")) {
+            p += 6;
+        } else {
+            return LINE_MALFORMED;
+        }
+        return parse_uint(&p, end, UINT32_MAX, v) && p == end ? LINE_MODE : LINE_MALFORMED;
+    }
+    if (starts_with(p, end, "# SYNC,")) {
+        p += 7;
+        return parse_uint(&p, end, UINT32_MAX, v) && p == end ? LINE_SYNC : LINE_MALFORMED;
+    }
+    if (starts_with(p, end, "# STATUS,")) {
+        return parse_fields(p + 9, end, status_limits, 3, v) ? LINE_STATUS : LINE_MALFORMED;
+    }
+
+    if (equals(p, end, "# ICNC1=ON")) {
+        return LINE_ICNC1_ON;
+    }
+    if (equals(p, end, "# ICNC1=OFF")) {
+        return LINE_ICNC1_OFF;
+    }
+
+    /* Any other comment is informational. */
+    return LINE_IGNORED;
+}
+
+/*
+ * Classify one line (without its '\n'; a trailing '\r' is allowed) and
+ * extract its fields into v[0 .. MAX_LINE_FIELDS).
+ */
+inline line_kind classify_line(const char *p, const char *end, uint64_t *v) {
+    const uint64_t length = static_cast<uint64_t>(end - p) + 1;
+
+    /* Firmware terminates lines with CRLF; tolerate bare LF as well. */
+    if (p != end && end[-1] == '\r') {
+        end--;
+    }
+
+    if (p == end) {
+        return LINE_BLANK;
+    }
+    if (*p >= '0' && *p <= '9') {
+        return parse_row(p, end, v) ? LINE_ROW : LINE_MALFORMED;
+    }
+    if (*p == '#') {
+        const line_kind kind = classify_comment(p, end, v);
+        if (kind == LINE_SYNC) {
+            v[1] = length;
+        }
+        return kind;
+    }
+    if (equals(p, end, "alive") || starts_with(p, end, "ticks,")) {
+        return LINE_IGNORED;
+    }
+    return LINE_MALFORMED;
+}
+
+}  // namespace log_syntax
+}  // namespace vlog
+
+#endif  // VLOG_LOG_SYNTAX_H
@@ -0,0 +1,151 @@
+#include "manchester.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace vlog {
+
+manchester_decoder::manchester_decoder(frame_sink &out, const manchester_options &options)
+    : edge_decoder(out), options_(options) {
+    // Above 1/3 the half-bit and full-bit windows would overlap.
+    if (!(options.bit_rate > 0.0) || !(options.tolerance > 0.0) || options.tolerance >= 1.0 / 3) {
+        throw std::invalid_argument("invalid Manchester options");
+    }
+}
+
+void manchester_decoder::reset(const run_config &config) {
+    half_ticks_ = tick_rate(config) / options_.bit_rate / 2.0;
+    short_min_ = half_ticks_ * (1.0 - options_.tolerance);
+    short_max_ = half_ticks_ * (1.0 + options_.tolerance);
+    long_min_ = 2.0 * short_min_;
+    long_max_ = 2.0 * short_max_;
+    have_last_ = false;
+    locked_ = false;
+    boundary_ = false;
+}
+
+void manchester_decoder::bit(int64_t mid, uint8_t edge) {
+    const int64_t half = std::llround(half_ticks_);
+    protocol_frame f;
+    f.start = mid - half;
+    f.end = mid + half;
+    f.value = (edge == EDGE_RISING) == options_.ieee ? 1 : 0;
+    f.bits = 1;
+    f.kind = FRAME_BIT;
+    f.flags = 0;
+    emit(f);
+}
+
+void manchester_decoder::violation(int64_t at) {
+    protocol_frame f;
+    f.start = last_tick_;
+    f.end = at;
+    f.value = 0;
+    f.bits = 0;
+    f.kind = FRAME_BIT;
+    f.flags = FRAME_ERR_CODING;
+    emit(f);
+    locked_ = false;
+}
+
+void manchester_decoder::edges(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                               size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const int64_t t = ticks[i];
+        const double d = static_cast<double>(t - last_tick_);
+        const bool is_short = d >= short_min_ && d <= short_max_;
+        const bool is_long = d >= long_min_ && d <= long_max_;
+
+        if (!have_last_ || gap[i] != 0) {
+            if (have_last_ && locked_) {
+                violation(t);
+            }
+            have_last_ = true;
+            locked_ = false;
+        } else if (locked_) {
+            if (boundary_ ? is_short : is_long) {
+                bit(t, edge[i]);
+                boundary_ = false;
+            } else if (!boundary_ && is_short) {
+                boundary_ = true;
+            } else if (d > long_max_) {
+                locked_ = false;
+            } else {
+                violation(t);
+            }
+        } else if (is_long) {
+            bit(last_tick_, last_edge_);
+            bit(t, edge[i]);
+            locked_ = true;
+            boundary_ = false;
+        }
+
+        last_tick_ = t;
+        last_edge_ = edge[i];
+    }
+    flush();
+}
+
+void manchester_decoder::finish() {
+    have_last_ = false;
+    locked_ = false;
+    flush();
+    out_.finish();
+}
+
+bit_assembler::bit_assembler(frame_sink &out, const assembler_options &options)
+    : frame_decoder(out), options_(options) {
+    if (options.word_bits < 1 || options.word_bits > 64) {
+        throw std::invalid_argument("word size must be 1..64 bits");
+    }
+}
+
+void bit_assembler::close_word() {
+    if (open_) {
+        word_.flags |= FRAME_ERR_INCOMPLETE;
+        emit(word_);
+        open_ = false;
+    }
+}
+
+void bit_assembler::frames(const protocol_frame *f, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const protocol_frame &b = f[i];
+        if (b.kind != FRAME_BIT || b.flags != 0) {
+            close_word();
+            emit(b);
+            continue;
+        }
+
+        // A bit that does not follow on within half a cell starts a new word.
+        if (open_ && b.start - word_.end > (b.end - b.start) / 2) {
+            close_word();
+        }
+        if (!open_) {
+            word_ = protocol_frame{b.start, b.end, 0, 0, FRAME_WORD, 0};
+            open_ = true;
+        }
+
+        if (options_.msb_first) {
+            word_.value = (word_.value << 1) | (b.value & 1);
+        } else {
+            word_.value |= (b.value & 1) << word_.bits;
+        }
+        word_.bits++;
+        word_.end = b.end;
+
+        if (word_.bits == options_.word_bits) {
+            emit(word_);
+            open_ = false;
+        }
+    }
+    flush();
+}
+
+void bit_assembler::finish() {
+    close_word();
+    flush();
+    out_.finish();
+}
+
+}  // namespace vlog
@@ -0,0 +1,84 @@
+#ifndef VLOG_MANCHESTER_H
+#define VLOG_MANCHESTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+
+namespace vlog {
+
+struct manchester_options {
+    double bit_rate = 1000.0;   // Bits per second.
+    bool ieee = true;           // IEEE 802.3: rising mid-bit = 1 (else G. E. Thomas).
+    double tolerance = 0.25;    // Accepted timing error, fraction of the nominal interval.
+};
+
+/*
+ * Manchester decoder, classifying the interval between edges.
+ *
+ * Every bit has an edge at mid-cell; consecutive equal bits add one at the
+ * cell boundary. So a full-bit interval always joins two mid-bit edges,
+ * and a half-bit interval joins a mid-bit edge and a boundary. The decoder
+ * locks onto the first full-bit interval (any 0/1 change, e.g. a preamble)
+ * and then follows the half/full pattern. An interval longer than a bit
+ * ends the frame quietly; any other timing emits a FRAME_ERR_CODING frame
+ * and drops lock. Emits one FRAME_BIT per bit.
+ */
+class manchester_decoder : public edge_decoder {
+public:
+    manchester_decoder(frame_sink &out, const manchester_options &options);
+
+    void reset(const run_config &config) override;
+    void edges(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+               size_t n) override;
+    void finish() override;
+
+private:
+    void bit(int64_t mid, uint8_t edge);
+    void violation(int64_t at);
+
+    manchester_options options_;
+    double half_ticks_ = 0.0;
+    double short_min_ = 0.0;
+    double short_max_ = 0.0;
+    double long_min_ = 0.0;
+    double long_max_ = 0.0;
+
+    bool have_last_ = false;
+    bool locked_ = false;
+    bool boundary_ = false;    // Last edge was a cell boundary.
+    int64_t last_tick_ = 0;
+    uint8_t last_edge_ = 0;
+};
+
+struct assembler_options {
+    unsigned word_bits = 8;     // 1..64.
+    bool msb_first = true;
+};
+
+/*
+ * Chain stage packing consecutive FRAME_BIT frames into FRAME_WORDs.
+ *
+ * A word also ends early, flagged FRAME_ERR_INCOMPLETE, at an error frame
+ * or where the next bit does not follow on directly (the line went idle).
+ * Other frame kinds are passed through untouched.
+ */
+class bit_assembler : public frame_decoder {
+public:
+    bit_assembler(frame_sink &out, const assembler_options &options);
+
+    void frames(const protocol_frame *f, size_t n) override;
+    void finish() override;
+
+private:
+    void close_word();
+
+    assembler_options options_;
+    protocol_frame word_ = {};
+    bool open_ = false;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_MANCHESTER_H
@@ -0,0 +1,73 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace vlog {
+
+mapped_file::mapped_file(const std::string &path) : path_(path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        const int err = errno;
+        ::close(fd);
+        throw std::runtime_error(path + ": " + std::strerror(err));
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void *p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            const int err = errno;
+            ::close(fd);
+            throw std::runtime_error(path + ": mmap: " + std::strerror(err));
+        }
+        data_ = static_cast<const uint8_t *>(p);
+
+        /* Logs and run files are almost always scanned front to back. */
+        ::madvise(p, size_, MADV_SEQUENTIAL);
+    }
+
+    /* The mapping keeps the file contents alive; the descriptor is not needed. */
+    ::close(fd);
+}
+
+mapped_file::~mapped_file() {
+    release();
+}
+
+mapped_file::mapped_file(mapped_file &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      path_(std::move(other.path_)) {}
+
+mapped_file &mapped_file::operator=(mapped_file &&other) noexcept {
+    if (this != &other) {
+        release();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        path_ = std::move(other.path_);
+    }
+    return *this;
+}
+
+void mapped_file::release() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<uint8_t *>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+}  // namespace vlog
@@ -0,0 +1,43 @@
+#ifndef VLOG_MAPPED_FILE_H
+#define VLOG_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace vlog {
+
+/*
+ * Read-only memory mapping of an entire file.
+ *
+ * Large logs and run files are accessed through the page cache rather than
+ * copied into heap buffers. An empty file maps to a null pointer and zero
+ * size. Throws std::runtime_error if the file cannot be opened or mapped.
+ */
+class mapped_file {
+public:
+    mapped_file() = default;
+    explicit mapped_file(const std::string &path);
+    ~mapped_file();
+
+    mapped_file(mapped_file &&other) noexcept;
+    mapped_file &operator=(mapped_file &&other) noexcept;
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    const uint8_t *data() const { return data_; }
+    const char *chars() const { return reinterpret_cast<const char *>(data_); }
+    size_t size() const { return size_; }
+    const std::string &path() const { return path_; }
+
+private:
+    void release();
+
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    std::string path_;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_MAPPED_FILE_H
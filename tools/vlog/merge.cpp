@@ -0,0 +1,159 @@
+#include "merge.h"
+
+#include <algorithm>
+
+namespace vlog {
+
+merge_source::merge_source(const std::string &log, const std::string &stamps, double memory,
+                           size_t hold_limit)
+    : file_(log), stamps_(stamps), clock_(stamps_, memory), hold_limit_(hold_limit) {
+    if (file_.size() != 0 && file_.data()[0] == 0) {
+        framed_.reset(new binary_log_decoder(*this));
+    } else {
+        text_.reset(new log_decoder(*this));
+    }
+}
+
+bool merge_source::fill() {
+    while (head_ == buf_.size()) {
+        buf_.clear();
+        head_ = 0;
+        if (finished_) {
+            return false;
+        }
+        const size_t n = std::min(MERGE_CHUNK, file_.size() - offset_);
+        if (n != 0) {
+            if (framed_) {
+                framed_->feed(file_.chars() + offset_, n);
+            } else {
+                text_->feed(file_.chars() + offset_, n);
+            }
+            offset_ += n;
+        } else {
+            if (framed_) {
+                framed_->finish();
+            } else {
+                text_->finish();
+            }
+            drop_held();
+            finished_ = true;
+        }
+    }
+    return true;
+}
+
+void merge_source::begin_run(const run_info &info) {
+    run_ = info.index;
+    session_ = info.session;
+}
+
+void merge_source::end_run(const run_info &) {}
+
+void merge_source::events(const event_batch &batch) {
+    if (held_.empty() && mapped()) {
+        for (size_t i = 0; i < batch.count; i++) {
+            place(batch.ticks[i], batch.edge[i], run_);
+        }
+        return;
+    }
+
+    /* Wait for this session's first fit; a new session gives up on the
+     * previous one's events. */
+    if (!held_.empty() && held_session_ != session_) {
+        drop_held();
+    }
+    held_session_ = session_;
+    for (size_t i = 0; i < batch.count; i++) {
+        if (held_.size() < hold_limit_) {
+            held_.push_back(timed_event{0, batch.ticks[i], run_, batch.edge[i]});
+        } else {
+            stats_.unaligned++;
+        }
+    }
+}
+
+void merge_source::sync(const sync_point &s) {
+    clock_.sync(s);
+    if (!held_.empty() && clock_.valid() && clock_.session() == held_session_) {
+        for (const timed_event &e : held_) {
+            place(e.ticks, e.edge, e.run);
+        }
+        held_.clear();
+    }
+}
+
+void merge_source::place(int64_t ticks, uint8_t edge, uint32_t run) {
+    int64_t t = clock_.mono_ns(ticks);
+    if (t < last_ns_) {
+        t = last_ns_;
+        stats_.clamped++;
+    }
+    last_ns_ = t;
+    buf_.push_back(timed_event{t, ticks, run, edge});
+    stats_.events++;
+}
+
+void merge_source::drop_held() {
+    stats_.unaligned += held_.size();
+    held_.clear();
+}
+
+namespace {
+
+struct source_head {
+    int64_t time_ns;
+    uint16_t channel;
+};
+
+// Heap order: std::*_heap keep the greatest on top, so "greater" is later.
+bool later(const source_head &a, const source_head &b) {
+    return a.time_ns != b.time_ns ? a.time_ns > b.time_ns : a.channel > b.channel;
+}
+
+}  // namespace
+
+void merge_timelines(const std::vector<merge_source *> &sources, merge_sink &out) {
+    std::vector<source_head> heap;
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i]->fill()) {
+            heap.push_back(source_head{sources[i]->pending()->time_ns, static_cast<uint16_t>(i)});
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        const uint16_t channel = heap.back().channel;
+        heap.pop_back();
+        merge_source &s = *sources[channel];
+
+        /* Hand over everything up to the next source's head. The popped
+         * head itself always qualifies, so each round makes progress. */
+        for (;;) {
+            const timed_event *ev = s.pending();
+            const size_t avail = s.pending_count();
+            size_t n = avail;
+            if (!heap.empty()) {
+                const source_head next = heap.front();
+                n = 0;
+                while (n < avail && later(next, source_head{ev[n].time_ns, channel})) {
+                    n++;
+                }
+            }
+            if (n != 0) {
+                out.events(channel, ev, n);
+                s.consume(n);
+            }
+            if (n < avail) {
+                heap.push_back(source_head{ev[n].time_ns, channel});
+                std::push_heap(heap.begin(), heap.end(), later);
+                break;
+            }
+            if (!s.fill()) {
+                break;
+            }
+        }
+    }
+}
+
+}  // namespace vlog
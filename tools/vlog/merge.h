@@ -0,0 +1,122 @@
+#ifndef VLOG_MERGE_H
+#define VLOG_MERGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binary_log.h"
+#include "clock_sync.h"
+#include "log_decoder.h"
+#include "mapped_file.h"
+
+namespace vlog {
+
+// One event placed on the host timeline.
+struct timed_event {
+    int64_t time_ns;    // CLOCK_MONOTONIC, from the source's clock fit.
+    int64_t ticks;      // Device ticks as decoded.
+    uint32_t run;
+    uint8_t edge;
+};
+
+// Per-source accounting for one merge.
+struct merge_source_stats {
+    uint64_t events = 0;     // Events placed on the timeline.
+    uint64_t unaligned = 0;  // Events dropped: their session had no clock fit in time.
+    uint64_t clamped = 0;    // Events moved later so a fit update cannot reorder them.
+};
+
+/*
+ * One capture as a stream of host-timed events, decoded on demand.
+ *
+ * The log (text, or the framed encoding, recognised by its leading 0x00
+ * delimiter) is fed to the decoder MERGE_CHUNK bytes at a time as the
+ * buffered events are consumed, so a source holds one chunk's events no
+ * matter how long the log is. Ticks are mapped through a device_clock fed
+ * by the log's own sync records and read stamps; each event takes the fit
+ * as it stands at that point of the log.
+ *
+ * Events of a session that has no fit yet (those before its first paired
+ * sync, about a second's worth) are held and placed once the fit arrives;
+ * beyond hold_limit of them, or if it never does, they are dropped and
+ * counted. A fit update can move the mapping back by up to its residual;
+ * events are clamped to the last time placed so each source stays in
+ * order.
+ */
+class merge_source : private run_sink {
+public:
+    static constexpr size_t MERGE_CHUNK = 256u << 10;
+
+    // Throws std::runtime_error if the log or its stamps cannot be read.
+    merge_source(const std::string &log, const std::string &stamps, double memory = 300.0,
+                 size_t hold_limit = 1u << 20);
+
+    // Make at least one event available, decoding more of the log as
+    // needed. Returns false once the log is exhausted.
+    bool fill();
+
+    // Available events, oldest first; valid until the next fill().
+    const timed_event *pending() const { return buf_.data() + head_; }
+    size_t pending_count() const { return buf_.size() - head_; }
+    void consume(size_t n) { head_ += n; }
+
+    const std::string &path() const { return file_.path(); }
+    const device_clock &clock() const { return clock_; }
+    const merge_source_stats &stats() const { return stats_; }
+
+private:
+    void begin_run(const run_info &info) override;
+    void events(const event_batch &batch) override;
+    void end_run(const run_info &info) override;
+    void sync(const sync_point &s) override;
+
+    bool mapped() const { return clock_.valid() && clock_.session() == session_; }
+    void place(int64_t ticks, uint8_t edge, uint32_t run);
+    void drop_held();
+
+    mapped_file file_;
+    read_stamps stamps_;
+    device_clock clock_;
+    std::unique_ptr<log_decoder> text_;
+    std::unique_ptr<binary_log_decoder> framed_;
+    size_t offset_ = 0;
+    bool finished_ = false;
+
+    uint32_t run_ = 0;
+    uint32_t session_ = 0;
+    int64_t last_ns_ = INT64_MIN;
+
+    std::vector<timed_event> buf_;
+    size_t head_ = 0;
+    std::vector<timed_event> held_;     // time_ns unset until placed.
+    uint32_t held_session_ = 0;
+    size_t hold_limit_;
+
+    merge_source_stats stats_;
+};
+
+// Receiver for the merged timeline: consecutive events of one source at a
+// time, in time order across calls. Pointers are valid during the call.
+class merge_sink {
+public:
+    virtual ~merge_sink() = default;
+    virtual void events(uint16_t channel, const timed_event *ev, size_t n) = 0;
+};
+
+/*
+ * k-way merge of sources into one time-ordered stream. Channel ids are
+ * positions in `sources`; equal times go to the lower channel.
+ *
+ * A binary heap holds each source's head time. Rather than popping one
+ * event per heap operation, the source on top hands over every event up
+ * to the next source's head in one call, so sources that alternate in
+ * bursts cost about one heap operation per burst.
+ */
+void merge_timelines(const std::vector<merge_source *> &sources, merge_sink &out);
+
+}  // namespace vlog
+
+#endif  // VLOG_MERGE_H
@@ -0,0 +1,289 @@
+#include "metrics.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace vlog {
+
+namespace {
+
+// How long a client has to send its request before it gets bare text.
+constexpr int REQUEST_WAIT_MS = 200;
+
+std::runtime_error sys_error(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+std::string format_value(double v) {
+    if (std::isinf(v)) {
+        return v > 0 ? "+Inf" : "-Inf";
+    }
+    if (std::isnan(v)) {
+        return "NaN";
+    }
+    char buf[32];
+    if (v == std::floor(v) && std::fabs(v) < 1e15) {
+        std::snprintf(buf, sizeof(buf), "%.0f", v);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.9g", v);
+    }
+    return buf;
+}
+
+void append_escaped(std::string &out, const std::string &s) {
+    for (const char c : s) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+}
+
+bool write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        const ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            return false;
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+}  // namespace
+
+void latency_histogram::observe(double seconds) {
+    size_t b = 0;
+    while (b + 1 < LATENCY_BUCKETS && seconds > LATENCY_BOUNDS[b]) {
+        b++;
+    }
+    buckets_[b].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(static_cast<uint64_t>(std::max(0.0, seconds) * 1e9),
+                      std::memory_order_relaxed);
+}
+
+histogram_snapshot latency_histogram::snapshot() const {
+    histogram_snapshot s;
+    uint64_t total = 0;
+    for (size_t b = 0; b < LATENCY_BUCKETS; b++) {
+        total += buckets_[b].load(std::memory_order_relaxed);
+        s.buckets[b] = total;
+    }
+    s.count = total;
+    s.sum = sum_ns_.load(std::memory_order_relaxed) * 1e-9;
+    return s;
+}
+
+void openmetrics_writer::family(const std::string &name, kind type, const std::string &help,
+                                const std::string &unit) {
+    static const char *const TYPES[] = {"counter", "gauge", "histogram"};
+    name_ = name;
+    kind_ = type;
+    out_ += "# TYPE " + name + " " + TYPES[type] + "\n";
+    if (!unit.empty()) {
+        out_ += "# UNIT " + name + " " + unit + "\n";
+    }
+    out_ += "# HELP " + name + " ";
+    append_escaped(out_, help);
+    out_ += "\n";
+}
+
+void openmetrics_writer::line(const std::string &suffix,
+                              const std::vector<std::pair<std::string, std::string>> &labels,
+                              const std::string *le, double value) {
+    out_ += name_ + suffix;
+    if (!labels.empty() || le != nullptr) {
+        out_ += '{';
+        bool first = true;
+        for (const auto &l : labels) {
+            out_ += first ? "" : ",";
+            out_ += l.first + "=\"";
+            append_escaped(out_, l.second);
+            out_ += '"';
+            first = false;
+        }
+        if (le != nullptr) {
+            out_ += first ? "le=\"" : ",le=\"";
+            out_ += *le + "\"";
+        }
+        out_ += '}';
+    }
+    out_ += ' ' + format_value(value) + '\n';
+}
+
+void openmetrics_writer::sample(const std::vector<std::pair<std::string, std::string>> &labels,
+                                double value) {
+    line(kind_ == COUNTER ? "_total" : "", labels, nullptr, value);
+}
+
+void openmetrics_writer::histogram(const std::vector<std::pair<std::string, std::string>> &labels,
+                                   const histogram_snapshot &h) {
+    for (size_t b = 0; b < LATENCY_BUCKETS; b++) {
+        /* Bounds in canonical form, as OpenMetrics asks of `le`: 1.0, not 1. */
+        std::string le = "+Inf";
+        if (b + 1 < LATENCY_BUCKETS) {
+            le = format_value(LATENCY_BOUNDS[b]);
+            if (le.find_first_of(".e") == std::string::npos) {
+                le += ".0";
+            }
+        }
+        line("_bucket", labels, &le, static_cast<double>(h.buckets[b]));
+    }
+    line("_count", labels, nullptr, static_cast<double>(h.count));
+    line("_sum", labels, nullptr, h.sum);
+}
+
+std::string openmetrics_writer::finish() {
+    out_ += "# EOF\n";
+    return std::move(out_);
+}
+
+metrics_server::metrics_server(const std::string &address, std::function<std::string()> render)
+    : render_(std::move(render)) {
+    if (address.find('/') != std::string::npos) {
+        sockaddr_un sa = {};
+        sa.sun_family = AF_UNIX;
+        if (address.size() >= sizeof(sa.sun_path)) {
+            throw std::runtime_error(address + ": socket path too long");
+        }
+        std::memcpy(sa.sun_path, address.c_str(), address.size() + 1);
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            throw sys_error("socket");
+        }
+        unlink(address.c_str());  // A stale socket from an earlier run.
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr *>(&sa), sizeof(sa)) != 0) {
+            const std::runtime_error e = sys_error(address);
+            close(listen_fd_);
+            throw e;
+        }
+        unix_path_ = address;
+        bound_ = address;
+    } else {
+        const size_t colon = address.rfind(':');
+        const std::string host =
+            colon == std::string::npos ? std::string("127.0.0.1") : address.substr(0, colon);
+        const std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+        sockaddr_in sa = {};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(static_cast<uint16_t>(std::atoi(port.c_str())));
+        if (inet_pton(AF_INET, host.c_str(), &sa.sin_addr) != 1) {
+            throw std::runtime_error(address + ": bad IPv4 address");
+        }
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            throw sys_error("socket");
+        }
+        const int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        socklen_t len = sizeof(sa);
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr *>(&sa), sizeof(sa)) != 0 ||
+            getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&sa), &len) != 0) {
+            const std::runtime_error e = sys_error(address);
+            close(listen_fd_);
+            throw e;
+        }
+        bound_ = host + ":" + std::to_string(ntohs(sa.sin_port));
+    }
+
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (listen(listen_fd_, 16) != 0 || stop_fd_ < 0) {
+        const std::runtime_error e = sys_error(address);
+        close(listen_fd_);
+        if (stop_fd_ >= 0) {
+            close(stop_fd_);
+        }
+        if (!unix_path_.empty()) {
+            unlink(unix_path_.c_str());
+        }
+        throw e;
+    }
+    thread_ = std::thread([this] { serve(); });
+}
+
+metrics_server::~metrics_server() {
+    const uint64_t one = 1;
+    const ssize_t r = write(stop_fd_, &one, sizeof(one));
+    (void)r;
+    thread_.join();
+    close(stop_fd_);
+    close(listen_fd_);
+    if (!unix_path_.empty()) {
+        unlink(unix_path_.c_str());
+    }
+}
+
+void metrics_server::serve() {
+    for (;;) {
+        pollfd fds[2] = {{stop_fd_, POLLIN, 0}, {listen_fd_, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[0].revents != 0) {
+            return;
+        }
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            answer(fd);
+            close(fd);
+        }
+    }
+}
+
+void metrics_server::answer(int fd) {
+    /* Read the request head, if the client sends one. */
+    std::string request;
+    char buf[1024];
+    while (request.size() < 8192 && request.find("\r\n\r\n") == std::string::npos &&
+           request.find("\n\n") == std::string::npos) {
+        pollfd p = {fd, POLLIN, 0};
+        if (poll(&p, 1, REQUEST_WAIT_MS) <= 0) {
+            break;
+        }
+        const ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        if (r <= 0) {
+            break;
+        }
+        request.append(buf, static_cast<size_t>(r));
+    }
+
+    const std::string body = render_();
+    if (request.compare(0, 4, "GET ") != 0 && request.compare(0, 5, "HEAD ") != 0) {
+        write_all(fd, body.data(), body.size());
+        return;
+    }
+    const std::string head =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n";
+    if (write_all(fd, head.data(), head.size()) && request[0] == 'G') {
+        write_all(fd, body.data(), body.size());
+    }
+}
+
+}  // namespace vlog
@@ -0,0 +1,108 @@
+#ifndef VLOG_METRICS_H
+#define VLOG_METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vlog {
+
+// Upper bounds of the latency histogram buckets, seconds (+Inf implied).
+constexpr double LATENCY_BOUNDS[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+                                     0.025,  0.05,    0.1,    0.25,  0.5,    1.0,   2.5};
+constexpr size_t LATENCY_BUCKETS = sizeof(LATENCY_BOUNDS) / sizeof(LATENCY_BOUNDS[0]) + 1;
+
+// Point-in-time copy of a latency_histogram; buckets are cumulative.
+struct histogram_snapshot {
+    uint64_t buckets[LATENCY_BUCKETS] = {};
+    uint64_t count = 0;
+    double sum = 0.0;            // Seconds.
+};
+
+/*
+ * Latency histogram updated with relaxed atomic increments only, so the
+ * thread observing never waits for one reading it. A snapshot taken while
+ * observations land may be off by those in flight, as scrapes tolerate.
+ */
+class latency_histogram {
+public:
+    void observe(double seconds);
+    histogram_snapshot snapshot() const;
+
+private:
+    std::atomic<uint64_t> buckets_[LATENCY_BUCKETS] = {};
+    std::atomic<uint64_t> sum_ns_{0};
+};
+
+/*
+ * Builder for OpenMetrics text exposition.
+ *
+ * Call family() once per metric family, then add its samples; finish()
+ * appends the terminating `# EOF`. Counter samples get the `_total`
+ * suffix, histograms their `_bucket`, `_count` and `_sum` series.
+ */
+class openmetrics_writer {
+public:
+    enum kind { COUNTER, GAUGE, HISTOGRAM };
+
+    void family(const std::string &name, kind type, const std::string &help,
+                const std::string &unit = std::string());
+
+    // `labels` is a list of name/value pairs.
+    void sample(const std::vector<std::pair<std::string, std::string>> &labels, double value);
+    void histogram(const std::vector<std::pair<std::string, std::string>> &labels,
+                   const histogram_snapshot &h);
+
+    std::string finish();
+
+private:
+    void line(const std::string &suffix,
+              const std::vector<std::pair<std::string, std::string>> &labels,
+              const std::string *le, double value);
+
+    std::string out_;
+    std::string name_;
+    kind kind_ = GAUGE;
+};
+
+/*
+ * Serves a metrics exposition on a local socket.
+ *
+ * `address` is a filesystem path (anything containing '/') for a Unix
+ * socket, or [host:]port for TCP, host defaulting to 127.0.0.1. Each
+ * connection gets the output of `render` once: as an HTTP response if it
+ * sends a request, so Prometheus or `curl --unix-socket` can scrape it,
+ * or as bare text if it sends nothing within a moment, for socat and nc.
+ * Connections are served one at a time on the server's own thread.
+ * Throws std::runtime_error if the address cannot be bound.
+ */
+class metrics_server {
+public:
+    metrics_server(const std::string &address, std::function<std::string()> render);
+    ~metrics_server();
+
+    metrics_server(const metrics_server &) = delete;
+    metrics_server &operator=(const metrics_server &) = delete;
+
+    // Address actually bound, with the port when 0 was asked for.
+    const std::string &address() const { return bound_; }
+
+private:
+    void serve();
+    void answer(int fd);
+
+    std::function<std::string()> render_;
+    std::string unix_path_;
+    std::string bound_;
+    int listen_fd_ = -1;
+    int stop_fd_ = -1;
+    std::thread thread_;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_METRICS_H
@@ -0,0 +1,233 @@
+#include "packed_run.h"
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace vlog {
+
+namespace {
+
+[[noreturn]] void io_error(const std::string &what) {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+std::string packed_run_path(const std::string &dir, const std::string &stem, uint32_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%04u.vlz", index);
+    return dir + "/" + stem + name;
+}
+
+packed_run::packed_run(const std::string &path) : file_(path) {
+    const uint8_t *base = file_.data();
+    const uint64_t size = file_.size();
+    const uint64_t preamble = sizeof(packed_file_header) + sizeof(run_file_header);
+
+    if (size < preamble) {
+        throw std::runtime_error(path + ": not a packed run (too short)");
+    }
+    header_ = reinterpret_cast<const packed_file_header *>(base);
+    run_header_ = reinterpret_cast<const run_file_header *>(base + sizeof(packed_file_header));
+
+    if (std::memcmp(header_->magic, PACKED_FILE_MAGIC, sizeof(PACKED_FILE_MAGIC)) != 0) {
+        throw std::runtime_error(path + ": not a packed run (bad magic)");
+    }
+    if (header_->version != PACKED_FILE_VERSION) {
+        throw std::runtime_error(path + ": unsupported packed run version " +
+                                 std::to_string(header_->version));
+    }
+
+    const uint64_t blocks = header_->block_count;
+    if (header_->index_offset % alignof(packed_block_entry) != 0 ||
+        header_->index_offset < preamble || header_->index_offset > size ||
+        blocks > (size - header_->index_offset) / sizeof(packed_block_entry)) {
+        throw std::runtime_error(path + ": packed run index is truncated or corrupt");
+    }
+    index_ = reinterpret_cast<const packed_block_entry *>(base + header_->index_offset);
+}
+
+size_t packed_run::decode_block(size_t i, int64_t *ticks, uint8_t *edge, uint16_t *gap) const {
+    const uint64_t offset = index_[i].offset;
+    if (offset % 8 != 0 || offset >= header_->index_offset) {
+        throw std::runtime_error(file_.path() + ": bad block offset");
+    }
+    return decode_tick_block(file_.data() + offset,
+                             static_cast<size_t>(header_->index_offset - offset), ticks, edge, gap);
+}
+
+/*
+ * Decode every block straight into the output columns.
+ *
+ * Blocks are independent, so workers take contiguous block ranges and
+ * write disjoint slices of the result without any coordination.
+ */
+capture_run packed_run::decode_all(unsigned threads) const {
+    capture_run run;
+    run.info = info();
+    run.ticks.resize(size());
+    run.edge.resize(size());
+    run.gap.resize(size());
+
+    const size_t blocks = block_count();
+    for (size_t i = 0; i < blocks; i++) {
+        if (index_[i].first_event > size()) {
+            throw std::runtime_error(file_.path() + ": block index out of range");
+        }
+    }
+
+    const auto work = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const size_t at = static_cast<size_t>(index_[i].first_event);
+            int64_t ticks[TICK_BLOCK_EVENTS];
+            uint8_t edge[TICK_BLOCK_EVENTS];
+            uint16_t gap[TICK_BLOCK_EVENTS];
+
+            const size_t n = decode_block(i, ticks, edge, gap);
+            const size_t room = size() - at;
+            const size_t keep = n < room ? n : room;
+            std::memcpy(&run.ticks[at], ticks, keep * sizeof(int64_t));
+            std::memcpy(&run.edge[at], edge, keep * sizeof(uint8_t));
+            std::memcpy(&run.gap[at], gap, keep * sizeof(uint16_t));
+        }
+    };
+
+    if (threads <= 1 || blocks < 2) {
+        work(0, blocks);
+        return run;
+    }
+
+    std::vector<std::thread> pool;
+    std::vector<std::exception_ptr> errors(threads);
+    for (unsigned t = 0; t < threads; t++) {
+        const size_t begin = blocks * t / threads;
+        const size_t end = blocks * (t + 1) / threads;
+        pool.emplace_back([&, t, begin, end] {
+            try {
+                work(begin, end);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread &th : pool) {
+        th.join();
+    }
+    for (const std::exception_ptr &e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+    return run;
+}
+
+packed_run_writer::packed_run_writer(std::string dir, std::string stem)
+    : dir_(std::move(dir)), stem_(std::move(stem)) {
+    ticks_.reserve(TICK_BLOCK_EVENTS);
+    edge_.reserve(TICK_BLOCK_EVENTS);
+    gap_.reserve(TICK_BLOCK_EVENTS);
+}
+
+packed_run_writer::~packed_run_writer() {
+    if (out_ != nullptr) {
+        std::fclose(out_);
+    }
+}
+
+void packed_run_writer::write(const void *data, size_t len) {
+    if (len > 0 && std::fwrite(data, 1, len, out_) != len) {
+        io_error(path_);
+    }
+    pos_ += len;
+}
+
+void packed_run_writer::begin_run(const run_info &info) {
+    if (out_ != nullptr) {
+        std::fclose(out_);
+    }
+
+    path_ = packed_run_path(dir_, stem_, info.index);
+    out_ = std::fopen(path_.c_str(), "wb");
+    if (out_ == nullptr) {
+        io_error(path_);
+    }
+    pos_ = 0;
+    events_ = 0;
+    index_.clear();
+
+    /* Placeholders; both headers are rewritten at end_run(). */
+    packed_file_header h;
+    std::memset(&h, 0, sizeof(h));
+    write(&h, sizeof(h));
+    const run_file_header rh = make_run_file_header(info);
+    write(&rh, sizeof(rh));
+}
+
+void packed_run_writer::events(const event_batch &batch) {
+    size_t i = 0;
+    while (i < batch.count) {
+        const size_t room = TICK_BLOCK_EVENTS - ticks_.size();
+        const size_t take = batch.count - i < room ? batch.count - i : room;
+
+        ticks_.insert(ticks_.end(), batch.ticks + i, batch.ticks + i + take);
+        edge_.insert(edge_.end(), batch.edge + i, batch.edge + i + take);
+        gap_.insert(gap_.end(), batch.gap + i, batch.gap + i + take);
+        i += take;
+
+        if (ticks_.size() == TICK_BLOCK_EVENTS) {
+            flush_block();
+        }
+    }
+}
+
+void packed_run_writer::flush_block() {
+    if (ticks_.empty()) {
+        return;
+    }
+
+    index_.push_back(packed_block_entry{pos_, events_, ticks_[0]});
+
+    encoded_.clear();
+    encode_tick_block(ticks_.data(), edge_.data(), gap_.data(), ticks_.size(), encoded_);
+    write(encoded_.data(), encoded_.size());
+
+    events_ += ticks_.size();
+    ticks_.clear();
+    edge_.clear();
+    gap_.clear();
+}
+
+void packed_run_writer::end_run(const run_info &info) {
+    flush_block();
+
+    packed_file_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, PACKED_FILE_MAGIC, sizeof(h.magic));
+    h.version = PACKED_FILE_VERSION;
+    h.block_events = TICK_BLOCK_EVENTS;
+    h.event_count = events_;
+    h.block_count = index_.size();
+    h.index_offset = pos_;
+
+    write(index_.data(), index_.size() * sizeof(packed_block_entry));
+
+    if (std::fseek(out_, 0, SEEK_SET) != 0) {
+        io_error(path_);
+    }
+    write(&h, sizeof(h));
+    const run_file_header rh = make_run_file_header(info);
+    write(&rh, sizeof(rh));
+
+    const int rc = std::fclose(out_);
+    out_ = nullptr;
+    if (rc != 0) {
+        io_error(path_);
+    }
+    paths_.push_back(path_);
+}
+
+}  // namespace vlog
@@ -0,0 +1,116 @@
+#ifndef VLOG_PACKED_RUN_H
+#define VLOG_PACKED_RUN_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+#include "mapped_file.h"
+#include "run_file.h"
+#include "tick_codec.h"
+
+namespace vlog {
+
+/*
+ * Compressed run file (.vlz).
+ *
+ *   [packed_file_header, 64 bytes]
+ *   [run_file_header, 128 bytes]      run identity / configuration
+ *   [tick blocks...]                  see tick_codec.h, each 8-byte aligned
+ *   [block index]                     one packed_block_entry per block
+ *
+ * The index is only a seek aid: every block is self-describing, so a
+ * damaged index or a file cut short by a crash can still be decoded block
+ * by block from the front.
+ */
+constexpr char PACKED_FILE_MAGIC[8] = {'V', 'L', 'O', 'G', 'P', 'A', 'K', '1'};
+constexpr uint32_t PACKED_FILE_VERSION = 1;
+
+struct packed_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_events;   // Events per block (last block may be short).
+    uint64_t event_count;
+    uint64_t block_count;
+    uint64_t index_offset;
+    uint8_t reserved[24];
+};
+
+static_assert(sizeof(packed_file_header) == 64, "packed_file_header layout changed");
+
+struct packed_block_entry {
+    uint64_t offset;       // File offset of the block header.
+    uint64_t first_event;  // Index of the block's first event in the run.
+    int64_t first_tick;    // Tick of that event (for time seeks).
+};
+
+// Memory-mapped compressed run.
+class packed_run {
+public:
+    explicit packed_run(const std::string &path);
+
+    size_t size() const { return static_cast<size_t>(header_->event_count); }
+    size_t block_count() const { return static_cast<size_t>(header_->block_count); }
+    const packed_block_entry &block(size_t i) const { return index_[i]; }
+    run_info info() const { return run_file_header_info(*run_header_); }
+
+    // Decode block `i` into arrays of TICK_BLOCK_EVENTS entries; returns its count.
+    size_t decode_block(size_t i, int64_t *ticks, uint8_t *edge, uint16_t *gap) const;
+
+    // Decode the whole run, splitting blocks across `threads` workers.
+    capture_run decode_all(unsigned threads = 1) const;
+
+    const std::string &path() const { return file_.path(); }
+
+private:
+    mapped_file file_;
+    const packed_file_header *header_ = nullptr;
+    const run_file_header *run_header_ = nullptr;
+    const packed_block_entry *index_ = nullptr;
+};
+
+/*
+ * Sink that writes each run as <dir>/<stem>_<NNNN>.vlz.
+ *
+ * Events are staged one block at a time, so memory use is independent of
+ * run length.
+ */
+class packed_run_writer : public run_sink {
+public:
+    packed_run_writer(std::string dir, std::string stem = "run");
+    ~packed_run_writer() override;
+
+    void begin_run(const run_info &info) override;
+    void events(const event_batch &batch) override;
+    void end_run(const run_info &info) override;
+
+    const std::vector<std::string> &paths() const { return paths_; }
+
+private:
+    void flush_block();
+    void write(const void *data, size_t len);
+
+    std::string dir_;
+    std::string stem_;
+    std::string path_;
+    std::FILE *out_ = nullptr;
+    uint64_t pos_ = 0;
+    uint64_t events_ = 0;
+
+    std::vector<int64_t> ticks_;
+    std::vector<uint8_t> edge_;
+    std::vector<uint16_t> gap_;
+    std::vector<uint8_t> encoded_;
+    std::vector<packed_block_entry> index_;
+    std::vector<std::string> paths_;
+};
+
+// Path a packed_run_writer uses for run `index`.
+std::string packed_run_path(const std::string &dir, const std::string &stem, uint32_t index);
+
+}  // namespace vlog
+
+#endif  // VLOG_PACKED_RUN_H
@@ -0,0 +1,120 @@
+#ifndef VLOG_PROTOCOL_H
+#define VLOG_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+
+namespace vlog {
+
+// What a protocol_frame carries.
+enum frame_kind : uint8_t {
+    FRAME_UART,   // One asynchronous serial character.
+    FRAME_BIT,    // One line-coded bit (Manchester).
+    FRAME_WORD,   // Bits assembled into a word.
+};
+
+// Frame error flags.
+enum : uint8_t {
+    FRAME_ERR_FRAMING = 1 << 0,    // Stop bit not at mark level.
+    FRAME_ERR_PARITY = 1 << 1,
+    FRAME_ERR_DROPPED = 1 << 2,    // Events were lost inside the frame.
+    FRAME_ERR_CODING = 1 << 3,     // Line code violation; value is meaningless.
+    FRAME_ERR_INCOMPLETE = 1 << 4, // Fewer bits than configured.
+};
+
+// One decoded unit, timestamped in run ticks.
+struct protocol_frame {
+    int64_t start;    // Tick the frame begins (start bit edge, bit cell start).
+    int64_t end;      // Tick just past its last bit cell.
+    uint64_t value;
+    uint16_t bits;    // Significant bits in value.
+    uint8_t kind;     // frame_kind
+    uint8_t flags;    // FRAME_ERR_* bits
+};
+
+// Receiver for decoded frames. Frame pointers are only valid during the call.
+class frame_sink {
+public:
+    virtual ~frame_sink() = default;
+    virtual void frames(const protocol_frame *f, size_t n) = 0;
+
+    // End of the current run; no frame is pending after this.
+    virtual void finish() {}
+};
+
+/*
+ * Common plumbing for decoders: frames emitted while handling one input
+ * batch are collected and handed downstream as a single batch.
+ */
+class frame_source {
+public:
+    explicit frame_source(frame_sink &out) : out_(out) {}
+    virtual ~frame_source() = default;
+
+protected:
+    void emit(const protocol_frame &f) { pending_.push_back(f); }
+
+    void flush() {
+        if (!pending_.empty()) {
+            out_.frames(pending_.data(), pending_.size());
+            pending_.clear();
+        }
+    }
+
+    frame_sink &out_;
+
+private:
+    std::vector<protocol_frame> pending_;
+};
+
+/*
+ * First stage of a chain: a state machine over a run's edges.
+ *
+ * reset() starts a new run with that run's timer configuration (so rates
+ * given in Hz can be converted to ticks); edges() may then be called any
+ * number of times with consecutive slices of the run, and finish() flushes
+ * whatever frame is still open, assuming the line stays idle.
+ */
+class edge_decoder : public frame_source {
+public:
+    using frame_source::frame_source;
+
+    virtual void reset(const run_config &config) = 0;
+    virtual void edges(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                       size_t n) = 0;
+    virtual void finish() = 0;
+};
+
+// Later stage of a chain: consumes the frames of the stage before it.
+class frame_decoder : public frame_source, public frame_sink {
+public:
+    using frame_source::frame_source;
+};
+
+/*
+ * Drive an edge decoder chain from decoded or replayed runs, so it can sit
+ * behind log_decoder or replay_run_file.
+ */
+class protocol_runner : public run_sink {
+public:
+    explicit protocol_runner(edge_decoder &decoder) : decoder_(decoder) {}
+
+    void begin_run(const run_info &info) override { decoder_.reset(info.config); }
+
+    void events(const event_batch &batch) override {
+        decoder_.edges(batch.ticks, batch.edge, batch.gap, batch.count);
+    }
+
+    void end_run(const run_info &) override { decoder_.finish(); }
+
+private:
+    edge_decoder &decoder_;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_PROTOCOL_H
@@ -0,0 +1,426 @@
+#include "pulse_search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "packed_run.h"
+#include "run_file.h"
+
+namespace vlog {
+
+namespace {
+
+// Events per unit of parallel work.
+constexpr size_t CHUNK_EVENTS = size_t(1) << 22;
+
+std::runtime_error pattern_error(const std::string &text, const std::string &what) {
+    return std::runtime_error("pattern '" + text + "': " + what);
+}
+
+// A width in seconds ("100us"), or a percentage as a fraction when allowed.
+double parse_width(const std::string &text, const std::string &s, bool percent) {
+    const char *p = s.c_str();
+    char *stop = nullptr;
+    double v = std::strtod(p, &stop);
+    if (stop == p || v < 0.0) {
+        throw pattern_error(text, "bad width '" + s + "'");
+    }
+    const std::string unit(stop);
+    if (unit.empty() || unit == "s") {
+    } else if (unit == "ms") {
+        v *= 1e-3;
+    } else if (unit == "us" || unit == "\xc2\xb5s") {
+        v *= 1e-6;
+    } else if (unit == "ns") {
+        v *= 1e-9;
+    } else if (percent && unit == "%") {
+        v *= -1e-2;  // Negative marks a fraction.
+    } else {
+        throw pattern_error(text, "unknown unit '" + unit + "'");
+    }
+    return v;
+}
+
+pulse_element parse_element(const std::string &text, const std::string &body, uint8_t level,
+                            double tolerance, bool relative) {
+    pulse_element e;
+    e.level = level;
+    e.max = HUGE_VAL;
+    if (body == "*") {
+        return e;
+    }
+    const size_t dots = body.find("..");
+    if (dots != std::string::npos) {
+        const std::string lo = body.substr(0, dots);
+        const std::string hi = body.substr(dots + 2);
+        e.min = lo.empty() ? 0.0 : parse_width(text, lo, false);
+        e.max = hi.empty() ? HUGE_VAL : parse_width(text, hi, false);
+    } else {
+        const size_t tilde = body.find('~');
+        const double width = parse_width(text, body.substr(0, tilde), false);
+        if (tilde != std::string::npos) {
+            const double t = parse_width(text, body.substr(tilde + 1), true);
+            relative = t < 0.0;
+            tolerance = std::fabs(t);
+        }
+        const double slack = relative ? width * tolerance : tolerance;
+        e.min = std::max(0.0, width - slack);
+        e.max = width + slack;
+    }
+    if (e.min > e.max) {
+        throw pattern_error(text, "empty width range '" + body + "'");
+    }
+    return e;
+}
+
+// One run file, whichever format.
+struct search_input {
+    std::unique_ptr<run_file> mapped;
+    std::unique_ptr<packed_run> packed;
+    run_info info;
+    size_t size = 0;
+};
+
+struct search_item {
+    size_t file;
+    size_t begin;
+    size_t end;
+    std::vector<pulse_match> matches;
+    std::exception_ptr error;
+};
+
+// Decoded events of a .vlz from the block holding `from` until past `end`.
+size_t decode_range(const packed_run &p, size_t from, size_t end, std::vector<int64_t> &ticks,
+                    std::vector<uint8_t> &edge, std::vector<uint16_t> &gap) {
+    size_t lo = 0;
+    size_t hi = p.block_count();
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (p.block(mid).first_event <= from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    const size_t first = lo > 0 ? lo - 1 : 0;
+    const size_t base = static_cast<size_t>(p.block(first).first_event);
+    size_t count = 0;
+    for (size_t b = first; b < p.block_count() && base + count < end; b++) {
+        ticks.resize(count + TICK_BLOCK_EVENTS);
+        edge.resize(count + TICK_BLOCK_EVENTS);
+        gap.resize(count + TICK_BLOCK_EVENTS);
+        count += p.decode_block(b, &ticks[count], &edge[count], &gap[count]);
+    }
+    ticks.resize(count);
+    edge.resize(count);
+    gap.resize(count);
+    return base;
+}
+
+}  // namespace
+
+pulse_pattern parse_pulse_pattern(const std::string &text, const std::string &tolerance_text) {
+    const double t = parse_width(text, tolerance_text, true);
+    const bool relative = t < 0.0;
+    const double tolerance = std::fabs(t);
+
+    pulse_pattern p;
+    p.text = text;
+    size_t at = 0;
+    for (;;) {
+        while (at < text.size() && std::isspace(static_cast<unsigned char>(text[at]))) {
+            at++;
+        }
+        if (at == text.size()) {
+            break;
+        }
+        size_t stop = at;
+        while (stop < text.size() && !std::isspace(static_cast<unsigned char>(text[stop]))) {
+            stop++;
+        }
+        std::string token = text.substr(at, stop - at);
+        at = stop;
+
+        const char c = static_cast<char>(std::toupper(static_cast<unsigned char>(token[0])));
+        if (c != 'H' && c != 'L') {
+            throw pattern_error(text, "element '" + token + "' is not H or L");
+        }
+        size_t repeat = 1;
+        const size_t brace = token.find('{');
+        if (brace != std::string::npos) {
+            char *end = nullptr;
+            repeat = std::strtoul(token.c_str() + brace + 1, &end, 10);
+            if (*end != '}' || end[1] != '\0' || repeat == 0) {
+                throw pattern_error(text, "bad repeat in '" + token + "'");
+            }
+            token.resize(brace);
+        }
+        const uint8_t level = c == 'H' ? 1 : 0;
+        const pulse_element e =
+            parse_element(text, token.substr(1), level, tolerance, relative);
+        for (size_t r = 0; r < repeat; r++) {
+            if (!p.elements.empty() && p.elements.back().level == level) {
+                p.elements.push_back(pulse_element{static_cast<uint8_t>(1 - level), 0.0, HUGE_VAL});
+            }
+            p.elements.push_back(e);
+        }
+    }
+    if (p.elements.empty()) {
+        throw pattern_error(text, "no elements");
+    }
+    return p;
+}
+
+pulse_matcher::pulse_matcher(const std::vector<pulse_pattern> &patterns, double tick_rate) {
+    /* Element ranges in whole ticks, inclusive; INT64_MAX for no bound. */
+    struct range {
+        uint8_t level;
+        int64_t lo;
+        int64_t hi;
+    };
+    std::vector<range> positions;
+    std::vector<size_t> offset;
+    for (uint32_t p = 0; p < patterns.size(); p++) {
+        const std::vector<pulse_element> &el = patterns[p].elements;
+        offset.push_back(positions.size());
+        for (const pulse_element &e : el) {
+            const double lo = std::ceil(e.min * tick_rate);
+            const double hi = std::floor(e.max * tick_rate);
+            positions.push_back(range{e.level, static_cast<int64_t>(std::min(lo, 9e18)),
+                                      hi >= 9e18 ? INT64_MAX : static_cast<int64_t>(hi)});
+        }
+        length_.push_back(static_cast<uint32_t>(el.size()));
+        longest_ = std::max(longest_, el.size());
+    }
+
+    for (const range &r : positions) {
+        if (r.lo > 0) {
+            bounds_[r.level].push_back(r.lo);
+        }
+        if (r.hi < INT64_MAX && r.hi >= r.lo) {
+            bounds_[r.level].push_back(r.hi + 1);
+        }
+    }
+    for (std::vector<int64_t> &b : bounds_) {
+        std::sort(b.begin(), b.end());
+        b.erase(std::unique(b.begin(), b.end()), b.end());
+    }
+    if (bounds_[0].size() + bounds_[1].size() + 2 >= UINT16_MAX) {
+        throw std::runtime_error("pulse patterns have too many distinct widths");
+    }
+    base_[0] = 0;
+    base_[1] = static_cast<uint16_t>(bounds_[0].size() + 1);
+    broken_ = static_cast<uint16_t>(base_[1] + bounds_[1].size() + 1);
+
+    words_ = (positions.size() + 63) / 64;
+    table_.assign((broken_ + 1) * words_, 0);
+    for (uint8_t level = 0; level < 2; level++) {
+        const std::vector<int64_t> &b = bounds_[level];
+        for (size_t bin = 0; bin <= b.size(); bin++) {
+            const int64_t bin_lo = bin == 0 ? 0 : b[bin - 1];
+            const int64_t bin_hi = bin == b.size() ? INT64_MAX : b[bin] - 1;
+            uint64_t *row = &table_[(base_[level] + bin) * words_];
+            for (size_t j = 0; j < positions.size(); j++) {
+                const range &r = positions[j];
+                if (r.level == level && r.lo <= bin_lo && bin_hi <= r.hi) {
+                    row[j / 64] |= uint64_t(1) << (j % 64);
+                }
+            }
+        }
+    }
+
+    /* owner_ maps a final position back to its pattern. */
+    start_.assign(words_, 0);
+    final_.assign(words_, 0);
+    owner_.assign(positions.size(), 0);
+    for (uint32_t p = 0; p < patterns.size(); p++) {
+        const size_t s = offset[p];
+        const size_t f = s + length_[p] - 1;
+        start_[s / 64] |= uint64_t(1) << (s % 64);
+        final_[f / 64] |= uint64_t(1) << (f % 64);
+        owner_[f] = p;
+    }
+    symbols_.resize(BLOCK);
+    state_.resize(words_);
+}
+
+void pulse_matcher::scan(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                         size_t begin, size_t end,
+                         const std::function<void(const pulse_match &)> &fn) {
+    /* The interval ending at event j runs from j - 1; a match ending at
+     * `begin` needs the longest_ intervals before it. */
+    size_t from = begin > longest_ ? begin - longest_ + 1 : 1;
+    std::fill(state_.begin(), state_.end(), 0);
+    int64_t width[BLOCK];
+    uint8_t level[BLOCK];
+    uint16_t count[2][BLOCK];
+
+    for (size_t j = from; j < end; j += BLOCK) {
+        const size_t m = std::min(BLOCK, end - j);
+
+        /* Symbols, one branch-free pass per bound so each vectorises. */
+        for (size_t k = 0; k < m; k++) {
+            width[k] = ticks[j + k] - ticks[j + k - 1];
+            level[k] = edge[j + k - 1] == EDGE_RISING;
+            count[0][k] = base_[0];
+            count[1][k] = base_[1];
+        }
+        for (uint8_t l = 0; l < 2; l++) {
+            for (const int64_t b : bounds_[l]) {
+                uint16_t *c = count[l];
+                for (size_t k = 0; k < m; k++) {
+                    c[k] = static_cast<uint16_t>(c[k] + (width[k] >= b));
+                }
+            }
+        }
+        uint16_t *sym = symbols_.data();
+        for (size_t k = 0; k < m; k++) {
+            const bool ok = gap[j + k] == 0 && edge[j + k] != edge[j + k - 1];
+            const uint16_t s = level[k] ? count[1][k] : count[0][k];
+            sym[k] = ok ? s : broken_;
+        }
+
+        const size_t report = begin > j ? begin - j : 0;
+        if (words_ == 1) {
+            uint64_t s = state_[0];
+            const uint64_t start = start_[0];
+            const uint64_t fin = final_[0];
+            for (size_t k = 0; k < m; k++) {
+                s = ((s << 1) | start) & table_[sym[k]];
+                uint64_t hit = s & fin;
+                while (hit != 0 && k >= report) {
+                    const unsigned bit = static_cast<unsigned>(__builtin_ctzll(hit));
+                    hit &= hit - 1;
+                    const uint32_t p = owner_[bit];
+                    const size_t last = j + k;
+                    const size_t first = last - length_[p];
+                    fn(pulse_match{p, first, last, ticks[first], ticks[last]});
+                }
+            }
+            state_[0] = s;
+            continue;
+        }
+
+        for (size_t k = 0; k < m; k++) {
+            const uint64_t *row = &table_[sym[k] * words_];
+            uint64_t carry = 0;
+            for (size_t w = 0; w < words_; w++) {
+                const uint64_t s = state_[w];
+                state_[w] = ((s << 1) | carry | start_[w]) & row[w];
+                carry = s >> 63;
+            }
+            if (k < report) {
+                continue;
+            }
+            for (size_t w = 0; w < words_; w++) {
+                uint64_t hit = state_[w] & final_[w];
+                while (hit != 0) {
+                    const unsigned bit = static_cast<unsigned>(__builtin_ctzll(hit));
+                    hit &= hit - 1;
+                    const uint32_t p = owner_[w * 64 + bit];
+                    const size_t last = j + k;
+                    const size_t first = last - length_[p];
+                    fn(pulse_match{p, first, last, ticks[first], ticks[last]});
+                }
+            }
+        }
+    }
+}
+
+void search_runs(const std::vector<std::string> &paths,
+                 const std::vector<pulse_pattern> &patterns, unsigned threads,
+                 const std::function<void(size_t file, const run_info &info,
+                                          const pulse_match &m)> &fn) {
+    std::vector<search_input> inputs(paths.size());
+    std::vector<search_item> items;
+    for (size_t f = 0; f < paths.size(); f++) {
+        search_input &in = inputs[f];
+        const std::string &path = paths[f];
+        const size_t dot = path.rfind('.');
+        if (dot != std::string::npos && path.compare(dot, std::string::npos, ".vlz") == 0) {
+            in.packed.reset(new packed_run(path));
+            in.info = in.packed->info();
+            in.size = in.packed->size();
+        } else {
+            in.mapped.reset(new run_file(path));
+            in.info = in.mapped->info();
+            in.size = in.mapped->size();
+        }
+        for (size_t b = 0; b < in.size; b += CHUNK_EVENTS) {
+            items.push_back(search_item{f, b, std::min(in.size, b + CHUNK_EVENTS), {}, nullptr});
+        }
+    }
+
+    threads = std::max(1u, threads);
+    const size_t wave_size = static_cast<size_t>(threads) * 4;
+
+    /* Items are searched in waves so stored matches stay bounded, and
+     * handed out dynamically since runs differ in length. */
+    for (size_t wave = 0; wave < items.size(); wave += wave_size) {
+        const size_t wave_end = std::min(items.size(), wave + wave_size);
+        std::atomic<size_t> next(wave);
+
+        const auto work = [&]() {
+            std::vector<int64_t> ticks;
+            std::vector<uint8_t> edge;
+            std::vector<uint16_t> gap;
+            for (size_t i = next++; i < wave_end; i = next++) {
+                search_item &item = items[i];
+                try {
+                    const search_input &in = inputs[item.file];
+                    pulse_matcher matcher(patterns, tick_rate(in.info.config));
+                    const auto keep = [&](size_t base) {
+                        return [&item, base](const pulse_match &m) {
+                            pulse_match r = m;
+                            r.first += base;
+                            r.last += base;
+                            item.matches.push_back(r);
+                        };
+                    };
+                    if (in.mapped) {
+                        matcher.scan(in.mapped->ticks(), in.mapped->edge(), in.mapped->gap(),
+                                     item.begin, item.end, keep(0));
+                    } else {
+                        const size_t from =
+                            item.begin > matcher.lookback() ? item.begin - matcher.lookback() : 0;
+                        const size_t base =
+                            decode_range(*in.packed, from, item.end, ticks, edge, gap);
+                        matcher.scan(ticks.data(), edge.data(), gap.data(), item.begin - base,
+                                     std::min(item.end - base, ticks.size()), keep(base));
+                    }
+                } catch (...) {
+                    item.error = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads && wave + t < wave_end; t++) {
+            pool.emplace_back(work);
+        }
+        work();
+        for (std::thread &th : pool) {
+            th.join();
+        }
+
+        for (size_t i = wave; i < wave_end; i++) {
+            search_item &item = items[i];
+            if (item.error) {
+                std::rethrow_exception(item.error);
+            }
+            for (const pulse_match &m : item.matches) {
+                fn(item.file, inputs[item.file].info, m);
+            }
+            item.matches = std::vector<pulse_match>();
+        }
+    }
+}
+
+}  // namespace vlog
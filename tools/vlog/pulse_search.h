@@ -0,0 +1,110 @@
+#ifndef VLOG_PULSE_SEARCH_H
+#define VLOG_PULSE_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "capture_run.h"
+
+namespace vlog {
+
+/*
+ * Pulse patterns: sequences of high and low intervals with widths.
+ *
+ *   L3ms H100us{8}          a 3 ms low, then eight 100 us pulses
+ *   H1ms~5% L* H90us..110us
+ *
+ * Each element is H (high) or L (low) followed by
+ *
+ *   <width>                 within the default tolerance of it
+ *   <width>~<tolerance>     tolerance as a duration or a percentage
+ *   <min>..<max>            either bound may be left out
+ *   *                       any width
+ *
+ * and optionally {n} to repeat it n times. Two elements of the same level
+ * in a row have an interval of the other level, of any width, between
+ * them, so "H100us{8}" is eight pulses with whatever lows separate them.
+ * Widths take s, ms, us or ns. Intervals follow for_each_interval(): one
+ * that spans a dropped event matches nothing.
+ */
+struct pulse_element {
+    uint8_t level = 1;       // 1 high, 0 low.
+    double min = 0.0;        // Seconds.
+    double max = 0.0;        // Seconds; HUGE_VAL for no upper bound.
+};
+
+struct pulse_pattern {
+    std::string text;
+    std::vector<pulse_element> elements;   // With the implied separators.
+};
+
+// `tolerance` is the default for widths without one, as a percentage
+// ("10%") or a duration ("2us"). Throws std::runtime_error describing the
+// problem.
+pulse_pattern parse_pulse_pattern(const std::string &text, const std::string &tolerance = "10%");
+
+// One occurrence: intervals from event `first` to event `last` of a run.
+struct pulse_match {
+    uint32_t pattern = 0;    // Index into the patterns searched for.
+    uint64_t first = 0;      // Event starting the first interval.
+    uint64_t last = 0;       // Event ending the last one.
+    int64_t start = 0;       // Their ticks.
+    int64_t end = 0;
+};
+
+/*
+ * Multi-pattern matcher over the interval stream of one run.
+ *
+ * Widths are quantised into symbols: for each level the range bounds of
+ * every element cut the width axis into bins, so one symbol says exactly
+ * which elements an interval satisfies. Symbols are computed for a block
+ * of intervals at a time with a branch-free bound count; all patterns are
+ * then matched together by one shift-and automaton, a bit per pattern
+ * position packed in 64-bit words, at one table lookup and a shift per
+ * interval.
+ */
+class pulse_matcher {
+public:
+    pulse_matcher(const std::vector<pulse_pattern> &patterns, double tick_rate);
+
+    // Report the matches ending at events [begin, end). Up to lookback()
+    // events before `begin` are read to recover the matcher state, so
+    // splitting a run into ranges finds exactly the matches of one scan.
+    void scan(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap, size_t begin,
+              size_t end, const std::function<void(const pulse_match &)> &fn);
+
+    size_t lookback() const { return longest_; }
+
+private:
+    static constexpr size_t BLOCK = 4096;
+
+    std::vector<int64_t> bounds_[2];       // Sorted bin boundaries per level, ticks.
+    uint16_t base_[2] = {0, 0};            // First symbol of each level.
+    uint16_t broken_ = 0;                  // Symbol of unmeasurable intervals.
+    size_t words_ = 0;
+    std::vector<uint64_t> table_;          // words_ per symbol.
+    std::vector<uint64_t> start_;          // First position of every pattern.
+    std::vector<uint64_t> final_;          // Last position of every pattern.
+    std::vector<uint32_t> owner_;          // Pattern of each final position.
+    std::vector<uint32_t> length_;         // Intervals per pattern.
+    size_t longest_ = 0;
+    std::vector<uint16_t> symbols_;
+    std::vector<uint64_t> state_;
+};
+
+/*
+ * Search run files (.vlr or .vlz) for any of `patterns`. Runs are cut into
+ * chunks searched on `threads` workers; `fn` receives every match, in file
+ * order and by position within each file, with the file's index and run.
+ */
+void search_runs(const std::vector<std::string> &paths,
+                 const std::vector<pulse_pattern> &patterns, unsigned threads,
+                 const std::function<void(size_t file, const run_info &info,
+                                          const pulse_match &m)> &fn);
+
+}  // namespace vlog
+
+#endif  // VLOG_PULSE_SEARCH_H
@@ -0,0 +1,92 @@
+#include "pulse_stats.h"
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+namespace vlog {
+
+pulse_timing analyse_pulse_timing(const int64_t *ticks, const uint8_t *edge,
+                                  const uint16_t *gap, size_t n, int64_t window_ticks,
+                                  unsigned threads) {
+    pulse_timing result;
+    result.window_ticks = window_ticks > 0 ? window_ticks : 0;
+    if (n == 0) {
+        return result;
+    }
+    result.origin = ticks[0];
+
+    const auto window_of = [&](size_t i) -> size_t {
+        const int64_t rel = ticks[i] - result.origin;
+        return rel > 0 ? static_cast<size_t>(rel / result.window_ticks) : 0;
+    };
+
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(n / 65536 + 1)));
+
+    struct part {
+        pulse_timing timing;
+        size_t first_window = 0;
+        std::exception_ptr error;
+    };
+    std::vector<part> parts(threads);
+
+    const auto work = [&](unsigned t) {
+        const size_t begin = n * t / threads;
+        const size_t end = n * (t + 1) / threads;
+        part &pt = parts[t];
+
+        try {
+            if (begin == end) {
+                return;
+            }
+            if (result.window_ticks > 0) {
+                pt.first_window = window_of(begin);
+                const size_t last = std::max(window_of(end - 1), pt.first_window);
+                pt.timing.windows.resize(last - pt.first_window + 1);
+            }
+
+            for_each_interval(ticks, edge, gap, begin, end,
+                              [&](interval_kind kind, size_t i, int64_t len) {
+                                  const uint64_t v = len > 0 ? static_cast<uint64_t>(len) : 0;
+                                  pt.timing.total[kind].add(v);
+                                  if (result.window_ticks > 0) {
+                                      const size_t w = std::min(
+                                          std::max(window_of(i), pt.first_window) - pt.first_window,
+                                          pt.timing.windows.size() - 1);
+                                      pt.timing.windows[w][kind].add(v);
+                                  }
+                              });
+        } catch (...) {
+            pt.error = std::current_exception();
+        }
+    };
+
+    if (threads == 1) {
+        work(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back(work, t);
+        }
+        for (std::thread &th : pool) {
+            th.join();
+        }
+    }
+
+    for (part &pt : parts) {
+        if (pt.error) {
+            std::rethrow_exception(pt.error);
+        }
+        result.total.merge(pt.timing.total);
+        if (result.windows.size() < pt.first_window + pt.timing.windows.size()) {
+            result.windows.resize(pt.first_window + pt.timing.windows.size());
+        }
+        for (size_t w = 0; w < pt.timing.windows.size(); w++) {
+            result.windows[pt.first_window + w].merge(pt.timing.windows[w]);
+        }
+    }
+
+    return result;
+}
+
+}  // namespace vlog
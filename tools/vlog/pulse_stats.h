@@ -0,0 +1,57 @@
+#ifndef VLOG_PULSE_STATS_H
+#define VLOG_PULSE_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "intervals.h"
+#include "sketch.h"
+
+namespace vlog {
+
+// Sketches for the three pulse timing metrics.
+struct interval_sketches {
+    timing_sketch period;
+    timing_sketch high;
+    timing_sketch low;
+
+    timing_sketch &operator[](interval_kind kind) {
+        return kind == INTERVAL_PERIOD ? period : (kind == INTERVAL_HIGH ? high : low);
+    }
+
+    void merge(const interval_sketches &other) {
+        period.merge(other.period);
+        high.merge(other.high);
+        low.merge(other.low);
+    }
+};
+
+/*
+ * Pulse timing distribution of one run, overall and per time window.
+ *
+ * Window w covers ticks [origin + w * window_ticks, origin + (w + 1) *
+ * window_ticks); an interval belongs to the window holding its ending
+ * edge. window_ticks == 0 disables windowing.
+ */
+struct pulse_timing {
+    interval_sketches total;
+    int64_t origin = 0;
+    int64_t window_ticks = 0;
+    std::vector<interval_sketches> windows;
+};
+
+/*
+ * Compute pulse timing sketches in one pass over the events.
+ *
+ * The run is split into `threads` contiguous ranges that are summarised
+ * independently (see for_each_interval) and merged, so the result does not
+ * depend on the thread count.
+ */
+pulse_timing analyse_pulse_timing(const int64_t *ticks, const uint8_t *edge,
+                                  const uint16_t *gap, size_t n, int64_t window_ticks,
+                                  unsigned threads = 1);
+
+}  // namespace vlog
+
+#endif  // VLOG_PULSE_STATS_H
@@ -0,0 +1,269 @@
+#include "pyramid.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#include "intervals.h"
+
+namespace vlog {
+
+namespace {
+
+// Level-0 resolution chosen when the caller does not fix one.
+constexpr uint64_t AUTO_EDGES_PER_BUCKET = 16;
+
+uint32_t clamp_interval(int64_t v) {
+    if (v < 0) {
+        return 0;
+    }
+    return v >= static_cast<int64_t>(UINT32_MAX) ? UINT32_MAX - 1 : static_cast<uint32_t>(v);
+}
+
+uint32_t auto_shift(int64_t duration, size_t n) {
+    const uint64_t target = std::max<uint64_t>(1, n / AUTO_EDGES_PER_BUCKET);
+    uint32_t shift = 0;
+    while (shift < 62 && (static_cast<uint64_t>(duration) >> shift) > target) {
+        shift++;
+    }
+    return shift;
+}
+
+/*
+ * Summarise events [begin, end) into `out`, which covers level-0 buckets
+ * starting at `first_bucket`.
+ */
+void summarise(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap, size_t begin,
+               size_t end, int64_t origin, uint32_t shift, int64_t first_bucket,
+               std::vector<pyramid_bucket> &out) {
+    const int64_t last = first_bucket + static_cast<int64_t>(out.size()) - 1;
+    const auto bucket = [&](size_t i) -> pyramid_bucket & {
+        const int64_t b = std::min(std::max((ticks[i] - origin) >> shift, first_bucket), last);
+        return out[static_cast<size_t>(b - first_bucket)];
+    };
+
+    for (size_t i = begin; i < end; i++) {
+        pyramid_bucket &bk = bucket(i);
+        bk.edges++;
+        const uint32_t drops = bk.drops + gap[i];
+        bk.drops = drops < bk.drops ? UINT32_MAX : drops;
+    }
+
+    for_each_interval(ticks, edge, gap, begin, end, [&](interval_kind kind, size_t i, int64_t len) {
+        pyramid_bucket &bk = bucket(i);
+        const uint32_t v = clamp_interval(len);
+        if (kind == INTERVAL_HIGH) {
+            bk.high_min = std::min(bk.high_min, v);
+            bk.high_max = std::max(bk.high_max, v);
+        } else if (kind == INTERVAL_PERIOD) {
+            bk.period_min = std::min(bk.period_min, v);
+            bk.period_max = std::max(bk.period_max, v);
+        }
+    });
+}
+
+}  // namespace
+
+void merge_bucket(pyramid_bucket &into, const pyramid_bucket &from) {
+    into.edges += from.edges;
+    const uint32_t drops = into.drops + from.drops;
+    into.drops = drops < into.drops ? UINT32_MAX : drops;
+    into.high_min = std::min(into.high_min, from.high_min);
+    into.high_max = std::max(into.high_max, from.high_max);
+    into.period_min = std::min(into.period_min, from.period_min);
+    into.period_max = std::max(into.period_max, from.period_max);
+}
+
+pyramid build_pyramid(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap, size_t n,
+                      int base_shift, unsigned threads) {
+    pyramid p;
+    if (n == 0) {
+        p.levels.emplace_back();
+        return p;
+    }
+
+    p.origin = ticks[0];
+    const int64_t span = std::max<int64_t>(ticks[n - 1] - p.origin, 0);
+    p.base_shift = base_shift >= 0 ? static_cast<uint32_t>(base_shift) : auto_shift(span, n);
+
+    const size_t buckets = static_cast<size_t>(span >> p.base_shift) + 1;
+    p.levels.emplace_back(buckets, PYRAMID_EMPTY);
+    std::vector<pyramid_bucket> &level0 = p.levels[0];
+
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(n / 65536 + 1)));
+
+    struct part {
+        int64_t first_bucket;
+        std::vector<pyramid_bucket> buckets;
+        std::exception_ptr error;
+    };
+    std::vector<part> parts(threads);
+
+    const auto bucket_of = [&](size_t i) {
+        const int64_t b = std::max<int64_t>(ticks[i] - p.origin, 0) >> p.base_shift;
+        return std::min<int64_t>(b, static_cast<int64_t>(buckets) - 1);
+    };
+
+    const auto work = [&](unsigned t) {
+        const size_t begin = n * t / threads;
+        const size_t end = n * (t + 1) / threads;
+        part &pt = parts[t];
+        try {
+            if (begin == end) {
+                return;
+            }
+            pt.first_bucket = bucket_of(begin);
+            const int64_t last_bucket = std::max(bucket_of(end - 1), pt.first_bucket);
+            pt.buckets.assign(static_cast<size_t>(last_bucket - pt.first_bucket + 1),
+                              PYRAMID_EMPTY);
+            summarise(ticks, edge, gap, begin, end, p.origin, p.base_shift, pt.first_bucket,
+                      pt.buckets);
+        } catch (...) {
+            pt.error = std::current_exception();
+        }
+    };
+
+    if (threads == 1) {
+        work(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back(work, t);
+        }
+        for (std::thread &th : pool) {
+            th.join();
+        }
+    }
+
+    /* Stitch: parts may share their boundary bucket, so merge rather than copy. */
+    for (part &pt : parts) {
+        if (pt.error) {
+            std::rethrow_exception(pt.error);
+        }
+        for (size_t i = 0; i < pt.buckets.size(); i++) {
+            merge_bucket(level0[static_cast<size_t>(pt.first_bucket) + i], pt.buckets[i]);
+        }
+    }
+
+    while (p.levels.back().size() > 1) {
+        const std::vector<pyramid_bucket> &below = p.levels.back();
+        std::vector<pyramid_bucket> above((below.size() + 1) / 2, PYRAMID_EMPTY);
+        for (size_t i = 0; i < below.size(); i++) {
+            merge_bucket(above[i / 2], below[i]);
+        }
+        p.levels.push_back(std::move(above));
+    }
+
+    return p;
+}
+
+std::string pyramid_path_for(const std::string &run_path) {
+    const size_t dot = run_path.find_last_of('.');
+    const size_t slash = run_path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return run_path + ".vlp";
+    }
+    return run_path.substr(0, dot) + ".vlp";
+}
+
+void write_pyramid(const std::string &path, const pyramid &p) {
+    pyramid_file_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, PYRAMID_FILE_MAGIC, sizeof(h.magic));
+    h.version = PYRAMID_FILE_VERSION;
+    h.base_shift = p.base_shift;
+    h.origin = p.origin;
+    h.level_count = static_cast<uint32_t>(p.levels.size());
+
+    std::vector<uint64_t> table;
+    uint64_t offset = sizeof(h) + p.levels.size() * 2 * sizeof(uint64_t);
+    for (const std::vector<pyramid_bucket> &level : p.levels) {
+        table.push_back(offset);
+        table.push_back(level.size());
+        offset += level.size() * sizeof(pyramid_bucket);
+    }
+
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+    }
+
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+              std::fwrite(table.data(), sizeof(uint64_t), table.size(), f) == table.size();
+    for (const std::vector<pyramid_bucket> &level : p.levels) {
+        ok = ok && std::fwrite(level.data(), sizeof(pyramid_bucket), level.size(), f) == level.size();
+    }
+    const int err = errno;
+
+    if (std::fclose(f) != 0 || !ok) {
+        throw std::runtime_error(path + ": " + std::strerror(ok ? errno : err));
+    }
+}
+
+pyramid_file::pyramid_file(const std::string &path) : file_(path) {
+    const uint64_t size = file_.size();
+    if (size < sizeof(pyramid_file_header)) {
+        throw std::runtime_error(path + ": not a pyramid file (too short)");
+    }
+    header_ = reinterpret_cast<const pyramid_file_header *>(file_.data());
+    if (std::memcmp(header_->magic, PYRAMID_FILE_MAGIC, sizeof(PYRAMID_FILE_MAGIC)) != 0 ||
+        header_->version != PYRAMID_FILE_VERSION) {
+        throw std::runtime_error(path + ": not a pyramid file (bad magic or version)");
+    }
+
+    const uint64_t levels = header_->level_count;
+    if (levels == 0 || levels > (size - sizeof(pyramid_file_header)) / sizeof(level_entry)) {
+        throw std::runtime_error(path + ": pyramid level table is corrupt");
+    }
+    table_ = reinterpret_cast<const level_entry *>(file_.data() + sizeof(pyramid_file_header));
+
+    for (uint64_t l = 0; l < levels; l++) {
+        const level_entry &e = table_[l];
+        if (e.offset % alignof(pyramid_bucket) != 0 || e.offset > size ||
+            e.count > (size - e.offset) / sizeof(pyramid_bucket)) {
+            throw std::runtime_error(path + ": pyramid level " + std::to_string(l) +
+                                     " is truncated or corrupt");
+        }
+    }
+}
+
+const pyramid_bucket *pyramid_file::level(uint32_t l, size_t *count) const {
+    *count = static_cast<size_t>(table_[l].count);
+    return reinterpret_cast<const pyramid_bucket *>(file_.data() + table_[l].offset);
+}
+
+pyramid_span pyramid_file::query(int64_t t0, int64_t t1, size_t max_buckets) const {
+    pyramid_span span;
+    max_buckets = std::max<size_t>(max_buckets, 1);
+
+    const int64_t lo = std::max<int64_t>(t0 - origin(), 0);
+    const int64_t hi = std::max<int64_t>(t1 - origin() - 1, lo);
+
+    for (uint32_t l = 0; l < level_count(); l++) {
+        const uint32_t shift = base_shift() + l;
+        size_t count;
+        const pyramid_bucket *buckets = level(l, &count);
+        if (count == 0) {
+            return span;
+        }
+
+        const uint64_t first = std::min<uint64_t>(static_cast<uint64_t>(lo >> shift), count - 1);
+        const uint64_t last = std::min<uint64_t>(static_cast<uint64_t>(hi >> shift), count - 1);
+
+        if (last - first + 1 <= max_buckets || l + 1 == level_count()) {
+            span.level = l;
+            span.bucket_ticks = INT64_C(1) << shift;
+            span.first_tick = origin() + static_cast<int64_t>(first) * span.bucket_ticks;
+            span.buckets = buckets + first;
+            span.count = static_cast<size_t>(last - first + 1);
+            return span;
+        }
+    }
+    return span;
+}
+
+}  // namespace vlog
@@ -0,0 +1,128 @@
+#ifndef VLOG_PYRAMID_H
+#define VLOG_PYRAMID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "capture_run.h"
+#include "mapped_file.h"
+
+namespace vlog {
+
+/*
+ * Per-bucket timing summary.
+ *
+ * Intervals are attributed to the bucket containing the edge that ends
+ * them: a high time to its falling edge, a period to its second rising
+ * edge. Intervals that span dropped events are not measured. Empty fields
+ * hold UINT32_MAX (minima) and 0 (maxima) so that merging is a plain
+ * min/max/sum.
+ */
+struct pyramid_bucket {
+    uint32_t edges;
+    uint32_t drops;
+    uint32_t high_min;
+    uint32_t high_max;
+    uint32_t period_min;
+    uint32_t period_max;
+};
+
+static_assert(sizeof(pyramid_bucket) == 24, "pyramid_bucket layout changed");
+
+constexpr pyramid_bucket PYRAMID_EMPTY = {0, 0, UINT32_MAX, 0, UINT32_MAX, 0};
+
+void merge_bucket(pyramid_bucket &into, const pyramid_bucket &from);
+
+/*
+ * Multi-resolution min/max pyramid for one run.
+ *
+ * Level 0 buckets are 2^base_shift ticks wide, starting at `origin`; each
+ * level above halves the bucket count, up to a single bucket covering the
+ * whole run. A viewer asking for any time span at any zoom reads
+ * O(width) buckets from the level whose resolution just fits.
+ */
+struct pyramid {
+    int64_t origin = 0;
+    uint32_t base_shift = 0;
+    std::vector<std::vector<pyramid_bucket>> levels;
+};
+
+/*
+ * Build a pyramid in one pass over the run, split across `threads`.
+ *
+ * Each worker summarises a contiguous range of events into level-0
+ * buckets; the partial buckets where ranges meet are merged, and the upper
+ * levels are folded from level 0. base_shift < 0 selects a resolution of
+ * roughly 16 edges per level-0 bucket.
+ */
+pyramid build_pyramid(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap, size_t n,
+                      int base_shift = -1, unsigned threads = 1);
+
+/*
+ * Pyramid file (.vlp), stored next to its run file:
+ *
+ *   [pyramid_file_header, 64 bytes]
+ *   [level table: {offset, count} x levels]
+ *   [level 0 buckets][level 1 buckets]...
+ */
+constexpr char PYRAMID_FILE_MAGIC[8] = {'V', 'L', 'O', 'G', 'P', 'Y', 'R', '1'};
+constexpr uint32_t PYRAMID_FILE_VERSION = 1;
+
+struct pyramid_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t base_shift;
+    int64_t origin;
+    uint32_t level_count;
+    uint8_t reserved[36];
+};
+
+static_assert(sizeof(pyramid_file_header) == 64, "pyramid_file_header layout changed");
+
+void write_pyramid(const std::string &path, const pyramid &p);
+
+// Sidecar path for a run file: run_0000.vlr -> run_0000.vlp.
+std::string pyramid_path_for(const std::string &run_path);
+
+// A contiguous span of buckets from one level.
+struct pyramid_span {
+    uint32_t level = 0;
+    int64_t first_tick = 0;      // Start tick of buckets[0].
+    int64_t bucket_ticks = 0;    // Width of each bucket.
+    const pyramid_bucket *buckets = nullptr;
+    size_t count = 0;
+};
+
+// Memory-mapped pyramid file.
+class pyramid_file {
+public:
+    explicit pyramid_file(const std::string &path);
+
+    uint32_t level_count() const { return header_->level_count; }
+    uint32_t base_shift() const { return header_->base_shift; }
+    int64_t origin() const { return header_->origin; }
+
+    const pyramid_bucket *level(uint32_t l, size_t *count) const;
+
+    /*
+     * Buckets covering [t0, t1) at the finest level that needs no more
+     * than `max_buckets` of them. Touches only the returned span.
+     */
+    pyramid_span query(int64_t t0, int64_t t1, size_t max_buckets) const;
+
+private:
+    struct level_entry {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    mapped_file file_;
+    const pyramid_file_header *header_ = nullptr;
+    const level_entry *table_ = nullptr;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_PYRAMID_H
@@ -0,0 +1,997 @@
+#include "query.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "capture_run.h"
+#include "intervals.h"
+#include "packed_run.h"
+#include "run_file.h"
+#include "tick_codec.h"
+
+namespace vlog {
+
+namespace {
+
+// Rows evaluated together, one column at a time.
+constexpr size_t QUERY_BATCH = 4096;
+
+// Events per unit of parallel work.
+constexpr size_t CHUNK_EVENTS = size_t(1) << 20;
+
+const char *const COLUMN_NAMES[COL_COUNT] = {
+    "t", "tick", "end", "width", "edge", "gap", "dt", "index", "run", "window",
+};
+
+const char *const AGGREGATE_NAMES[] = {"count", "min", "max", "mean", "sum", "stddev"};
+
+const char *const SOURCE_NAMES[] = {"edges", "high", "low", "period"};
+
+bool column_valid(query_source source, uint8_t column) {
+    switch (column) {
+    case COL_END:
+    case COL_WIDTH:
+        return source != QUERY_EDGES;
+    case COL_EDGE:
+    case COL_GAP:
+    case COL_DT:
+        return source == QUERY_EDGES;
+    default:
+        return true;
+    }
+}
+
+std::string lower(std::string s) {
+    for (char &c : s) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return s;
+}
+
+/* ------------------------------------------------------------------------
+ * Parser
+ * ------------------------------------------------------------------------ */
+
+enum token_kind { TOK_NUMBER, TOK_WORD, TOK_SYMBOL, TOK_END };
+
+struct token {
+    token_kind kind;
+    std::string text;   // Lower-cased for words.
+    double value;
+    size_t begin;
+    size_t end;
+};
+
+class parser {
+public:
+    parser(const std::string &text, query &q) : text_(text), q_(q) { tokenize(); }
+
+    void parse() {
+        expect_word("select");
+        parse_select();
+        expect_word("from");
+        parse_source();
+
+        if (accept_word("where")) {
+            q_.where = parse_expr(false);
+        }
+        if (accept_word("group")) {
+            expect_word("by");
+            expect_word("window");
+            expect_symbol("(");
+            const token &t = next();
+            if (t.kind != TOK_NUMBER || !(t.value > 0.0)) {
+                fail(t, "expected a positive window duration");
+            }
+            q_.window = t.value;
+            expect_symbol(")");
+        }
+        if (accept_word("having")) {
+            q_.having = parse_expr(true);
+        }
+        if (peek().kind != TOK_END) {
+            fail(peek(), "unexpected input");
+        }
+
+        check();
+        bound_time(q_.where);
+    }
+
+private:
+    /* Tokens ------------------------------------------------------------- */
+
+    void tokenize() {
+        size_t i = 0;
+        while (true) {
+            while (i < text_.size() && std::isspace(static_cast<unsigned char>(text_[i]))) {
+                i++;
+            }
+            if (i == text_.size()) {
+                tokens_.push_back({TOK_END, "", 0.0, i, i});
+                return;
+            }
+
+            const size_t begin = i;
+            const char c = text_[i];
+            if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+                char *stop = nullptr;
+                double v = std::strtod(text_.c_str() + i, &stop);
+                if (stop == text_.c_str() + i) {
+                    /* A '.' not starting a number, e.g. a file name. */
+                    throw std::runtime_error(std::string("query: unexpected character '") + c +
+                                             "'");
+                }
+                i = static_cast<size_t>(stop - text_.c_str());
+                size_t u = i;
+                while (u < text_.size() && (std::isalpha(static_cast<unsigned char>(text_[u])) ||
+                                            text_[u] == '%' || (text_[u] & 0x80))) {
+                    u++;
+                }
+                const std::string unit = text_.substr(i, u - i);
+                if (unit == "s" || unit.empty()) {
+                } else if (unit == "ms") {
+                    v *= 1e-3;
+                } else if (unit == "us" || unit == "\xc2\xb5s") {
+                    v *= 1e-6;
+                } else if (unit == "ns") {
+                    v *= 1e-9;
+                } else if (unit == "%") {
+                    v *= 1e-2;
+                } else {
+                    throw std::runtime_error("query: unknown unit '" + unit + "'");
+                }
+                i = u;
+                tokens_.push_back({TOK_NUMBER, text_.substr(begin, i - begin), v, begin, i});
+            } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                while (i < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[i])) ||
+                                            text_[i] == '_')) {
+                    i++;
+                }
+                tokens_.push_back({TOK_WORD, lower(text_.substr(begin, i - begin)), 0.0, begin, i});
+            } else {
+                static const char *const two[] = {"<=", ">=", "!=", "<>", "=="};
+                size_t len = 1;
+                for (const char *s : two) {
+                    if (text_.compare(i, 2, s) == 0) {
+                        len = 2;
+                    }
+                }
+                if (len == 1 && std::strchr("<>=(),+-*/", c) == nullptr) {
+                    throw std::runtime_error(std::string("query: unexpected character '") + c +
+                                             "'");
+                }
+                i += len;
+                tokens_.push_back({TOK_SYMBOL, text_.substr(begin, len), 0.0, begin, i});
+            }
+        }
+    }
+
+    const token &peek() const { return tokens_[pos_]; }
+    const token &next() { return tokens_[pos_ < tokens_.size() - 1 ? pos_++ : pos_]; }
+
+    [[noreturn]] void fail(const token &t, const std::string &what) const {
+        throw std::runtime_error("query: " + what +
+                                 (t.kind == TOK_END ? " at end" : " near '" + t.text + "'"));
+    }
+
+    bool accept_word(const char *w) {
+        if (peek().kind == TOK_WORD && peek().text == w) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool accept_symbol(const char *s) {
+        if (peek().kind == TOK_SYMBOL && peek().text == s) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect_word(const char *w) {
+        if (!accept_word(w)) {
+            fail(peek(), std::string("expected ") + w);
+        }
+    }
+
+    void expect_symbol(const char *s) {
+        if (!accept_symbol(s)) {
+            fail(peek(), std::string("expected '") + s + "'");
+        }
+    }
+
+    /* Clauses ------------------------------------------------------------ */
+
+    void parse_select() {
+        if (accept_symbol("*")) {
+            select_all_ = true;
+            return;
+        }
+        do {
+            const size_t begin = peek().begin;
+            const int node = parse_expr(true);
+            std::string name = text_.substr(begin, tokens_[pos_ - 1].end - begin);
+            if (accept_word("as")) {
+                const token &t = next();
+                if (t.kind != TOK_WORD) {
+                    fail(t, "expected a column name");
+                }
+                name = text_.substr(t.begin, t.end - t.begin);
+            }
+            q_.select.push_back({name, node});
+        } while (accept_symbol(","));
+    }
+
+    void parse_source() {
+        const token &t = next();
+        for (uint8_t s = 0; s < 4; s++) {
+            if (t.kind == TOK_WORD && t.text == SOURCE_NAMES[s]) {
+                q_.source = static_cast<query_source>(s);
+                if (select_all_) {
+                    for (uint8_t c = 0; c < COL_COUNT; c++) {
+                        if (c != COL_WINDOW && column_valid(q_.source, c)) {
+                            q_.select.push_back({COLUMN_NAMES[c], column(c)});
+                        }
+                    }
+                }
+                return;
+            }
+        }
+        fail(t, "expected edges, high, low or period");
+    }
+
+    /* Expressions -------------------------------------------------------- */
+
+    int add(query_node n) {
+        q_.nodes.push_back(n);
+        return static_cast<int>(q_.nodes.size() - 1);
+    }
+
+    int column(uint8_t c) {
+        query_node n{OP_COLUMN};
+        n.column = c;
+        return add(n);
+    }
+
+    int binary(query_op op, int lhs, int rhs) {
+        query_node n{op};
+        n.lhs = lhs;
+        n.rhs = rhs;
+        return add(n);
+    }
+
+    int parse_expr(bool aggregates) {
+        aggregates_ok_ = aggregates;
+        return parse_or();
+    }
+
+    int parse_or() {
+        int lhs = parse_and();
+        while (accept_word("or")) {
+            lhs = binary(OP_OR, lhs, parse_and());
+        }
+        return lhs;
+    }
+
+    int parse_and() {
+        int lhs = parse_not();
+        while (accept_word("and")) {
+            lhs = binary(OP_AND, lhs, parse_not());
+        }
+        return lhs;
+    }
+
+    int parse_not() {
+        if (accept_word("not")) {
+            return binary(OP_NOT, parse_not(), -1);
+        }
+        return parse_compare();
+    }
+
+    int parse_compare() {
+        const int lhs = parse_sum();
+        if (accept_word("between")) {
+            const int lo = parse_sum();
+            expect_word("and");
+            const int hi = parse_sum();
+            return binary(OP_AND, binary(OP_GE, lhs, lo), binary(OP_LE, lhs, hi));
+        }
+
+        static const struct {
+            const char *text;
+            query_op op;
+        } ops[] = {{"<", OP_LT}, {"<=", OP_LE}, {">", OP_GT}, {">=", OP_GE},
+                   {"=", OP_EQ}, {"==", OP_EQ}, {"!=", OP_NE}, {"<>", OP_NE}};
+        for (const auto &o : ops) {
+            if (accept_symbol(o.text)) {
+                return binary(o.op, lhs, parse_sum());
+            }
+        }
+        return lhs;
+    }
+
+    int parse_sum() {
+        int lhs = parse_product();
+        while (true) {
+            if (accept_symbol("+")) {
+                lhs = binary(OP_ADD, lhs, parse_product());
+            } else if (accept_symbol("-")) {
+                lhs = binary(OP_SUB, lhs, parse_product());
+            } else {
+                return lhs;
+            }
+        }
+    }
+
+    int parse_product() {
+        int lhs = parse_unary();
+        while (true) {
+            if (accept_symbol("*")) {
+                lhs = binary(OP_MUL, lhs, parse_unary());
+            } else if (accept_symbol("/")) {
+                lhs = binary(OP_DIV, lhs, parse_unary());
+            } else {
+                return lhs;
+            }
+        }
+    }
+
+    int parse_unary() {
+        if (accept_symbol("-")) {
+            return binary(OP_NEG, parse_unary(), -1);
+        }
+        return parse_primary();
+    }
+
+    int parse_primary() {
+        const token &t = next();
+        if (t.kind == TOK_NUMBER) {
+            query_node n{OP_CONST};
+            n.value = t.value;
+            return add(n);
+        }
+        if (t.kind == TOK_SYMBOL && t.text == "(") {
+            const int inner = parse_or();
+            expect_symbol(")");
+            return inner;
+        }
+        if (t.kind != TOK_WORD) {
+            fail(t, "expected an expression");
+        }
+
+        if (!accept_symbol("(")) {
+            for (uint8_t c = 0; c < COL_COUNT; c++) {
+                if (t.text == COLUMN_NAMES[c]) {
+                    return column(c);
+                }
+            }
+            fail(t, "unknown column");
+        }
+
+        if (t.text == "abs") {
+            const int arg = parse_or();
+            expect_symbol(")");
+            return binary(OP_ABS, arg, -1);
+        }
+
+        for (uint8_t f = 0; f <= AGG_STDDEV; f++) {
+            if (t.text != AGGREGATE_NAMES[f] && !(f == AGG_MEAN && t.text == "avg")) {
+                continue;
+            }
+            if (!aggregates_ok_ || in_aggregate_) {
+                fail(t, "aggregate not allowed here");
+            }
+            query_aggregate a{static_cast<aggregate_fn>(f), -1};
+            if (f == AGG_COUNT) {
+                accept_symbol("*");
+            } else {
+                in_aggregate_ = true;
+                a.arg = parse_or();
+                in_aggregate_ = false;
+            }
+            expect_symbol(")");
+
+            query_node n{OP_AGGREGATE};
+            n.index = static_cast<uint32_t>(q_.aggregates.size());
+            q_.aggregates.push_back(a);
+            return add(n);
+        }
+        fail(t, "unknown function");
+    }
+
+    /* Checks -------------------------------------------------------------- */
+
+    // Columns referenced outside aggregates must suit the query shape.
+    void check_node(int node, bool grouped, bool inside_aggregate) {
+        if (node < 0) {
+            return;
+        }
+        const query_node &n = q_.nodes[node];
+        if (n.op == OP_COLUMN) {
+            const bool group_column = n.column == COL_RUN || n.column == COL_WINDOW;
+            if (!column_valid(q_.source, n.column) ||
+                (n.column == COL_WINDOW && (q_.window <= 0.0 || inside_aggregate)) ||
+                (grouped && !inside_aggregate && !group_column)) {
+                throw std::runtime_error(std::string("query: column '") +
+                                         COLUMN_NAMES[n.column] + "' not available here");
+            }
+        }
+        if (n.op == OP_AGGREGATE) {
+            check_node(q_.aggregates[n.index].arg, grouped, true);
+            return;
+        }
+        check_node(n.lhs, grouped, inside_aggregate);
+        check_node(n.rhs, grouped, inside_aggregate);
+    }
+
+    void check() {
+        if (q_.having >= 0 && !q_.grouped()) {
+            throw std::runtime_error("query: HAVING needs aggregates or GROUP BY");
+        }
+        for (const query_item &item : q_.select) {
+            check_node(item.node, q_.grouped(), false);
+        }
+        check_node(q_.where, false, false);
+        check_node(q_.having, true, false);
+    }
+
+    // Narrow [t_min, t_max] from `t <op> constant` terms ANDed at the top of WHERE.
+    void bound_time(int node) {
+        if (node < 0) {
+            return;
+        }
+        const query_node &n = q_.nodes[node];
+        if (n.op == OP_AND) {
+            bound_time(n.lhs);
+            bound_time(n.rhs);
+            return;
+        }
+        if (n.op < OP_LT || n.op > OP_EQ) {
+            return;
+        }
+
+        const query_node &l = q_.nodes[n.lhs];
+        const query_node &r = q_.nodes[n.rhs];
+        query_op op = n.op;
+        double v;
+        if (l.op == OP_COLUMN && l.column == COL_T && r.op == OP_CONST) {
+            v = r.value;
+        } else if (r.op == OP_COLUMN && r.column == COL_T && l.op == OP_CONST) {
+            v = l.value;
+            op = op == OP_LT ? OP_GT : op == OP_LE ? OP_GE : op == OP_GT ? OP_LT
+                 : op == OP_GE ? OP_LE : op;
+        } else {
+            return;
+        }
+
+        if (op == OP_LT || op == OP_LE || op == OP_EQ) {
+            q_.t_max = std::min(q_.t_max, v);
+        }
+        if (op == OP_GT || op == OP_GE || op == OP_EQ) {
+            q_.t_min = std::max(q_.t_min, v);
+        }
+    }
+
+    const std::string &text_;
+    query &q_;
+    std::vector<token> tokens_;
+    size_t pos_ = 0;
+    bool select_all_ = false;
+    bool aggregates_ok_ = false;
+    bool in_aggregate_ = false;
+};
+
+/* ------------------------------------------------------------------------
+ * Evaluation
+ * ------------------------------------------------------------------------ */
+
+struct row_batch {
+    size_t n = 0;
+    double col[COL_COUNT][QUERY_BATCH];
+};
+
+struct aggregate_state {
+    double count = 0.0;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    double min = HUGE_VAL;
+    double max = -HUGE_VAL;
+
+    void add(double v) {
+        count += 1.0;
+        sum += v;
+        sum_sq += v * v;
+        min = std::min(min, v);
+        max = std::max(max, v);
+    }
+
+    void merge(const aggregate_state &o) {
+        count += o.count;
+        sum += o.sum;
+        sum_sq += o.sum_sq;
+        min = std::min(min, o.min);
+        max = std::max(max, o.max);
+    }
+
+    double result(aggregate_fn fn) const {
+        switch (fn) {
+        case AGG_COUNT:
+            return count;
+        case AGG_MIN:
+            return count > 0.0 ? min : NAN;
+        case AGG_MAX:
+            return count > 0.0 ? max : NAN;
+        case AGG_MEAN:
+            return count > 0.0 ? sum / count : NAN;
+        case AGG_SUM:
+            return sum;
+        case AGG_STDDEV:
+            return count > 1.0 ? std::sqrt(std::max(0.0, (sum_sq - sum * sum / count) /
+                                                             (count - 1.0)))
+                               : NAN;
+        }
+        return NAN;
+    }
+};
+
+struct group {
+    uint64_t rows = 0;
+    std::vector<aggregate_state> aggregates;
+};
+
+// Groups keyed by window number, kept as a dense span.
+struct group_span {
+    int64_t first = 0;
+    std::vector<group> groups;
+
+    group &at(int64_t key, size_t aggregates) {
+        if (groups.empty()) {
+            first = key;
+        } else if (key < first) {
+            groups.insert(groups.begin(), static_cast<size_t>(first - key), group());
+            first = key;
+        }
+        const size_t i = static_cast<size_t>(key - first);
+        if (i >= groups.size()) {
+            groups.resize(i + 1);
+        }
+        if (groups[i].aggregates.empty()) {
+            groups[i].aggregates.resize(aggregates);
+        }
+        return groups[i];
+    }
+
+    void merge(const group_span &o, size_t aggregates) {
+        for (size_t i = 0; i < o.groups.size(); i++) {
+            if (o.groups[i].rows == 0) {
+                continue;
+            }
+            group &g = at(o.first + static_cast<int64_t>(i), aggregates);
+            g.rows += o.groups[i].rows;
+            for (size_t a = 0; a < aggregates; a++) {
+                g.aggregates[a].merge(o.groups[i].aggregates[a]);
+            }
+        }
+    }
+};
+
+// Column-at-a-time evaluation of expressions over a row batch.
+class batch_evaluator {
+public:
+    explicit batch_evaluator(const query &q)
+        : q_(q), scratch_(q.nodes.size(), std::vector<double>(QUERY_BATCH)) {}
+
+    const double *eval(int node, const row_batch &b) {
+        const query_node &nd = q_.nodes[node];
+        const size_t n = b.n;
+        double *out = scratch_[node].data();
+
+        switch (nd.op) {
+        case OP_COLUMN:
+            return b.col[nd.column];
+        case OP_CONST:
+            std::fill(out, out + n, nd.value);
+            return out;
+        case OP_AGGREGATE:
+            throw std::logic_error("aggregate evaluated per row");
+        case OP_NEG:
+        case OP_NOT:
+        case OP_ABS: {
+            const double *a = eval(nd.lhs, b);
+            for (size_t i = 0; i < n; i++) {
+                out[i] = nd.op == OP_NEG ? -a[i] : nd.op == OP_NOT ? (a[i] == 0.0) : std::fabs(a[i]);
+            }
+            return out;
+        }
+        default:
+            break;
+        }
+
+        const double *a = eval(nd.lhs, b);
+        const double *c = eval(nd.rhs, b);
+        switch (nd.op) {
+        case OP_ADD: for (size_t i = 0; i < n; i++) out[i] = a[i] + c[i]; break;
+        case OP_SUB: for (size_t i = 0; i < n; i++) out[i] = a[i] - c[i]; break;
+        case OP_MUL: for (size_t i = 0; i < n; i++) out[i] = a[i] * c[i]; break;
+        case OP_DIV: for (size_t i = 0; i < n; i++) out[i] = a[i] / c[i]; break;
+        case OP_LT: for (size_t i = 0; i < n; i++) out[i] = a[i] < c[i]; break;
+        case OP_LE: for (size_t i = 0; i < n; i++) out[i] = a[i] <= c[i]; break;
+        case OP_GT: for (size_t i = 0; i < n; i++) out[i] = a[i] > c[i]; break;
+        case OP_GE: for (size_t i = 0; i < n; i++) out[i] = a[i] >= c[i]; break;
+        case OP_EQ: for (size_t i = 0; i < n; i++) out[i] = a[i] == c[i]; break;
+        case OP_NE: for (size_t i = 0; i < n; i++) out[i] = a[i] != c[i]; break;
+        case OP_AND: for (size_t i = 0; i < n; i++) out[i] = a[i] != 0.0 && c[i] != 0.0; break;
+        case OP_OR: for (size_t i = 0; i < n; i++) out[i] = a[i] != 0.0 || c[i] != 0.0; break;
+        default: break;
+        }
+        return out;
+    }
+
+private:
+    const query &q_;
+    std::vector<std::vector<double>> scratch_;
+};
+
+// Evaluate a select or HAVING expression for one finished group.
+double eval_group(const query &q, int node, const group &g, double run, double window) {
+    const query_node &n = q.nodes[node];
+    switch (n.op) {
+    case OP_CONST:
+        return n.value;
+    case OP_COLUMN:
+        return n.column == COL_WINDOW ? window : run;
+    case OP_AGGREGATE:
+        return g.aggregates[n.index].result(q.aggregates[n.index].fn);
+    default:
+        break;
+    }
+
+    const double a = eval_group(q, n.lhs, g, run, window);
+    if (n.op == OP_NEG) return -a;
+    if (n.op == OP_NOT) return a == 0.0;
+    if (n.op == OP_ABS) return std::fabs(a);
+
+    const double c = eval_group(q, n.rhs, g, run, window);
+    switch (n.op) {
+    case OP_ADD: return a + c;
+    case OP_SUB: return a - c;
+    case OP_MUL: return a * c;
+    case OP_DIV: return a / c;
+    case OP_LT: return a < c;
+    case OP_LE: return a <= c;
+    case OP_GT: return a > c;
+    case OP_GE: return a >= c;
+    case OP_EQ: return a == c;
+    case OP_NE: return a != c;
+    case OP_AND: return a != 0.0 && c != 0.0;
+    case OP_OR: return a != 0.0 || c != 0.0;
+    default: return NAN;
+    }
+}
+
+/* ------------------------------------------------------------------------
+ * Execution
+ * ------------------------------------------------------------------------ */
+
+// A run opened for querying, either mapped (.vlr) or compressed (.vlz).
+struct query_input {
+    std::unique_ptr<run_file> mapped;
+    std::unique_ptr<packed_run> packed;
+    run_info info;
+    size_t size = 0;
+    int64_t origin = 0;
+    double rate = 0.0;
+
+    // Index of the first event with tick >= t.
+    size_t seek(int64_t t) const {
+        if (mapped) {
+            return static_cast<size_t>(std::lower_bound(mapped->ticks(), mapped->ticks() + size, t) -
+                                       mapped->ticks());
+        }
+        size_t lo = 0;
+        size_t hi = packed->block_count();
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if (packed->block(mid).first_tick < t) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        // Block lo starts at or after t; the answer may lie in the block before.
+        return lo == 0 ? 0 : static_cast<size_t>(packed->block(lo - 1).first_event);
+    }
+};
+
+// Events [begin, end) of a run, with earlier events available for lookback.
+struct event_view {
+    const int64_t *ticks;
+    const uint8_t *edge;
+    const uint16_t *gap;
+    size_t begin;
+    size_t end;
+    size_t base;        // Run index of view element 0.
+};
+
+struct chunk_output {
+    std::vector<double> rows;
+    group_span groups;
+    std::exception_ptr error;
+};
+
+class chunk_runner {
+public:
+    chunk_runner(const query &q, const query_input &in)
+        : q_(q), in_(in), eval_(q), batch_(new row_batch) {}
+
+    void run(size_t begin, size_t end, chunk_output &out) {
+        out_ = &out;
+        const event_view v = view(begin, end);
+        const double run_index = in_.info.index;
+        const double inv_rate = 1.0 / in_.rate;
+
+        const auto time = [&](int64_t tick) {
+            return static_cast<double>(tick - in_.origin) * inv_rate;
+        };
+
+        if (q_.source == QUERY_EDGES) {
+            for (size_t i = v.begin; i < v.end; i++) {
+                const size_t k = next_row();
+                row_batch &b = *batch_;
+                b.col[COL_T][k] = time(v.ticks[i]);
+                b.col[COL_TICK][k] = static_cast<double>(v.ticks[i]);
+                b.col[COL_EDGE][k] = v.edge[i];
+                b.col[COL_GAP][k] = v.gap[i];
+                b.col[COL_DT][k] =
+                    i > 0 ? static_cast<double>(v.ticks[i] - v.ticks[i - 1]) * inv_rate : 0.0;
+                b.col[COL_INDEX][k] = static_cast<double>(v.base + i);
+                b.col[COL_RUN][k] = run_index;
+            }
+        } else {
+            const interval_kind want = q_.source == QUERY_HIGH  ? INTERVAL_HIGH
+                                       : q_.source == QUERY_LOW ? INTERVAL_LOW
+                                                                : INTERVAL_PERIOD;
+            for_each_interval(v.ticks, v.edge, v.gap, v.begin, v.end,
+                              [&](interval_kind kind, size_t i, int64_t len) {
+                                  if (kind != want) {
+                                      return;
+                                  }
+                                  const int64_t start = v.ticks[i] - len;
+                                  size_t first = i - 1;
+                                  while (first > 0 && v.ticks[first] > start) {
+                                      first--;
+                                  }
+                                  const size_t k = next_row();
+                                  row_batch &b = *batch_;
+                                  b.col[COL_T][k] = time(start);
+                                  b.col[COL_TICK][k] = static_cast<double>(start);
+                                  b.col[COL_END][k] = time(v.ticks[i]);
+                                  b.col[COL_WIDTH][k] = static_cast<double>(len) * inv_rate;
+                                  b.col[COL_INDEX][k] = static_cast<double>(v.base + first);
+                                  b.col[COL_RUN][k] = run_index;
+                              });
+        }
+        process();
+    }
+
+private:
+    event_view view(size_t begin, size_t end) {
+        if (in_.mapped) {
+            return {in_.mapped->ticks(), in_.mapped->edge(), in_.mapped->gap(), begin, end, 0};
+        }
+
+        /* Decode the blocks covering [begin, end), plus one before for lookback. */
+        const packed_run &p = *in_.packed;
+        size_t lo = 0;
+        size_t hi = p.block_count();
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if (p.block(mid).first_event <= begin) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        const size_t first = lo >= 2 ? lo - 2 : 0;
+        const size_t base = static_cast<size_t>(p.block(first).first_event);
+        size_t count = 0;
+        for (size_t b = first; b < p.block_count() && base + count < end; b++) {
+            ticks_.resize(count + TICK_BLOCK_EVENTS);
+            edge_.resize(count + TICK_BLOCK_EVENTS);
+            gap_.resize(count + TICK_BLOCK_EVENTS);
+            count += p.decode_block(b, &ticks_[count], &edge_[count], &gap_[count]);
+        }
+        return {ticks_.data(), edge_.data(), gap_.data(), begin - base,
+                std::min(end, base + count) - base, base};
+    }
+
+    size_t next_row() {
+        if (batch_->n == QUERY_BATCH) {
+            process();
+        }
+        return batch_->n++;
+    }
+
+    void process() {
+        row_batch &b = *batch_;
+        if (b.n == 0) {
+            return;
+        }
+
+        const double *mask = q_.where >= 0 ? eval_.eval(q_.where, b) : nullptr;
+        selected_.clear();
+        for (size_t i = 0; i < b.n; i++) {
+            if (mask == nullptr || mask[i] != 0.0) {
+                selected_.push_back(i);
+            }
+        }
+
+        if (!q_.grouped()) {
+            const size_t width = q_.select.size();
+            columns_.resize(width);
+            for (size_t s = 0; s < width; s++) {
+                columns_[s] = eval_.eval(q_.select[s].node, b);
+            }
+            for (size_t i : selected_) {
+                for (size_t s = 0; s < width; s++) {
+                    out_->rows.push_back(columns_[s][i]);
+                }
+            }
+        } else {
+            const size_t na = q_.aggregates.size();
+            columns_.resize(na);
+            for (size_t a = 0; a < na; a++) {
+                columns_[a] = q_.aggregates[a].arg >= 0 ? eval_.eval(q_.aggregates[a].arg, b)
+                                                         : nullptr;
+            }
+            for (size_t i : selected_) {
+                const int64_t key = q_.window > 0.0
+                                        ? static_cast<int64_t>(std::floor(b.col[COL_T][i] / q_.window))
+                                        : 0;
+                group &g = out_->groups.at(key, na);
+                g.rows++;
+                for (size_t a = 0; a < na; a++) {
+                    g.aggregates[a].add(columns_[a] != nullptr ? columns_[a][i] : 0.0);
+                }
+            }
+        }
+        b.n = 0;
+    }
+
+    const query &q_;
+    const query_input &in_;
+    batch_evaluator eval_;
+    std::unique_ptr<row_batch> batch_;
+    chunk_output *out_ = nullptr;
+
+    std::vector<size_t> selected_;
+    std::vector<const double *> columns_;
+    std::vector<int64_t> ticks_;
+    std::vector<uint8_t> edge_;
+    std::vector<uint16_t> gap_;
+};
+
+}  // namespace
+
+query parse_query(const std::string &text) {
+    query q;
+    q.t_min = -HUGE_VAL;
+    q.t_max = HUGE_VAL;
+    parser(text, q).parse();
+    return q;
+}
+
+void execute_query(const query &q, const std::string &path, unsigned threads,
+                   const std::function<void(const double *values)> &row) {
+    query_input in;
+    const size_t dot = path.rfind('.');
+    if (dot != std::string::npos && path.compare(dot, std::string::npos, ".vlz") == 0) {
+        in.packed.reset(new packed_run(path));
+        in.info = in.packed->info();
+        in.size = in.packed->size();
+        in.origin = in.size > 0 ? in.packed->block(0).first_tick : 0;
+    } else {
+        in.mapped.reset(new run_file(path));
+        in.info = in.mapped->info();
+        in.size = in.mapped->size();
+        in.origin = in.size > 0 ? in.mapped->ticks()[0] : 0;
+    }
+    in.rate = tick_rate(in.info.config);
+
+    /*
+     * Seek to the time bounds. A row's t is its first edge, which precedes
+     * the edge that completes it by at most two events.
+     */
+    size_t begin = 0;
+    size_t end = in.size;
+    if (q.t_min > 0.0) {
+        begin = in.seek(in.origin + static_cast<int64_t>(std::floor(q.t_min * in.rate)));
+    }
+    if (q.t_max < HUGE_VAL) {
+        const double hi = std::ceil(q.t_max * in.rate);
+        if (hi < 0.0) {
+            end = 0;
+        } else if (hi < static_cast<double>(INT64_MAX / 2)) {
+            const size_t stop = in.seek(in.origin + static_cast<int64_t>(hi) + 1);
+            end = std::min(in.size, stop + (in.mapped ? 2 : TICK_BLOCK_EVENTS + 2));
+        }
+    }
+    begin = std::min(begin, end);
+
+    threads = std::max(1u, threads);
+    const size_t chunks = (end - begin + CHUNK_EVENTS - 1) / CHUNK_EVENTS;
+    const size_t width = q.select.size();
+    const size_t na = q.aggregates.size();
+    group_span groups;
+    std::vector<double> values(width);
+
+    /* Chunks are evaluated in waves of `threads` so row output stays bounded. */
+    for (size_t wave = 0; wave < chunks; wave += threads) {
+        const size_t count = std::min<size_t>(threads, chunks - wave);
+        std::vector<chunk_output> outputs(count);
+
+        const auto work = [&](size_t k) {
+            try {
+                const size_t c = wave + k;
+                const size_t b = begin + c * CHUNK_EVENTS;
+                chunk_runner(q, in).run(b, std::min(end, b + CHUNK_EVENTS), outputs[k]);
+            } catch (...) {
+                outputs[k].error = std::current_exception();
+            }
+        };
+
+        if (count == 1) {
+            work(0);
+        } else {
+            std::vector<std::thread> pool;
+            for (size_t k = 0; k < count; k++) {
+                pool.emplace_back(work, k);
+            }
+            for (std::thread &th : pool) {
+                th.join();
+            }
+        }
+
+        for (chunk_output &o : outputs) {
+            if (o.error) {
+                std::rethrow_exception(o.error);
+            }
+            for (size_t r = 0; r + width <= o.rows.size(); r += width) {
+                row(&o.rows[r]);
+            }
+            groups.merge(o.groups, na);
+        }
+    }
+
+    if (!q.grouped()) {
+        return;
+    }
+    if (q.window <= 0.0 && groups.groups.empty()) {
+        groups.at(0, na);
+    }
+    for (size_t i = 0; i < groups.groups.size(); i++) {
+        const group &g = groups.groups[i];
+        if (q.window > 0.0 && g.rows == 0) {
+            continue;
+        }
+        const double window = static_cast<double>(groups.first + static_cast<int64_t>(i)) * q.window;
+        if (q.having >= 0 && eval_group(q, q.having, g, in.info.index, window) == 0.0) {
+            continue;
+        }
+        for (size_t s = 0; s < width; s++) {
+            values[s] = eval_group(q, q.select[s].node, g, in.info.index, window);
+        }
+        row(values.data());
+    }
+}
+
+}  // namespace vlog
@@ -0,0 +1,143 @@
+#ifndef VLOG_QUERY_H
+#define VLOG_QUERY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace vlog {
+
+/*
+ * Event-time queries over run files.
+ *
+ *   SELECT <expr> [AS name], ... | *
+ *   FROM edges | high | low | period
+ *   [WHERE <expr>]
+ *   [GROUP BY WINDOW(<duration>)]
+ *   [HAVING <expr>]
+ *
+ * Row sources and their columns (times in seconds from the first event of
+ * the run, widths in seconds):
+ *
+ *   edges                  t, tick, edge (1 rising), gap, dt, index, run
+ *   high, low, period      t, tick, end, width, index, run
+ *
+ * `index` is the event index of the row's first edge. With GROUP BY the
+ * select list may use `window` (window start time), `run` and aggregates
+ * count(), min(x), max(x), mean(x), sum(x), stddev(x); without it, a
+ * select list of aggregates yields one row per run. Expressions support
+ * + - * /, comparisons, AND/OR/NOT, BETWEEN, abs(), and literals with
+ * units s, ms, us, ns or %. Keywords are case-insensitive.
+ *
+ *   SELECT t, width FROM high WHERE t BETWEEN 100s AND 200s AND width < 12us
+ *   SELECT window, mean(width) FROM period GROUP BY WINDOW(10ms)
+ *       HAVING abs(max(width) / mean(width) - 1) > 1%
+ */
+
+enum query_source : uint8_t {
+    QUERY_EDGES,
+    QUERY_HIGH,
+    QUERY_LOW,
+    QUERY_PERIOD,
+};
+
+enum query_column : uint8_t {
+    COL_T,
+    COL_TICK,
+    COL_END,
+    COL_WIDTH,
+    COL_EDGE,
+    COL_GAP,
+    COL_DT,
+    COL_INDEX,
+    COL_RUN,
+    COL_WINDOW,
+    COL_COUNT,
+};
+
+enum query_op : uint8_t {
+    OP_CONST,
+    OP_COLUMN,
+    OP_AGGREGATE,
+    OP_NEG,
+    OP_NOT,
+    OP_ABS,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_OR,
+};
+
+enum aggregate_fn : uint8_t {
+    AGG_COUNT,
+    AGG_MIN,
+    AGG_MAX,
+    AGG_MEAN,
+    AGG_SUM,
+    AGG_STDDEV,
+};
+
+// Expression tree node; children are indices into query::nodes.
+struct query_node {
+    query_op op;
+    uint8_t column = 0;      // OP_COLUMN
+    uint32_t index = 0;      // OP_AGGREGATE: query::aggregates slot
+    double value = 0.0;      // OP_CONST
+    int lhs = -1;
+    int rhs = -1;
+};
+
+struct query_aggregate {
+    aggregate_fn fn;
+    int arg;                 // Node evaluated per row; -1 for count().
+};
+
+struct query_item {
+    std::string name;
+    int node;
+};
+
+struct query {
+    query_source source = QUERY_EDGES;
+    std::vector<query_node> nodes;
+    std::vector<query_item> select;
+    std::vector<query_aggregate> aggregates;
+    int where = -1;
+    int having = -1;
+    double window = 0.0;           // GROUP BY WINDOW duration, 0 if none.
+
+    // Bounds on t implied by WHERE, used to seek before scanning.
+    double t_min;
+    double t_max;
+
+    bool grouped() const { return window > 0.0 || !aggregates.empty(); }
+};
+
+// Parse a query; throws std::runtime_error describing the first error.
+query parse_query(const std::string &text);
+
+/*
+ * Run a query over one run file (.vlr or .vlz), calling `row` once per
+ * output row in time order with query::select.size() values.
+ *
+ * The time range implied by WHERE is located by binary search on the tick
+ * column (or the block index of a .vlz) so only that span is read. It is
+ * cut into chunks evaluated on `threads` workers in batches of a few
+ * thousand rows, one column at a time; results are merged in order.
+ */
+void execute_query(const query &q, const std::string &path, unsigned threads,
+                   const std::function<void(const double *values)> &row);
+
+}  // namespace vlog
+
+#endif  // VLOG_QUERY_H
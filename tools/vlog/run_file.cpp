@@ -0,0 +1,248 @@
+#include "run_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace vlog {
+
+namespace {
+
+[[noreturn]] void io_error(const std::string &what) {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+void write_all(std::FILE *f, const void *data, size_t len, const std::string &path) {
+    if (len > 0 && std::fwrite(data, 1, len, f) != len) {
+        io_error(path);
+    }
+}
+
+uint64_t align_up(uint64_t v) {
+    return (v + RUN_FILE_ALIGN - 1) & ~static_cast<uint64_t>(RUN_FILE_ALIGN - 1);
+}
+
+/* Zero-fill from `pos` to the next column boundary; returns the new offset. */
+uint64_t pad_column(std::FILE *f, uint64_t pos, const std::string &path) {
+    static const uint8_t zeros[RUN_FILE_ALIGN] = {};
+    const uint64_t next = align_up(pos);
+    write_all(f, zeros, static_cast<size_t>(next - pos), path);
+    return next;
+}
+
+/* Append the whole of a spool file to `out`. */
+void copy_spool(std::FILE *spool, std::FILE *out, const std::string &path) {
+    uint8_t buf[1 << 16];
+    size_t n;
+
+    if (std::fflush(spool) != 0 || std::fseek(spool, 0, SEEK_SET) != 0) {
+        io_error(path + ": spool");
+    }
+    while ((n = std::fread(buf, 1, sizeof(buf), spool)) > 0) {
+        write_all(out, buf, n, path);
+    }
+    if (std::ferror(spool)) {
+        io_error(path + ": spool");
+    }
+}
+
+/* Column layout for `count` events following the header. */
+void layout_columns(run_file_header *h, uint64_t count) {
+    h->ticks_offset = align_up(sizeof(run_file_header));
+    h->edge_offset = align_up(h->ticks_offset + count * sizeof(int64_t));
+    h->gap_offset = align_up(h->edge_offset + count * sizeof(uint8_t));
+}
+
+}  // namespace
+
+run_file_header make_run_file_header(const run_info &info) {
+    run_file_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, RUN_FILE_MAGIC, sizeof(h.magic));
+    h.version = RUN_FILE_VERSION;
+    h.header_size = sizeof(run_file_header);
+    h.event_count = info.event_count;
+    h.source_offset = info.source_offset;
+    h.dropped = info.dropped;
+    h.run_index = info.index;
+    h.flags = info.truncated ? RUN_FILE_FLAG_TRUNCATED : 0u;
+    h.f_cpu = info.config.f_cpu;
+    h.baud = info.config.baud;
+    h.timer1_prescaler = info.config.timer1_prescaler;
+    h.capture_buffer_size = info.config.capture_buffer_size;
+    h.icnc1 = info.config.icnc1;
+    return h;
+}
+
+run_info run_file_header_info(const run_file_header &h) {
+    run_info info;
+    info.config.f_cpu = h.f_cpu;
+    info.config.baud = h.baud;
+    info.config.timer1_prescaler = h.timer1_prescaler;
+    info.config.capture_buffer_size = h.capture_buffer_size;
+    info.config.icnc1 = static_cast<int8_t>(h.icnc1);
+    info.index = h.run_index;
+    info.source_offset = h.source_offset;
+    info.event_count = h.event_count;
+    info.dropped = h.dropped;
+    info.truncated = (h.flags & RUN_FILE_FLAG_TRUNCATED) != 0;
+    return info;
+}
+
+std::string run_file_path(const std::string &dir, const std::string &stem, uint32_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%04u.vlr", index);
+    return dir + "/" + stem + name;
+}
+
+/*
+ * Map and validate a run file.
+ *
+ * Every column must lie entirely inside the mapping and be naturally
+ * aligned, so that the typed pointers handed out are safe to dereference.
+ */
+run_file::run_file(const std::string &path) : file_(path) {
+    const uint8_t *base = file_.data();
+    const uint64_t size = file_.size();
+
+    if (size < sizeof(run_file_header)) {
+        throw std::runtime_error(path + ": not a run file (too short)");
+    }
+    header_ = reinterpret_cast<const run_file_header *>(base);
+    if (std::memcmp(header_->magic, RUN_FILE_MAGIC, sizeof(RUN_FILE_MAGIC)) != 0) {
+        throw std::runtime_error(path + ": not a run file (bad magic)");
+    }
+    if (header_->version != RUN_FILE_VERSION) {
+        throw std::runtime_error(path + ": unsupported run file version " +
+                                 std::to_string(header_->version));
+    }
+
+    const uint64_t n = header_->event_count;
+    const auto column_ok = [&](uint64_t offset, uint64_t width) {
+        return offset % width == 0 && offset <= size && n <= (size - offset) / width;
+    };
+    if (!column_ok(header_->ticks_offset, sizeof(int64_t)) ||
+        !column_ok(header_->edge_offset, sizeof(uint8_t)) ||
+        !column_ok(header_->gap_offset, sizeof(uint16_t))) {
+        throw std::runtime_error(path + ": run file is truncated or corrupt");
+    }
+
+    ticks_ = reinterpret_cast<const int64_t *>(base + header_->ticks_offset);
+    edge_ = base + header_->edge_offset;
+    gap_ = reinterpret_cast<const uint16_t *>(base + header_->gap_offset);
+}
+
+run_info run_file::info() const {
+    return run_file_header_info(*header_);
+}
+
+void replay_run_file(const run_file &run, run_sink &sink, size_t batch_size) {
+    const run_info info = run.info();
+
+    sink.begin_run(info);
+    for (size_t i = 0; i < run.size(); i += batch_size) {
+        const size_t end = run.size() - i > batch_size ? i + batch_size : run.size();
+        sink.events(run.batch(i, end));
+    }
+    sink.end_run(info);
+}
+
+void write_run_file(const std::string &path, const capture_run &run) {
+    run_info info = run.info;
+    info.event_count = run.size();
+
+    run_file_header h = make_run_file_header(info);
+    layout_columns(&h, info.event_count);
+
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        io_error(path);
+    }
+
+    try {
+        uint64_t pos = 0;
+        write_all(f, &h, sizeof(h), path);
+        pos = pad_column(f, sizeof(h), path);
+        write_all(f, run.ticks.data(), run.size() * sizeof(int64_t), path);
+        pos = pad_column(f, pos + run.size() * sizeof(int64_t), path);
+        write_all(f, run.edge.data(), run.size() * sizeof(uint8_t), path);
+        pos = pad_column(f, pos + run.size() * sizeof(uint8_t), path);
+        write_all(f, run.gap.data(), run.size() * sizeof(uint16_t), path);
+    } catch (...) {
+        std::fclose(f);
+        throw;
+    }
+
+    if (std::fclose(f) != 0) {
+        io_error(path);
+    }
+}
+
+run_file_writer::run_file_writer(std::string dir, std::string stem)
+    : dir_(std::move(dir)), stem_(std::move(stem)) {}
+
+run_file_writer::~run_file_writer() {
+    close_all();
+}
+
+void run_file_writer::close_all() {
+    for (std::FILE **f : {&out_, &edge_spool_, &gap_spool_}) {
+        if (*f != nullptr) {
+            std::fclose(*f);
+            *f = nullptr;
+        }
+    }
+}
+
+void run_file_writer::begin_run(const run_info &info) {
+    close_all();
+
+    path_ = run_file_path(dir_, stem_, info.index);
+    out_ = std::fopen(path_.c_str(), "wb");
+    if (out_ == nullptr) {
+        io_error(path_);
+    }
+    edge_spool_ = std::tmpfile();
+    gap_spool_ = std::tmpfile();
+    if (edge_spool_ == nullptr || gap_spool_ == nullptr) {
+        io_error(path_ + ": spool");
+    }
+
+    /* Placeholder header; rewritten once the event count is known. */
+    const run_file_header h = make_run_file_header(info);
+    write_all(out_, &h, sizeof(h), path_);
+    pad_column(out_, sizeof(h), path_);
+}
+
+void run_file_writer::events(const event_batch &batch) {
+    write_all(out_, batch.ticks, batch.count * sizeof(int64_t), path_);
+    write_all(edge_spool_, batch.edge, batch.count * sizeof(uint8_t), path_);
+    write_all(gap_spool_, batch.gap, batch.count * sizeof(uint16_t), path_);
+}
+
+void run_file_writer::end_run(const run_info &info) {
+    run_file_header h = make_run_file_header(info);
+    layout_columns(&h, info.event_count);
+
+    pad_column(out_, h.ticks_offset + info.event_count * sizeof(int64_t), path_);
+    copy_spool(edge_spool_, out_, path_);
+    pad_column(out_, h.edge_offset + info.event_count * sizeof(uint8_t), path_);
+    copy_spool(gap_spool_, out_, path_);
+
+    if (std::fseek(out_, 0, SEEK_SET) != 0) {
+        io_error(path_);
+    }
+    write_all(out_, &h, sizeof(h), path_);
+
+    const int rc = std::fclose(out_);
+    out_ = nullptr;
+    if (rc != 0) {
+        io_error(path_);
+    }
+    close_all();
+
+    paths_.push_back(path_);
+}
+
+}  // namespace vlog
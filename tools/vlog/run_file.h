@@ -0,0 +1,138 @@
+#ifndef VLOG_RUN_FILE_H
+#define VLOG_RUN_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+#include "mapped_file.h"
+
+namespace vlog {
+
+/*
+ * Columnar run file (.vlr).
+ *
+ * One decoded run per file, laid out so that each column can be used in
+ * place from a memory mapping (by C++ tools, or as NumPy arrays through the
+ * Python bindings) without parsing or copying:
+ *
+ *   [header, 128 bytes]
+ *   [ticks : int64  x event_count]   64-byte aligned
+ *   [edge  : uint8  x event_count]   64-byte aligned
+ *   [gap   : uint16 x event_count]   64-byte aligned
+ *
+ * All integers are little-endian (the only byte order the host tools
+ * target). Column offsets are recorded in the header so that later
+ * versions may append columns without moving existing ones.
+ */
+constexpr char RUN_FILE_MAGIC[8] = {'V', 'L', 'O', 'G', 'R', 'U', 'N', '1'};
+constexpr uint32_t RUN_FILE_VERSION = 1;
+constexpr uint32_t RUN_FILE_ALIGN = 64;
+
+constexpr uint32_t RUN_FILE_FLAG_TRUNCATED = 1u << 0;
+
+struct run_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t event_count;
+    uint64_t source_offset;
+    uint64_t dropped;
+    uint32_t run_index;
+    uint32_t flags;
+    uint32_t f_cpu;
+    uint32_t baud;
+    uint32_t timer1_prescaler;
+    uint32_t capture_buffer_size;
+    int32_t icnc1;
+    uint32_t reserved0;
+    uint64_t ticks_offset;
+    uint64_t edge_offset;
+    uint64_t gap_offset;
+    uint8_t reserved[32];
+};
+
+static_assert(sizeof(run_file_header) == 128, "run_file_header layout changed");
+
+// Header describing `info`, with no column layout yet (offsets zero).
+run_file_header make_run_file_header(const run_info &info);
+
+// Run identity and configuration recorded in a header.
+run_info run_file_header_info(const run_file_header &h);
+
+// Read-only, memory-mapped view of a run file.
+// Throws std::runtime_error if the file is missing or not a valid run file.
+class run_file {
+public:
+    explicit run_file(const std::string &path);
+
+    size_t size() const { return static_cast<size_t>(header_->event_count); }
+    const int64_t *ticks() const { return ticks_; }
+    const uint8_t *edge() const { return edge_; }
+    const uint16_t *gap() const { return gap_; }
+
+    const run_file_header &header() const { return *header_; }
+    run_info info() const;
+
+    // Events [begin, end) as a batch pointing into the mapping.
+    event_batch batch(size_t begin, size_t end) const {
+        return event_batch{ticks_ + begin, edge_ + begin, gap_ + begin, end - begin};
+    }
+
+    const std::string &path() const { return file_.path(); }
+
+private:
+    mapped_file file_;
+    const run_file_header *header_ = nullptr;
+    const int64_t *ticks_ = nullptr;
+    const uint8_t *edge_ = nullptr;
+    const uint16_t *gap_ = nullptr;
+};
+
+/*
+ * Sink that writes every decoded run to its own run file.
+ *
+ * Files are named <dir>/<stem>_<NNNN>.vlr after the run index. The tick
+ * column is streamed straight into the output while the narrower columns
+ * are spooled to temporary files, so memory use stays constant however
+ * long the run is.
+ */
+class run_file_writer : public run_sink {
+public:
+    run_file_writer(std::string dir, std::string stem = "run");
+    ~run_file_writer() override;
+
+    void begin_run(const run_info &info) override;
+    void events(const event_batch &batch) override;
+    void end_run(const run_info &info) override;
+
+    // Paths of the files completed so far, in run order.
+    const std::vector<std::string> &paths() const { return paths_; }
+
+private:
+    void close_all();
+
+    std::string dir_;
+    std::string stem_;
+    std::string path_;
+    std::FILE *out_ = nullptr;
+    std::FILE *edge_spool_ = nullptr;
+    std::FILE *gap_spool_ = nullptr;
+    std::vector<std::string> paths_;
+};
+
+// Deliver a mapped run to `sink` as a single run, in batches of `batch_size`.
+void replay_run_file(const run_file &run, run_sink &sink, size_t batch_size = 65536);
+
+// Write an in-memory run to `path` in run file format.
+void write_run_file(const std::string &path, const capture_run &run);
+
+// Path a run_file_writer uses for run `index`.
+std::string run_file_path(const std::string &dir, const std::string &stem, uint32_t index);
+
+}  // namespace vlog
+
+#endif  // VLOG_RUN_FILE_H
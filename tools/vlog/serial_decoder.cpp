@@ -0,0 +1,101 @@
+#include "serial_decoder.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace vlog {
+
+uart_decoder::uart_decoder(frame_sink &out, const uart_options &options)
+    : edge_decoder(out), options_(options) {
+    if (!(options.baud > 0.0) || options.data_bits < 1 || options.data_bits > 32 ||
+        options.stop_bits < 1) {
+        throw std::invalid_argument("invalid UART options");
+    }
+    frame_bits_ = 1u + options.data_bits + (options.parity != PARITY_NONE ? 1u : 0u) +
+                  options.stop_bits;
+}
+
+void uart_decoder::reset(const run_config &config) {
+    bit_ticks_ = tick_rate(config) / options_.baud;
+    level_ = 1;
+    in_frame_ = false;
+}
+
+/*
+ * Bit cell b (0 = start bit) is sampled at start + (b + 0.5) bit times.
+ * Sample times are recomputed from the start edge rather than accumulated
+ * so rounding cannot drift across long characters.
+ */
+void uart_decoder::sample_until(double t) {
+    const unsigned data_end = 1u + options_.data_bits;
+
+    while (in_frame_ && next_sample_ < t) {
+        const unsigned b = next_bit_;
+        if (b == 0) {
+            if (level_ != 0) {
+                in_frame_ = false;
+                return;
+            }
+        } else if (b < data_end) {
+            shift_ |= static_cast<uint64_t>(level_) << (b - 1);
+            ones_ += level_;
+        } else if (b == data_end && options_.parity != PARITY_NONE) {
+            ones_ += level_;
+            if ((ones_ & 1u) != (options_.parity == PARITY_ODD ? 1u : 0u)) {
+                flags_ |= FRAME_ERR_PARITY;
+            }
+        } else if (level_ == 0) {
+            flags_ |= FRAME_ERR_FRAMING;
+        }
+
+        next_bit_ = b + 1;
+        next_sample_ = static_cast<double>(start_) + (next_bit_ + 0.5) * bit_ticks_;
+        if (next_bit_ == frame_bits_) {
+            complete();
+        }
+    }
+}
+
+void uart_decoder::complete() {
+    protocol_frame f;
+    f.start = start_;
+    f.end = start_ + std::llround(frame_bits_ * bit_ticks_);
+    f.value = shift_;
+    f.bits = options_.data_bits;
+    f.kind = FRAME_UART;
+    f.flags = flags_;
+    emit(f);
+    in_frame_ = false;
+}
+
+void uart_decoder::edges(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                         size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        sample_until(static_cast<double>(ticks[i]));
+
+        if (gap[i] != 0 && in_frame_) {
+            flags_ |= FRAME_ERR_DROPPED;
+        }
+        level_ = (edge[i] == EDGE_RISING) != options_.inverted ? 1 : 0;
+
+        if (!in_frame_ && level_ == 0) {
+            in_frame_ = true;
+            start_ = ticks[i];
+            next_bit_ = 0;
+            next_sample_ = static_cast<double>(start_) + 0.5 * bit_ticks_;
+            shift_ = 0;
+            ones_ = 0;
+            flags_ = gap[i] != 0 ? FRAME_ERR_DROPPED : 0;
+        }
+    }
+    flush();
+}
+
+void uart_decoder::finish() {
+    sample_until(HUGE_VAL);
+    in_frame_ = false;
+    flush();
+    out_.finish();
+}
+
+}  // namespace vlog
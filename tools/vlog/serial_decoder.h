@@ -0,0 +1,64 @@
+#ifndef VLOG_SERIAL_DECODER_H
+#define VLOG_SERIAL_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+
+namespace vlog {
+
+enum parity_mode : uint8_t {
+    PARITY_NONE,
+    PARITY_EVEN,
+    PARITY_ODD,
+};
+
+struct uart_options {
+    double baud = 9600.0;
+    uint8_t data_bits = 8;        // 5..9, sent LSB first.
+    parity_mode parity = PARITY_NONE;
+    uint8_t stop_bits = 1;
+    bool inverted = false;        // Idle low (RS-232 level, no transceiver).
+};
+
+/*
+ * Asynchronous serial (UART) decoder.
+ *
+ * A falling edge on an idle line starts a character; each bit is taken as
+ * the line level at the middle of its bit cell, which is known from the
+ * last edge before that instant. A start bit that is no longer low at its
+ * middle is treated as a glitch. Emits one FRAME_UART per character with
+ * the data bits in value.
+ */
+class uart_decoder : public edge_decoder {
+public:
+    uart_decoder(frame_sink &out, const uart_options &options);
+
+    void reset(const run_config &config) override;
+    void edges(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+               size_t n) override;
+    void finish() override;
+
+private:
+    // Sample the current level for every bit cell whose middle is before t.
+    void sample_until(double t);
+    void complete();
+
+    uart_options options_;
+    unsigned frame_bits_;         // Start + data + parity + stop.
+    double bit_ticks_ = 0.0;
+
+    uint8_t level_ = 1;           // Logical line level (1 = mark).
+    bool in_frame_ = false;
+    int64_t start_ = 0;
+    unsigned next_bit_ = 0;
+    double next_sample_ = 0.0;
+    uint64_t shift_ = 0;
+    unsigned ones_ = 0;
+    uint8_t flags_ = 0;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_SERIAL_DECODER_H
@@ -0,0 +1,218 @@
+#include "shm_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace vlog {
+
+namespace {
+
+std::runtime_error sys_error(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+size_t ring_bytes(size_t capacity) {
+    return sizeof(shm_ring_header) + capacity * sizeof(live_record);
+}
+
+}  // namespace
+
+shm_ring_writer::shm_ring_writer(const std::string &name, size_t capacity)
+    : name_(name), mask_(capacity - 1) {
+    if (capacity == 0 || (capacity & mask_) != 0 || capacity > UINT32_MAX) {
+        throw std::invalid_argument("live ring capacity must be a power of two");
+    }
+
+    /* A ring left by a capture that died is replaced, not reused: its
+     * readers may still hold it mapped. */
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw sys_error(name);
+    }
+    map_size_ = ring_bytes(capacity);
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(map_size_)) == 0) {
+        p = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (p == MAP_FAILED) {
+        const std::runtime_error e = sys_error(name);
+        close(fd);
+        shm_unlink(name.c_str());
+        throw e;
+    }
+    close(fd);
+
+    /* The object starts zeroed, which is every counter's initial value;
+     * the magic goes in last so a reader never sees a half-made header. */
+    header_ = new (p) shm_ring_header();
+    records_ = reinterpret_cast<live_record *>(static_cast<char *>(p) + sizeof(shm_ring_header));
+    header_->record_size = sizeof(live_record);
+    header_->capacity = static_cast<uint32_t>(capacity);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header_->magic, SHM_RING_MAGIC, sizeof(SHM_RING_MAGIC));
+}
+
+shm_ring_writer::~shm_ring_writer() {
+    header_->closed.store(1, std::memory_order_release);
+    munmap(header_, map_size_);
+    shm_unlink(name_.c_str());
+}
+
+uint64_t shm_ring_writer::claim(size_t n) {
+    const uint64_t first = claimed_;
+    claimed_ += n;
+    header_->claimed.store(claimed_, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return first;
+}
+
+void shm_ring_writer::store(uint64_t seq, const live_event &e) {
+    constexpr std::memory_order o = std::memory_order_relaxed;
+    live_record &r = records_[seq & mask_];
+    r.seq.store(seq, o);
+    r.ticks.store(e.ticks, o);
+    r.run.store(e.run, o);
+    r.session.store(e.session, o);
+    r.gap.store(e.gap, o);
+    r.kind.store(e.kind, o);
+    r.edge.store(e.edge, o);
+}
+
+void shm_ring_writer::publish() {
+    header_->published.store(claimed_, std::memory_order_release);
+}
+
+void shm_ring_writer::config(const run_config &config) {
+    header_->f_cpu.store(config.f_cpu, std::memory_order_relaxed);
+    header_->baud.store(config.baud, std::memory_order_relaxed);
+    header_->buffer_size.store(config.capture_buffer_size, std::memory_order_relaxed);
+}
+
+shm_ring_reader::shm_ring_reader(const std::string &name, bool from_start) {
+    const int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        throw sys_error(name);
+    }
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(shm_ring_header)) {
+        map_size_ = static_cast<size_t>(st.st_size);
+        p = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error(name + ": not a live ring");
+    }
+
+    header_ = static_cast<const shm_ring_header *>(p);
+    records_ = reinterpret_cast<const live_record *>(static_cast<const char *>(p) +
+                                                     sizeof(shm_ring_header));
+    const size_t capacity = header_->capacity;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (std::memcmp(header_->magic, SHM_RING_MAGIC, sizeof(SHM_RING_MAGIC)) != 0 ||
+        header_->record_size != sizeof(live_record) || capacity == 0 ||
+        (capacity & (capacity - 1)) != 0 || map_size_ < ring_bytes(capacity)) {
+        munmap(const_cast<shm_ring_header *>(header_), map_size_);
+        throw std::runtime_error(name + ": not a live ring");
+    }
+    mask_ = capacity - 1;
+
+    cursor_ = header_->published.load(std::memory_order_acquire);
+    if (from_start) {
+        cursor_ = std::min(cursor_, oldest_intact());
+    }
+}
+
+shm_ring_reader::~shm_ring_reader() {
+    munmap(const_cast<shm_ring_header *>(header_), map_size_);
+}
+
+uint64_t shm_ring_reader::oldest_intact() const {
+    const uint64_t claimed = header_->claimed.load(std::memory_order_relaxed);
+    return claimed > mask_ + 1 ? claimed - (mask_ + 1) : 0;
+}
+
+shm_ring_reader::span shm_ring_reader::peek(size_t max) {
+    const uint64_t published = header_->published.load(std::memory_order_acquire);
+    const uint64_t oldest = oldest_intact();
+    if (cursor_ < oldest) {
+        lost_ += oldest - cursor_;
+        cursor_ = oldest;
+    }
+    if (cursor_ >= published) {
+        return span{records_, 0, cursor_};
+    }
+    const size_t at = static_cast<size_t>(cursor_) & mask_;
+    const size_t n = static_cast<size_t>(
+        std::min<uint64_t>({published - cursor_, max, mask_ + 1 - at}));
+    return span{records_ + at, n, cursor_};
+}
+
+/* Anything read from the records is ordered before the claimed load by
+ * the fence, pairing with the writer's fence after raising claimed. */
+size_t shm_ring_reader::release(const span &s) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t oldest = oldest_intact();
+    const size_t torn =
+        oldest > s.first ? static_cast<size_t>(std::min<uint64_t>(oldest - s.first, s.count)) : 0;
+    lost_ += torn;
+    cursor_ = s.first + s.count;
+    return torn;
+}
+
+size_t shm_ring_reader::read(live_event *out, size_t max) {
+    const span s = peek(max);
+    for (size_t i = 0; i < s.count; i++) {
+        out[i] = load_record(s.records[i]);
+    }
+    const size_t torn = release(s);
+    if (torn != 0) {
+        std::memmove(out, out + torn, (s.count - torn) * sizeof(live_event));
+    }
+    return s.count - torn;
+}
+
+void live_publisher::begin_run(const run_info &info) {
+    ring_.config(info.config);
+    run_ = info.index;
+    session_ = info.session;
+    put(live_event{0, 0, run_, session_, 0, LIVE_BEGIN_RUN, 0});
+}
+
+void live_publisher::events(const event_batch &batch) {
+    for (size_t i = 0; i < batch.count;) {
+        const size_t n = std::min(batch.count - i, ring_.capacity());
+        const uint64_t first = ring_.claim(n);
+        for (size_t j = 0; j < n; j++, i++) {
+            ring_.store(first + j, live_event{0, batch.ticks[i], run_, session_, batch.gap[i],
+                                              LIVE_EVENT, batch.edge[i]});
+        }
+        ring_.publish();
+    }
+}
+
+void live_publisher::end_run(const run_info &info) {
+    put(live_event{0, static_cast<int64_t>(info.event_count), run_, session_, 0, LIVE_END_RUN,
+                   static_cast<uint8_t>(info.truncated ? 1 : 0)});
+}
+
+void live_publisher::status(const status_record &s) {
+    ring_.config(s.config);
+    put(live_event{0, s.ticks, s.ring_high_water, session_, s.dropped, LIVE_STATUS, 0});
+}
+
+void live_publisher::put(const live_event &e) {
+    ring_.store(ring_.claim(1), e);
+    ring_.publish();
+}
+
+}  // namespace vlog
@@ -0,0 +1,183 @@
+#ifndef VLOG_SHM_RING_H
+#define VLOG_SHM_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+
+namespace vlog {
+
+/*
+ * Live event stream in POSIX shared memory.
+ *
+ * One writer (capture_daemon, one ring per device, named "/vlog.<name>")
+ * publishes decoded records into a ring; any number of readers map it
+ * read-only and follow at their own pace. Nothing is copied per reader and
+ * the writer never waits: a reader that falls more than a ring behind
+ * finds its records overwritten, which it detects from the counters and
+ * reports as lost.
+ *
+ * Records are numbered from 0 (their sequence number) and record s lives
+ * in slot s % capacity. The writer raises `claimed` past the records it is
+ * about to write, writes them, then raises `published` to match. A reader
+ * takes records below `published` and, after using them, checks `claimed`
+ * again: any record more than `capacity` below it may have been torn by
+ * the writer meanwhile and is discarded. This is a seqlock over the whole
+ * ring, so record fields are atomics accessed relaxed (plain moves).
+ */
+constexpr char SHM_RING_MAGIC[8] = {'V', 'L', 'O', 'G', 'S', 'H', 'M', '1'};
+
+// Record kinds.
+enum : uint8_t {
+    LIVE_EVENT = 0,      // ticks, edge and gap as in event_batch.
+    LIVE_BEGIN_RUN = 1,  // ticks 0.
+    LIVE_END_RUN = 2,    // ticks = events in the run; edge = 1 if truncated.
+    LIVE_STATUS = 3,     // Firmware status: run = ring high-water, gap = dropped counter.
+};
+
+struct shm_ring_header {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t capacity;                 // Records, a power of two.
+    std::atomic<uint32_t> f_cpu;       // Header of the latest run; 0 = unknown.
+    std::atomic<uint32_t> baud;
+    std::atomic<uint32_t> closed;      // Writer gone; a new capture makes a new ring.
+    std::atomic<uint32_t> buffer_size; // Firmware capture ring depth; 0 = unknown.
+    alignas(64) std::atomic<uint64_t> claimed;
+    alignas(64) std::atomic<uint64_t> published;
+};
+
+struct alignas(32) live_record {
+    std::atomic<uint64_t> seq;
+    std::atomic<int64_t> ticks;
+    std::atomic<uint32_t> run;
+    std::atomic<uint32_t> session;
+    std::atomic<uint16_t> gap;
+    std::atomic<uint8_t> kind;
+    std::atomic<uint8_t> edge;
+};
+static_assert(sizeof(live_record) == 32, "live_record is a shared layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock-free");
+
+// A record's contents, read out of the ring.
+struct live_event {
+    uint64_t seq;
+    int64_t ticks;
+    uint32_t run;
+    uint32_t session;
+    uint16_t gap;
+    uint8_t kind;
+    uint8_t edge;
+};
+
+inline live_event load_record(const live_record &r) {
+    constexpr std::memory_order o = std::memory_order_relaxed;
+    return live_event{r.seq.load(o),  r.ticks.load(o), r.run.load(o),  r.session.load(o),
+                      r.gap.load(o),  r.kind.load(o),  r.edge.load(o)};
+}
+
+// Creates the ring, replacing a stale one of the same name, and removes
+// the name again when destroyed (mapped readers keep their view and see
+// `closed`). Throws std::runtime_error.
+class shm_ring_writer {
+public:
+    shm_ring_writer(const std::string &name, size_t capacity);
+    ~shm_ring_writer();
+
+    shm_ring_writer(const shm_ring_writer &) = delete;
+    shm_ring_writer &operator=(const shm_ring_writer &) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Reserve sequence numbers [s, s + n) for writing and return s;
+    // n <= capacity(). Fill each with store(), then publish().
+    uint64_t claim(size_t n);
+    void store(uint64_t seq, const live_event &e);
+    void publish();
+
+    void config(const run_config &config);
+
+private:
+    std::string name_;
+    size_t mask_;
+    size_t map_size_ = 0;
+    shm_ring_header *header_ = nullptr;
+    live_record *records_ = nullptr;
+    uint64_t claimed_ = 0;
+};
+
+/*
+ * Read-only view of a ring. Records can be used in place through peek()
+ * and release(), or copied out with read().
+ */
+class shm_ring_reader {
+public:
+    // Maps "/vlog.<name>"-style `name`. The cursor starts at the newest
+    // record, or at the oldest one still held when `from_start` is set.
+    // Throws std::runtime_error if it does not exist or is not a ring.
+    explicit shm_ring_reader(const std::string &name, bool from_start = false);
+    ~shm_ring_reader();
+
+    shm_ring_reader(const shm_ring_reader &) = delete;
+    shm_ring_reader &operator=(const shm_ring_reader &) = delete;
+
+    struct span {
+        const live_record *records;
+        size_t count;
+        uint64_t first;       // Sequence number of records[0].
+    };
+
+    // Records from the cursor on, up to `max` and the end of the ring
+    // memory (call again for the rest); count 0 when caught up. Records
+    // already overwritten are skipped and counted as lost.
+    span peek(size_t max = SIZE_MAX);
+
+    // Move the cursor past a peeked span. Returns how many of its leading
+    // records were overwritten while in use; the caller must disregard
+    // what it took from them. They are counted as lost.
+    size_t release(const span &s);
+
+    // Copy up to `max` intact records out; returns the number copied.
+    size_t read(live_event *out, size_t max);
+
+    uint64_t position() const { return cursor_; }
+    uint64_t lost() const { return lost_; }
+    bool closed() const { return header_->closed.load(std::memory_order_acquire) != 0; }
+    const shm_ring_header &header() const { return *header_; }
+
+private:
+    uint64_t oldest_intact() const;
+
+    size_t mask_ = 0;
+    size_t map_size_ = 0;
+    const shm_ring_header *header_ = nullptr;
+    const live_record *records_ = nullptr;
+    uint64_t cursor_ = 0;
+    uint64_t lost_ = 0;
+};
+
+// Sink that publishes a decoded stream into a ring.
+class live_publisher : public run_sink {
+public:
+    explicit live_publisher(shm_ring_writer &ring) : ring_(ring) {}
+
+    void begin_run(const run_info &info) override;
+    void events(const event_batch &batch) override;
+    void end_run(const run_info &info) override;
+    void status(const status_record &s) override;
+
+private:
+    void put(const live_event &e);
+
+    shm_ring_writer &ring_;
+    uint32_t run_ = 0;
+    uint32_t session_ = 0;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_SHM_RING_H
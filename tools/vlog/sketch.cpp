@@ -0,0 +1,152 @@
+#include "sketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vlog {
+
+namespace {
+
+constexpr uint32_t EXACT = 1u << SKETCH_SUB_BITS;
+constexpr uint32_t HALF = EXACT / 2;
+
+}  // namespace
+
+/*
+ * Bucket index: exact below EXACT, then HALF buckets per power of two.
+ * Indices are contiguous across the boundary, so a bucket span is just a
+ * range of integers.
+ */
+uint32_t timing_sketch::bucket_of(uint64_t value) {
+    if (value < EXACT) {
+        return static_cast<uint32_t>(value);
+    }
+    const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(value));
+    const unsigned shift = msb - SKETCH_SUB_BITS + 1;
+    return shift * HALF + static_cast<uint32_t>(value >> shift);
+}
+
+uint64_t timing_sketch::bucket_low(uint32_t bucket) {
+    if (bucket < EXACT) {
+        return bucket;
+    }
+    const unsigned shift = bucket / HALF - 1;
+    return static_cast<uint64_t>(bucket - shift * HALF) << shift;
+}
+
+uint64_t timing_sketch::bucket_width(uint32_t bucket) {
+    return bucket < EXACT ? 1u : UINT64_C(1) << (bucket / HALF - 1);
+}
+
+/*
+ * Count n values in a bucket. Once SKETCH_MAX_BINS bins are in use, a new
+ * bucket below them all is counted in the lowest bin; one above pushes the
+ * lowest bin out, its count going to the next.
+ */
+void timing_sketch::bump(uint32_t bucket, uint64_t n) {
+    /* Timings cluster, and a cluster's bins are usually consecutive buckets:
+     * try the bin as far from the last one hit as the bucket is. */
+    if (hint_ < bins_.size()) {
+        const size_t guess = hint_ + (static_cast<size_t>(bucket) - bins_[hint_].bucket);
+        if (guess < bins_.size() && bins_[guess].bucket == bucket) {
+            bins_[guess].count += n;
+            hint_ = guess;
+            return;
+        }
+    }
+
+    const auto it = std::lower_bound(bins_.begin(), bins_.end(), bucket,
+                                     [](const bin &b, uint32_t v) { return b.bucket < v; });
+    size_t i = static_cast<size_t>(it - bins_.begin());
+    if (it != bins_.end() && it->bucket == bucket) {
+        it->count += n;
+    } else if (bins_.size() < SKETCH_MAX_BINS) {
+        if (bins_.size() == bins_.capacity()) {
+            bins_.reserve(std::min(SKETCH_MAX_BINS, std::max<size_t>(16, bins_.size() * 2)));
+        }
+        bins_.insert(bins_.begin() + static_cast<std::ptrdiff_t>(i), bin{bucket, n});
+    } else if (i == 0) {
+        bins_[0].count += n;
+    } else {
+        const uint64_t folded = bins_[0].count;
+        std::move(bins_.begin() + 1, bins_.begin() + static_cast<std::ptrdiff_t>(i),
+                  bins_.begin());
+        i--;
+        bins_[i] = bin{bucket, n};
+        bins_[0].count += folded;
+    }
+    hint_ = i;
+}
+
+void timing_sketch::add(uint64_t value) {
+    bump(bucket_of(value), 1);
+
+    count_++;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+
+    const double x = static_cast<double>(value);
+    const double delta = x - mean_;
+    mean_ += delta / static_cast<double>(count_);
+    m2_ += delta * (x - mean_);
+}
+
+void timing_sketch::merge(const timing_sketch &other) {
+    if (other.count_ == 0) {
+        return;
+    }
+
+    for (const bin &b : other.bins_) {
+        bump(b.bucket, b.count);
+    }
+
+    /* Chan et al. parallel combination of mean and M2. */
+    const double na = static_cast<double>(count_);
+    const double nb = static_cast<double>(other.count_);
+    const double delta = other.mean_ - mean_;
+    const double n = na + nb;
+    mean_ += delta * nb / n;
+    m2_ += other.m2_ + delta * delta * na * nb / n;
+
+    count_ += other.count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+double timing_sketch::stddev() const {
+    return count_ > 1 ? std::sqrt(m2_ / static_cast<double>(count_ - 1)) : 0.0;
+}
+
+/*
+ * Walk the buckets to the one holding rank ceil(q * count) and report its
+ * midpoint, clamped to the observed extremes. The extreme ranks are
+ * answered from min and max, so p0 and p100 stay exact when the low bins
+ * have been folded.
+ */
+double timing_sketch::quantile(double q) const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+
+    q = std::min(std::max(q, 0.0), 1.0);
+    const uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count_))));
+    if (rank == 1) {
+        return static_cast<double>(min_);
+    }
+
+    uint64_t seen = 0;
+    for (const bin &b : bins_) {
+        seen += b.count;
+        if (seen >= rank) {
+            const uint32_t bucket = b.bucket;
+            const double low = static_cast<double>(bucket_low(bucket));
+            const double width = static_cast<double>(bucket_width(bucket));
+            const double mid = width > 1.0 ? low + (width - 1.0) / 2.0 : low;
+            return std::min(std::max(mid, static_cast<double>(min_)), static_cast<double>(max_));
+        }
+    }
+    return static_cast<double>(max_);
+}
+
+}  // namespace vlog
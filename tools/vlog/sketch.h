@@ -0,0 +1,73 @@
+#ifndef VLOG_SKETCH_H
+#define VLOG_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vlog {
+
+/*
+ * Mergeable streaming histogram for timing values (HDR-histogram style).
+ *
+ * Values below 2^SKETCH_SUB_BITS ticks are counted exactly; above that each
+ * power-of-two range is split into 2^(SKETCH_SUB_BITS - 1) equal buckets,
+ * bounding the relative quantile error at 2^-(SKETCH_SUB_BITS - 1) (0.2%).
+ * At 8 MHz, intervals up to 128 us are therefore resolved to the tick.
+ *
+ * Only buckets actually hit are stored, as sorted (bucket, count) bins,
+ * and at most SKETCH_MAX_BINS of them: 8 KB, however many values a sketch
+ * absorbs. Pulse timings cluster tightly, so typically a few dozen bins are
+ * used. Past the cap the lowest bins are folded into the lowest one kept
+ * (as DDSketch does), so the top SKETCH_MAX_BINS distinct buckets keep
+ * full resolution and only quantiles that fall in the folded low tail are
+ * reported high; min() stays exact.
+ *
+ * Merging is exact: sketches built over any split of the data and merged
+ * in any order are identical to one built sequentially (mean and variance
+ * aside, which are combined in floating point). Folding preserves this,
+ * as the bins kept depend only on the set of buckets hit.
+ */
+constexpr unsigned SKETCH_SUB_BITS = 10;
+constexpr size_t SKETCH_MAX_BINS = 512;
+
+class timing_sketch {
+public:
+    void add(uint64_t value);
+    void merge(const timing_sketch &other);
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return min_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return mean_; }
+    double stddev() const;
+
+    // Nearest-rank quantile, q in [0, 1]. Returns 0 for an empty sketch.
+    double quantile(double q) const;
+
+    size_t memory_bytes() const { return sizeof(*this) + bins_.capacity() * sizeof(bin); }
+
+private:
+    struct bin {
+        uint32_t bucket;
+        uint64_t count;
+    };
+
+    static uint32_t bucket_of(uint64_t value);
+    static uint64_t bucket_low(uint32_t bucket);
+    static uint64_t bucket_width(uint32_t bucket);
+
+    void bump(uint32_t bucket, uint64_t n);
+
+    std::vector<bin> bins_;          // Ascending by bucket, at most SKETCH_MAX_BINS.
+    size_t hint_ = 0;                // Bin hit last; consecutive values mostly share one.
+    uint64_t count_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;                // Sum of squared deviations (Welford).
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_SKETCH_H
@@ -0,0 +1,387 @@
+#include "spectrum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "fft.h"
+
+namespace vlog {
+
+namespace {
+
+// Jobs queued per worker before the resampler waits.
+constexpr size_t QUEUE_DEPTH = 2;
+
+// Low bins ignored when looking for peaks (DC and window leakage).
+constexpr size_t PEAK_SKIP_BINS = 3;
+
+// Bins either side of a peak summed for its amplitude (Hann main lobe).
+constexpr size_t PEAK_HALF_WIDTH = 2;
+
+// Two real segments, transformed together as one complex FFT.
+struct segment_pair {
+    std::vector<double> a;
+    std::vector<double> b;
+    bool has_b = false;
+};
+
+class segment_queue {
+public:
+    explicit segment_queue(size_t capacity) : capacity_(capacity) {}
+
+    void push(segment_pair &&job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [&] { return jobs_.size() < capacity_; });
+        jobs_.push_back(std::move(job));
+        ready_.notify_one();
+    }
+
+    bool pop(segment_pair &job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [&] { return !jobs_.empty() || closed_; });
+        if (jobs_.empty()) {
+            return false;
+        }
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+        space_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        ready_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable space_;
+    std::deque<segment_pair> jobs_;
+    size_t capacity_;
+    bool closed_ = false;
+};
+
+/*
+ * Per-thread transform state: accumulates sum |X_k|^2 over the segments it
+ * is handed, unscaled.
+ */
+class welch_worker {
+public:
+    welch_worker(const fft &plan, const std::vector<double> &window)
+        : plan_(plan), window_(window), in_(plan.size()), out_(plan.size()),
+          power_(plan.size() / 2 + 1, 0.0) {}
+
+    void process(segment_pair &job) {
+        const size_t n = plan_.size();
+        prepare(job.a);
+        if (job.has_b) {
+            prepare(job.b);
+        } else {
+            job.b.assign(n, 0.0);
+        }
+        for (size_t j = 0; j < n; j++) {
+            in_[j] = fft::complex(job.a[j], job.b[j]);
+        }
+        plan_.forward(in_.data(), out_.data());
+
+        /* Split the spectra of the real and imaginary inputs. */
+        for (size_t k = 0; k < power_.size(); k++) {
+            const fft::complex z = out_[k];
+            const fft::complex zc = std::conj(out_[k == 0 ? 0 : n - k]);
+            power_[k] += (std::norm(z + zc) + std::norm(z - zc)) * 0.25;
+        }
+    }
+
+    const std::vector<double> &power() const { return power_; }
+
+private:
+    /* Remove the least-squares line, then apply the window. */
+    void prepare(std::vector<double> &v) const {
+        const size_t n = v.size();
+        const double mid = (static_cast<double>(n) - 1.0) / 2.0;
+        double mean = 0.0;
+        double sjv = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            mean += v[j];
+            sjv += (static_cast<double>(j) - mid) * v[j];
+        }
+        mean /= static_cast<double>(n);
+        const double sjj =
+            static_cast<double>(n) * (static_cast<double>(n) * n - 1.0) / 12.0;
+        const double slope = sjj > 0.0 ? sjv / sjj : 0.0;
+
+        for (size_t j = 0; j < n; j++) {
+            v[j] = (v[j] - mean - slope * (static_cast<double>(j) - mid)) * window_[j];
+        }
+    }
+
+    const fft &plan_;
+    const std::vector<double> &window_;
+    std::vector<fft::complex> in_;
+    std::vector<fft::complex> out_;
+    std::vector<double> power_;
+};
+
+/*
+ * Linear interpolation of (time, value) samples onto a uniform grid that
+ * starts at the first sample, cut into overlapping segments.
+ */
+class segmenter {
+public:
+    segmenter(double step, size_t length, size_t hop, std::function<void(segment_pair &&)> emit)
+        : step_(step), length_(length), hop_(hop), emit_(std::move(emit)) {}
+
+    void sample(double t, double v) {
+        if (!have_prev_) {
+            have_prev_ = true;
+            origin_ = t;
+            grid_ = t;
+        } else if (t <= prev_t_) {
+            return;
+        }
+        while (grid_ <= t) {
+            push(samples_ == 0 ? v : prev_v_ + (v - prev_v_) * (grid_ - prev_t_) / (t - prev_t_));
+            samples_++;
+            grid_ = origin_ + static_cast<double>(samples_) * step_;
+        }
+        prev_t_ = t;
+        prev_v_ = v;
+    }
+
+    void finish() {
+        if (!half_.a.empty()) {
+            emit_(std::move(half_));
+        }
+    }
+
+    uint64_t samples() const { return samples_; }
+    uint64_t segments() const { return segments_; }
+
+private:
+    void push(double v) {
+        pending_.push_back(v);
+        if (pending_.size() < length_) {
+            return;
+        }
+        segments_++;
+        if (half_.a.empty()) {
+            half_.a = pending_;
+        } else {
+            half_.b = pending_;
+            half_.has_b = true;
+            emit_(std::move(half_));
+            half_ = segment_pair();
+        }
+        pending_.erase(pending_.begin(), pending_.begin() + static_cast<ptrdiff_t>(hop_));
+    }
+
+    double step_;
+    size_t length_;
+    size_t hop_;
+    std::function<void(segment_pair &&)> emit_;
+
+    bool have_prev_ = false;
+    double origin_ = 0.0;
+    double grid_ = 0.0;
+    double prev_t_ = 0.0;
+    double prev_v_ = 0.0;
+    uint64_t samples_ = 0;
+    uint64_t segments_ = 0;
+    std::vector<double> pending_;
+    segment_pair half_;
+};
+
+/*
+ * Visit the selected edges as fn(index, contiguous), where contiguous means
+ * no events were dropped since the previous selected edge.
+ */
+template <typename Fn>
+void for_each_clock_edge(const uint8_t *edge, const uint16_t *gap, size_t n, uint8_t polarity,
+                         Fn &&fn) {
+    bool dropped = true;
+    for (size_t i = 0; i < n; i++) {
+        dropped |= gap[i] != 0;
+        if (edge[i] == polarity) {
+            fn(i, !dropped);
+            dropped = false;
+        }
+    }
+}
+
+}  // namespace
+
+timing_spectrum welch_spectrum(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                               size_t n, double tick_rate, const spectrum_options &options) {
+    if (options.segment < 2) {
+        throw std::invalid_argument("spectrum segment must hold at least two samples");
+    }
+
+    /* Mean period: the default sample rate and the TIE reference. */
+    int64_t period_sum = 0;
+    uint64_t periods = 0;
+    size_t prev = 0;
+    for_each_clock_edge(edge, gap, n, options.edge, [&](size_t i, bool contiguous) {
+        if (contiguous) {
+            period_sum += ticks[i] - ticks[prev];
+            periods++;
+        }
+        prev = i;
+    });
+    if (periods == 0) {
+        throw std::runtime_error("no complete periods for spectral analysis");
+    }
+    const double mean_period = static_cast<double>(period_sum) / static_cast<double>(periods);
+
+    timing_spectrum result;
+    result.sample_rate_hz =
+        options.sample_rate_hz > 0.0 ? options.sample_rate_hz : tick_rate / mean_period;
+    result.resolution_hz = result.sample_rate_hz / static_cast<double>(options.segment);
+
+    const size_t length = options.segment;
+    const double overlap = std::min(std::max(options.overlap, 0.0), 0.99);
+    const size_t hop = std::max<size_t>(1, static_cast<size_t>(std::lround(length * (1.0 - overlap))));
+
+    const fft plan(length);
+    std::vector<double> window(length);
+    double window_power = 0.0;
+    for (size_t j = 0; j < length; j++) {
+        window[j] = 0.5 - 0.5 * std::cos(2.0 * M_PI * static_cast<double>(j) / length);
+        window_power += window[j] * window[j];
+    }
+
+    const unsigned threads = std::max(1u, options.threads);
+    std::vector<welch_worker> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back(plan, window);
+    }
+
+    segment_queue queue(threads * QUEUE_DEPTH);
+    std::vector<std::thread> pool;
+    std::function<void(segment_pair &&)> emit;
+    if (threads == 1) {
+        emit = [&](segment_pair &&job) { workers[0].process(job); };
+    } else {
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back([&, t] {
+                segment_pair job;
+                while (queue.pop(job)) {
+                    workers[t].process(job);
+                }
+            });
+        }
+        emit = [&](segment_pair &&job) { queue.push(std::move(job)); };
+    }
+
+    /* Stream the series through the resampler; times relative to the run start. */
+    segmenter seg(tick_rate / result.sample_rate_hz, length, hop, emit);
+    const int64_t t0 = ticks[0];
+    bool first = true;
+    int64_t first_tick = 0;
+    uint64_t cycle = 0;
+    prev = 0;
+    for_each_clock_edge(edge, gap, n, options.edge, [&](size_t i, bool contiguous) {
+        const double t = static_cast<double>(ticks[i] - t0);
+        const int64_t dt = ticks[i] - ticks[prev];
+        prev = i;
+
+        if (options.series == SERIES_PERIOD) {
+            if (contiguous) {
+                seg.sample(t, static_cast<double>(dt));
+            }
+            return;
+        }
+
+        if (first) {
+            first = false;
+            first_tick = ticks[i];
+        } else if (contiguous) {
+            cycle++;
+        } else {
+            cycle += std::max<uint64_t>(1, std::llround(dt / mean_period));
+        }
+        seg.sample(t, static_cast<double>(ticks[i] - first_tick) - cycle * mean_period);
+    });
+    seg.finish();
+
+    queue.close();
+    for (std::thread &th : pool) {
+        th.join();
+    }
+
+    result.samples = seg.samples();
+    result.segments = seg.segments();
+    if (result.segments == 0) {
+        throw std::runtime_error("run too short for one segment of " + std::to_string(length) +
+                                 " samples");
+    }
+
+    /* One-sided density: double every bin except DC and Nyquist. */
+    result.psd.assign(length / 2 + 1, 0.0);
+    for (const welch_worker &w : workers) {
+        for (size_t k = 0; k < result.psd.size(); k++) {
+            result.psd[k] += w.power()[k];
+        }
+    }
+    const double scale =
+        1.0 / (result.sample_rate_hz * window_power * static_cast<double>(result.segments));
+    for (size_t k = 0; k < result.psd.size(); k++) {
+        const bool edge_bin = k == 0 || (length % 2 == 0 && k == length / 2);
+        result.psd[k] *= edge_bin ? scale : 2.0 * scale;
+    }
+
+    return result;
+}
+
+/*
+ * Peak frequency is refined by fitting a parabola to the log density of
+ * the peak bin and its neighbours.
+ */
+std::vector<spectral_peak> find_peaks(const timing_spectrum &spectrum, size_t count) {
+    const std::vector<double> &psd = spectrum.psd;
+    std::vector<size_t> bins;
+    for (size_t k = PEAK_SKIP_BINS; k + 1 < psd.size(); k++) {
+        if (psd[k] > psd[k - 1] && psd[k] >= psd[k + 1]) {
+            bins.push_back(k);
+        }
+    }
+    std::sort(bins.begin(), bins.end(), [&](size_t a, size_t b) { return psd[a] > psd[b]; });
+    bins.resize(std::min(bins.size(), count));
+
+    std::vector<spectral_peak> peaks;
+    for (size_t k : bins) {
+        double offset = 0.0;
+        if (psd[k - 1] > 0.0 && psd[k + 1] > 0.0) {
+            const double l = std::log(psd[k - 1]);
+            const double c = std::log(psd[k]);
+            const double r = std::log(psd[k + 1]);
+            const double denom = l - 2.0 * c + r;
+            offset = denom < 0.0 ? 0.5 * (l - r) / denom : 0.0;
+        }
+
+        double power = 0.0;
+        const size_t lo = k > PEAK_HALF_WIDTH ? k - PEAK_HALF_WIDTH : 0;
+        const size_t hi = std::min(psd.size() - 1, k + PEAK_HALF_WIDTH);
+        for (size_t j = lo; j <= hi; j++) {
+            power += psd[j];
+        }
+
+        spectral_peak p;
+        p.frequency_hz = (static_cast<double>(k) + offset) * spectrum.resolution_hz;
+        p.psd = psd[k];
+        p.rms = std::sqrt(power * spectrum.resolution_hz);
+        peaks.push_back(p);
+    }
+    return peaks;
+}
+
+}  // namespace vlog
@@ -0,0 +1,70 @@
+#ifndef VLOG_SPECTRUM_H
+#define VLOG_SPECTRUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "capture_run.h"
+
+namespace vlog {
+
+// Edge timing signal whose modulation is analysed.
+enum timing_series : uint8_t {
+    SERIES_PERIOD,   // Length of each period, at its ending edge.
+    SERIES_TIE,      // Edge time minus the nominal clock (mean period).
+};
+
+struct spectrum_options {
+    timing_series series = SERIES_PERIOD;
+    uint8_t edge = EDGE_RISING;
+    size_t segment = 4096;        // Welch segment (FFT) length, any size.
+    double overlap = 0.5;         // Fraction of each segment shared with the next.
+    double sample_rate_hz = 0.0;  // Resampling rate; 0 selects the edge rate.
+    unsigned threads = 1;
+};
+
+/*
+ * Welch power spectral density of a timing series.
+ *
+ * psd[k] is the one-sided density at k * resolution_hz in ticks^2/Hz, so
+ * summing psd over a peak and multiplying by resolution_hz gives the mean
+ * square of that modulation component in ticks^2.
+ */
+struct timing_spectrum {
+    double sample_rate_hz = 0.0;
+    double resolution_hz = 0.0;
+    uint64_t samples = 0;     // Resampled points produced.
+    uint64_t segments = 0;    // Segments averaged.
+    std::vector<double> psd;  // segment / 2 + 1 bins.
+};
+
+struct spectral_peak {
+    double frequency_hz;   // Interpolated between bins.
+    double psd;            // Peak bin density, ticks^2/Hz.
+    double rms;            // Component amplitude, ticks RMS.
+};
+
+/*
+ * Compute the spectrum in one streaming pass (two for SERIES_TIE, which
+ * first needs the mean period). `tick_rate` is the run's Timer1 ticks per
+ * second, tick_rate() of its config.
+ *
+ * Selected edges are turned into a series sampled at each edge, linearly
+ * interpolated onto a uniform grid, and cut into overlapping segments that
+ * are detrended, Hann windowed and transformed on a pool of `threads`
+ * workers, two real segments per complex FFT. Memory is bounded by a few
+ * segments per worker regardless of run length. Periods that span dropped
+ * events are left out and the series is interpolated across them.
+ *
+ * Throws std::runtime_error if the run is too short for one segment.
+ */
+timing_spectrum welch_spectrum(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap,
+                               size_t n, double tick_rate, const spectrum_options &options = {});
+
+// The `count` strongest local maxima, strongest first, ignoring the DC bins.
+std::vector<spectral_peak> find_peaks(const timing_spectrum &spectrum, size_t count);
+
+}  // namespace vlog
+
+#endif  // VLOG_SPECTRUM_H
@@ -0,0 +1,89 @@
+#ifndef VLOG_SPSC_RING_H
+#define VLOG_SPSC_RING_H
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace vlog {
+
+/*
+ * Lock-free single-producer / single-consumer byte ring.
+ *
+ * The producer exposes free space as up to two iovecs (the ring may wrap)
+ * so data can be read() straight into it, and publishes it with commit();
+ * the consumer likewise writes straight out of peek() and frees space with
+ * release(). Positions are free-running 64-bit counters, each written by
+ * one side only, so no locks or CAS are needed.
+ */
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t capacity) : mask_(capacity - 1), data_(new uint8_t[capacity]) {
+        if (capacity == 0 || (capacity & mask_) != 0) {
+            throw std::invalid_argument("ring capacity must be a power of two");
+        }
+    }
+
+    spsc_ring(const spsc_ring &) = delete;
+    spsc_ring &operator=(const spsc_ring &) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Bytes waiting for the consumer (approximate from the other side).
+    size_t size() const {
+        return static_cast<size_t>(head_.load(std::memory_order_acquire) -
+                                   tail_.load(std::memory_order_acquire));
+    }
+
+    /* Producer side. Returns the number of spans filled (0 if full). */
+    int prepare(iovec span[2]) {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        const uint64_t tail = tail_.load(std::memory_order_acquire);
+        return spans(head, capacity() - static_cast<size_t>(head - tail), span);
+    }
+
+    void commit(size_t n) {
+        head_.store(head_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    /* Consumer side. Returns the number of spans filled (0 if empty). */
+    int peek(iovec span[2]) {
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        return spans(tail, static_cast<size_t>(head - tail), span);
+    }
+
+    void release(size_t n) {
+        tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+private:
+    int spans(uint64_t pos, size_t len, iovec span[2]) {
+        if (len == 0) {
+            return 0;
+        }
+        const size_t at = static_cast<size_t>(pos) & mask_;
+        const size_t first = len < capacity() - at ? len : capacity() - at;
+        span[0].iov_base = data_.get() + at;
+        span[0].iov_len = first;
+        if (first == len) {
+            return 1;
+        }
+        span[1].iov_base = data_.get();
+        span[1].iov_len = len - first;
+        return 2;
+    }
+
+    const size_t mask_;
+    std::unique_ptr<uint8_t[]> data_;
+    alignas(64) std::atomic<uint64_t> head_{0};   // Producer position.
+    alignas(64) std::atomic<uint64_t> tail_{0};   // Consumer position.
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_SPSC_RING_H
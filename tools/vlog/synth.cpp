@@ -0,0 +1,148 @@
+#include "synth.h"
+
+#include <cstdio>
+
+namespace vlog {
+
+log_synth::log_synth(const synth_options &options)
+    : options_(options), rng_(options.seed != 0 ? options.seed : 1) {}
+
+// xorshift64*: cheap and reproducible across platforms.
+uint32_t log_synth::next_random() {
+    rng_ ^= rng_ >> 12;
+    rng_ ^= rng_ << 25;
+    rng_ ^= rng_ >> 27;
+    return static_cast<uint32_t>((rng_ * UINT64_C(2685821657736338717)) >> 32);
+}
+
+void log_synth::line(std::string &out, const char *text) {
+    out += text;
+    out += "\r\n";
+}
+
+void log_synth::header(std::string &out) {
+    char buf[64];
+
+    if (options_.framed) {
+        run_config config;
+        config.f_cpu = options_.f_cpu;
+        config.baud = options_.baud;
+        config.timer1_prescaler = 1;
+        config.capture_buffer_size = 64;
+        config.icnc1 = 1;
+        writer_.header(out, config);
+        return;
+    }
+
+    line(out, "# validation-logger");
+    std::snprintf(buf, sizeof(buf), "# F_CPU=%u", options_.f_cpu);
+    line(out, buf);
+    std::snprintf(buf, sizeof(buf), "# BAUD=%u", options_.baud);
+    line(out, buf);
+    line(out, "# TIMER1_PRESCALER=1");
+    line(out, "# ICNC1=ON");
+    line(out, "# CAPTURE_BUFFER_SIZE=64");
+    line(out, "# ---");
+}
+
+/* Emit every sync and status record due by the current tick. */
+void log_synth::sync(std::string &out) {
+    const uint64_t interval = static_cast<uint64_t>(options_.sync_interval * options_.f_cpu);
+    if (interval == 0) {
+        return;
+    }
+
+    while (next_sync_ <= tick_) {
+        const uint32_t t32 = static_cast<uint32_t>(next_sync_);
+        const uint16_t high_water = dropped_ != status_dropped_ ? 63 : 1;
+        status_dropped_ = dropped_;
+        if (options_.framed) {
+            writer_.sync(out, t32);
+            writer_.status(out, t32, high_water, dropped_);
+        } else {
+            char buf[64];
+            const int len = std::snprintf(buf, sizeof(buf), "# SYNC,%u\r\n# STATUS,%u,%u,%u\r\n",
+                                          t32, t32, high_water, dropped_);
+            out.append(buf, static_cast<size_t>(len));
+        }
+        next_sync_ += interval;
+    }
+}
+
+size_t log_synth::generate(std::string &out, size_t events) {
+    char buf[64];
+
+    if (!header_sent_) {
+        header_sent_ = true;
+        header(out);
+    }
+
+    size_t produced = 0;
+    while (produced < events && !finished_) {
+        if (!in_run_) {
+            if (options_.framed) {
+                writer_.start(out);
+            } else {
+                line(out, "# START");
+                line(out, "ticks,edge,dt_ticks,dropped");
+            }
+            in_run_ = true;
+            run_events_ = 0;
+            have_last_ = false;
+        }
+
+        const double share = high_ ? options_.duty : 1.0 - options_.duty;
+        int64_t interval = static_cast<int64_t>(share * options_.period_ticks);
+        if (options_.jitter_ticks > 0) {
+            interval += static_cast<int64_t>(next_random() % (2 * options_.jitter_ticks + 1)) -
+                        options_.jitter_ticks;
+        }
+        tick_ += static_cast<uint64_t>(interval > 1 ? interval : 1);
+        high_ = !high_;
+        sync(out);
+
+        const bool drop = options_.drop_rate > 0.0 &&
+                          next_random() < options_.drop_rate * 4294967296.0;
+        if (drop) {
+            dropped_++;
+        } else {
+            const uint32_t t32 = static_cast<uint32_t>(tick_);
+            const uint32_t dt = have_last_ ? t32 - last_tick_ : 0;
+            have_last_ = true;
+            last_tick_ = t32;
+            if (options_.framed) {
+                writer_.event(out, t32, high_ ? EDGE_RISING : EDGE_FALLING, dropped_);
+            } else {
+                const int len = std::snprintf(buf, sizeof(buf), "%u,%c,%u,%u\r\n", t32,
+                                              high_ ? 'R' : 'F', dt, dropped_);
+                out.append(buf, static_cast<size_t>(len));
+            }
+        }
+
+        produced++;
+        emitted_++;
+        run_events_++;
+
+        const bool last = options_.total_events != 0 && emitted_ >= options_.total_events;
+        if (last || (options_.events_per_run != 0 && run_events_ >= options_.events_per_run)) {
+            in_run_ = false;
+            finished_ = last;
+            if (options_.framed) {
+                writer_.stop(out);
+            } else {
+                line(out, "# STOP");
+                if (!last) {
+                    line(out, "alive");
+                }
+            }
+        }
+    }
+
+    /* Do not hold events back from a paced reader. */
+    if (options_.framed) {
+        writer_.flush(out);
+    }
+    return produced;
+}
+
+}  // namespace vlog
@@ -0,0 +1,76 @@
+#ifndef VLOG_SYNTH_H
+#define VLOG_SYNTH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "binary_log.h"
+
+namespace vlog {
+
+struct synth_options {
+    uint32_t f_cpu = 16000000;
+    uint32_t baud = 38400;
+    uint32_t period_ticks = 1000;   // Nominal square wave period.
+    double duty = 0.3;              // High fraction of each period.
+    uint32_t jitter_ticks = 2;      // Uniform +/- jitter on every edge interval.
+    double drop_rate = 0.0;         // Probability an event is dropped by the "ring".
+    uint64_t events_per_run = 0;    // Split into START/STOP runs; 0 = a single run.
+    uint64_t total_events = 0;      // Events to emit, 0 = unlimited.
+    uint64_t seed = 1;
+    bool framed = false;            // Binary framed encoding (binary_log.h) instead of text.
+    double sync_interval = 1.0;     // Device seconds between `# SYNC` + `# STATUS`; 0 = none.
+};
+
+/*
+ * Generator of logger serial output for tests and load generation.
+ *
+ * Produces exactly what the firmware prints: the header block, `# START`
+ * with the column header, event rows with 32-bit wrapping ticks, dt and
+ * the cumulative dropped counter, `# STOP` and the periodic `# SYNC` and
+ * `# STATUS` records, each stamped with the tick it falls due at. Status
+ * reports a full ring for intervals that dropped events and a nearly empty
+ * one otherwise. The stream is fully
+ * determined by the options, so runs are reproducible. With `framed` the
+ * same records are written in the binary framed encoding instead.
+ */
+class log_synth {
+public:
+    explicit log_synth(const synth_options &options);
+
+    // Append the next `events` events (and any due header / run lines) to out.
+    // Returns the number of events generated; 0 once total_events are done.
+    size_t generate(std::string &out, size_t events);
+
+    bool done() const { return finished_; }
+    uint64_t events() const { return emitted_; }
+
+private:
+    uint32_t next_random();
+    void line(std::string &out, const char *text);
+    void header(std::string &out);
+    void sync(std::string &out);
+
+    synth_options options_;
+    uint64_t rng_;
+    bool header_sent_ = false;
+    bool in_run_ = false;
+    bool finished_ = false;
+    uint64_t emitted_ = 0;
+    uint64_t run_events_ = 0;
+
+    uint64_t tick_ = 0;
+    uint64_t next_sync_ = 0;
+    uint32_t last_tick_ = 0;
+    bool have_last_ = false;
+    bool high_ = false;
+    uint16_t dropped_ = 0;
+    uint16_t status_dropped_ = 0;   // dropped_ at the previous status.
+
+    binary_log_writer writer_;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_SYNTH_H
@@ -0,0 +1,308 @@
+#include "tick_codec.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace vlog {
+
+namespace {
+
+/*
+ * Pack / unpack exactly 64 values at B bits.
+ *
+ * With B a template parameter and the loop fully unrolled, every word
+ * index and shift below is a constant, leaving straight-line code the
+ * compiler can schedule and vectorise freely.
+ */
+template <unsigned B>
+void pack_group(const uint64_t *in, uint64_t *out) {
+    if constexpr (B == 0) {
+        (void)in;
+        (void)out;
+    } else if constexpr (B == 64) {
+        std::memcpy(out, in, 64 * sizeof(uint64_t));
+    } else {
+        constexpr uint64_t mask = (UINT64_C(1) << B) - 1;
+        for (unsigned w = 0; w < B; w++) {
+            out[w] = 0;
+        }
+#pragma GCC unroll 64
+        for (unsigned k = 0; k < 64; k++) {
+            const unsigned bit = k * B;
+            const unsigned w = bit / 64;
+            const unsigned off = bit % 64;
+            const uint64_t v = in[k] & mask;
+            out[w] |= v << off;
+            if (off + B > 64) {
+                out[w + 1] |= v >> (64 - off);
+            }
+        }
+    }
+}
+
+template <unsigned B>
+void unpack_group(const uint64_t *in, uint64_t *out) {
+    if constexpr (B == 0) {
+        (void)in;
+        std::memset(out, 0, 64 * sizeof(uint64_t));
+    } else if constexpr (B == 64) {
+        std::memcpy(out, in, 64 * sizeof(uint64_t));
+    } else {
+        constexpr uint64_t mask = (UINT64_C(1) << B) - 1;
+#pragma GCC unroll 64
+        for (unsigned k = 0; k < 64; k++) {
+            const unsigned bit = k * B;
+            const unsigned w = bit / 64;
+            const unsigned off = bit % 64;
+            uint64_t v = in[w] >> off;
+            if (off + B > 64) {
+                v |= in[w + 1] << (64 - off);
+            }
+            out[k] = v & mask;
+        }
+    }
+}
+
+using group_fn = void (*)(const uint64_t *, uint64_t *);
+
+/* Kernel tables indexed by bit width 0..64. */
+template <size_t... B>
+struct kernel_table {
+    static constexpr group_fn pack[] = {&pack_group<B>...};
+    static constexpr group_fn unpack[] = {&unpack_group<B>...};
+};
+
+template <size_t... B>
+kernel_table<B...> make_kernel_table(std::index_sequence<B...>);
+
+using kernels = decltype(make_kernel_table(std::make_index_sequence<65>()));
+
+unsigned bit_width(uint64_t v) {
+    return v == 0 ? 0u : 64u - static_cast<unsigned>(__builtin_clzll(v));
+}
+
+size_t words_to_bytes(size_t words) {
+    return words * sizeof(uint64_t);
+}
+
+/* Residual count for a block of `n` events at the given lag. */
+size_t residual_count(size_t n, unsigned lag) {
+    return n > lag + 1 ? n - 1 - lag : 0;
+}
+
+}  // namespace
+
+size_t bitpack(const uint64_t *in, size_t n, unsigned bits, uint64_t *out) {
+    const group_fn kernel = kernels::pack[bits];
+    const size_t full = n / 64;
+
+    for (size_t g = 0; g < full; g++) {
+        kernel(in + g * 64, out + g * bits);
+    }
+
+    if (n % 64 != 0) {
+        uint64_t tail[64] = {};
+        std::memcpy(tail, in + full * 64, (n % 64) * sizeof(uint64_t));
+        kernel(tail, out + full * bits);
+    }
+
+    return bitpack_words(n, bits);
+}
+
+void bitunpack(const uint64_t *in, size_t n, unsigned bits, uint64_t *out) {
+    const group_fn kernel = kernels::unpack[bits];
+    const size_t groups = (n + 63) / 64;
+
+    for (size_t g = 0; g < groups; g++) {
+        kernel(in + g * bits, out + g * 64);
+    }
+}
+
+/*
+ * Encode one block.
+ *
+ * Interval arithmetic is done in uint64 so that pathological input (large
+ * jumps after drops, or ticks that go backwards) wraps rather than
+ * overflowing; the frame-of-reference width simply grows to cover it.
+ */
+void encode_tick_block(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap, size_t n,
+                       std::vector<uint8_t> &out) {
+    uint64_t residual[2][TICK_BLOCK_EVENTS];
+    uint64_t base[2] = {0, 0};
+    unsigned bits[2] = {0, 0};
+
+    for (unsigned lag = 1; lag <= 2; lag++) {
+        const size_t m = residual_count(n, lag);
+        uint64_t *r = residual[lag - 1];
+        int64_t lo = INT64_MAX;
+        int64_t hi = INT64_MIN;
+
+        for (size_t j = 0; j < m; j++) {
+            const size_t i = j + lag + 1;
+            const uint64_t d = static_cast<uint64_t>(ticks[i]) - static_cast<uint64_t>(ticks[i - 1]);
+            const uint64_t dl = static_cast<uint64_t>(ticks[i - lag]) -
+                                static_cast<uint64_t>(ticks[i - lag - 1]);
+            const int64_t v = static_cast<int64_t>(d - dl);
+            r[j] = static_cast<uint64_t>(v);
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+        }
+
+        if (m > 0) {
+            base[lag - 1] = static_cast<uint64_t>(lo);
+            bits[lag - 1] = bit_width(static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo));
+            for (size_t j = 0; j < m; j++) {
+                r[j] -= base[lag - 1];
+            }
+        }
+    }
+
+    const unsigned lag = bits[1] < bits[0] ? 2u : 1u;
+    const size_t m = residual_count(n, lag);
+
+    tick_block_header h;
+    std::memset(&h, 0, sizeof(h));
+    h.count = static_cast<uint32_t>(n);
+    h.first_tick = ticks[0];
+    h.seed[0] = n > 1 ? ticks[1] - ticks[0] : 0;
+    h.seed[1] = (lag == 2 && n > 2) ? ticks[2] - ticks[1] : 0;
+    h.residual_base = base[lag - 1];
+    h.lag = static_cast<uint8_t>(lag);
+    h.residual_bits = static_cast<uint8_t>(bits[lag - 1]);
+    h.first_edge = edge[0];
+
+    h.edge_mode = TICK_EDGE_ALTERNATING;
+    for (size_t i = 1; i < n; i++) {
+        if (edge[i] != (edge[i - 1] ^ 1u)) {
+            h.edge_mode = TICK_EDGE_BITMAP;
+            break;
+        }
+    }
+
+    uint16_t gap_max = 0;
+    for (size_t i = 0; i < n; i++) {
+        gap_max |= gap[i];
+    }
+    h.gap_bits = static_cast<uint8_t>(bit_width(gap_max));
+
+    const size_t residual_words = bitpack_words(m, h.residual_bits);
+    const size_t edge_words = h.edge_mode == TICK_EDGE_BITMAP ? (n + 63) / 64 : 0;
+    const size_t gap_words = bitpack_words(n, h.gap_bits);
+    h.block_bytes = static_cast<uint32_t>(
+        sizeof(h) + words_to_bytes(residual_words + edge_words + gap_words));
+
+    const size_t start = out.size();
+    out.resize(start + h.block_bytes);
+    uint8_t *dst = out.data() + start;
+    std::memcpy(dst, &h, sizeof(h));
+
+    /* Payload words are assembled in an aligned scratch area then copied. */
+    uint64_t words[TICK_BLOCK_EVENTS            /* residuals, up to 64 bits */
+                   + TICK_BLOCK_EVENTS / 64     /* edge bitmap */
+                   + TICK_BLOCK_EVENTS / 4];    /* gaps, up to 16 bits */
+    size_t w = 0;
+
+    w += bitpack(residual[lag - 1], m, h.residual_bits, words + w);
+
+    if (edge_words > 0) {
+        std::memset(words + w, 0, words_to_bytes(edge_words));
+        for (size_t i = 0; i < n; i++) {
+            words[w + i / 64] |= static_cast<uint64_t>(edge[i] & 1u) << (i % 64);
+        }
+        w += edge_words;
+    }
+
+    if (gap_words > 0) {
+        uint64_t wide[TICK_BLOCK_EVENTS];
+        for (size_t i = 0; i < n; i++) {
+            wide[i] = gap[i];
+        }
+        w += bitpack(wide, n, h.gap_bits, words + w);
+    }
+
+    std::memcpy(dst + sizeof(h), words, words_to_bytes(w));
+}
+
+size_t decode_tick_block(const uint8_t *p, size_t avail, int64_t *ticks, uint8_t *edge,
+                         uint16_t *gap) {
+    if (avail < sizeof(tick_block_header)) {
+        throw std::runtime_error("tick block: truncated header");
+    }
+
+    tick_block_header h;
+    std::memcpy(&h, p, sizeof(h));
+
+    const size_t n = h.count;
+    if (n == 0 || n > TICK_BLOCK_EVENTS || (h.lag != 1 && h.lag != 2) || h.residual_bits > 64 ||
+        h.gap_bits > 16 || h.edge_mode > TICK_EDGE_ALTERNATING) {
+        throw std::runtime_error("tick block: corrupt header");
+    }
+
+    const size_t m = residual_count(n, h.lag);
+    const size_t residual_words = bitpack_words(m, h.residual_bits);
+    const size_t edge_words = h.edge_mode == TICK_EDGE_BITMAP ? (n + 63) / 64 : 0;
+    const size_t gap_words = bitpack_words(n, h.gap_bits);
+    const size_t expect = sizeof(h) + words_to_bytes(residual_words + edge_words + gap_words);
+    if (h.block_bytes != expect || expect > avail) {
+        throw std::runtime_error("tick block: size mismatch");
+    }
+
+    const uint64_t *words = reinterpret_cast<const uint64_t *>(p + sizeof(h));
+    uint64_t tmp[TICK_BLOCK_EVENTS];
+
+    /* ---- ticks: seeds, then running sums of residual intervals ---- */
+    bitunpack(words, m, h.residual_bits, tmp);
+    words += residual_words;
+
+    ticks[0] = h.first_tick;
+    if (n > 1) {
+        ticks[1] = h.first_tick + h.seed[0];
+    }
+
+    if (h.lag == 1) {
+        uint64_t d = static_cast<uint64_t>(h.seed[0]);
+        for (size_t j = 0; j < m; j++) {
+            d += tmp[j] + h.residual_base;
+            ticks[j + 2] = static_cast<int64_t>(static_cast<uint64_t>(ticks[j + 1]) + d);
+        }
+    } else {
+        if (n > 2) {
+            ticks[2] = ticks[1] + h.seed[1];
+        }
+        uint64_t d_even = static_cast<uint64_t>(h.seed[0]);
+        uint64_t d_odd = static_cast<uint64_t>(h.seed[1]);
+        for (size_t j = 0; j < m; j++) {
+            const uint64_t d = d_even + tmp[j] + h.residual_base;
+            d_even = d_odd;
+            d_odd = d;
+            ticks[j + 3] = static_cast<int64_t>(static_cast<uint64_t>(ticks[j + 2]) + d);
+        }
+    }
+
+    /* ---- edge polarity ---- */
+    if (h.edge_mode == TICK_EDGE_ALTERNATING) {
+        for (size_t i = 0; i < n; i++) {
+            edge[i] = static_cast<uint8_t>((h.first_edge ^ i) & 1u);
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            edge[i] = static_cast<uint8_t>((words[i / 64] >> (i % 64)) & 1u);
+        }
+        words += edge_words;
+    }
+
+    /* ---- drop counts ---- */
+    if (h.gap_bits == 0) {
+        std::memset(gap, 0, n * sizeof(uint16_t));
+    } else {
+        bitunpack(words, n, h.gap_bits, tmp);
+        for (size_t i = 0; i < n; i++) {
+            gap[i] = static_cast<uint16_t>(tmp[i]);
+        }
+    }
+
+    return n;
+}
+
+}  // namespace vlog
@@ -0,0 +1,85 @@
+#ifndef VLOG_TICK_CODEC_H
+#define VLOG_TICK_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vlog {
+
+/*
+ * Block codec for edge timestamp streams.
+ *
+ * Edge ticks are monotone and, for the periodic signals we mostly capture,
+ * highly regular. Each block of up to TICK_BLOCK_EVENTS events is coded as:
+ *
+ *   ticks : first tick + seed intervals, then interval-of-interval residuals
+ *           r[i] = d[i] - d[i - lag], where d[i] = t[i] - t[i - 1]. lag 2
+ *           compares each interval with the previous one of the same
+ *           polarity, which removes the duty-cycle alternation of PWM-like
+ *           signals; lag 1 is classic delta-of-delta. The encoder picks
+ *           whichever needs fewer bits.
+ *   edge  : nothing when polarity strictly alternates, else a bitmap.
+ *   gap   : nothing when no drops occurred, else bit-packed counts.
+ *
+ * Residuals are frame-of-reference coded (offset from the block minimum)
+ * and bit-packed in groups of 64 values, each group occupying exactly
+ * `bits` 64-bit words. Pack/unpack kernels are instantiated per bit width
+ * with every shift a compile-time constant, which lets the compiler unroll
+ * and vectorise them.
+ *
+ * Every block starts with a self-contained header, so decoding may begin
+ * at any block without reference to earlier data.
+ */
+constexpr uint32_t TICK_BLOCK_EVENTS = 4096;
+
+enum : uint8_t {
+    TICK_EDGE_BITMAP = 0,
+    TICK_EDGE_ALTERNATING = 1,
+};
+
+struct tick_block_header {
+    uint32_t block_bytes;   // Header + payload, multiple of 8.
+    uint32_t count;         // Events in this block.
+    int64_t first_tick;
+    int64_t seed[2];        // d[1], d[2] (those not coded as residuals).
+    uint64_t residual_base; // Frame of reference (two's complement).
+    uint8_t lag;            // 1 or 2.
+    uint8_t residual_bits;  // 0..64.
+    uint8_t edge_mode;      // TICK_EDGE_*.
+    uint8_t first_edge;     // Polarity of event 0 (alternating mode).
+    uint8_t gap_bits;       // 0..16; 0 means no drops in the block.
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(tick_block_header) == 48, "tick_block_header layout changed");
+
+// Append one encoded block of `n` (1..TICK_BLOCK_EVENTS) events to `out`.
+void encode_tick_block(const int64_t *ticks, const uint8_t *edge, const uint16_t *gap, size_t n,
+                       std::vector<uint8_t> &out);
+
+/*
+ * Decode the block at `p` (8-byte aligned, `avail` bytes readable) into
+ * caller arrays of at least TICK_BLOCK_EVENTS entries.
+ *
+ * Returns the number of events decoded. Throws std::runtime_error if the
+ * header is inconsistent with the available bytes.
+ */
+size_t decode_tick_block(const uint8_t *p, size_t avail, int64_t *ticks, uint8_t *edge,
+                         uint16_t *gap);
+
+// Bit-pack `n` values at `bits` each into 64-bit words (groups of 64).
+// Returns the number of words written: ceil(n / 64) * bits.
+size_t bitpack(const uint64_t *in, size_t n, unsigned bits, uint64_t *out);
+
+// Inverse of bitpack(); `out` must have room for ceil(n / 64) * 64 values.
+void bitunpack(const uint64_t *in, size_t n, unsigned bits, uint64_t *out);
+
+// Words occupied by `n` values packed at `bits`.
+inline size_t bitpack_words(size_t n, unsigned bits) {
+    return (n + 63) / 64 * bits;
+}
+
+}  // namespace vlog
+
+#endif  // VLOG_TICK_CODEC_H
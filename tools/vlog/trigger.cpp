@@ -0,0 +1,537 @@
+#include "trigger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace vlog {
+
+namespace {
+
+// Predicates are reduced over blocks of this many events.
+constexpr size_t BLOCK = 64;
+
+// Edge value for history slots with no event in them; matches neither edge.
+constexpr uint8_t NO_EDGE = 2;
+
+std::runtime_error spec_error(const std::string &text, const std::string &what) {
+    return std::runtime_error("trigger '" + text + "': " + what);
+}
+
+// A duration in seconds ("12us"), or a fraction ("10%") when allowed.
+double parse_value(const std::string &spec, const std::string &s, bool fraction) {
+    const char *p = s.c_str();
+    char *stop = nullptr;
+    double v = std::strtod(p, &stop);
+    if (stop == p || v < 0.0) {
+        throw spec_error(spec, "bad value '" + s + "'");
+    }
+    const std::string unit(stop);
+    if (unit.empty() || (!fraction && unit == "s")) {
+    } else if (!fraction && unit == "ms") {
+        v *= 1e-3;
+    } else if (!fraction && (unit == "us" || unit == "\xc2\xb5s")) {
+        v *= 1e-6;
+    } else if (!fraction && unit == "ns") {
+        v *= 1e-9;
+    } else if (fraction && unit == "%") {
+        v *= 1e-2;
+    } else {
+        throw spec_error(spec, "unknown unit '" + unit + "'");
+    }
+    return v;
+}
+
+std::pair<double, double> parse_range(const std::string &spec, const std::string &s) {
+    const size_t dots = s.find("..");
+    if (dots == std::string::npos) {
+        throw spec_error(spec, "expected <min>..<max>, got '" + s + "'");
+    }
+    const std::string lo = s.substr(0, dots);
+    const std::string hi = s.substr(dots + 2);
+    std::pair<double, double> r(0.0, HUGE_VAL);
+    if (!lo.empty()) {
+        r.first = parse_value(spec, lo, false);
+    }
+    if (!hi.empty()) {
+        r.second = parse_value(spec, hi, false);
+    }
+    if (r.first > r.second) {
+        throw spec_error(spec, "empty range");
+    }
+    return r;
+}
+
+uint64_t to_ticks(double seconds, double rate) {
+    const double t = std::floor(seconds * rate + 0.5);
+    return t >= 1.8e19 ? UINT64_MAX : static_cast<uint64_t>(t);
+}
+
+}  // namespace
+
+trigger_spec parse_trigger(const std::string &text) {
+    const size_t colon = text.find(':');
+    if (colon == std::string::npos) {
+        throw spec_error(text, "expected <kind>:<argument>");
+    }
+    const std::string kind = text.substr(0, colon);
+    const std::string arg = text.substr(colon + 1);
+    trigger_spec s;
+    s.text = text;
+
+    if (kind == "high" || kind == "low" || kind == "period") {
+        s.kind = kind == "high" ? TRIGGER_HIGH : kind == "low" ? TRIGGER_LOW : TRIGGER_PERIOD;
+        const std::pair<double, double> r = parse_range(text, arg);
+        s.min = r.first;
+        s.max = r.second;
+        if (s.min == 0.0 && s.max == HUGE_VAL) {
+            throw spec_error(text, "range has no bound");
+        }
+    } else if (kind == "silence") {
+        s.kind = TRIGGER_SILENCE;
+        s.max = parse_value(text, arg, false);
+    } else if (kind == "step") {
+        s.kind = TRIGGER_STEP;
+        s.step = parse_value(text, arg, true);
+    } else if (kind == "pattern") {
+        s.kind = TRIGGER_PATTERN;
+        size_t at = 0;
+        for (;;) {
+            const size_t comma = arg.find(',', at);
+            s.pattern.push_back(parse_range(text, arg.substr(at, comma - at)));
+            if (comma == std::string::npos) {
+                break;
+            }
+            at = comma + 1;
+        }
+        if (s.pattern.size() > 64) {
+            throw spec_error(text, "pattern longer than 64 pulses");
+        }
+    } else {
+        throw spec_error(text, "unknown condition '" + kind + "'");
+    }
+    return s;
+}
+
+trigger_recorder::trigger_recorder(std::vector<trigger_spec> specs,
+                                   const trigger_options &options, window_fn on_window)
+    : specs_(std::move(specs)),
+      options_(options),
+      on_window_(std::move(on_window)),
+      conds_(specs_.size()),
+      hits_(specs_.size(), 0) {
+    for (const trigger_spec &s : specs_) {
+        need_high_ |= s.kind == TRIGGER_HIGH || s.kind == TRIGGER_PATTERN;
+        need_low_ |= s.kind == TRIGGER_LOW;
+        need_period_ |= s.kind == TRIGGER_PERIOD || s.kind == TRIGGER_STEP;
+    }
+    size_t capacity = 1;
+    while (capacity < options_.pre_events) {
+        capacity *= 2;
+    }
+    ring_mask_ = capacity - 1;
+    ring_ticks_.resize(capacity);
+    ring_edge_.resize(capacity);
+    ring_gap_.resize(capacity);
+}
+
+void trigger_recorder::begin_run(const run_info &info) {
+    info_ = info;
+    in_run_ = true;
+    rate_ = tick_rate(info.config);
+    for (size_t i = 0; i < specs_.size(); i++) {
+        const trigger_spec &s = specs_[i];
+        condition &c = conds_[i];
+        c.lo = to_ticks(s.min, rate_);
+        c.hi = s.max == HUGE_VAL ? UINT64_MAX : to_ticks(s.max, rate_);
+        c.pattern.clear();
+        for (const std::pair<double, double> &r : s.pattern) {
+            c.pattern.emplace_back(to_ticks(r.first, rate_),
+                                   r.second == HUGE_VAL ? UINT64_MAX : to_ticks(r.second, rate_));
+        }
+    }
+    /* The ring only holds the run's own history. */
+    ring_pushed_ = 0;
+    have_last_ = false;
+    reset_history();
+}
+
+void trigger_recorder::reset_history() {
+    history_ = 0;
+    have_rising_ = false;
+    dropped_since_rising_ = false;
+    last_period_ = 0;
+    for (condition &c : conds_) {
+        c.state = 0;
+        c.silence_fired = false;
+    }
+}
+
+void trigger_recorder::events(const event_batch &batch) {
+    if (!in_run_ || batch.count == 0) {
+        return;
+    }
+    const size_t n = batch.count;
+    events_seen_ += n;
+    measure(batch);
+
+    pending_.clear();
+    for (size_t i = 0; i < specs_.size(); i++) {
+        scan(i, n);
+    }
+    if (pending_.size() > 1) {
+        std::stable_sort(pending_.begin(), pending_.end(),
+                         [](const hit &a, const hit &b) { return a.index < b.index; });
+    }
+
+    size_t pos = 0;
+    for (const hit &h : pending_) {
+        route(batch, pos, h.index);
+        pos = h.index;
+        on_hit(h, &batch);
+    }
+    route(batch, pos, n);
+
+    /* Keep the last two events as the next batch's history. */
+    for (size_t k = 0; k < HISTORY; k++) {
+        t_[k] = t_[n + k];
+        e_[k] = e_[n + k];
+        g_[k] = g_[n + k];
+    }
+    history_ = std::min(HISTORY, history_ + n);
+    have_last_ = true;
+    last_ticks_ = batch.ticks[n - 1];
+    for (condition &c : conds_) {
+        c.silence_fired = false;
+    }
+}
+
+/* Derive the interval columns for the batch. Everything except periods is
+ * a function of an event and the one before it and vectorises; periods
+ * carry the last rising edge across falling ones. */
+void trigger_recorder::measure(const event_batch &batch) {
+    const size_t n = batch.count;
+    const size_t cols = n + HISTORY;
+    if (t_.size() < cols) {
+        t_.resize(cols);
+        e_.resize(cols);
+        g_.resize(cols);
+        dt_.resize(cols);
+        high_.resize(cols);
+        low_.resize(cols);
+        period_.resize(cols);
+        prev_period_.resize(cols);
+    }
+    /* Missing history: same tick (no silence), no edge, a gap. */
+    for (size_t k = history_; k < HISTORY; k++) {
+        const size_t slot = HISTORY - 1 - k;
+        t_[slot] = history_ > 0 ? t_[HISTORY - 1] : batch.ticks[0];
+        e_[slot] = NO_EDGE;
+        g_[slot] = 1;
+    }
+    std::memcpy(t_.data() + HISTORY, batch.ticks, n * sizeof(int64_t));
+    std::memcpy(e_.data() + HISTORY, batch.edge, n * sizeof(uint8_t));
+    std::memcpy(g_.data() + HISTORY, batch.gap, n * sizeof(uint16_t));
+
+    const int64_t *t = t_.data();
+    const uint8_t *e = e_.data();
+    const uint16_t *g = g_.data();
+    uint64_t *dt = dt_.data();
+    for (size_t k = HISTORY; k < cols; k++) {
+        dt[k] = static_cast<uint64_t>(t[k] - t[k - 1]);
+    }
+    if (need_high_) {
+        uint64_t *h = high_.data();
+        for (size_t k = HISTORY; k < cols; k++) {
+            const bool ok = e[k] == EDGE_FALLING && e[k - 1] == EDGE_RISING && g[k] == 0;
+            h[k] = ok ? dt[k] : 0;
+        }
+    }
+    if (need_low_) {
+        uint64_t *l = low_.data();
+        for (size_t k = HISTORY; k < cols; k++) {
+            const bool ok = e[k] == EDGE_RISING && e[k - 1] == EDGE_FALLING && g[k] == 0;
+            l[k] = ok ? dt[k] : 0;
+        }
+    }
+    if (need_period_) {
+        for (size_t k = HISTORY; k < cols; k++) {
+            dropped_since_rising_ |= g[k] != 0;
+            period_[k] = 0;
+            prev_period_[k] = last_period_;
+            if (e[k] != EDGE_RISING) {
+                continue;
+            }
+            if (have_rising_ && !dropped_since_rising_) {
+                period_[k] = static_cast<uint64_t>(t[k] - rising_);
+                last_period_ = period_[k];
+            }
+            have_rising_ = true;
+            rising_ = t[k];
+            dropped_since_rising_ = false;
+        }
+    }
+}
+
+void trigger_recorder::scan(size_t spec, size_t n) {
+    const trigger_spec &s = specs_[spec];
+    condition &c = conds_[spec];
+    const int64_t *t = t_.data() + HISTORY;
+    const uint16_t *g = g_.data() + HISTORY;
+
+    if (s.kind == TRIGGER_PATTERN) {
+        const uint64_t *h = high_.data() + HISTORY;
+        const size_t len = c.pattern.size();
+        const uint64_t done = uint64_t(1) << (len - 1);
+        for (size_t i = 0; i < n; i++) {
+            if (g[i] != 0) {
+                c.state = 0;
+            }
+            if (h[i] == 0) {
+                continue;
+            }
+            uint64_t match = 0;
+            for (size_t j = 0; j < len; j++) {
+                match |= static_cast<uint64_t>(h[i] >= c.pattern[j].first &&
+                                               h[i] <= c.pattern[j].second) << j;
+            }
+            c.state = ((c.state << 1) | 1) & match;
+            if (c.state & done) {
+                pending_.push_back(hit{i, spec, t[i], static_cast<int64_t>(h[i])});
+            }
+        }
+        return;
+    }
+
+    const uint64_t lo = c.lo;
+    const uint64_t hi = c.hi;
+    const double step = s.step;
+    const uint64_t *v = nullptr;
+    switch (s.kind) {
+    case TRIGGER_HIGH:
+        v = high_.data() + HISTORY;
+        break;
+    case TRIGGER_LOW:
+        v = low_.data() + HISTORY;
+        break;
+    case TRIGGER_PERIOD:
+    case TRIGGER_STEP:
+        v = period_.data() + HISTORY;
+        break;
+    case TRIGGER_SILENCE:
+        v = dt_.data() + HISTORY;
+        break;
+    default:
+        return;
+    }
+    const uint64_t *prev = prev_period_.data() + HISTORY;
+
+    for (size_t b = 0; b < n; b += BLOCK) {
+        const size_t m = std::min(BLOCK, n - b);
+        unsigned any = 0;
+        if (s.kind == TRIGGER_STEP) {
+            for (size_t j = b; j < b + m; j++) {
+                const double d = static_cast<double>(v[j]) - static_cast<double>(prev[j]);
+                any |= (v[j] != 0) & (prev[j] != 0) &
+                       (std::fabs(d) > step * static_cast<double>(prev[j]));
+            }
+        } else if (s.kind == TRIGGER_SILENCE) {
+            for (size_t j = b; j < b + m; j++) {
+                any |= v[j] > hi;
+            }
+        } else {
+            for (size_t j = b; j < b + m; j++) {
+                any |= (v[j] != 0) & ((v[j] < lo) | (v[j] > hi));
+            }
+        }
+        if (!any) {
+            continue;
+        }
+
+        for (size_t j = b; j < b + m; j++) {
+            bool fire;
+            if (s.kind == TRIGGER_STEP) {
+                const double d = static_cast<double>(v[j]) - static_cast<double>(prev[j]);
+                fire = v[j] != 0 && prev[j] != 0 &&
+                       std::fabs(d) > step * static_cast<double>(prev[j]);
+            } else if (s.kind == TRIGGER_SILENCE) {
+                /* Already reported from device time while it lasted. */
+                fire = v[j] > hi && !(j == 0 && c.silence_fired);
+            } else {
+                fire = v[j] != 0 && (v[j] < lo || v[j] > hi);
+            }
+            if (!fire) {
+                continue;
+            }
+            /* Too long is known as soon as the limit passes. */
+            int64_t when = t[j];
+            if (s.kind == TRIGGER_SILENCE || (s.kind != TRIGGER_STEP && v[j] > hi)) {
+                when = t[j] - static_cast<int64_t>(v[j]) + static_cast<int64_t>(hi);
+            }
+            pending_.push_back(hit{j, spec, when, static_cast<int64_t>(v[j])});
+        }
+    }
+}
+
+void trigger_recorder::route(const event_batch &batch, size_t begin, size_t end) {
+    while (begin < end) {
+        if (!open_) {
+            push_ring(batch, begin, end);
+            return;
+        }
+        const int64_t *stop =
+            std::upper_bound(batch.ticks + begin, batch.ticks + end, window_.end);
+        const size_t j = static_cast<size_t>(stop - batch.ticks);
+        capture_run &w = window_.events;
+        w.ticks.insert(w.ticks.end(), batch.ticks + begin, batch.ticks + j);
+        w.edge.insert(w.edge.end(), batch.edge + begin, batch.edge + j);
+        w.gap.insert(w.gap.end(), batch.gap + begin, batch.gap + j);
+        push_ring(batch, begin, j);
+        if (j == end) {
+            return;
+        }
+        close_window(false);
+        begin = j;
+    }
+}
+
+void trigger_recorder::push_ring(const event_batch &batch, size_t begin, size_t end) {
+    const size_t capacity = ring_mask_ + 1;
+    if (end - begin > capacity) {
+        ring_pushed_ += end - begin - capacity;
+        begin = end - capacity;
+    }
+    while (begin < end) {
+        const size_t at = static_cast<size_t>(ring_pushed_) & ring_mask_;
+        const size_t n = std::min(end - begin, capacity - at);
+        std::memcpy(&ring_ticks_[at], batch.ticks + begin, n * sizeof(int64_t));
+        std::memcpy(&ring_edge_[at], batch.edge + begin, n * sizeof(uint8_t));
+        std::memcpy(&ring_gap_[at], batch.gap + begin, n * sizeof(uint16_t));
+        ring_pushed_ += n;
+        begin += n;
+    }
+}
+
+void trigger_recorder::on_hit(const hit &h, const event_batch *batch) {
+    hits_[h.spec]++;
+    const int64_t post = static_cast<int64_t>(to_ticks(options_.post, rate_));
+    const int64_t completed = batch != nullptr && h.index != SIZE_MAX ? batch->ticks[h.index]
+                                                                      : h.ticks;
+    if (open_ && completed > window_.end) {
+        close_window(false);
+    }
+    if (open_) {
+        window_.hits++;
+        window_.end = std::min(std::max(window_.end, h.ticks + post), limit_);
+        return;
+    }
+
+    open_ = true;
+    window_.index = static_cast<uint32_t>(windows_);
+    window_.spec = h.spec;
+    window_.trigger_ticks = h.ticks;
+    window_.value = h.value;
+    window_.hits = 1;
+    window_.start = h.ticks - static_cast<int64_t>(to_ticks(options_.pre, rate_));
+    window_.end = h.ticks + post;
+    limit_ = std::max(window_.end,
+                      h.ticks + static_cast<int64_t>(to_ticks(options_.max_window, rate_)));
+
+    /* The pre-trigger part is whatever the ring still holds of it. */
+    capture_run &w = window_.events;
+    w.ticks.clear();
+    w.edge.clear();
+    w.gap.clear();
+    const size_t capacity = ring_mask_ + 1;
+    const uint64_t held = std::min<uint64_t>(ring_pushed_, capacity);
+    uint64_t lo = ring_pushed_ - held;
+    uint64_t hi = ring_pushed_;
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (ring_ticks_[mid & ring_mask_] < window_.start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    window_.pre_truncated = ring_pushed_ > capacity && lo == ring_pushed_ - held;
+    for (uint64_t s = lo; s < ring_pushed_; s++) {
+        const size_t at = static_cast<size_t>(s) & ring_mask_;
+        w.ticks.push_back(ring_ticks_[at]);
+        w.edge.push_back(ring_edge_[at]);
+        w.gap.push_back(ring_gap_[at]);
+    }
+}
+
+void trigger_recorder::close_window(bool truncated) {
+    if (!open_) {
+        return;
+    }
+    open_ = false;
+    capture_run &w = window_.events;
+    w.info = info_;
+    w.info.event_count = w.size();
+    w.info.dropped = 0;
+    for (uint16_t gap : w.gap) {
+        w.info.dropped += gap;
+    }
+    w.info.truncated = truncated;
+    windows_++;
+    on_window_(window_);
+}
+
+void trigger_recorder::advance(int64_t ticks) {
+    if (!in_run_) {
+        return;
+    }
+    if (open_ && ticks > window_.end) {
+        close_window(false);
+    }
+    if (!have_last_) {
+        return;
+    }
+    for (size_t i = 0; i < specs_.size(); i++) {
+        condition &c = conds_[i];
+        if (specs_[i].kind != TRIGGER_SILENCE || c.silence_fired || ticks <= last_ticks_ ||
+            static_cast<uint64_t>(ticks - last_ticks_) <= c.hi) {
+            continue;
+        }
+        c.silence_fired = true;
+        on_hit(hit{SIZE_MAX, i, last_ticks_ + static_cast<int64_t>(c.hi),
+                   ticks - last_ticks_},
+               nullptr);
+        if (ticks > window_.end) {
+            close_window(false);
+        }
+    }
+}
+
+/* The firmware stopped reporting edges one by one; intervals restart
+ * after the window, and edges it counted are not silence. */
+void trigger_recorder::summary(const summary_window &w) {
+    if (!in_run_) {
+        return;
+    }
+    advance(w.end);
+    reset_history();
+    if (w.edges != 0) {
+        have_last_ = true;
+        last_ticks_ = w.end;
+    }
+}
+
+void trigger_recorder::end_run(const run_info &) {
+    close_window(true);
+    in_run_ = false;
+}
+
+void trigger_recorder::sync(const sync_point &s) {
+    advance(s.ticks);
+}
+
+void trigger_recorder::status(const status_record &s) {
+    advance(s.ticks);
+}
+
+}  // namespace vlog
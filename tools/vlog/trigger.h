@@ -0,0 +1,188 @@
+#ifndef VLOG_TRIGGER_H
+#define VLOG_TRIGGER_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "capture_run.h"
+#include "log_decoder.h"
+
+namespace vlog {
+
+/*
+ * Trigger conditions on a decoded event stream.
+ *
+ *   high:<min>..<max>      high time outside [min, max]
+ *   low:<min>..<max>       low time outside [min, max]
+ *   period:<min>..<max>    period outside [min, max]
+ *   silence:<t>            no edge for longer than t
+ *   step:<fraction>        period differs from the one before by more
+ *                          than fraction of it
+ *   pattern:<r>,<r>,...    consecutive high times falling in each range
+ *                          r = <min>..<max> in turn (at most 64)
+ *
+ * Either bound of a range may be left out. Durations take a unit of s,
+ * ms, us or ns (default s); a fraction may be given in %. Measurements
+ * follow for_each_interval(): none spans a dropped event or a run boundary.
+ */
+enum trigger_kind : uint8_t {
+    TRIGGER_HIGH,
+    TRIGGER_LOW,
+    TRIGGER_PERIOD,
+    TRIGGER_SILENCE,
+    TRIGGER_STEP,
+    TRIGGER_PATTERN,
+};
+
+struct trigger_spec {
+    trigger_kind kind = TRIGGER_HIGH;
+    std::string text;                                  // As written.
+    double min = 0.0;                                  // Seconds.
+    double max = HUGE_VAL;                             // Seconds; silence: the limit.
+    double step = 0.0;                                 // TRIGGER_STEP fraction.
+    std::vector<std::pair<double, double>> pattern;    // High-time ranges, seconds.
+};
+
+// Parse one condition; throws std::runtime_error describing the problem.
+trigger_spec parse_trigger(const std::string &text);
+
+struct trigger_options {
+    double pre = 0.01;           // Seconds recorded before a trigger.
+    double post = 0.01;          // Seconds after; a trigger within extends it.
+    double max_window = 1.0;     // Longest extension past the first trigger.
+    size_t pre_events = 1 << 20; // Pre-trigger ring capacity (rounded up to 2^n).
+};
+
+// One recorded window, handed out once it closes.
+struct trigger_window {
+    uint32_t index = 0;          // Windows recorded before this one.
+    size_t spec = 0;             // Condition that opened it.
+    int64_t trigger_ticks = 0;   // When it became true, extended ticks.
+    int64_t value = 0;           // Offending measurement in ticks (pattern:
+                                 // the last high time; silence: the gap).
+    uint32_t hits = 0;           // Triggers that fired inside the window.
+    int64_t start = 0;           // Requested span, extended ticks.
+    int64_t end = 0;
+    bool pre_truncated = false;  // The ring no longer held the window's start.
+    capture_run events;          // info: the run's; truncated if it ended early.
+};
+
+/*
+ * Records pre/post windows around triggers on a live stream.
+ *
+ * Every event passes through a ring of the last `pre_events` events
+ * until a condition fires; the window then takes the ring's events from
+ * `pre` before the trigger and every event up to `post` after it, and is
+ * passed to the callback when it closes (on the first event beyond it, or
+ * when device time from sync, status or summary records passes it, or at
+ * the end of the run). Windows never span runs.
+ *
+ * Conditions are evaluated per batch, one column at a time: interval
+ * lengths are derived for the whole batch, then each predicate is tested
+ * over blocks of events with a branch-free reduction, and only a block
+ * that contains a hit is walked to find it. Patterns, which carry state
+ * from pulse to pulse, match with a bit-parallel shift-and automaton.
+ *
+ * Silence is also checked against device time from sync and status
+ * records, so a signal that stops altogether still triggers once.
+ */
+class trigger_recorder : public run_sink {
+public:
+    using window_fn = std::function<void(const trigger_window &)>;
+
+    trigger_recorder(std::vector<trigger_spec> specs, const trigger_options &options,
+                     window_fn on_window);
+
+    void begin_run(const run_info &info) override;
+    void events(const event_batch &batch) override;
+    void summary(const summary_window &w) override;
+    void end_run(const run_info &info) override;
+    void sync(const sync_point &s) override;
+    void status(const status_record &s) override;
+
+    const std::vector<trigger_spec> &specs() const { return specs_; }
+    const std::vector<uint64_t> &hits() const { return hits_; }  // Per spec.
+    uint64_t windows() const { return windows_; }
+    uint64_t events_seen() const { return events_seen_; }
+
+private:
+    // A spec resolved to ticks for the current run.
+    struct condition {
+        uint64_t lo = 0;
+        uint64_t hi = UINT64_MAX;
+        std::vector<std::pair<uint64_t, uint64_t>> pattern;
+        uint64_t state = 0;          // Shift-and: bit j = prefix of j + 1 matched.
+        bool silence_fired = false;  // Already reported from device time.
+    };
+
+    struct hit {
+        size_t index;                // Event completing it; SIZE_MAX: none.
+        size_t spec;
+        int64_t ticks;
+        int64_t value;
+    };
+
+    void reset_history();
+    void measure(const event_batch &batch);
+    void scan(size_t spec, size_t n);
+    void route(const event_batch &batch, size_t begin, size_t end);
+    void on_hit(const hit &h, const event_batch *batch);
+    void push_ring(const event_batch &batch, size_t begin, size_t end);
+    void advance(int64_t ticks);
+    void close_window(bool truncated);
+
+    std::vector<trigger_spec> specs_;
+    trigger_options options_;
+    window_fn on_window_;
+    std::vector<condition> conds_;
+    bool need_high_ = false;
+    bool need_low_ = false;
+    bool need_period_ = false;
+
+    bool in_run_ = false;
+    run_info info_;
+    double rate_ = 0.0;
+
+    // Two events of history, then the batch: column k holds event k - 2.
+    static constexpr size_t HISTORY = 2;
+    std::vector<int64_t> t_;
+    std::vector<uint8_t> e_;
+    std::vector<uint16_t> g_;
+    std::vector<uint64_t> dt_;
+    std::vector<uint64_t> high_;
+    std::vector<uint64_t> low_;
+    std::vector<uint64_t> period_;
+    std::vector<uint64_t> prev_period_;
+    size_t history_ = 0;             // Valid history events, 0..2.
+    bool have_rising_ = false;
+    int64_t rising_ = 0;
+    bool dropped_since_rising_ = false;
+    uint64_t last_period_ = 0;
+    bool have_last_ = false;
+    int64_t last_ticks_ = 0;
+    std::vector<hit> pending_;
+
+    // Pre-trigger ring.
+    size_t ring_mask_ = 0;
+    std::vector<int64_t> ring_ticks_;
+    std::vector<uint8_t> ring_edge_;
+    std::vector<uint16_t> ring_gap_;
+    uint64_t ring_pushed_ = 0;
+
+    bool open_ = false;
+    int64_t limit_ = 0;              // Latest end extensions may reach.
+    trigger_window window_;
+
+    std::vector<uint64_t> hits_;
+    uint64_t windows_ = 0;
+    uint64_t events_seen_ = 0;
+};
+
+}  // namespace vlog
+
+#endif  // VLOG_TRIGGER_H